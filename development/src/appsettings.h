@@ -11,6 +11,7 @@ typedef struct appSettings {
     int timeslice;
     double chargePerTimeslice;
     int chargePrecision;
+    QString tariffFile;   /* declarative tariff (empty for the linear charge). */
 } appSettings;
 
 /* the default, maximum, minimum parking capacity. */
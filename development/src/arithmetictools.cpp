@@ -31,3 +31,13 @@ bool
 isGreaterThan(const double a, const double b) {
     return (a - b) > ((fabs(a) < fabs(b) ? fabs(b) : fabs(a)) * std::numeric_limits<double>::epsilon());
 }
+
+/* return the percentile p (0..1) of sorted values (0 if none). */
+qint64
+percentile(const QVector<qint64> &sorted, const double p) {
+    if (sorted.isEmpty()) return 0;
+
+    const int index = qBound(0, (int) (p * sorted.size() + 0.5) - 1, sorted.size() - 1);
+
+    return sorted.at(index);
+}
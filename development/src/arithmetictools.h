@@ -6,10 +6,16 @@
 #include <cmath>
 #include <limits>
 
+/* include some QT libraries. */
+#include <QVector>
+
 /* check if double a is less than double b. */
 bool isLessThan(const double a, const double b);
 
 /* check if double a is greater than double b. */
 bool isGreaterThan(const double a, const double b);
 
+/* return the percentile p (0..1) of sorted values (0 if none). */
+qint64 percentile(const QVector<qint64> &sorted, const double p);
+
 #endif // ARITHMETICTOOLS_H
@@ -0,0 +1,199 @@
+/*
+ *  This file implements the in-memory balances of the credit card members.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <QtSql>
+#include <climits>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "balanceledger.h"
+#include "globaldeclarations.h"
+
+/* the units of an account not opened yet (never a balance). */
+static const int NO_BALANCE = INT_MIN;
+
+/* create an empty table (load it before sharing it). */
+BalanceLedger::BalanceLedger() {
+    accounts = new account[MIN_BALANCE_ACCOUNTS];
+    mask = MIN_BALANCE_ACCOUNTS - 1;
+
+    for (int i = 0; i <= mask; i++) accounts[i].units = NO_BALANCE;
+}
+
+/* delete the table. */
+BalanceLedger::~BalanceLedger() {
+    delete [] accounts;
+}
+
+/* load the balances of the credit card members (their card money and the
+   ledger entries not applied to it). not thread safe, call it before the
+   table is shared with the lanes. */
+bool
+BalanceLedger::load(QSqlDatabase db) {
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    if (!query.exec(QString("SELECT cust.id, IFNULL(cust.card_money, 0) + "
+                            "       IFNULL((SELECT SUM(amount) FROM ledger WHERE ledger.cust_id = cust.id AND ledger.applied = 0), 0) "
+                            "FROM customer AS cust WHERE cust.card_id = %1").arg(CreditCardType + 1))) /* for fixing with indexes. */
+        return false;
+
+    QList<int> ids;
+    QList<double> balances;
+
+    while (query.next()) {
+        ids << query.value(0).toInt();
+        balances << query.value(1).toDouble();
+    }
+
+    if (query.lastError().isValid()) return false;
+
+    /* a table at most a quarter full (the new members fit too). */
+    int size = MIN_BALANCE_ACCOUNTS;
+    while (size < ids.size() * 4 && size < (1 << 30)) size <<= 1;
+
+    delete [] accounts;
+    accounts = new account[size];
+    mask = size - 1;
+
+    for (int i = 0; i <= mask; i++) accounts[i].units = NO_BALANCE;
+
+    for (int i = 0; i < ids.size(); i++)
+        if (!open(ids.at(i), balances.at(i))) return false;
+
+    return true;
+}
+
+/* open the account of a member with a balance (or set its balance). */
+bool
+BalanceLedger::open(const int custId, const double balance) {
+    if (!fits(balance)) return false;
+
+    const qint64 units = toUnits(balance);
+
+    account *a = find(custId, true);
+    if (!a) return false;
+
+    a->units.fetchAndStoreOrdered((int) units);
+
+    return true;
+}
+
+/* check and debit the balance of a member in one atomic step. */
+BalanceLedger::debitResult
+BalanceLedger::debit(const int custId, const double amount, double *balance) {
+    account *a = find(custId, false);
+    if (!a) return Debit_NoAccount;
+
+    const qint64 units = toUnits(amount);
+    if (units < 0) return Debit_NotEnoughMoney;
+
+    forever {
+        const int current = a->units;
+
+        if (current == NO_BALANCE) return Debit_NoAccount;
+        if (current < units) return Debit_NotEnoughMoney;
+
+        /* only if nobody changed the balance since we read it. */
+        if (a->units.testAndSetOrdered(current, current - (int) units)) {
+            if (balance) *balance = fromUnits(current - units);
+            return Debit_Ok;
+        }
+    }
+}
+
+/* credit the balance of a member (a top up or a debit undone). */
+bool
+BalanceLedger::credit(const int custId, const double amount) {
+    account *a = find(custId, false);
+    if (!a) return false;
+
+    const qint64 units = toUnits(amount);
+    if (units < 0) return false;
+
+    forever {
+        const int current = a->units;
+
+        if (current == NO_BALANCE || current + units > INT_MAX) return false;
+
+        if (a->units.testAndSetOrdered(current, current + (int) units)) return true;
+    }
+}
+
+/* the balance of a member (false if it has no account). */
+bool
+BalanceLedger::balance(const int custId, double &value) const {
+    account *a = find(custId, false);
+    if (!a) return false;
+
+    const int units = a->units;
+    if (units == NO_BALANCE) return false;
+
+    value = fromUnits(units);
+
+    return true;
+}
+
+/* money in units (rounded). */
+qint64
+BalanceLedger::toUnits(const double money) {
+    return qRound64(money * BALANCE_UNITS);
+}
+
+/* check if some money can be a balance (in units, in an integer). */
+bool
+BalanceLedger::fits(const double money) {
+    const qint64 units = toUnits(money);
+
+    return units > NO_BALANCE && units <= INT_MAX;
+}
+
+/* units in money. */
+double
+BalanceLedger::fromUnits(const qint64 units) {
+    return (double) units / BALANCE_UNITS;
+}
+
+/* find the account of a member (linear probing), claiming a free one
+   for it if asked. 0 if it is not found (or the table is full). */
+BalanceLedger::account *
+BalanceLedger::find(const int custId, const bool add) const {
+    if (custId <= 0) return 0;
+
+    int i = (int) (((quint32) custId * 2654435761U) & (quint32) mask);
+
+    for (int probes = 0; probes <= mask; probes++, i = (i + 1) & mask) {
+        const int id = accounts[i].custId;
+
+        if (id == custId) return &accounts[i];
+
+        if (!id) {
+            if (!add) return 0;
+
+            /* claim the free account (else somebody else did, look again). */
+            if (accounts[i].custId.testAndSetOrdered(0, custId)) return &accounts[i];
+            if ((int) accounts[i].custId == custId) return &accounts[i];
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+/* header defining the interface of the source. */
+#ifndef BALANCELEDGER_H
+#define BALANCELEDGER_H
+
+/* include some QT libraries. */
+#include <QAtomicInt>
+#include <QSqlDatabase>
+
+/* the balances are kept in thousandths of the money (the default charge precision). */
+static const int BALANCE_UNITS = 1000;
+
+/* the fewest accounts of the balance table (a power of 2). */
+static const int MIN_BALANCE_ACCOUNTS = 1024;
+
+/* the default msecs between the snapshots of the balances to the customers. */
+static const int DEF_BALANCE_SNAPSHOT_INTERVAL = 60000;
+
+/* class which implements the in-memory balances of the credit card
+   members. the DB keeps an append-only ledger of every debit and credit,
+   the card money of a customer is the snapshot of its balance (the ledger
+   entries not applied yet are added to it).
+
+   the balances are an open addressing table of atomic integers, so any
+   number of lanes can check-and-debit a balance with compare-and-swap,
+   without locks and without a read-then-write race. the table is filled
+   by load() before it is shared and an account is added at most once.
+   it does not grow while shared: a member who finds it full has no
+   account and is debited on the DB (see ParkingEngine::debitCard), the
+   next load() makes room for it. */
+class BalanceLedger
+{
+    public:
+        /* debit results enumeration data type. */
+        typedef enum debitResult {
+            Debit_Ok = 0,
+            Debit_NotEnoughMoney,
+            Debit_NoAccount
+        } debitResult;
+
+        BalanceLedger();
+        ~BalanceLedger();
+
+        bool load(QSqlDatabase db);
+
+        bool open(const int custId, const double balance);
+        debitResult debit(const int custId, const double amount, double *balance = 0);
+        bool credit(const int custId, const double amount);
+        bool balance(const int custId, double &value) const;
+
+        static bool fits(const double money);
+        static qint64 toUnits(const double money);
+        static double fromUnits(const qint64 units);
+
+    private:
+        /* account of the table structure data type. */
+        struct account {
+            QAtomicInt custId;  /* 0 for a free account. */
+            QAtomicInt units;   /* NO_BALANCE until it is opened. */
+        };
+
+        account *find(const int custId, const bool add) const;
+
+        account *accounts;
+        int mask;               /* accounts - 1. */
+
+        Q_DISABLE_COPY(BalanceLedger)
+};
+
+#endif // BALANCELEDGER_H
@@ -17,33 +17,200 @@
  *  along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
-/* include header defining the interface of the source. */
+/* include some QT libraries. */
+#include <QtCore>
+
+/* include headers defining the interface of the sources. */
 #include "bankingtools.h"
+#include "appsettings.h"
+#include "databasetools.h"
+#include "connectionpool.h"
+
+/* the default payment processor and end of day capture time. */
+static const QString defPaymentProviderStr = "mock";
+static const QString defCaptureTimeStr     = "23:30";
+
+/* the digits of an issuer identification number (the start of a card number). */
+static const int BIN_DIGITS = 6;
+
+/* issuer range structure data type (of the first BIN_DIGITS digits). */
+typedef struct binRange {
+    int low;
+    int high;
+    int minDigits;        /* lengths of the card numbers of the range. */
+    int maxDigits;
+    creditCardType type;
+} binRange;
+
+/* the issuer ranges, sorted and not overlapping (a binary search finds
+   the range of a number). the brands sharing a prefix are cut around
+   the narrower range. */
+static const binRange binRanges[] = {
+    { 222100, 272099, 16, 16, creditCardMasterCard },
+    { 300000, 305999, 14, 19, creditCardDiners },
+    { 340000, 349999, 15, 15, creditCardAmex },
+    { 352800, 358999, 16, 19, creditCardJcb },
+    { 360000, 369999, 14, 19, creditCardDiners },
+    { 370000, 379999, 15, 15, creditCardAmex },
+    { 380000, 399999, 16, 19, creditCardDiners },
+    { 400000, 499999, 13, 19, creditCardVisa },
+    { 500000, 509999, 12, 19, creditCardMaestro },
+    { 510000, 559999, 16, 16, creditCardMasterCard },
+    { 560000, 589999, 12, 19, creditCardMaestro },
+    { 601100, 601199, 16, 19, creditCardDiscover },
+    { 620000, 629999, 16, 19, creditCardUnionPay },
+    { 644000, 659999, 16, 19, creditCardDiscover },
+    { 670000, 679999, 12, 19, creditCardMaestro }
+};
+
+static const int BIN_RANGES_COUNT = sizeof(binRanges) / sizeof(binRanges[0]);
 
-/* get the type of the credit card. */
+/* a digit doubled by the Luhn check (with the digits of the product summed). */
+static const int luhnDoubled[10] = { 0, 2, 4, 6, 8, 1, 3, 5, 7, 9 };
+
+/* get the digits of a card number (spaces and dashes skipped), their
+   count or -1 if there is any other character or too many digits. */
+int
+cardNumberDigits(const QString &cardNumber, char *digits) {
+    const QChar *c = cardNumber.constData();
+    int count = 0;
+
+    for (int i = 0; i < cardNumber.size(); i++) {
+        const ushort u = c[i].unicode();
+
+        if (u >= '0' && u <= '9') {
+            if (count == MAX_CARD_DIGITS) return -1;
+            digits[count++] = (char) (u - '0');
+        }
+        else if (u != ' ' && u != '-') {
+            return -1;
+        }
+    }
+
+    return count;
+}
+
+/* check the Luhn (mod 10) check digit of some digits (0 to 9 values). */
+bool
+isLuhnValid(const char *digits, const int count) {
+    int sum = 0;
+
+    /* every second digit from the check digit (the last one) is doubled. */
+    for (int i = count - 1, doubled = 0; i >= 0; i--, doubled ^= 1)
+        sum += doubled ? luhnDoubled[(int) digits[i]] : digits[i];
+
+    return count > 0 && sum % 10 == 0;
+}
+
+/* get the type of the credit card (creditCardError for a number which is
+   malformed, fails the check digit or has no known issuer range). */
 creditCardType
 getCreditCardType(const QString cardNumber) {
-    /* here goes code for card type recognition (visa, mastercard). */
+    char digits[MAX_CARD_DIGITS];
+    const int count = cardNumberDigits(cardNumber, digits);
+
+    if (count < MIN_CARD_DIGITS || !isLuhnValid(digits, count)) return creditCardError;
+
+    int bin = 0;
+    for (int i = 0; i < BIN_DIGITS; i++) bin = bin * 10 + digits[i];
+
+    /* the last range starting at or before the number. */
+    int low = 0, high = BIN_RANGES_COUNT;
+
+    while (low < high) {
+        const int middle = (low + high) / 2;
+
+        if (binRanges[middle].low <= bin) low = middle + 1;
+        else high = middle;
+    }
+
+    if (!low) return creditCardError;
+
+    const binRange &range = binRanges[low - 1];
+
+    if (bin > range.high || count < range.minDigits || count > range.maxDigits)
+        return creditCardError;
+
+    return range.type;
+}
 
-    /* assume that card type was Visa. */
-    return creditCardVisa;
+/* the printable name of a credit card type. */
+QString
+creditCardName(const creditCardType type) {
+    switch (type) {
+        case creditCardVisa:       return "Visa";
+        case creditCardMasterCard: return "MasterCard";
+        case creditCardAmex:       return "American Express";
+        case creditCardDiscover:   return "Discover";
+        case creditCardDiners:     return "Diners Club";
+        case creditCardJcb:        return "JCB";
+        case creditCardUnionPay:   return "UnionPay";
+        case creditCardMaestro:    return "Maestro";
+        default:                   return "unknown";
+    }
 }
 
-/* we need here an OO factory pattern. */
+/* create the payment processor of the given name (0 if it is unknown). */
+PaymentProvider *
+createPaymentProvider(const QString &name) {
+    QSettings s(setsAppOrg, setsAppName);
 
-/* try to charge the credit card. */
-bool
-chargeCreditCard(const QString cardNumber, const double charge) {
-    const creditCardType cardtype = getCreditCardType(cardNumber);
+    /* the local processor (for testing, or until a bank is configured). */
+    if (name == "mock")
+        return new MockPaymentProvider(s.value("payment/mock_latency", DEF_MOCK_LATENCY).toInt(),
+                                       s.value("payment/mock_decline_rate", DEF_MOCK_DECLINE_RATE).toInt(),
+                                       s.value("payment/mock_failure_rate", DEF_MOCK_FAILURE_RATE).toInt(),
+                                       (uint) QDateTime::currentDateTime().toTime_t());
+
+    return 0;
+}
+
+/* the payment gateway of the application (created from the settings once). */
+PaymentGateway *
+paymentGateway() {
+    static PaymentGateway *gateway = 0;
+
+    if (!gateway) {
+        QSettings s(setsAppOrg, setsAppName);
+
+        /* an unknown processor falls back to the local one. */
+        PaymentProvider *provider = createPaymentProvider(s.value("payment/provider", defPaymentProviderStr).toString());
+        if (!provider) provider = createPaymentProvider(defPaymentProviderStr);
+
+        /* it lives as long as the application. */
+        gateway = new PaymentGateway(provider, QCoreApplication::instance());
+        gateway->setTimeout(s.value("payment/timeout", DEF_PAYMENT_TIMEOUT).toInt());
+        gateway->setRetries(s.value("payment/retries", DEF_PAYMENT_RETRIES).toInt());
+
+        /* the approved payments are captured at the end of the day. */
+        QTime captureTime = QTime::fromString(s.value("payment/capture_time", defCaptureTimeStr).toString(), "hh:mm");
+        if (!captureTime.isValid()) captureTime = QTime::fromString(defCaptureTimeStr, "hh:mm");
+
+        gateway->scheduleCapture(captureTime);
+
+        /* the payments approved but not captured wait in the DB. */
+        gateway->setStore(connectionPool());
+    }
+
+    return gateway;
+}
+
+/* the payment outbox of the application (started with the gateway once). */
+PaymentOutbox *
+paymentOutbox() {
+    static PaymentOutbox *outbox = 0;
+
+    if (!outbox) {
+        QSettings s(setsAppOrg, setsAppName);
+
+        outbox = new PaymentOutbox(paymentGateway(), dbFileNameStr, QCoreApplication::instance());
+        outbox->setRiskLimit(s.value("payment/offline_limit", DEF_OUTBOX_RISK_LIMIT).toDouble());
 
-    /* if the credit card type is Visa. */
-    if(cardtype == creditCardVisa) {
-        /* here goes code for charging Visa credit card. */
+        /* it stops before the gateway it forwards to is deleted. */
+        QObject::connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), outbox, SLOT(shutdown()));
 
-        /* assume that credit card was charged. */
-        return true;
+        outbox->start(QThread::LowPriority);
     }
 
-    /* in any other case the card was not charged. */
-    return false;
+    return outbox;
 }
@@ -5,17 +5,48 @@
 /* include some QT libraries. */
 #include <QString>
 
+/* include header defining the interface of the source. */
+#include "paymentgateway.h"
+#include "paymentoutbox.h"
+
+/* the fewest and the most digits of a card number. */
+static const int MIN_CARD_DIGITS = 12;
+static const int MAX_CARD_DIGITS = 19;
+
 /* credit card types enumeration data type. */
 typedef enum creditCardType {
     creditCardError = -1, /* exists for error checking. */
     creditCardVisa,
-    creditCardMasterCard
+    creditCardMasterCard,
+    creditCardAmex,
+    creditCardDiscover,
+    creditCardDiners,
+    creditCardJcb,
+    creditCardUnionPay,
+    creditCardMaestro
 } creditCardType;
 
-/* get the type of the credit card. */
+/* get the digits of a card number (spaces and dashes skipped), their
+   count or -1 if there is any other character or too many digits. */
+int cardNumberDigits(const QString &cardNumber, char *digits);
+
+/* check the Luhn (mod 10) check digit of some digits (0 to 9 values). */
+bool isLuhnValid(const char *digits, const int count);
+
+/* get the type of the credit card (creditCardError for a number which is
+   malformed, fails the check digit or has no known issuer range). */
 creditCardType getCreditCardType(const QString cardNumber);
 
-/* try to charge the credit card. */
-bool chargeCreditCard(const QString cardNumber, const double charge);
+/* the printable name of a credit card type. */
+QString creditCardName(const creditCardType type);
+
+/* create the payment processor of the given name (0 if it is unknown). */
+PaymentProvider *createPaymentProvider(const QString &name);
+
+/* the payment gateway of the application (created from the settings once). */
+PaymentGateway *paymentGateway();
+
+/* the payment outbox of the application (started with the gateway once). */
+PaymentOutbox *paymentOutbox();
 
 #endif // BANKINGTOOLS_H
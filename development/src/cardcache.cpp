@@ -0,0 +1,78 @@
+/*
+ *  This file implements the cache of the cards of the customers.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+
+/* include header defining the interface of the source. */
+#include "cardcache.h"
+
+/* create an empty cache. */
+CardCache::CardCache() {
+}
+
+/* find the card of a customer (false if it is not cached). */
+bool
+CardCache::find(const int custId, memberCard &card) const {
+    QMutexLocker locker(&mutex);
+
+    QHash<int, memberCard>::const_iterator i = cards.constFind(custId);
+
+    if (i == cards.constEnd()) return false;
+
+    card = i.value();
+
+    return true;
+}
+
+/* cache the card of a customer (as read from the DB). */
+void
+CardCache::insert(const int custId, const memberCard &card) {
+    QMutexLocker locker(&mutex);
+
+    cards.insert(custId, card);
+}
+
+/* drop the card of a customer (it is edited or deleted). */
+void
+CardCache::invalidate(const int custId) {
+    QMutexLocker locker(&mutex);
+
+    cards.remove(custId);
+}
+
+/* drop all the cards. */
+void
+CardCache::clear() {
+    QMutexLocker locker(&mutex);
+
+    cards.clear();
+}
+
+/* the card cache of the application (created by the first call, which
+   is made by the main thread). */
+CardCache *
+cardCache() {
+    static CardCache *cache = 0;
+
+    /* it lives as long as the application. */
+    if (!cache) cache = new CardCache;
+
+    return cache;
+}
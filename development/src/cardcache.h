@@ -0,0 +1,37 @@
+/* header defining the interface of the source. */
+#ifndef CARDCACHE_H
+#define CARDCACHE_H
+
+/* include some QT libraries. */
+#include <QMutex>
+#include <QHash>
+
+/* include headers defining the interface of the sources. */
+#include "chargingtools.h"
+
+/* class which implements the cache of the cards of the customers (the
+   card type and the expiry day of every customer looked up), so an exit
+   reads the card of a member from the DB once. an edit of a customer
+   drops its card, it is read again at its next exit. any thread may use
+   it. */
+class CardCache
+{
+    public:
+        CardCache();
+
+        bool find(const int custId, memberCard &card) const;
+        void insert(const int custId, const memberCard &card);
+        void invalidate(const int custId);
+        void clear();
+
+    private:
+        mutable QMutex mutex;
+        QHash<int, memberCard> cards;
+
+        Q_DISABLE_COPY(CardCache)
+};
+
+/* the card cache of the application. */
+CardCache *cardCache();
+
+#endif // CARDCACHE_H
@@ -0,0 +1,111 @@
+/*
+ *  This file implements the background job flagging the expiring cards.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+#include <QtSql>
+
+/* include headers defining the interface of the sources. */
+#include "cardexpiryscanner.h"
+#include "databasetools.h"
+
+/* name of the scanner's connection. */
+static const QString scannerConnectionStr = "parkman-card-scanner";
+
+/* create the scanner (call start() to run it). */
+CardExpiryScanner::CardExpiryScanner(const QString &fileName, QObject *parent) : QThread(parent) {
+    this->fileName = fileName;
+
+    horizon = DEF_CARD_EXPIRY_HORIZON;
+    interval = DEF_CARD_SCAN_INTERVAL;
+}
+
+/* stop the scanner. */
+CardExpiryScanner::~CardExpiryScanner() {
+    stop();
+    wait();
+}
+
+/* change the days ahead a card is flagged (any thread, next scan). */
+void
+CardExpiryScanner::setHorizon(const int days) {
+    horizon.fetchAndStoreOrdered(qMax(days, 0));
+}
+
+/* change the msecs between the scans (any thread, next scan). */
+void
+CardExpiryScanner::setInterval(const int msecs) {
+    interval.fetchAndStoreOrdered(qMax(msecs, 1000));
+}
+
+/* ask the scanner to stop (it wakes up at once). */
+void
+CardExpiryScanner::stop() {
+    stopping.fetchAndStoreOrdered(1);
+    wakeUp.release();
+}
+
+/* the scanner's loop. */
+void
+CardExpiryScanner::run() {
+    {
+        /* the connection belongs to the scanner thread. */
+        QSqlDatabase db = openDBConnection(scannerConnectionStr, fileName);
+
+        while (!stopping.fetchAndAddOrdered(0)) {
+            int expired = 0;
+            QStringList expiring;
+
+            if (scan(db, expired, expiring)) emit scanned(expired, expiring);
+
+            /* sleep until the next scan (or the stop). */
+            wakeUp.tryAcquire(1, interval);
+        }
+    }
+
+    QSqlDatabase::removeDatabase(scannerConnectionStr);
+}
+
+/* scan the expiry day of the cards (two range reads of its index). */
+bool
+CardExpiryScanner::scan(QSqlDatabase db, int &expired, QStringList &expiring) {
+    const qint64 today = QDate::currentDate().toJulianDay();
+
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    /* the cards expired on or before today. */
+    query.prepare("SELECT COUNT(*) FROM customer WHERE card_expiry <= :today AND tombstone IS NULL");
+    query.bindValue(":today", today);
+
+    if (!query.exec() || !query.next()) return false;
+
+    expired = query.value(0).toInt();
+
+    /* the cards which expire within the horizon. */
+    query.prepare("SELECT name FROM customer WHERE card_expiry > :today AND card_expiry <= :horizon AND tombstone IS NULL ORDER BY card_expiry");
+    query.bindValue(":today", today);
+    query.bindValue(":horizon", today + horizon);
+
+    if (!query.exec()) return false;
+
+    while (query.next()) expiring << query.value(0).toString();
+
+    return true;
+}
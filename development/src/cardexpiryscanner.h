@@ -0,0 +1,54 @@
+/* header defining the interface of the source. */
+#ifndef CARDEXPIRYSCANNER_H
+#define CARDEXPIRYSCANNER_H
+
+/* include some QT libraries. */
+#include <QThread>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QStringList>
+#include <QSqlDatabase>
+
+/* the default days ahead a card is flagged as expiring. */
+static const int DEF_CARD_EXPIRY_HORIZON = 7;
+
+/* the default msecs between the scans of the cards. */
+static const int DEF_CARD_SCAN_INTERVAL = 3600000;
+
+/* class which implements the background job flagging the member cards
+   which are expired or expire soon. it scans the indexed expiry day of
+   the customers on its own connection, right after start() and then
+   periodically, and reports every scan with a signal. */
+class CardExpiryScanner : public QThread
+{
+    Q_OBJECT
+
+    public:
+        CardExpiryScanner(const QString &fileName, QObject *parent = 0);
+        ~CardExpiryScanner();
+
+        void setHorizon(const int days);
+        void setInterval(const int msecs);
+        void stop();
+
+    signals:
+        /* a scan is over (emitted by the scanner thread): the count of the
+           expired cards and the names of the customers whose card expires
+           within the horizon (the soonest first). */
+        void scanned(const int expired, const QStringList &expiring);
+
+    protected:
+        void run();
+
+    private:
+        bool scan(QSqlDatabase db, int &expired, QStringList &expiring);
+
+        QString fileName;
+        QAtomicInt horizon;
+        QAtomicInt interval;
+
+        QSemaphore wakeUp;
+        QAtomicInt stopping;
+};
+
+#endif // CARDEXPIRYSCANNER_H
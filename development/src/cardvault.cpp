@@ -0,0 +1,227 @@
+/*
+ *  This file implements the sealing of the card numbers in the DB.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+
+/* include the openssl headers of the cipher, the mac and the random bytes. */
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+
+/* include the system headers creating the key file. */
+#ifndef Q_OS_WIN
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* include header defining the interface of the source. */
+#include "cardvault.h"
+
+/* the bytes of the key in its file, of a nonce and of a tag. */
+static const int VAULT_KEY_BYTES = 32;
+static const int VAULT_NONCE_BYTES = 12;
+static const int VAULT_TAG_BYTES = 16;
+
+/* the version of the sealed numbers written (authenticated with them). */
+static const char VAULT_VERSION = 1;
+
+/* the HMAC-SHA256 of a message (empty on failure). */
+static QByteArray
+hmacSha256(const QByteArray &key, const QByteArray &message) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+
+    if (!HMAC(EVP_sha256(), key.constData(), key.size(),
+              (const unsigned char *) message.constData(), message.size(), digest, &length))
+        return QByteArray();
+
+    return QByteArray((const char *) digest, length);
+}
+
+/* some random bytes of the generator of openssl (empty on failure). */
+static QByteArray
+randomBytes(const int bytes) {
+    QByteArray random(bytes, 0);
+
+    if (RAND_bytes((unsigned char *) random.data(), bytes) != 1) return QByteArray();
+
+    return random;
+}
+
+/* read the key of a key file (empty if there is none). */
+static QByteArray
+readKeyFile(const QString &fileName) {
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+
+    return file.readAll();
+}
+
+/* write a new key file, readable and writable by the owner only from its
+   creation (false if there is one already or it cannot be written). */
+static bool
+writeKeyFile(const QString &fileName, const QByteArray &key) {
+#ifdef Q_OS_WIN
+    QFile file(fileName);
+
+    if (file.exists() || !file.open(QIODevice::WriteOnly)) return false;
+
+    file.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+
+    const bool written = file.write(key) == key.size() && file.flush();
+    file.close();
+#else
+    const QByteArray name = QFile::encodeName(fileName);
+    const int fd = ::open(name.constData(), O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+
+    if (fd < 0) return false;
+
+    const bool written = ::write(fd, key.constData(), key.size()) == key.size() && fsync(fd) == 0;
+    ::close(fd);
+#endif
+
+    /* a part of a key is no key. */
+    if (!written) QFile::remove(fileName);
+
+    return written;
+}
+
+/* open the vault of a key file (the key is created if there is none). */
+CardVault::CardVault(const QString &keyFileName) {
+    QByteArray key = readKeyFile(keyFileName);
+
+    if (key.isEmpty() && !QFile::exists(keyFileName)) {
+        const QByteArray created = randomBytes(VAULT_KEY_BYTES);
+
+        /* another process may create it first, its key is the key. */
+        if (created.size() == VAULT_KEY_BYTES && writeKeyFile(keyFileName, created))
+            key = created;
+        else
+            key = readKeyFile(keyFileName);
+    }
+
+    if (key.size() != VAULT_KEY_BYTES) return;
+
+    /* a key of its own for every use. */
+    encryptionKey = hmacSha256(key, "encryption");
+    tokenKey = hmacSha256(key, "token");
+
+    OPENSSL_cleanse(key.data(), key.size());
+
+    if (encryptionKey.size() != VAULT_KEY_BYTES || tokenKey.isEmpty()) {
+        encryptionKey.clear();
+        tokenKey.clear();
+    }
+}
+
+/* check if the vault has its key. */
+bool
+CardVault::isOpen() const {
+    return !encryptionKey.isEmpty();
+}
+
+/* seal the digits of a card number (base64 of the version, the nonce, the
+   encrypted digits and the tag), empty without the key. */
+QString
+CardVault::seal(const QString &digits) const {
+    if (!isOpen()) return QString();
+
+    const QByteArray plain = digits.toAscii();
+    const QByteArray nonce = randomBytes(VAULT_NONCE_BYTES);
+
+    if (nonce.isEmpty()) return QString();
+
+    QByteArray cipher(plain.size(), 0), tag(VAULT_TAG_BYTES, 0);
+    int length = 0, last = 0;
+
+    EVP_CIPHER_CTX *context = EVP_CIPHER_CTX_new();
+
+    const bool ok = context
+        && EVP_EncryptInit_ex(context, EVP_aes_256_gcm(), 0, 0, 0) == 1
+        && EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_IVLEN, VAULT_NONCE_BYTES, 0) == 1
+        && EVP_EncryptInit_ex(context, 0, 0, (const unsigned char *) encryptionKey.constData(),
+                              (const unsigned char *) nonce.constData()) == 1
+        && EVP_EncryptUpdate(context, 0, &length, (const unsigned char *) &VAULT_VERSION, 1) == 1
+        && EVP_EncryptUpdate(context, (unsigned char *) cipher.data(), &length,
+                             (const unsigned char *) plain.constData(), plain.size()) == 1
+        && EVP_EncryptFinal_ex(context, (unsigned char *) cipher.data() + length, &last) == 1
+        && EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_GET_TAG, VAULT_TAG_BYTES, tag.data()) == 1;
+
+    if (context) EVP_CIPHER_CTX_free(context);
+
+    if (!ok) return QString();
+
+    QByteArray sealed(1, VAULT_VERSION);
+    sealed += nonce + cipher + tag;
+
+    return QString::fromAscii(sealed.toBase64());
+}
+
+/* get the digits of a sealed card number (false if it is not of this key
+   or it was changed). */
+bool
+CardVault::unseal(const QString &sealed, QString &digits) const {
+    if (!isOpen()) return false;
+
+    const QByteArray data = QByteArray::fromBase64(sealed.toAscii());
+
+    if (data.size() < 1 + VAULT_NONCE_BYTES + VAULT_TAG_BYTES || data.at(0) != VAULT_VERSION) return false;
+
+    const QByteArray nonce = data.mid(1, VAULT_NONCE_BYTES);
+    const QByteArray cipher = data.mid(1 + VAULT_NONCE_BYTES, data.size() - 1 - VAULT_NONCE_BYTES - VAULT_TAG_BYTES);
+    QByteArray tag = data.right(VAULT_TAG_BYTES);
+
+    QByteArray plain(cipher.size(), 0);
+    int length = 0, last = 0;
+
+    EVP_CIPHER_CTX *context = EVP_CIPHER_CTX_new();
+
+    /* the final step checks the tag. */
+    const bool ok = context
+        && EVP_DecryptInit_ex(context, EVP_aes_256_gcm(), 0, 0, 0) == 1
+        && EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_IVLEN, VAULT_NONCE_BYTES, 0) == 1
+        && EVP_DecryptInit_ex(context, 0, 0, (const unsigned char *) encryptionKey.constData(),
+                              (const unsigned char *) nonce.constData()) == 1
+        && EVP_DecryptUpdate(context, 0, &length, (const unsigned char *) data.constData(), 1) == 1
+        && EVP_DecryptUpdate(context, (unsigned char *) plain.data(), &length,
+                             (const unsigned char *) cipher.constData(), cipher.size()) == 1
+        && EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_TAG, VAULT_TAG_BYTES, tag.data()) == 1
+        && EVP_DecryptFinal_ex(context, (unsigned char *) plain.data() + length, &last) == 1;
+
+    if (context) EVP_CIPHER_CTX_free(context);
+
+    if (!ok) return false;
+
+    digits = QString::fromAscii(plain);
+
+    return true;
+}
+
+/* the token of a card number (hex, the same for the same number), empty
+   without the key. */
+QString
+CardVault::token(const QString &digits) const {
+    if (!isOpen()) return QString();
+
+    return QString::fromAscii(hmacSha256(tokenKey, digits.toAscii()).toHex());
+}
@@ -0,0 +1,35 @@
+/* header defining the interface of the source. */
+#ifndef CARDVAULT_H
+#define CARDVAULT_H
+
+/* include some QT libraries. */
+#include <QByteArray>
+#include <QString>
+
+/* the suffix of the key file of the card numbers of a DB file. */
+static const QString cardKeySuffixStr = ".cardkey";
+
+/* class which implements the sealing of the card numbers stored in the
+   DB. a number is encrypted (AES-256-GCM of openssl) with a key kept in
+   its own file (created readable by the owner only), not in the DB, so a
+   copy of the DB (a backup, the standby copy) holds no card number in
+   clear. the key is from the random generator of openssl, and a token of
+   a number (HMAC-SHA256, the same for the same number) finds its
+   payments without the number. a vault without its key seals nothing. */
+class CardVault
+{
+    public:
+        CardVault(const QString &keyFileName);
+
+        bool isOpen() const;
+
+        QString seal(const QString &digits) const;
+        bool unseal(const QString &sealed, QString &digits) const;
+        QString token(const QString &digits) const;
+
+    private:
+        QByteArray encryptionKey;
+        QByteArray tokenKey;
+};
+
+#endif // CARDVAULT_H
@@ -0,0 +1,58 @@
+/*
+ *  This file implements the charging rules of the transactions.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QDate>
+
+/* include headers defining the interface of the sources. */
+#include "chargingtools.h"
+#include "globaldeclarations.h"
+
+/* check if the card of a member (month/year card) is expired. */
+bool
+isCardExpired(const int card_type, const QDate card_date, const QDate today) {
+    return isCardExpired(cardExpiryDay(card_type, card_date), today.toJulianDay());
+}
+
+/* the julian day the card of a member expires on (0 for never). */
+qint64
+cardExpiryDay(const int card_type, const QDate card_date) {
+    /* if the card has date find the first day it is expired. */
+    if (card_type == MonthCardType) {
+        return card_date.toJulianDay() + 30; /* plus the card creation day. */
+    }
+    else if (card_type == YearCardType) {
+        return card_date.toJulianDay() + card_date.daysInYear() + 1;
+    }
+
+    /* the rest cards never expire. */
+    return 0;
+}
+
+/* check if a card is expired on a julian day by its expiry day. */
+bool
+isCardExpired(const qint64 card_expiry, const qint64 today) {
+    return card_expiry && today >= card_expiry;
+}
+
+/* check if the card of a member is expired on a julian day. */
+bool
+isCardExpired(const memberCard &card, const qint64 today) {
+    return isCardExpired(card.expiry, today);
+}
@@ -0,0 +1,27 @@
+/* header defining the interface of the source. */
+#ifndef CHARGINGTOOLS_H
+#define CHARGINGTOOLS_H
+
+/* include some QT libraries. */
+#include <QDate>
+
+/* the card of a member structure data type (see CardCache). */
+typedef struct memberCard {
+    int cardType;         /* for fixing with indexes (the id - 1). */
+    qint64 expiry;        /* the julian day it expires on, 0 for never. */
+} memberCard;
+
+/* check if the card of a member (month/year card) is expired. */
+bool isCardExpired(const int card_type, const QDate card_date, const QDate today);
+
+/* the julian day the card of a member expires on (0 for never), computed
+   once when the card is issued and stored with the customer. */
+qint64 cardExpiryDay(const int card_type, const QDate card_date);
+
+/* check if a card is expired on a julian day by its expiry day. */
+bool isCardExpired(const qint64 card_expiry, const qint64 today);
+
+/* check if the card of a member is expired on a julian day. */
+bool isCardExpired(const memberCard &card, const qint64 today);
+
+#endif // CHARGINGTOOLS_H
@@ -0,0 +1,280 @@
+/*
+ *  This file implements the connection pool of the worker threads.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <QtSql>
+#include <cstring>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "connectionpool.h"
+#include "databasetools.h"
+
+/* name of a pooled connection (the prefix of the pool and a number). */
+static const QString poolConnectionStr = "%1-%2";
+
+/* guards the creation of the pool of the application. */
+static QMutex applicationPoolMutex;
+
+/* create the pool of a DB file (no connection is opened yet). */
+ConnectionPool::ConnectionPool(const QString &fileName, const int maxConnections,
+                               const QString &connectionPrefix, QObject *parent)
+    : QObject(parent), available(qBound(MIN_POOL_CONNECTIONS, maxConnections, MAX_POOL_CONNECTIONS)) {
+    dbFileName = fileName;
+    this->connectionPrefix = connectionPrefix;
+    capacity = qBound(MIN_POOL_CONNECTIONS, maxConnections, MAX_POOL_CONNECTIONS);
+    lastConnection = 0;
+
+    memset(&stats, 0, sizeof(stats));
+}
+
+/* close the connection of the thread deleting the pool (the main thread,
+   whose finished() never comes). only its thread may close a connection,
+   so those of the other threads still alive are left to them. */
+ConnectionPool::~ConnectionPool() {
+    closeConnection();
+}
+
+/* check out the connection of the calling thread (waiting for one if all
+   are checked out). an invalid connection if none is free in time or the
+   DB cannot open. every valid checkout must be checked in (release()). */
+QSqlDatabase
+ConnectionPool::acquire(const int waitMsecs) {
+    QObject *thread = QThread::currentThread();
+
+    /* the thread has it already (a nested checkout). */
+    {
+        QMutexLocker locker(&mutex);
+
+        QHash<QObject *, threadConnection>::iterator i = threads.find(thread);
+
+        if (i != threads.end() && i.value().depth > 0) {
+            i.value().depth++;
+            return QSqlDatabase::database(i.value().name, false);
+        }
+    }
+
+    /* wait for a free connection only when there is none. */
+    QElapsedTimer waited;
+    waited.start();
+
+    const bool full = !available.tryAcquire();
+
+    if (full && !available.tryAcquire(1, waitMsecs)) {
+        QMutexLocker locker(&mutex);
+        stats.waits++;
+        stats.timeouts++;
+        stats.waitUsecs += waited.nsecsElapsed() / 1000;
+
+        return QSqlDatabase();
+    }
+
+    QString name;
+    bool opened;
+
+    {
+        QMutexLocker locker(&mutex);
+
+        if (full) {
+            stats.waits++;
+            stats.waitUsecs += waited.nsecsElapsed() / 1000;
+        }
+
+        /* the first checkout of the thread opens its connection. */
+        opened = !threads.contains(thread);
+
+        if (opened) {
+            threadConnection connection;
+            connection.name = poolConnectionStr.arg(connectionPrefix).arg(++lastConnection);
+            connection.depth = 0;
+
+            threads.insert(thread, connection);
+        }
+
+        threadConnection &connection = threads[thread];
+        connection.depth = 1;
+        connection.checkedOut.start();
+
+        name = connection.name;
+
+        stats.checkouts++;
+        stats.checkedOut++;
+        stats.peakCheckedOut = qMax(stats.peakCheckedOut, stats.checkedOut);
+    }
+
+    if (!opened) return QSqlDatabase::database(name, false);
+
+    QSqlDatabase db = open(name);
+
+    if (!db.isOpen()) {
+        /* forget it, the next checkout tries again. */
+        {
+            QMutexLocker locker(&mutex);
+            threads.remove(thread);
+            stats.checkedOut--;
+        }
+
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(name);
+        available.release();
+
+        return QSqlDatabase();
+    }
+
+    /* the connection is closed with its thread (from that thread, once
+       however many times the thread is started). */
+    connect(thread, SIGNAL(finished()), this, SLOT(threadFinished()),
+            (Qt::ConnectionType) (Qt::DirectConnection | Qt::UniqueConnection));
+
+    QMutexLocker locker(&mutex);
+    stats.connections++;
+
+    return db;
+}
+
+/* check in the connection of the calling thread (it stays open). */
+void
+ConnectionPool::release() {
+    QMutexLocker locker(&mutex);
+
+    QHash<QObject *, threadConnection>::iterator i = threads.find(QThread::currentThread());
+    if (i == threads.end() || i.value().depth == 0) return;
+
+    /* the outer checkout checks it in. */
+    if (--i.value().depth > 0) return;
+
+    const qint64 usecs = i.value().checkedOut.nsecsElapsed() / 1000;
+
+    stats.checkoutUsecs += usecs;
+    stats.maxCheckoutUsecs = qMax(stats.maxCheckoutUsecs, usecs);
+    stats.checkedOut--;
+
+    locker.unlock();
+
+    available.release();
+}
+
+/* the DB file of the pool. */
+QString
+ConnectionPool::fileName() const {
+    return dbFileName;
+}
+
+/* the most connections checked out at once. */
+int
+ConnectionPool::maxConnections() const {
+    return capacity;
+}
+
+/* get the statistics of the pool. */
+connectionPoolStatistics
+ConnectionPool::statistics() {
+    QMutexLocker locker(&mutex);
+    return stats;
+}
+
+/* close the connection of a thread which finished (called by that thread). */
+void
+ConnectionPool::threadFinished() {
+    closeConnection();
+}
+
+/* close the connection of the calling thread, if it has one (a connection
+   is removed only by the thread which opened it). */
+void
+ConnectionPool::closeConnection() {
+    QMutexLocker locker(&mutex);
+
+    QHash<QObject *, threadConnection>::iterator i = threads.find(QThread::currentThread());
+    if (i == threads.end()) return;
+
+    const threadConnection connection = i.value();
+    threads.erase(i);
+
+    stats.connections--;
+
+    /* a thread which never checked it in. */
+    if (connection.depth > 0) {
+        stats.checkedOut--;
+        available.release();
+    }
+
+    locker.unlock();
+
+    QSqlDatabase::removeDatabase(connection.name);
+}
+
+/* open a named connection with the pragmas of the workers (reports,
+   imports and exports scan much of the DB, so a larger cache and the
+   temporary sorts in memory). */
+QSqlDatabase
+ConnectionPool::open(const QString &name) {
+    QSqlDatabase db = openDBConnection(name, dbFileName);
+
+    if (db.isOpen()) {
+        /* declare a sql query object for the DB. */
+        QSqlQuery query(db);
+
+        query.exec(QString("PRAGMA cache_size = %1").arg(DEF_POOL_CACHE_SIZE));
+        query.exec("PRAGMA temp_store = MEMORY");
+    }
+
+    return db;
+}
+
+/* check out the pooled connection of the calling thread. */
+PooledConnection::PooledConnection(ConnectionPool *pool, const int waitMsecs) {
+    this->pool = pool;
+    database = pool->acquire(waitMsecs);
+}
+
+/* check in the connection (if it was checked out). */
+PooledConnection::~PooledConnection() {
+    if (!database.isValid()) return;
+
+    database = QSqlDatabase();
+    pool->release();
+}
+
+/* check if a connection was checked out (and is open). */
+bool
+PooledConnection::isValid() const {
+    return database.isOpen();
+}
+
+/* the checked out connection. */
+QSqlDatabase
+PooledConnection::db() const {
+    return database;
+}
+
+/* the connection pool of the DB of the application (created by the main
+   thread at the start, before the workers use it). */
+ConnectionPool *
+connectionPool() {
+    QMutexLocker locker(&applicationPoolMutex);
+
+    static ConnectionPool *pool = 0;
+
+    /* it lives as long as the application. */
+    if (!pool) pool = new ConnectionPool(dbFileNameStr, DEF_POOL_CONNECTIONS, defPoolPrefixStr, QCoreApplication::instance());
+
+    return pool;
+}
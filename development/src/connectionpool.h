@@ -0,0 +1,116 @@
+/* header defining the interface of the source. */
+#ifndef CONNECTIONPOOL_H
+#define CONNECTIONPOOL_H
+
+/* include some QT libraries. */
+#include <QObject>
+#include <QSqlDatabase>
+#include <QElapsedTimer>
+#include <QSemaphore>
+#include <QMutex>
+#include <QHash>
+#include <QString>
+
+/* the default, maximum, minimum connections checked out at once. */
+static const int DEF_POOL_CONNECTIONS = 4;
+static const int MAX_POOL_CONNECTIONS = 64;
+static const int MIN_POOL_CONNECTIONS = 1;
+
+/* msecs a thread waits for a connection before giving up. */
+static const int DEF_POOL_WAIT = 30000;
+
+/* the default prefix of the names of the pooled connections (the pools
+   of one process need their own, e.g. one per site). */
+static const QString defPoolPrefixStr = "pool";
+
+/* pages of the cache of a pooled connection (negative for KiB). */
+static const int DEF_POOL_CACHE_SIZE = -8192;
+
+/* connection pool statistics structure data type. */
+typedef struct connectionPoolStatistics {
+    int connections;            /* open (one per thread which used the pool). */
+    int checkedOut;             /* by threads right now. */
+    int peakCheckedOut;
+    qint64 checkouts;
+    qint64 waits;               /* checkouts which found the pool full. */
+    qint64 timeouts;            /* ... and gave up. */
+    qint64 waitUsecs;           /* total wait for a connection. */
+    qint64 checkoutUsecs;       /* total time the connections were checked out. */
+    qint64 maxCheckoutUsecs;
+} connectionPoolStatistics;
+
+/* class which implements the pool of the connections of the worker
+   threads. a connection may only be used by the thread which opened it,
+   so the pool hands every thread its own named connection (opened once,
+   with the pragmas of the readers applied) and keeps it until the thread
+   finishes (the main thread's until the pool is deleted). at most the
+   given connections are checked out at once, the rest of the threads
+   wait for one. a thread checking out again before it checks in gets the
+   same connection (the checkouts nest). */
+class ConnectionPool : public QObject
+{
+    Q_OBJECT
+
+    public:
+        ConnectionPool(const QString &fileName, const int maxConnections = DEF_POOL_CONNECTIONS,
+                       const QString &connectionPrefix = defPoolPrefixStr, QObject *parent = 0);
+        ~ConnectionPool();
+
+        QSqlDatabase acquire(const int waitMsecs = DEF_POOL_WAIT);
+        void release();
+
+        QString fileName() const;
+        int maxConnections() const;
+
+        connectionPoolStatistics statistics();
+
+    private slots:
+        void threadFinished();
+
+    private:
+        /* connection of a thread structure data type. */
+        typedef struct threadConnection {
+            QString name;
+            int depth;                  /* nested checkouts (0 when checked in). */
+            QElapsedTimer checkedOut;
+        } threadConnection;
+
+        QSqlDatabase open(const QString &name);
+        void closeConnection();
+
+        QString dbFileName;
+        QString connectionPrefix;
+        int capacity;
+        int lastConnection;
+
+        QSemaphore available;           /* connections which may be checked out. */
+
+        QMutex mutex;
+        QHash<QObject *, threadConnection> threads;
+        connectionPoolStatistics stats;
+
+        Q_DISABLE_COPY(ConnectionPool)
+};
+
+/* class which implements the checkout of a pooled connection by the
+   calling thread for the lifetime of the object (checked in at the end). */
+class PooledConnection
+{
+    public:
+        PooledConnection(ConnectionPool *pool, const int waitMsecs = DEF_POOL_WAIT);
+        ~PooledConnection();
+
+        bool isValid() const;
+        QSqlDatabase db() const;
+
+    private:
+        ConnectionPool *pool;
+        QSqlDatabase database;
+
+        Q_DISABLE_COPY(PooledConnection)
+};
+
+/* the connection pool of the DB of the application (any thread). */
+ConnectionPool *connectionPool();
+
+#endif // CONNECTIONPOOL_H
@@ -0,0 +1,72 @@
+# headless core of the application (shared by the application and its tools).
+
+# qt sql support for the core.
+QT += sql
+
+# openssl crypto for sealing the card numbers.
+LIBS += -lcrypto
+
+# search the core headers from anywhere.
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+# headers used in the core.
+HEADERS += $$PWD/globaldeclarations.h \
+                  $$PWD/appsettings.h \
+              $$PWD/arithmetictools.h \
+                $$PWD/databasetools.h \
+                $$PWD/chargingtools.h \
+                    $$PWD/cardcache.h \
+                $$PWD/parkingengine.h \
+                    $$PWD/mpscqueue.h \
+                     $$PWD/dbwriter.h \
+                 $$PWD/gateprotocol.h \
+                 $$PWD/tariffengine.h \
+               $$PWD/whatifanalysis.h \
+                 $$PWD/quoteservice.h \
+            $$PWD/cardexpiryscanner.h \
+                $$PWD/balanceledger.h \
+               $$PWD/paymentgateway.h \
+                 $$PWD/bankingtools.h \
+                    $$PWD/cardvault.h \
+                $$PWD/paymentoutbox.h \
+               $$PWD/receiptspooler.h \
+              $$PWD/settingsservice.h \
+                      $$PWD/zonemap.h \
+                   $$PWD/siteshards.h \
+               $$PWD/connectionpool.h \
+               $$PWD/latencymetrics.h \
+                  $$PWD/querytracer.h \
+                 $$PWD/eventjournal.h \
+               $$PWD/standbyreplica.h \
+                $$PWD/customerpurge.h \
+                    $$PWD/filetools.h
+
+# sources used in the core.
+SOURCES += $$PWD/arithmetictools.cpp \
+             $$PWD/databasetools.cpp \
+             $$PWD/chargingtools.cpp \
+                 $$PWD/cardcache.cpp \
+             $$PWD/parkingengine.cpp \
+                  $$PWD/dbwriter.cpp \
+              $$PWD/gateprotocol.cpp \
+              $$PWD/tariffengine.cpp \
+            $$PWD/whatifanalysis.cpp \
+              $$PWD/quoteservice.cpp \
+            $$PWD/cardexpiryscanner.cpp \
+             $$PWD/balanceledger.cpp \
+            $$PWD/paymentgateway.cpp \
+              $$PWD/bankingtools.cpp \
+                 $$PWD/cardvault.cpp \
+             $$PWD/paymentoutbox.cpp \
+            $$PWD/receiptspooler.cpp \
+           $$PWD/settingsservice.cpp \
+                   $$PWD/zonemap.cpp \
+                $$PWD/siteshards.cpp \
+            $$PWD/connectionpool.cpp \
+            $$PWD/latencymetrics.cpp \
+               $$PWD/querytracer.cpp \
+              $$PWD/eventjournal.cpp \
+            $$PWD/standbyreplica.cpp \
+             $$PWD/customerpurge.cpp \
+                 $$PWD/filetools.cpp
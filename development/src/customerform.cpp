@@ -25,9 +25,21 @@
 #include "customerform.h"
 #include "paywizard.h"
 #include "globaldeclarations.h"
+#include "querytracer.h"
+#include "chargingtools.h"
+#include "cardcache.h"
+#include "dbwriter.h"
+#include "customerpurge.h"
 
 /* creates the application's customer gui form and data model. */
-CustomerForm::CustomerForm(const int id, QWidget *parent) : QDialog(parent) {
+CustomerForm::CustomerForm(DBWriter *writer, const int id, QWidget *parent) : QDialog(parent) {
+    /* store the DB writer of the balances. */
+    this->writer = writer;
+
+    /* no new credit card money yet. */
+    cardMoneyChanged = false;
+    cardMoney = 0;
+
     /* create the appropriate customer line edits, labels and set buddies. */
     nameEdit = new QLineEdit;
     nameLabel = new QLabel(nameLabelStr);
@@ -85,13 +97,13 @@ CustomerForm::CustomerForm(const int id, QWidget *parent) : QDialog(parent) {
     connect(cardComboBox, SIGNAL(activated(const int)), this, SLOT(handleCardType(const int)));
 
     /* create the relational table model for the customer. */
-    tableModel = new QSqlRelationalTableModel(this);
+    tableModel = new TracedRelationalTableModel(this);
 
     /* set the table to select. */
     tableModel->setTable("customer");
 
-    /* get either a selected customer or none. */
-    tableModel->setFilter(QString("customer.id = %1").arg(id));
+    /* get either a selected customer or none (not one being deleted). */
+    tableModel->setFilter(QString("customer.id = %1 AND customer.tombstone IS NULL").arg(id));
 
     /* set a relation for the card type of the customer. */
     tableModel->setRelation(Customer_CardId, QSqlRelation("cardtype", "id", "title"));
@@ -206,6 +218,13 @@ CustomerForm::done(const int result) {
     /* update any changes. */
     mapper->submit();
 
+    /* the balance of a new credit card. */
+    submitCardMoney();
+
+    /* the cards of the customers of the form may have changed. */
+    for (int row = 0; row < tableModel->rowCount(); row++)
+        cardCache()->invalidate(tableModel->record(row).value(Customer_Id).toInt());
+
     /* return from the form. */
     QDialog::done(result);
 }
@@ -258,6 +277,9 @@ CustomerForm::addCustomer() {
     /* perform any changes to the current customer. */
     mapper->submit();
 
+    /* the balance of a new credit card. */
+    submitCardMoney();
+
     /* disable the card type combobox. */
     cardComboBox->setDisabled(true);
 
@@ -292,18 +314,14 @@ CustomerForm::deleteCustomer() {
     /* get the id of the customer. */
     const int id = record.value(Customer_Id).toInt();
 
-    /* declare a sql query object. */
-    QSqlQuery query;
-
-    /* execute queries to reparent the vehicles (if any) to simple guest. */
-    query.exec(QString("UPDATE vehicle SET cust_id = 1 WHERE cust_id = %1").arg(id));
-    query.exec(QString("UPDATE transacts SET cust_id = 1 WHERE cust_id = %1").arg(id));
+    /* tombstone the customer, the purge reparents the vehicles (if any)
+       to simple guest and removes it in the background. */
+    if (!customerPurge()->purge(QList<int>() << id)) return;
 
-    /* now remove also the customer. */
-    tableModel->removeRow(row);
+    cardCache()->invalidate(id);
 
-    /* apply any changes. */
-    mapper->submit();
+    /* the customer is filtered out now. */
+    tableModel->select();
 
     /* disable the card type combobox. */
     cardComboBox->setDisabled(true);
@@ -331,6 +349,9 @@ CustomerForm::handleCardType (const int index) {
                 /* clear both date and money of the card. */
                 cardDateEdit->clear();
                 cardMoneyEdit->clear();
+
+                /* the card never expires. */
+                setCardExpiry(index, QDate());
                 break;
             }
         case MonthCardType:
@@ -346,6 +367,9 @@ CustomerForm::handleCardType (const int index) {
                     /* set the date of the card as current. */
                     cardDateEdit->setDate(QDate::currentDate());
 
+                    /* store the day the card expires on once. */
+                    setCardExpiry(index, QDate::currentDate());
+
                     /* clear the card money. */
                     cardMoneyEdit->clear();
                 }
@@ -381,6 +405,13 @@ CustomerForm::handleCardType (const int index) {
 
                         /* set the new money to the edit (if changes happen). */
                         cardMoneyEdit->setText(QString("%1").arg(money));
+
+                        /* the balance is set when the customer is stored. */
+                        cardMoneyChanged = true;
+                        cardMoney = money;
+
+                        /* the card never expires. */
+                        setCardExpiry(index, QDate());
                     }
                     else {
                         /* set the previous card type index from the combobox. */
@@ -405,6 +436,37 @@ CustomerForm::handleCardType (const int index) {
     cardComboBox->setDisabled(true);
 }
 
+/* store the day the card of the current customer expires on (the exits
+   only compare it with the current day, it is null for the cards which
+   never expire). */
+void
+CustomerForm::setCardExpiry(const int card_type, const QDate card_date) {
+    const qint64 card_expiry = cardExpiryDay(card_type, card_date);
+
+    tableModel->setData(tableModel->index(mapper->currentIndex(), Customer_CardExpiry),
+                        card_expiry ? QVariant(card_expiry) : QVariant(QVariant::LongLong));
+}
+
+/* set the balance of the credit card given to the current customer (if
+   any) after it is stored, the lanes debit the new money from now on. */
+void
+CustomerForm::submitCardMoney() {
+    if (!cardMoneyChanged) return;
+
+    cardMoneyChanged = false;
+
+    /* a new customer has no balance yet (it is read when first debited). */
+    const int id = tableModel->record(mapper->currentIndex()).value(Customer_Id).toInt();
+    if (id <= 0) return;
+
+    writeCommand command = createWriteCommand(Write_Balance);
+    command.custId = id;
+    command.amount = cardMoney;
+    command.when = QDateTime::currentDateTime();
+
+    writer->execute(command);
+}
+
 /* lock (readonly, disable) the gui objects. */
 void
 CustomerForm::lockGUI() {
@@ -16,6 +16,7 @@ class QPushButton;
 class QComboBox;
 class QLineEdit;
 class QLabel;
+class DBWriter;
 
 /* GUI string messages. */
 static const QString custWinTitleStr   = QObject::tr("Manage Customers");
@@ -52,10 +53,12 @@ class CustomerForm : public QDialog
             Customer_Email,
             Customer_CardDate,
             Customer_CardMoney,
-            Customer_CardId
+            Customer_CardId,
+            Customer_CardExpiry,
+            Customer_Tombstone
         } customerField;
 
-        CustomerForm(const int id, QWidget *parent = 0);
+        CustomerForm(DBWriter *writer, const int id, QWidget *parent = 0);
         void done(const int result);
 
     private slots:
@@ -68,12 +71,19 @@ class CustomerForm : public QDialog
         void lockGUI();
         void unlockGUI();
         void clearGUI();
+        void setCardExpiry(const int card_type, const QDate card_date);
+        void submitCardMoney();
+
+        DBWriter *writer;
 
         QSqlRelationalTableModel *tableModel;
         QDataWidgetMapper *mapper;
 
         int previousCardType;
 
+        bool cardMoneyChanged;
+        double cardMoney;
+
         QLabel *nameLabel;
         QLabel *addressLabel;
         QLabel *cityLabel;
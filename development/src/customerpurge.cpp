@@ -0,0 +1,248 @@
+/*
+ *  This file implements the deletion of customers (tombstones and purge).
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+#include <QtSql>
+
+/* include headers defining the interface of the sources. */
+#include "customerpurge.h"
+#include "databasetools.h"
+#include "dbwriter.h"
+#include "querytracer.h"
+
+/* name of the purge thread's connection. */
+static const QString purgeConnectionStr = "parkman-purge";
+
+/* the ids tombstoned by one statement. */
+static const int TOMBSTONE_CHUNK = 500;
+
+/* create the purge (call start() to run it). */
+CustomerPurge::CustomerPurge(const QString &fileName, QObject *parent) : QThread(parent) {
+    this->fileName = fileName;
+
+    /* nothing is purged until the writer is given. */
+    writer = 0;
+}
+
+/* stop the purge (after the batch in progress). */
+CustomerPurge::~CustomerPurge() {
+    stop();
+    wait();
+}
+
+/* tombstone some customers for the purge (by the thread of the default
+   connection, in one transaction). the guest customer is never deleted
+   and a customer is not deleted into itself. */
+bool
+CustomerPurge::purge(const QList<int> &ids, const int target) {
+    QStringList chunk;
+    QList<int> tombstones;
+
+    foreach (const int id, ids) {
+        if (id != GUEST_CUSTOMER_ID && id != target) tombstones << id;
+    }
+
+    if (tombstones.isEmpty()) return true;
+
+    QSqlDatabase db = QSqlDatabase::database();
+
+    /* start a DB transaction. */
+    if (!db.transaction()) return false;
+
+    /* declare a sql query object. */
+    TracedQuery query;
+
+    for (int i = 0; i < tombstones.size(); i++) {
+        chunk << QString::number(tombstones.at(i));
+
+        if (chunk.size() < TOMBSTONE_CHUNK && i < tombstones.size() - 1) continue;
+
+        /* the primary key finds every one of them. */
+        if (!query.exec(QString("UPDATE customer SET tombstone = %1 WHERE id IN (%2) AND tombstone IS NULL")
+                            .arg(target).arg(chunk.join(",")))) {
+            db.rollback();
+            return false;
+        }
+
+        chunk.clear();
+    }
+
+    if (!db.commit()) return false;
+
+    emit tombstoned(tombstones);
+
+    /* wake up the purge. */
+    pending.release();
+
+    return true;
+}
+
+/* give the purge the writer of the DB (any thread). the owner of the
+   writer takes it back (0) before it stops: the batch in progress is
+   finished first and the tombstones left wait for the next writer. */
+void
+CustomerPurge::setWriter(DBWriter *writer) {
+    writerMutex.lock();
+    this->writer = writer;
+    writerMutex.unlock();
+
+    /* wake up the purge. */
+    pending.release();
+}
+
+/* ask the purge to stop (the tombstones left are purged by the next run). */
+void
+CustomerPurge::stop() {
+    stopping.fetchAndStoreOrdered(1);
+
+    /* wake up the purge. */
+    pending.release();
+}
+
+/* the purge's loop: every tombstone is purged, a batch at a time. */
+void
+CustomerPurge::run() {
+    {
+        /* the connection belongs to the purge thread. */
+        QSqlDatabase db = openDBConnection(purgeConnectionStr, fileName);
+
+        /* the tombstones left by a previous run first. */
+        int wait = 0;
+
+        forever {
+            pending.tryAcquire(1, wait);
+            while (pending.tryAcquire()) ; /* one pass for all the wake ups. */
+
+            if (stopping.fetchAndAddOrdered(0)) break;
+
+            /* the customers to purge in this pass. */
+            int total = 0;
+
+            {
+                QSqlQuery query(db);
+
+                if (query.exec("SELECT COUNT(*) FROM customer WHERE tombstone IS NOT NULL") && query.next())
+                    total = query.value(0).toInt();
+            }
+
+            int done = 0;
+            bool unfinished = false;
+            QString error;
+
+            wait = -1; /* until the next tombstones. */
+
+            while (done < total && !stopping.fetchAndAddOrdered(0)) {
+                QMutexLocker locker(&writerMutex);
+
+                /* until the writer is given (again). */
+                if (!writer) {
+                    unfinished = true;
+                    break;
+                }
+
+                const int batch = purgeBatch(db, error);
+
+                if (batch < 0) {
+                    emit failed(error);
+                    wait = DEF_PURGE_RETRY;
+                    break;
+                }
+
+                /* none is left. */
+                if (!batch) break;
+
+                done += batch;
+                emit progress(done, qMax(total, done));
+            }
+
+            if (done && wait < 0 && !unfinished) emit purged(done);
+        }
+    }
+
+    QSqlDatabase::removeDatabase(purgeConnectionStr);
+}
+
+/* purge a batch of tombstoned customers with the writer (the caller
+   holds the writer). every purge is submitted at once, so they share the
+   writer's commits, and the batch is over when all are committed. the
+   purged customers or -1 on failure. */
+int
+CustomerPurge::purgeBatch(QSqlDatabase db, QString &error) {
+    QList<int> ids;
+
+    {
+        /* declare a sql query object for the DB. */
+        QSqlQuery query(db);
+
+        query.prepare("SELECT id FROM customer WHERE tombstone IS NOT NULL ORDER BY id LIMIT :batch");
+        query.bindValue(":batch", DEF_PURGE_BATCH);
+
+        if (!query.exec()) {
+            error = "cannot purge the customers: " + query.lastError().text();
+            return -1;
+        }
+
+        while (query.next()) ids << query.value(0).toInt();
+    }
+
+    QList<WriteTicket *> tickets;
+
+    foreach (const int id, ids) {
+        writeCommand command = createWriteCommand(Write_Purge);
+        command.custId = id;
+        command.ticket = new WriteTicket;
+
+        writer->submit(command);
+        tickets << command.ticket;
+    }
+
+    /* the purge refused last (a batch is tried again as a whole). */
+    ParkingEngine::gateResult refused = ParkingEngine::Gate_Ok;
+
+    foreach (WriteTicket *ticket, tickets) {
+        const ParkingEngine::gateResult result = ticket->wait();
+
+        if (result != ParkingEngine::Gate_Ok) refused = result;
+    }
+
+    qDeleteAll(tickets);
+
+    if (refused != ParkingEngine::Gate_Ok) {
+        error = "cannot purge the customers: " + ParkingEngine::resultName(refused);
+        return -1;
+    }
+
+    return ids.size();
+}
+
+/* the customer purge of the application (started by the first call,
+   which is made by the main thread at start). */
+CustomerPurge *
+customerPurge() {
+    static CustomerPurge *purge = 0;
+
+    /* it lives as long as the application. */
+    if (!purge) {
+        purge = new CustomerPurge(dbFileNameStr, QCoreApplication::instance());
+        purge->start(QThread::LowPriority);
+    }
+
+    return purge;
+}
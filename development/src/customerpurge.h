@@ -0,0 +1,88 @@
+/* header defining the interface of the source. */
+#ifndef CUSTOMERPURGE_H
+#define CUSTOMERPURGE_H
+
+/* include some QT libraries. */
+#include <QThread>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QString>
+#include <QList>
+
+/* the guest customer (the vehicles of a deleted customer go to it). */
+static const int GUEST_CUSTOMER_ID = 1;
+
+/* the customers submitted to the writer at once (they fit in one of its
+   group commits, see DEF_WRITER_MAX_BATCH). */
+static const int DEF_PURGE_BATCH = 200;
+
+/* msecs before a batch which failed is tried again. */
+static const int DEF_PURGE_RETRY = 10000;
+
+/* the most tombstones followed to the live customer a deleted customer
+   goes to (more is a cycle, the customer goes to the guest). */
+static const int MAX_PURGE_HOPS = 64;
+
+/* use this class. */
+class DBWriter;
+
+/* class which implements the deletion of customers. a customer is first
+   tombstoned (it leaves the views at once, which filter the tombstones
+   out) with the customer its vehicles and tickets go to, then the purge
+   thread has the DB writer purge it (see ParkingEngine::purgeCustomer),
+   a batch at a time: the writer re-parents its vehicles and tickets and
+   deletes the customer with the indexes of the customer of the vehicles
+   and the tickets. its report rows go to that customer too, under its
+   name, so the charges stay in the report without the name of the
+   deleted customer. its ledger (the history of the money of its card) is
+   deleted, the money of the card of the other customer must not change.
+
+   the tombstones are in the DB, so the purges left by a crash are
+   finished when the thread starts again (and the writer is given). */
+class CustomerPurge : public QThread
+{
+    Q_OBJECT
+
+    public:
+        CustomerPurge(const QString &fileName, QObject *parent = 0);
+        ~CustomerPurge();
+
+        bool purge(const QList<int> &ids, const int target = GUEST_CUSTOMER_ID);
+        void setWriter(DBWriter *writer);
+        void stop();
+
+    signals:
+        /* some customers are tombstoned (emitted by the thread calling purge()). */
+        void tombstoned(const QList<int> &ids);
+
+        /* a batch is purged (emitted by the purge thread). */
+        void progress(const int purged, const int total);
+
+        /* every tombstoned customer is purged (emitted by the purge thread). */
+        void purged(const int count);
+
+        /* a batch cannot be purged, it is tried again later (emitted by the purge thread). */
+        void failed(const QString &error);
+
+    protected:
+        void run();
+
+    private:
+        int purgeBatch(QSqlDatabase db, QString &error);
+
+        QString fileName;
+
+        /* the writer purging the customers (none until it is given). */
+        QMutex writerMutex;
+        DBWriter *writer;
+
+        QSemaphore pending;
+        QAtomicInt stopping;
+};
+
+/* the customer purge of the application (started once). */
+CustomerPurge *customerPurge();
+
+#endif // CUSTOMERPURGE_H
@@ -0,0 +1,383 @@
+/*
+ *  This file implements database tools (schema, default data).
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtSql>
+
+/* include headers defining the interface of the sources. */
+#include "databasetools.h"
+#include "chargingtools.h"
+
+/* the append-only ledger of the credit card balances (since version 2). */
+static const QString ledgerTableStr = "CREATE TABLE IF NOT EXISTS ledger ("
+                                      "  id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                                      "  cust_id INTEGER NOT NULL, "
+                                      "  amount REAL NOT NULL, "
+                                      "  balance REAL NOT NULL, "
+                                      "  entry_date TEXT NOT NULL, "
+                                      "  entry_time TEXT NOT NULL, "
+                                      "  reason TEXT NOT NULL, "
+                                      "  applied INTEGER NOT NULL DEFAULT 0, "
+                                      "  FOREIGN KEY (cust_id) REFERENCES customer)";
+
+static const QString ledgerIndexStr = "CREATE INDEX IF NOT EXISTS ledger_applied ON ledger (applied, cust_id)";
+
+/* the card payments accepted offline, to be forwarded (since version 3).
+   the card is its last digits, the number is sealed (see CardVault) and
+   its token finds the payments of the card. */
+static const QString outboxTableStr = "CREATE TABLE IF NOT EXISTS payment_outbox ("
+                                      "  id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                                      "  pay_key TEXT NOT NULL UNIQUE, "
+                                      "  card TEXT NOT NULL, "
+                                      "  card_token TEXT NOT NULL, "
+                                      "  card_secret TEXT, "
+                                      "  amount REAL NOT NULL, "
+                                      "  entry_date TEXT NOT NULL, "
+                                      "  entry_time TEXT NOT NULL, "
+                                      "  status INTEGER NOT NULL DEFAULT 0, "
+                                      "  attempts INTEGER NOT NULL DEFAULT 0, "
+                                      "  next_try INTEGER NOT NULL DEFAULT 0, "
+                                      "  auth_code TEXT)";
+
+static const QString outboxIndexStr = "CREATE INDEX IF NOT EXISTS payment_outbox_due ON payment_outbox (status, next_try)";
+static const QString outboxCardIndexStr = "CREATE INDEX IF NOT EXISTS payment_outbox_card ON payment_outbox (card_token, status)";
+
+/* the approved card payments waiting for the capture (since version 7),
+   the last digits of the card only. */
+static const QString captureTableStr = "CREATE TABLE IF NOT EXISTS payment_capture ("
+                                       "  pay_key TEXT PRIMARY KEY, "
+                                       "  card TEXT NOT NULL, "
+                                       "  amount REAL NOT NULL, "
+                                       "  auth_code TEXT, "
+                                       "  attempts INTEGER NOT NULL DEFAULT 0)";
+
+/* the zones of the parking (since version 4). the card types are the ids
+   of the card types the zone is reserved for ("2,3,4"), none for all. */
+static const QString zoneTableStr = "CREATE TABLE IF NOT EXISTS zone ("
+                                    "  id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                                    "  name TEXT NOT NULL UNIQUE, "
+                                    "  level INTEGER NOT NULL DEFAULT 0, "
+                                    "  capacity INTEGER NOT NULL, "
+                                    "  card_types TEXT, "
+                                    "  priority INTEGER NOT NULL DEFAULT 0)";
+
+static const QString transactsZoneIndexStr = "CREATE INDEX IF NOT EXISTS transacts_zone ON transacts (zone_id)";
+
+/* the last event of the journal projected to the DB (since version 5). it
+   is updated in the transaction of the events, so the tables the writer
+   changes are a snapshot of the journal up to it (the rest of the DB is
+   not journaled). */
+static const QString journalStateTableStr = "CREATE TABLE IF NOT EXISTS journal_state ("
+                                            "  id INTEGER PRIMARY KEY CHECK (id = 1), "
+                                            "  seq INTEGER NOT NULL)";
+
+static const QString journalStateRowStr = "INSERT OR IGNORE INTO journal_state (id, seq) VALUES (1, 0)";
+
+/* the customers of the vehicles, the tickets and the ledger, and the
+   tombstoned customers, for deleting customers (since version 6). */
+static const QString vehicleCustomerIndexStr = "CREATE INDEX IF NOT EXISTS vehicle_customer ON vehicle (cust_id)";
+static const QString transactsCustomerIndexStr = "CREATE INDEX IF NOT EXISTS transacts_customer ON transacts (cust_id)";
+static const QString ledgerCustomerIndexStr = "CREATE INDEX IF NOT EXISTS ledger_customer ON ledger (cust_id)";
+static const QString customerTombstoneIndexStr = "CREATE INDEX IF NOT EXISTS customer_tombstone ON customer (tombstone)";
+
+/* the customers of the report rows, for anonymizing the deleted
+   customers' rows (since version 8). */
+static const QString reportCustomerIndexStr = "CREATE INDEX IF NOT EXISTS report_customer ON report (cust_id)";
+
+/* the sql statements creating the DB schema (one per table or index). */
+QStringList
+dbSchemaStatements() {
+    QStringList statements;
+
+    statements << "CREATE TABLE cardtype ("
+                  "  id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                  "  title TEXT NOT NULL)";
+
+    statements << "CREATE TABLE customer ("
+                  "  id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                  "  name TEXT NOT NULL, "
+                  "  address TEXT, "
+                  "  city TEXT, "
+                  "  state TEXT, "
+                  "  phone TEXT,"
+                  "  email TEXT, "
+                  "  card_date TEXT,"
+                  "  card_money REAL,"
+                  "  card_id INTEGER NOT NULL, "
+                  "  card_expiry INTEGER, "
+                  "  tombstone INTEGER, "
+                  "  FOREIGN KEY (card_id) REFERENCES cardtype)";
+
+    statements << "CREATE INDEX customer_card_expiry ON customer (card_expiry)";
+
+    statements << "CREATE TABLE vehicle ("
+                  "  id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                  "  reg_num TEXT NOT NULL, "
+                  "  desc TEXT, "
+                  "  cust_id INTEGER NOT NULL, "
+                  "  FOREIGN KEY (cust_id) REFERENCES customer)";
+
+    statements << "CREATE TABLE transacts ("
+                  "  id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                  "  vehi_id INTEGER NOT NULL, "
+                  "  cust_id INTEGER NOT NULL, "
+                  "  start_date TEXT NOT NULL,"
+                  "  start_time TEXT NOT NULL,"
+                  "  zone_id INTEGER, "
+                  "  FOREIGN KEY (vehi_id) REFERENCES vehicle, "
+                  "  FOREIGN KEY (cust_id) REFERENCES customer, "
+                  "  FOREIGN KEY (zone_id) REFERENCES zone)";
+
+    statements << "CREATE TABLE report ("
+                  "  id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                  "  vehicle TEXT NOT NULL, "
+                  "  start_date TEXT NOT NULL,"
+                  "  end_date TEXT NOT NULL,"
+                  "  start_time TEXT NOT NULL,"
+                  "  end_time TEXT NOT NULL,"
+                  "  charge REAL NOT NULL,"
+                  "  customer TEXT NOT NULL,"
+                  "  zone TEXT,"
+                  "  cust_id INTEGER)";
+
+    statements << ledgerTableStr;
+    statements << ledgerIndexStr;
+    statements << outboxTableStr;
+    statements << outboxIndexStr;
+    statements << outboxCardIndexStr;
+    statements << zoneTableStr;
+    statements << transactsZoneIndexStr;
+    statements << journalStateTableStr;
+    statements << vehicleCustomerIndexStr;
+    statements << transactsCustomerIndexStr;
+    statements << ledgerCustomerIndexStr;
+    statements << customerTombstoneIndexStr;
+    statements << captureTableStr;
+    statements << reportCustomerIndexStr;
+
+    return statements;
+}
+
+/* the sql statements filling the DB default data. */
+QStringList
+dbDefaultDataStatements() {
+    QStringList statements;
+
+    /* fill the card types. */
+    statements << "INSERT INTO cardtype (title) VALUES ('No Card Customer')";
+    statements << "INSERT INTO cardtype (title) VALUES ('Simple Member Card')";
+    statements << "INSERT INTO cardtype (title) VALUES ('Month Member Card')";
+    statements << "INSERT INTO cardtype (title) VALUES ('Year Member Card')";
+    statements << "INSERT INTO cardtype (title) VALUES ('Credit Card Member')";
+
+    /* insert the guest customer. */
+    statements << "INSERT INTO customer (name, card_id) VALUES ('Simple Guest', 1)";
+
+    /* nothing of the journal is projected yet. */
+    statements << journalStateRowStr;
+
+    return statements;
+}
+
+/* check if the DB has already a schema. */
+bool
+hasDBSchema(QSqlDatabase db) {
+    return db.tables().contains("cardtype");
+}
+
+/* create the DB schema and fill the default data (in one transaction). */
+bool
+createDBSchema(QSqlDatabase db) {
+    /* declare a sql query object for the DB. */
+    QSqlQuery query(db);
+
+    /* start a DB transaction. */
+    if (!db.transaction()) return false;
+
+    /* create the schema and then the default data. */
+    const QStringList statements = dbSchemaStatements() + dbDefaultDataStatements();
+
+    foreach (const QString statement, statements) {
+        if (!query.exec(statement)) {
+            /* undo everything. */
+            db.rollback();
+            return false;
+        }
+    }
+
+    /* the schema is of the current version. */
+    if (!query.exec(QString("PRAGMA user_version = %1").arg(DB_SCHEMA_VERSION))) {
+        db.rollback();
+        return false;
+    }
+
+    /* commit the DB transaction. */
+    return db.commit();
+}
+
+/* upgrade the schema of an older DB to the current version (in one
+   transaction, nothing happens if it is already the current one). */
+bool
+upgradeDBSchema(QSqlDatabase db) {
+    /* declare a sql query object for the DB. */
+    QSqlQuery query(db);
+
+    if (!query.exec("PRAGMA user_version") || !query.next()) return false;
+
+    const int version = query.value(0).toInt();
+    if (version >= DB_SCHEMA_VERSION) return true;
+
+    query.finish();
+
+    /* start a DB transaction. */
+    if (!db.transaction()) return false;
+
+    bool ok = true;
+
+    /* version 1: the expiry day of the cards (indexed). */
+    if (version < 1) {
+        if (!db.record("customer").contains("card_expiry"))
+            ok = query.exec("ALTER TABLE customer ADD COLUMN card_expiry INTEGER");
+
+        ok = ok && query.exec("CREATE INDEX IF NOT EXISTS customer_card_expiry ON customer (card_expiry)");
+
+        /* compute the expiry day of the cards already issued. */
+        QList<int> ids;
+        QList<qint64> expiries;
+
+        ok = ok && query.exec("SELECT id, card_id, card_date FROM customer WHERE card_date IS NOT NULL");
+
+        while (ok && query.next()) {
+            ids << query.value(0).toInt();
+            expiries << cardExpiryDay(query.value(1).toInt() - 1, query.value(2).toDate()); /* for fixing with indexes. */
+        }
+
+        query.finish();
+
+        ok = ok && query.prepare("UPDATE customer SET card_expiry = :card_expiry WHERE id = :cust_id");
+
+        for (int i = 0; ok && i < ids.size(); i++) {
+            query.bindValue(":card_expiry", expiries.at(i) ? QVariant(expiries.at(i)) : QVariant(QVariant::LongLong));
+            query.bindValue(":cust_id", ids.at(i));
+            ok = query.exec();
+        }
+    }
+
+    /* version 2: the ledger of the credit card balances. */
+    if (version < 2) {
+        ok = ok && query.exec(ledgerTableStr);
+        ok = ok && query.exec(ledgerIndexStr);
+    }
+
+    /* version 3: the outbox of the card payments accepted offline. */
+    if (version < 3) {
+        ok = ok && query.exec(outboxTableStr);
+        ok = ok && query.exec(outboxIndexStr);
+        ok = ok && query.exec(outboxCardIndexStr);
+    }
+
+    /* version 4: the zones of the parking (of the tickets and in the report). */
+    if (version < 4) {
+        ok = ok && query.exec(zoneTableStr);
+
+        if (ok && !db.record("transacts").contains("zone_id"))
+            ok = query.exec("ALTER TABLE transacts ADD COLUMN zone_id INTEGER REFERENCES zone");
+
+        if (ok && !db.record("report").contains("zone"))
+            ok = query.exec("ALTER TABLE report ADD COLUMN zone TEXT");
+
+        ok = ok && query.exec(transactsZoneIndexStr);
+    }
+
+    /* version 5: the position of the DB in the journal of the events. */
+    if (version < 5) {
+        ok = ok && query.exec(journalStateTableStr);
+        ok = ok && query.exec(journalStateRowStr);
+    }
+
+    /* version 6: the tombstones of the customers being deleted (the
+       customer their vehicles go to) and the indexes of the purge. */
+    if (version < 6) {
+        if (ok && !db.record("customer").contains("tombstone"))
+            ok = query.exec("ALTER TABLE customer ADD COLUMN tombstone INTEGER");
+
+        ok = ok && query.exec(vehicleCustomerIndexStr);
+        ok = ok && query.exec(transactsCustomerIndexStr);
+        ok = ok && query.exec(ledgerCustomerIndexStr);
+        ok = ok && query.exec(customerTombstoneIndexStr);
+    }
+
+    /* version 7: the approved card payments waiting for the capture. */
+    if (version < 7) {
+        ok = ok && query.exec(captureTableStr);
+    }
+
+    /* version 8: the customer ids of the report rows. the old rows only
+       have the name, they get the id of the one customer of that name
+       (the rows of a name shared by customers are left without it). */
+    if (version < 8) {
+        if (ok && !db.record("report").contains("cust_id"))
+            ok = query.exec("ALTER TABLE report ADD COLUMN cust_id INTEGER");
+
+        ok = ok && query.exec("CREATE INDEX IF NOT EXISTS customer_name_upgrade ON customer (name)");
+        ok = ok && query.exec("UPDATE report SET cust_id = "
+                              "(SELECT id FROM customer WHERE customer.name = report.customer) "
+                              "WHERE cust_id IS NULL AND "
+                              "(SELECT COUNT(*) FROM customer WHERE customer.name = report.customer) = 1");
+        ok = ok && query.exec("DROP INDEX IF EXISTS customer_name_upgrade");
+        ok = ok && query.exec(reportCustomerIndexStr);
+    }
+
+    ok = ok && query.exec(QString("PRAGMA user_version = %1").arg(DB_SCHEMA_VERSION));
+
+    /* undo everything on any failure. */
+    if (!ok) {
+        db.rollback();
+        return false;
+    }
+
+    /* commit the DB transaction. */
+    return db.commit();
+}
+
+/* apply the pragmas of every connection to the DB. */
+void
+applyConnectionPragmas(QSqlDatabase db) {
+    /* declare a sql query object for the DB. */
+    QSqlQuery query(db);
+
+    /* with the write-ahead log the readers never block the writer
+       and the writer never blocks the readers. */
+    query.exec("PRAGMA journal_mode = WAL");
+}
+
+/* open a named connection to a DB file (a connection per thread). */
+QSqlDatabase
+openDBConnection(const QString &connectionName, const QString &fileName) {
+    QSqlDatabase db = QSqlDatabase::addDatabase(dbDriverStr, connectionName);
+    db.setDatabaseName(fileName);
+
+    /* wait for the writer instead of failing with a locked DB. */
+    db.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(DB_BUSY_TIMEOUT));
+
+    /* the caller checks if the connection is open. */
+    if (db.open()) applyConnectionPragmas(db);
+
+    return db;
+}
@@ -0,0 +1,41 @@
+/* header defining the interface of the source. */
+#ifndef DATABASETOOLS_H
+#define DATABASETOOLS_H
+
+/* include some QT libraries. */
+#include <QString>
+#include <QStringList>
+#include <QSqlDatabase>
+
+/* declare DB driver and filename. */
+static const QString dbDriverStr = "QSQLITE";
+static const QString dbFileNameStr = "database.db";
+
+/* the version of the DB schema (PRAGMA user_version). */
+static const int DB_SCHEMA_VERSION = 8;
+
+/* msecs a connection waits for a locked DB before failing. */
+static const int DB_BUSY_TIMEOUT = 5000;
+
+/* the sql statements creating the DB schema (one per table or index). */
+QStringList dbSchemaStatements();
+
+/* the sql statements filling the DB default data. */
+QStringList dbDefaultDataStatements();
+
+/* check if the DB has already a schema. */
+bool hasDBSchema(QSqlDatabase db);
+
+/* create the DB schema and fill the default data (in one transaction). */
+bool createDBSchema(QSqlDatabase db);
+
+/* upgrade the schema of an older DB to the current version. */
+bool upgradeDBSchema(QSqlDatabase db);
+
+/* apply the pragmas of every connection to the DB. */
+void applyConnectionPragmas(QSqlDatabase db);
+
+/* open a named connection to a DB file (a connection per thread). */
+QSqlDatabase openDBConnection(const QString &connectionName, const QString &fileName);
+
+#endif // DATABASETOOLS_H
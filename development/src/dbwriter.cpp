@@ -0,0 +1,612 @@
+/*
+ *  This file implements the single DB writer (thread) of the gates.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <QtSql>
+#include <cstring>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "dbwriter.h"
+#include "databasetools.h"
+
+/* name of the writer's connection (after the prefix of the writer). */
+static const QString writerConnectionStr = "%1-writer";
+
+/* name of the connection loading the balances and the zones. */
+static const QString balancesConnectionStr = "%1-balances";
+
+/* msecs the writer sleeps before checking if it must stop. */
+static const int WRITER_IDLE_WAIT = 100;
+
+/* the event of a command done (0 for a command which is not journaled). */
+static int
+eventTypeOf(const int commandType) {
+    switch (commandType) {
+        case Write_Entry:   return Event_Entry;
+        case Write_Exit:    return Event_Exit;
+        case Write_Payment: return Event_Payment;
+        case Write_Close:   return Event_Close;
+        case Write_Cancel:  return Event_Void;
+        case Write_Settle:  return Event_Settle;
+        case Write_Balance: return Event_Balance;
+        case Write_Purge:   return Event_Purge;
+        default:            return 0; /* the snapshots are derived from the events. */
+    }
+}
+
+/* the command replaying an event. */
+static writeCommand
+commandOfEvent(const journalEvent &event) {
+    int type = Write_Entry;
+
+    switch (event.type) {
+        case Event_Entry:   type = Write_Entry;   break;
+        case Event_Exit:    type = Write_Exit;    break;
+        case Event_Payment: type = Write_Payment; break;
+        case Event_Close:   type = Write_Close;   break;
+        case Event_Void:    type = Write_Cancel;  break;
+        case Event_Settle:  type = Write_Settle;  break;
+        case Event_Balance: type = Write_Balance; break;
+        case Event_Purge:   type = Write_Purge;   break;
+    }
+
+    writeCommand command = createWriteCommand(type);
+
+    command.vehiId = event.vehiId;
+    command.custId = event.custId;
+    command.tranId = event.tranId;
+    command.amount = event.amount;
+
+    /* an exit is applied with the charge it had, not the tariff of now. */
+    command.recorded = event.type == Event_Exit;
+
+    if (event.when) command.when = QDateTime::fromMSecsSinceEpoch(event.when);
+
+    return command;
+}
+
+/* create a command of the given type (the rest cleared). */
+writeCommand
+createWriteCommand(const int type) {
+    writeCommand command;
+
+    command.type = type;
+    command.vehiId = -1;
+    command.custId = -1;
+    command.tranId = -1;
+    command.amount = 0;
+    command.recorded = false;
+    command.ticket = 0;
+    command.tag = 0;
+
+    return command;
+}
+
+/* create an uncompleted ticket. */
+WriteTicket::WriteTicket() {
+    result = ParkingEngine::Gate_DBError;
+    charge = 0;
+}
+
+/* complete the ticket (writer thread) and wake up the waiting thread. */
+void
+WriteTicket::complete(const ParkingEngine::gateResult result, const double charge) {
+    this->result = result;
+    this->charge = charge;
+
+    /* the semaphore also publishes the values to the waiting thread. */
+    done.release();
+}
+
+/* wait until the command of the ticket is committed. */
+ParkingEngine::gateResult
+WriteTicket::wait(double *charge) {
+    done.acquire();
+
+    if (charge) *charge = this->charge;
+
+    return result;
+}
+
+/* the bucket of a value in a log2 histogram (0 for values under 2). */
+static int
+log2Bucket(qint64 value, const int buckets) {
+    int bucket = 0;
+
+    while (value > 1 && bucket < buckets - 1) {
+        value >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+/* create the writer (call start() to run it). */
+DBWriter::DBWriter(const appSettings &sets, const QString &fileName, const QString &connectionPrefix, QObject *parent)
+    : QThread(parent), journal(fileName + journalSuffixStr) {
+    this->sets = sets;
+    this->fileName = fileName;
+    this->connectionPrefix = connectionPrefix;
+
+    maxBatch = DEF_WRITER_MAX_BATCH;
+    window = DEF_COMMIT_WINDOW;
+    setsChanged = false;
+
+    /* no commits yet. */
+    memset(&stats, 0, sizeof(stats));
+
+    /* nothing recovered until the writer starts. */
+    uncheckpointed = 0;
+    recovered.journaling = false;
+    recovered.projectedSeq = 0;
+    recovered.replayed = recovered.failed = 0;
+    recovered.usecs = 0;
+
+    /* load the balances before anybody reads them (if it fails
+       every account is read from the DB when first debited) and the
+       zones (if it fails the capacity of the settings is used). */
+    {
+        QSqlDatabase db = openDBConnection(balancesConnectionStr.arg(connectionPrefix), fileName);
+        ledger.load(db);
+        zoneMap.load(db);
+    }
+
+    QSqlDatabase::removeDatabase(balancesConnectionStr.arg(connectionPrefix));
+}
+
+/* stop the writer (commands already submitted are committed). */
+DBWriter::~DBWriter() {
+    stop();
+    wait();
+}
+
+/* submit a command (any thread, never blocks). */
+void
+DBWriter::submit(const writeCommand &command) {
+    queue.push(command);
+
+    /* wake up the writer. */
+    pending.release();
+}
+
+/* submit a command and wait until it is committed. */
+ParkingEngine::gateResult
+DBWriter::execute(const writeCommand &command, double *charge) {
+    WriteTicket ticket;
+
+    writeCommand ticketed = command;
+    ticketed.ticket = &ticket;
+
+    submit(ticketed);
+
+    return ticket.wait(charge);
+}
+
+/* ask the writer to stop when the queue is empty. */
+void
+DBWriter::stop() {
+    stopping.fetchAndStoreOrdered(1);
+
+    /* wake up the writer. */
+    pending.release();
+}
+
+/* change the settings of the writer (any thread). the commands
+   already in a batch keep the settings they started with. */
+void
+DBWriter::setSettings(const appSettings &sets) {
+    QMutexLocker locker(&settingsMutex);
+
+    newSets = sets;
+    setsChanged = true;
+}
+
+/* change the group commit window (any thread). */
+void
+DBWriter::setCommitWindow(const int msecs) {
+    window.fetchAndStoreOrdered(qBound(MIN_COMMIT_WINDOW, msecs, MAX_COMMIT_WINDOW));
+}
+
+/* get the group commit window. */
+int
+DBWriter::commitWindow() const {
+    return window;
+}
+
+/* get a copy of the group commit statistics (any thread). */
+groupCommitStatistics
+DBWriter::statistics() {
+    QMutexLocker locker(&statisticsMutex);
+
+    return stats;
+}
+
+/* get the in-memory balances of the credit cards (any thread, read only). */
+const BalanceLedger &
+DBWriter::balances() const {
+    return ledger;
+}
+
+/* get the zones with their occupancy (any thread, read only). */
+const ZoneMap &
+DBWriter::zones() const {
+    return zoneMap;
+}
+
+/* get the recovery of the journal (any thread, filled in once the writer
+   has started). */
+journalRecovery
+DBWriter::recovery() {
+    QMutexLocker locker(&statisticsMutex);
+
+    return recovered;
+}
+
+/* the writer's loop. */
+void
+DBWriter::run() {
+    {
+        /* the connection belongs to the writer thread. */
+        QSqlDatabase db = openDBConnection(writerConnectionStr.arg(connectionPrefix), fileName);
+
+        /* acknowledge only what is synced to the disk (the write-ahead
+           log is synced on every commit, not only on checkpoints). */
+        QSqlQuery(db).exec("PRAGMA synchronous = FULL");
+
+        /* the commands are savepoints inside the batch transaction. */
+        ParkingEngine engine(sets, db);
+        engine.setBatchMode(true);
+        engine.setLedger(&ledger);
+        engine.setZones(&zoneMap);
+
+        /* bring the DB up to the journal before any new command. */
+        recover(db, engine);
+
+        writeCommand command;
+
+        /* the balances are stored in the customers from time to time. */
+        QElapsedTimer snapshotTimer;
+        snapshotTimer.start();
+
+        forever {
+            /* sleep until a command arrives (or it is time to check for stop). */
+            pending.tryAcquire(1, WRITER_IDLE_WAIT);
+
+            if (snapshotTimer.hasExpired(DEF_BALANCE_SNAPSHOT_INTERVAL)) {
+                submit(createWriteCommand(Write_Snapshot));
+                snapshotTimer.restart();
+            }
+
+            if (queue.pop(command)) {
+                /* apply any new settings between the batches. */
+                settingsMutex.lock();
+
+                if (setsChanged) {
+                    engine.setSettings(newSets);
+                    setsChanged = false;
+                }
+
+                settingsMutex.unlock();
+
+                commitBatch(db, engine, command);
+                continue;
+            }
+
+            /* stop only when the queue is empty. */
+            if (stopping.fetchAndAddOrdered(0)) break;
+        }
+
+        /* the last snapshot of the balances. */
+        commitBatch(db, engine, createWriteCommand(Write_Snapshot));
+
+        /* the next start replays nothing. */
+        if (journal.isOpen()) journal.checkpoint();
+
+        journal.close();
+    }
+
+    QSqlDatabase::removeDatabase(writerConnectionStr.arg(connectionPrefix));
+}
+
+/* collect the commands arriving within the commit window of the first
+   one (or until the batch is full). while stopping nobody waits. */
+void
+DBWriter::collectBatch(QVector<writeCommand> &batch) {
+    QElapsedTimer timer;
+    timer.start();
+
+    const int msecs = commitWindow();
+
+    writeCommand command;
+
+    while (batch.size() < maxBatch) {
+        /* take what is already in the queue. */
+        if (queue.pop(command)) {
+            pending.tryAcquire(); /* keep the wake ups in step with the queue. */
+            batch << command;
+            continue;
+        }
+
+        /* the window is over. */
+        const int left = msecs - (int) timer.elapsed();
+        if (left <= 0 || stopping.fetchAndAddOrdered(0)) break;
+
+        /* sleep until the next command and take it with its wake up (a
+           wake up left by a command taken already takes nothing, the
+           next one sleeps again). */
+        if (pending.tryAcquire(1, left) && queue.pop(command))
+            batch << command;
+    }
+}
+
+/* commit the first command with all the commands of its window. */
+void
+DBWriter::commitBatch(QSqlDatabase db, ParkingEngine &engine, const writeCommand &first) {
+    /* the commands of the batch and their results. */
+    QVector<writeCommand> batch;
+    QVector<ParkingEngine::gateResult> results;
+    QVector<double> charges;
+    QVector<QList<settledTicket> > settled;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    batch << first;
+
+    /* the group of the commit. */
+    collectBatch(batch);
+
+    const qint64 windowUsecs = timer.nsecsElapsed() / 1000;
+    timer.restart();
+
+    /* one transaction (one sync to the disk) for the whole batch. */
+    const bool began = QSqlQuery(db).exec("BEGIN IMMEDIATE");
+
+    foreach (const writeCommand &item, batch) {
+        double charge = 0;
+        QList<settledTicket> tickets;
+
+        results << (began ? apply(engine, item, charge, &tickets) : ParkingEngine::Gate_DBError);
+        charges << charge;
+        settled << tickets;
+    }
+
+    /* the events are durable in the journal before the commit. */
+    const bool journaled = began && (!journal.isOpen() || journalBatch(db, batch, results, charges, settled));
+
+    /* if the commit fails nothing of the batch happened (in either). */
+    const bool committed = journaled && QSqlQuery(db).exec("COMMIT");
+
+    if (!committed) {
+        if (began) QSqlQuery(db).exec("ROLLBACK");
+        journal.rollback();
+        results.fill(ParkingEngine::Gate_DBError);
+    }
+    else if (uncheckpointed >= DEF_JOURNAL_CHECKPOINT && journal.checkpoint()) {
+        uncheckpointed = 0;
+    }
+
+    /* the balances of a batch undone are read again. */
+    engine.finishBatch(committed);
+
+    account(batch.size(), windowUsecs, timer.nsecsElapsed() / 1000, committed);
+
+    /* the commands are durable now, wake up their threads. */
+    for (int i = 0; i < batch.size(); i++) {
+        if (batch.at(i).ticket)
+            batch.at(i).ticket->complete(results.at(i), charges.at(i));
+        else if (batch.at(i).tag)
+            emit completed(batch.at(i).tag, results.at(i), charges.at(i));
+    }
+}
+
+/* append the events of the commands done to the journal and store the
+   last one with the batch (in its transaction), then sync the journal.
+   the charges are journaled as they were made (a settlement as the exits
+   of its tickets), so a replay never prices them again. */
+bool
+DBWriter::journalBatch(QSqlDatabase db, const QVector<writeCommand> &batch,
+                       const QVector<ParkingEngine::gateResult> &results, const QVector<double> &charges,
+                       const QVector<QList<settledTicket> > &settled) {
+    journal.mark();
+
+    int appended = 0;
+
+    for (int i = 0; i < batch.size(); i++) {
+        const writeCommand &item = batch.at(i);
+        const int type = eventTypeOf(item.type);
+
+        /* a command refused changed nothing. */
+        if (!type || results.at(i) != ParkingEngine::Gate_Ok) continue;
+
+        if (item.type == Write_Settle) {
+            foreach (const settledTicket &ticket, settled.at(i)) {
+                journalEvent event;
+                event.type = Event_Exit;
+                event.when = item.when.isValid() ? item.when.toMSecsSinceEpoch() : 0;
+                event.vehiId = ticket.vehiId;
+                event.custId = ticket.custId;
+                event.tranId = ticket.tranId;
+                event.amount = ticket.charge;
+
+                if (!journal.append(event)) return false;
+
+                appended++;
+            }
+
+            continue;
+        }
+
+        journalEvent event;
+        event.type = type;
+        event.when = item.when.isValid() ? item.when.toMSecsSinceEpoch() : 0;
+        event.vehiId = item.vehiId;
+        event.custId = item.custId;
+        event.tranId = item.tranId;
+        event.amount = item.type == Write_Exit ? charges.at(i) : item.amount;
+
+        if (!journal.append(event)) return false;
+
+        appended++;
+    }
+
+    if (!appended) return true;
+
+    /* declare a sql query object for the DB. */
+    QSqlQuery query(db);
+
+    query.prepare("UPDATE journal_state SET seq = :seq WHERE id = 1");
+    query.bindValue(":seq", journal.lastSeq());
+
+    if (!query.exec() || !journal.sync()) return false;
+
+    uncheckpointed += appended;
+
+    return true;
+}
+
+/* open the journal and replay its tail past the last event of the DB
+   (in one transaction). without a journal the writer goes on without
+   one, the DB being the only record of the commands. */
+void
+DBWriter::recover(QSqlDatabase db, ParkingEngine &engine) {
+    QElapsedTimer timer;
+    timer.start();
+
+    journalRecovery result;
+    result.journaling = false;
+    result.projectedSeq = 0;
+    result.replayed = result.failed = 0;
+
+    QList<journalEvent> events;
+
+    /* declare a sql query object for the DB. */
+    QSqlQuery query(db);
+
+    if (!query.exec("SELECT seq FROM journal_state WHERE id = 1") || !query.next())
+        result.error = "the DB has no position in the journal";
+    else if (journal.open(result.error)) {
+        result.projectedSeq = query.value(0).toULongLong();
+
+        /* a journal behind the DB (e.g. lost) goes on after it. */
+        journal.skipTo(result.projectedSeq);
+
+        result.journaling = journal.readAfter(result.projectedSeq, events, result.error);
+    }
+
+    query.finish();
+
+    if (result.journaling && !events.isEmpty()) {
+        bool ok = query.exec("BEGIN IMMEDIATE");
+
+        foreach (const journalEvent &event, events) {
+            if (!ok) break;
+
+            double charge = 0;
+
+            if (apply(engine, commandOfEvent(event), charge) != ParkingEngine::Gate_Ok) result.failed++;
+
+            result.replayed++;
+        }
+
+        query.prepare("UPDATE journal_state SET seq = :seq WHERE id = 1");
+        query.bindValue(":seq", events.last().seq);
+
+        ok = ok && query.exec() && query.exec("COMMIT");
+
+        if (!ok) {
+            query.exec("ROLLBACK");
+
+            /* new events after a tail not projected would hide it. */
+            result.error = "cannot replay the journal: " + query.lastError().text();
+            result.journaling = false;
+            result.replayed = result.failed = 0;
+        }
+
+        engine.finishBatch(ok);
+    }
+
+    if (result.journaling) journal.checkpoint();
+    else journal.close();
+
+    result.usecs = timer.nsecsElapsed() / 1000;
+
+    QMutexLocker locker(&statisticsMutex);
+    recovered = result;
+}
+
+/* apply a command with the engine. */
+ParkingEngine::gateResult
+DBWriter::apply(ParkingEngine &engine, const writeCommand &command, double &charge,
+               QList<settledTicket> *settled) {
+    switch (command.type) {
+        case Write_Entry:
+            return engine.enterVehicle(command.vehiId, command.when);
+        case Write_Exit:
+            return engine.exitVehicle(command.vehiId, command.when, &charge, command.recorded ? command.amount : -1);
+        case Write_Payment:
+            charge = command.amount;
+            return engine.chargeCard(command.custId, command.amount);
+        case Write_Close:
+            charge = command.amount;
+            return engine.closeTicket(command.tranId, command.when, command.amount, command.custId);
+        case Write_Cancel:
+            return engine.cancelTicket(command.tranId);
+        case Write_Settle:
+            {
+                /* the charge is the total of the settled tickets. */
+                settlementSummary summary;
+                const ParkingEngine::gateResult result = engine.settleTickets(command.when, &summary, settled);
+
+                charge = result == ParkingEngine::Gate_Ok ? summary.charged : 0;
+                return result;
+            }
+        case Write_Balance:
+            charge = command.amount;
+            return engine.setCardBalance(command.custId, command.amount, command.when);
+        case Write_Snapshot:
+            return engine.snapshotBalances();
+        case Write_Purge:
+            return engine.purgeCustomer(command.custId);
+        default: /* this should never happen. */
+            break;
+    }
+
+    return ParkingEngine::Gate_DBError;
+}
+
+/* account a batch in the group commit statistics. */
+void
+DBWriter::account(const int size, const qint64 windowUsecs, const qint64 commitUsecs, const bool committed) {
+    QMutexLocker locker(&statisticsMutex);
+
+    stats.commits++;
+    stats.commands += size;
+    if (!committed) stats.failedCommits++;
+
+    stats.largestBatch = qMax(stats.largestBatch, size);
+    stats.sizeBuckets[log2Bucket(size, COMMIT_SIZE_BUCKETS)]++;
+
+    stats.windowUsecs += windowUsecs;
+    stats.commitUsecs += commitUsecs;
+    stats.maxCommitUsecs = qMax(stats.maxCommitUsecs, commitUsecs);
+    stats.latencyBuckets[log2Bucket(commitUsecs, COMMIT_LATENCY_BUCKETS)]++;
+}
@@ -0,0 +1,202 @@
+/* header defining the interface of the source. */
+#ifndef DBWRITER_H
+#define DBWRITER_H
+
+/* include some QT libraries. */
+#include <QThread>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QMutex>
+#include <QVector>
+
+/* include headers defining the interface of the sources. */
+#include "mpscqueue.h"
+#include "parkingengine.h"
+#include "balanceledger.h"
+#include "zonemap.h"
+#include "eventjournal.h"
+#include "appsettings.h"
+
+/* the default prefix of the names of the writer's connections (the
+   writers of one process need their own, e.g. one per site). */
+static const QString defWriterPrefixStr = "parkman";
+
+/* the most commands committed in one DB transaction. */
+static const int DEF_WRITER_MAX_BATCH = 256;
+
+/* the default, maximum, minimum window (in msecs) the writer waits for
+   more commands to join the group commit of the first one. */
+static const int DEF_COMMIT_WINDOW = 5;
+static const int MAX_COMMIT_WINDOW = 1000;
+static const int MIN_COMMIT_WINDOW = 0; /* only the commands already queued. */
+
+/* buckets of the batch size histogram (1, 2-3, 4-7, ..., 512 and more). */
+static const int COMMIT_SIZE_BUCKETS = 10;
+
+/* buckets of the commit latency histogram (usecs: <2, 2-3, 4-7, ..., 2^24 and more). */
+static const int COMMIT_LATENCY_BUCKETS = 25;
+
+/* class which implements the completion of a write command. the
+   submitting thread waits on it until the command is committed. */
+class WriteTicket
+{
+    public:
+        WriteTicket();
+
+        void complete(const ParkingEngine::gateResult result, const double charge);
+        ParkingEngine::gateResult wait(double *charge = 0);
+
+    private:
+        QSemaphore done;
+        ParkingEngine::gateResult result;
+        double charge;
+
+        Q_DISABLE_COPY(WriteTicket)
+};
+
+/* write command types enumeration data type. */
+typedef enum writeCommandType {
+    Write_Entry = 0,
+    Write_Exit,
+    Write_Payment,
+    Write_Close,
+    Write_Settle,         /* all the open tickets (see ParkingEngine::settleTickets). */
+    Write_Balance,        /* the money of a credit card (see ParkingEngine::setCardBalance). */
+    Write_Snapshot,       /* the balances to the customers (see ParkingEngine::snapshotBalances). */
+    Write_Cancel,         /* a ticket by mistake (see ParkingEngine::cancelTicket). */
+    Write_Purge           /* a deleted customer (see ParkingEngine::purgeCustomer). */
+} writeCommandType;
+
+/* write command structure data type. */
+typedef struct writeCommand {
+    int type;
+    int vehiId;           /* entry, exit. */
+    int custId;           /* payment, balance, purge (and a close paid from the card). */
+    int tranId;           /* close, cancel. */
+    double amount;        /* payment, close, balance (and a recorded exit). */
+    bool recorded;        /* the amount of an exit is its journaled charge (a replay). */
+    QDateTime when;
+    WriteTicket *ticket;  /* completion (none for fire and forget). */
+    int tag;              /* completion signal (when not zero, without ticket). */
+} writeCommand;
+
+/* create a command of the given type (the rest cleared). */
+writeCommand createWriteCommand(const int type);
+
+/* group commit statistics structure data type. */
+typedef struct groupCommitStatistics {
+    qint64 commits;                                 /* DB transactions. */
+    qint64 commands;                                /* commands in them. */
+    qint64 failedCommits;
+    int largestBatch;
+    qint64 sizeBuckets[COMMIT_SIZE_BUCKETS];        /* commits per batch size. */
+    qint64 windowUsecs;                             /* total wait for the groups. */
+    qint64 commitUsecs;                             /* total BEGIN to durable COMMIT. */
+    qint64 maxCommitUsecs;
+    qint64 latencyBuckets[COMMIT_LATENCY_BUCKETS];  /* commits per commit latency. */
+} groupCommitStatistics;
+
+/* journal recovery structure data type (of the start of the writer). */
+typedef struct journalRecovery {
+    bool journaling;      /* false if the journal could not be opened. */
+    QString error;
+    quint64 projectedSeq; /* the last event in the DB when it started. */
+    int replayed;         /* events of the tail applied to the DB. */
+    int failed;           /* of them, those the engine refused. */
+    qint64 usecs;
+} journalRecovery;
+
+/* class which implements the single DB writer. gates (any thread) push
+   entry/exit/payment commands in a lock-free queue and the writer thread,
+   the only one writing the DB, commits them in batches. readers use their
+   own connections and, thanks to the write-ahead log, never block it.
+
+   the commands arriving within the commit window of the first one share
+   its transaction (group commit), so a burst costs one sync to the disk.
+   every caller is acknowledged only when the shared commit is durable,
+   either waking up its ticket or (event-driven callers) with a signal.
+
+   the writer also keeps the in-memory balances of the credit cards and
+   the occupancy of the zones, any thread may read them while the writer
+   changes them.
+
+   every command done is an event appended to the journal of the DB
+   (see EventJournal) and synced before its batch commits. only what the
+   writer changes (the tickets, the report, the card balances and the
+   purges of the deleted customers) follows the journal up to the seq
+   stored with it: the customers, their tombstones, the vehicles and the
+   payment outbox are written directly by their forms and services, are
+   not journaled and cannot be rebuilt from it. on start only the tail
+   of the journal past that seq is replayed, i.e. the commands of a batch
+   whose commit was lost in a crash, against the rest of the DB as it is. */
+class DBWriter : public QThread
+{
+    Q_OBJECT
+
+    public:
+        DBWriter(const appSettings &sets, const QString &fileName,
+                 const QString &connectionPrefix = defWriterPrefixStr, QObject *parent = 0);
+        ~DBWriter();
+
+        void submit(const writeCommand &command);
+        ParkingEngine::gateResult execute(const writeCommand &command, double *charge = 0);
+        void stop();
+
+        void setSettings(const appSettings &sets);
+        void setCommitWindow(const int msecs);
+        int commitWindow() const;
+
+        groupCommitStatistics statistics();
+
+        const BalanceLedger &balances() const;
+        const ZoneMap &zones() const;
+
+        journalRecovery recovery();
+
+    signals:
+        /* a tagged command is committed (emitted by the writer thread). */
+        void completed(const int tag, const int result, const double charge);
+
+    protected:
+        void run();
+
+    private:
+        void collectBatch(QVector<writeCommand> &batch);
+        void commitBatch(QSqlDatabase db, ParkingEngine &engine, const writeCommand &first);
+        ParkingEngine::gateResult apply(ParkingEngine &engine, const writeCommand &command, double &charge,
+                                        QList<settledTicket> *settled = 0);
+        void recover(QSqlDatabase db, ParkingEngine &engine);
+        bool journalBatch(QSqlDatabase db, const QVector<writeCommand> &batch,
+                          const QVector<ParkingEngine::gateResult> &results, const QVector<double> &charges,
+                          const QVector<QList<settledTicket> > &settled);
+        void account(const int size, const qint64 windowUsecs, const qint64 commitUsecs, const bool committed);
+
+        appSettings sets;
+        QString fileName;
+        QString connectionPrefix;
+        int maxBatch;
+        QAtomicInt window;
+
+        /* settings changed by other threads (applied before the next batch). */
+        QMutex settingsMutex;
+        appSettings newSets;
+        bool setsChanged;
+
+        QMutex statisticsMutex;
+        groupCommitStatistics stats;
+
+        BalanceLedger ledger;
+        ZoneMap zoneMap;
+
+        /* only the writer thread uses the journal. */
+        EventJournal journal;
+        int uncheckpointed;
+        journalRecovery recovered;
+
+        MpscQueue<writeCommand> queue;
+        QSemaphore pending;
+        QAtomicInt stopping;
+};
+
+#endif // DBWRITER_H
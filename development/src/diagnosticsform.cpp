@@ -0,0 +1,162 @@
+/*
+ *  This file implements the diagnostics gui form.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtGui>
+#include <QtSql>
+
+/* include headers defining the interface of the sources. */
+#include "diagnosticsform.h"
+#include "globaldeclarations.h"
+#include "latencymetrics.h"
+#include "connectionpool.h"
+#include "standbyreplica.h"
+#include "paymentoutbox.h"
+
+/* a latency in msecs (as shown). */
+static QString
+msecsText(const qint64 usecs) {
+    return QString::number(usecs / 1000.0, 'f', 3);
+}
+
+/* creates the application's diagnostics gui form. */
+DiagnosticsForm::DiagnosticsForm(QWidget *parent) : QDialog(parent) {
+    /* create the table of the latencies (an operation per row). */
+    latencyTable = new QTableWidget(LATENCY_METRICS, 6);
+    latencyTable->setHorizontalHeaderLabels(QStringList() << diagOperationStr << diagCountStr
+                                                          << diagP50Str << diagP95Str << diagP99Str << diagMaxStr);
+    latencyTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    latencyTable->setSelectionMode(QAbstractItemView::NoSelection);
+    latencyTable->verticalHeader()->hide();
+
+    const QStringList operations = QStringList() << diagEntryStr << diagExitStr << diagPaymentStr
+                                                 << diagReportStr << diagFilterStr;
+
+    for (int row = 0; row < LATENCY_METRICS; row++) {
+        latencyTable->setItem(row, 0, new QTableWidgetItem(operations.at(row)));
+
+        for (int column = 1; column < latencyTable->columnCount(); column++) {
+            QTableWidgetItem *item = new QTableWidgetItem;
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            latencyTable->setItem(row, column, item);
+        }
+    }
+
+    /* create the label of the connection pool. */
+    poolLabel = new QLabel;
+
+    /* create the label of the standby copy. */
+    standbyLabel = new QLabel;
+
+    /* create the label of the offline card payments. */
+    outboxLabel = new QLabel;
+
+    /* create the management buttons. */
+    closeButton = new QPushButton(closeButtonStr);
+
+    /* add the buttons in a button box dialog. */
+    buttonBox = new QDialogButtonBox;
+    buttonBox->addButton(closeButton, QDialogButtonBox::AcceptRole);
+
+    /* create the timer which refreshes the diagnostics. */
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(DEF_DIAGNOSTICS_REFRESH);
+
+    /* set the signals/slots for the events. */
+    connect(refreshTimer, SIGNAL(timeout()), this, SLOT(refreshDiagnostics()));
+    connect(closeButton, SIGNAL(clicked()), this, SLOT(accept()));
+
+    /* create a vertical layout. */
+    QVBoxLayout *mainLayout = new QVBoxLayout;
+
+    /* add the following objects in the layout. */
+    mainLayout->addWidget(latencyTable);
+    mainLayout->addWidget(poolLabel);
+    mainLayout->addWidget(standbyLabel);
+    mainLayout->addWidget(outboxLabel);
+    mainLayout->addWidget(buttonBox);
+
+    /* set the layout for the diagnostics form. */
+    setLayout(mainLayout);
+
+    /* set the text of the form's window. */
+    setWindowTitle(diagWinTitleStr);
+
+    /* show them now and keep them live. */
+    refreshDiagnostics();
+    latencyTable->resizeColumnsToContents();
+    resize(latencyTable->horizontalHeader()->length() + 50, sizeHint().height());
+
+    refreshTimer->start();
+}
+
+/* stop the refreshes and close the form. */
+void
+DiagnosticsForm::done(const int result) {
+    refreshTimer->stop();
+
+    /* return from the form. */
+    QDialog::done(result);
+}
+
+/* show the latencies, the connection pool, the standby copy and the outbox again. */
+void
+DiagnosticsForm::refreshDiagnostics() {
+    for (int row = 0; row < LATENCY_METRICS; row++) {
+        const latencySummary summary = latencySnapshot((latencyMetric) row);
+
+        latencyTable->item(row, 1)->setText(QString::number(summary.count));
+        latencyTable->item(row, 2)->setText(msecsText(summary.p50Usecs));
+        latencyTable->item(row, 3)->setText(msecsText(summary.p95Usecs));
+        latencyTable->item(row, 4)->setText(msecsText(summary.p99Usecs));
+        latencyTable->item(row, 5)->setText(msecsText(summary.maxUsecs));
+    }
+
+    const connectionPoolStatistics pool = connectionPool()->statistics();
+
+    poolLabel->setText(diagPoolStr.arg(pool.connections).arg(pool.checkedOut).arg(pool.peakCheckedOut)
+                                  .arg(pool.checkouts).arg(pool.waits).arg(pool.timeouts));
+
+    const standbyStatistics standby = standbyReplica()->statistics();
+
+    if (!standby.error.isEmpty())
+        standbyLabel->setText(diagBackupErrStr.arg(standby.error));
+    else
+        standbyLabel->setText(diagStandbyStr.arg(standby.lastBackup.isValid() ? standby.lastBackup.toString(Qt::ISODate) : diagNoBackupStr)
+                                            .arg(standby.backupMsecs).arg(standby.lagEvents).arg(standby.lagMsecs / 1000.0, 0, 'f', 1));
+
+    /* the payments waiting and declined (the forwarded ones are not counted). */
+    int counts[Outbox_Declined + 1] = {0, 0, 0};
+    double amounts[Outbox_Declined + 1] = {0, 0, 0};
+
+    QSqlQuery query(QString("SELECT status, COUNT(*), IFNULL(SUM(amount), 0) FROM payment_outbox "
+                            "WHERE status IN (%1, %2) GROUP BY status").arg(Outbox_Queued).arg(Outbox_Declined));
+
+    while (query.next()) {
+        const int status = query.value(0).toInt();
+
+        if (status < Outbox_Queued || status > Outbox_Declined) continue;
+
+        counts[status] = query.value(1).toInt();
+        amounts[status] = query.value(2).toDouble();
+    }
+
+    outboxLabel->setText(diagOutboxStr.arg(counts[Outbox_Queued]).arg(amounts[Outbox_Queued], 0, 'f', 2)
+                                      .arg(counts[Outbox_Declined]).arg(amounts[Outbox_Declined], 0, 'f', 2));
+}
@@ -0,0 +1,69 @@
+/* header defining the interface of the source. */
+#ifndef DIAGNOSTICSFORM_H
+#define DIAGNOSTICSFORM_H
+
+/* include some QT libraries. */
+#include <QDialog>
+
+/* use these classes. */
+class QDialogButtonBox;
+class QPushButton;
+class QTableWidget;
+class QLabel;
+class QTimer;
+
+/* the msecs between the refreshes of the diagnostics. */
+static const int DEF_DIAGNOSTICS_REFRESH = 1000;
+
+/* GUI string messages. */
+static const QString diagWinTitleStr  = QObject::tr("Diagnostics");
+
+static const QString diagOperationStr = QObject::tr("Operation");
+static const QString diagCountStr     = QObject::tr("Count");
+static const QString diagP50Str       = QObject::tr("p50 (ms)");
+static const QString diagP95Str       = QObject::tr("p95 (ms)");
+static const QString diagP99Str       = QObject::tr("p99 (ms)");
+static const QString diagMaxStr       = QObject::tr("Max (ms)");
+
+static const QString diagEntryStr     = QObject::tr("Vehicle Entry");
+static const QString diagExitStr      = QObject::tr("Exit Pricing");
+static const QString diagPaymentStr   = QObject::tr("Card Payment");
+static const QString diagReportStr    = QObject::tr("Report Storage");
+static const QString diagFilterStr    = QObject::tr("Report Filter");
+
+static const QString diagPoolStr      = QObject::tr("Connection pool: %1 open, %2 checked out (peak %3), "
+                                                    "%4 checkout(s), %5 wait(s), %6 timeout(s).");
+static const QString diagStandbyStr   = QObject::tr("Standby: last backup %1 (%2 ms), %3 event(s) behind for %4 s.");
+static const QString diagNoBackupStr  = QObject::tr("never");
+static const QString diagBackupErrStr = QObject::tr("Standby failed: %1");
+static const QString diagOutboxStr    = QObject::tr("Offline card payments: %1 waiting (%2), %3 declined by the bank (%4).");
+
+/* class which implements the diagnostics gui form. it shows the latency
+   percentiles of the hot paths (see latencymetrics.h) and the state of
+   the connection pool, the standby copy and the offline card payments
+   (the declined ones are money lost), refreshed live. */
+class DiagnosticsForm : public QDialog
+{
+    Q_OBJECT
+
+    public:
+        DiagnosticsForm(QWidget *parent = 0);
+        void done(const int result);
+
+    private slots:
+        void refreshDiagnostics();
+
+    private:
+        QTimer *refreshTimer;
+
+        QTableWidget *latencyTable;
+        QLabel *poolLabel;
+        QLabel *standbyLabel;
+        QLabel *outboxLabel;
+
+        QPushButton *closeButton;
+
+        QDialogButtonBox *buttonBox;
+};
+
+#endif // DIAGNOSTICSFORM_H
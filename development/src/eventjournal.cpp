@@ -0,0 +1,473 @@
+/*
+ *  This file implements the append-only journal of the events of the writer.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <QtEndian>
+#include <cstring>
+using namespace std;
+
+/* include the system headers flushing a mapping to the disk. */
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/* include headers defining the interface of the sources. */
+#include "eventjournal.h"
+#include "filetools.h"
+
+/* the bytes of a record (little-endian):
+
+     0 checksum (of the bytes 2 to 47)   2 type   3 version
+     8 seq   16 when   24 vehicle   28 customer   32 transaction
+    40 amount (the bits of the double) */
+static const int JOURNAL_RECORD = 48;
+
+/* the version of the records written. */
+static const int JOURNAL_RECORD_VERSION = 1;
+
+/* the checkpoint of the journal ("segment offset seq"). */
+static const QString checkpointFileStr = "checkpoint";
+static const QString checkpointTempFileStr = "checkpoint.tmp";
+
+/* write an event to a record. */
+static void
+encodeEvent(const journalEvent &event, uchar *record) {
+    memset(record, 0, JOURNAL_RECORD);
+
+    quint64 amount;
+    memcpy(&amount, &event.amount, sizeof(amount));
+
+    record[2] = (uchar) event.type;
+    record[3] = (uchar) JOURNAL_RECORD_VERSION;
+    qToLittleEndian<quint64>(event.seq, record + 8);
+    qToLittleEndian<qint64>(event.when, record + 16);
+    qToLittleEndian<qint32>(event.vehiId, record + 24);
+    qToLittleEndian<qint32>(event.custId, record + 28);
+    qToLittleEndian<qint32>(event.tranId, record + 32);
+    qToLittleEndian<quint64>(amount, record + 40);
+
+    const quint16 checksum = qChecksum((const char *) record + 2, JOURNAL_RECORD - 2);
+    qToLittleEndian<quint16>(checksum, record);
+}
+
+/* read an event from a record (false if it is empty or torn). */
+static bool
+decodeEvent(const uchar *record, journalEvent &event) {
+    if (record[2] < Event_Entry || record[2] > Event_Balance) return false;
+    if (record[3] != JOURNAL_RECORD_VERSION) return false;
+
+    const quint16 checksum = qChecksum((const char *) record + 2, JOURNAL_RECORD - 2);
+    if (qFromLittleEndian<quint16>(record) != checksum) return false;
+
+    const quint64 amount = qFromLittleEndian<quint64>(record + 40);
+
+    event.type = record[2];
+    event.seq = qFromLittleEndian<quint64>(record + 8);
+    event.when = qFromLittleEndian<qint64>(record + 16);
+    event.vehiId = qFromLittleEndian<qint32>(record + 24);
+    event.custId = qFromLittleEndian<qint32>(record + 28);
+    event.tranId = qFromLittleEndian<qint32>(record + 32);
+    memcpy(&event.amount, &amount, sizeof(amount));
+
+    return true;
+}
+
+/* create a closed journal in a directory (created when opened). */
+EventJournal::EventJournal(const QString &directory, const qint64 segmentSize) {
+    this->directory = directory;
+
+    /* whole records only. */
+    this->segmentSize = qMax(segmentSize / JOURNAL_RECORD, (qint64) 1) * JOURNAL_RECORD;
+
+    map = 0;
+    current.segment = 0;
+    current.offset = 0;
+    current.seq = 0;
+    marked = current;
+    synced = 0;
+}
+
+/* close the journal (what is appended is synced). */
+EventJournal::~EventJournal() {
+    close();
+}
+
+/* open the journal and find its end, reading only the records after
+   the checkpoint. an end left torn by a crash is cleared, so nothing
+   after it is read again. a bad record with events after it is damage
+   in the history, not a torn end: the journal is not opened and nothing
+   is cleared or removed (the error says where it is). */
+bool
+EventJournal::open(QString &error) {
+    close();
+
+    if (!QDir().mkpath(directory)) {
+        error = QString("cannot create the directory '%1'").arg(directory);
+        return false;
+    }
+
+    journalPosition start;
+    if (!readCheckpoint(start)) {
+        start.segment = start.offset = 0;
+        start.seq = 0;
+    }
+
+    journalPosition end;
+    if (!scan(start, 0, 0, end)) {
+        error = QString("cannot read the journal in '%1'").arg(directory);
+        return false;
+    }
+
+    journalPosition damage;
+    if (findEventsAfter(end, damage)) {
+        error = QString("the journal in '%1' is damaged after the seq %2 (the segment '%3' at %4), "
+                        "the events from the seq %5 on are kept")
+                    .arg(directory).arg(end.seq).arg(segmentName(end.segment)).arg(end.offset).arg(damage.seq);
+        return false;
+    }
+
+    if (!mapSegment(end.segment, true)) {
+        error = QString("cannot map the segment '%1'").arg(segmentName(end.segment));
+        return false;
+    }
+
+    current = end;
+    marked = end;
+
+    /* clear the rest of the segment up to its last record which is not
+       empty (a torn record and whatever the crash left after it). */
+    static const uchar empty[JOURNAL_RECORD] = { 0 };
+
+    qint64 dirty = current.offset;
+
+    for (qint64 offset = current.offset; offset + JOURNAL_RECORD <= file.size(); offset += JOURNAL_RECORD)
+        if (memcmp(map + offset, empty, JOURNAL_RECORD)) dirty = offset + JOURNAL_RECORD;
+
+    if (dirty > current.offset) {
+        memset(map + current.offset, 0, dirty - current.offset);
+        flush(current.offset, dirty);
+    }
+
+    synced = current.offset;
+
+    return true;
+}
+
+/* close the journal (what is appended is synced). */
+void
+EventJournal::close() {
+    if (!map) return;
+
+    sync();
+    unmapSegment();
+}
+
+/* check if the journal is open. */
+bool
+EventJournal::isOpen() const {
+    return map != 0;
+}
+
+/* the seq of the last event appended (0 if none). */
+quint64
+EventJournal::lastSeq() const {
+    return current.seq;
+}
+
+/* continue the seqs after the given one (if the journal is behind it,
+   e.g. a journal lost with the DB kept). */
+void
+EventJournal::skipTo(const quint64 seq) {
+    if (seq > current.seq) current.seq = seq;
+}
+
+/* remember the end of the journal (the start of a batch). */
+void
+EventJournal::mark() {
+    marked = current;
+}
+
+/* append an event, giving it the next seq (it is durable after a sync). */
+bool
+EventJournal::append(journalEvent &event) {
+    if (!map) return false;
+
+    /* begin the next segment when this one is full. */
+    if (current.offset + JOURNAL_RECORD > file.size()) {
+        if (!sync()) return false;
+
+        unmapSegment();
+
+        if (!mapSegment(current.segment + 1, true)) return false;
+
+        current.segment++;
+        current.offset = 0;
+        synced = 0;
+    }
+
+    event.seq = current.seq + 1;
+    encodeEvent(event, map + current.offset);
+
+    current.offset += JOURNAL_RECORD;
+    current.seq = event.seq;
+
+    return true;
+}
+
+/* sync the events appended since the last sync to the disk. */
+bool
+EventJournal::sync() {
+    if (!map) return false;
+    if (synced == current.offset) return true;
+
+    if (!flush(synced, current.offset)) return false;
+
+    synced = current.offset;
+
+    return true;
+}
+
+/* forget the events appended since the mark (their batch is undone). */
+void
+EventJournal::rollback() {
+    if (!map) return;
+
+    /* the segments begun since the mark. */
+    if (current.segment != marked.segment) {
+        unmapSegment();
+
+        for (int segment = marked.segment + 1; segment <= current.segment; segment++)
+            QFile::remove(segmentName(segment));
+
+        if (!mapSegment(marked.segment, false)) {
+            current = marked;
+            return;
+        }
+
+        current.offset = file.size();
+    }
+
+    if (current.offset > marked.offset) {
+        memset(map + marked.offset, 0, current.offset - marked.offset);
+        flush(marked.offset, current.offset);
+    }
+
+    current = marked;
+    synced = qMin(synced, current.offset);
+}
+
+/* record that every event up to the last one is projected to the DB
+   (recovery starts reading after it). */
+bool
+EventJournal::checkpoint() {
+    if (!map) return false;
+
+    QFile temp(QDir(directory).filePath(checkpointTempFileStr));
+    if (!temp.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) return false;
+
+    const QByteArray line = QString("%1 %2 %3\n").arg(current.segment).arg(current.offset).arg(current.seq).toAscii();
+
+    /* the new checkpoint is on the disk before it replaces the old one. */
+    const bool written = temp.write(line) == line.size() && syncFile(temp);
+    temp.close();
+
+    return written && replaceFile(temp.fileName(), QDir(directory).filePath(checkpointFileStr));
+}
+
+/* read the events after a seq (the tail of the journal, from the
+   checkpoint if it is not past the seq, else from the beginning). */
+bool
+EventJournal::readAfter(const quint64 seq, QList<journalEvent> &events, QString &error) {
+    journalPosition start;
+    if (!readCheckpoint(start) || start.seq > seq) {
+        start.segment = start.offset = 0;
+        start.seq = 0;
+    }
+
+    journalPosition end;
+    if (!scan(start, seq, &events, end)) {
+        error = QString("cannot read the journal in '%1'").arg(directory);
+        return false;
+    }
+
+    return true;
+}
+
+/* the file of a segment. */
+QString
+EventJournal::segmentName(const int segment) const {
+    return QDir(directory).filePath(QString("%1.seg").arg(segment, 8, 10, QChar('0')));
+}
+
+/* map a segment to the memory (created full of empty records). */
+bool
+EventJournal::mapSegment(const int segment, const bool create) {
+    file.setFileName(segmentName(segment));
+
+    if (!create && !file.exists()) return false;
+    if (!file.open(QIODevice::ReadWrite)) return false;
+
+    if (file.size() < segmentSize && !file.resize(segmentSize)) {
+        file.close();
+        return false;
+    }
+
+    map = file.map(0, file.size());
+
+    if (!map) {
+        file.close();
+        return false;
+    }
+
+    return true;
+}
+
+/* unmap the segment. */
+void
+EventJournal::unmapSegment() {
+    if (map) file.unmap(map);
+
+    map = 0;
+    file.close();
+}
+
+/* flush a range of the mapping to the disk (and wait for it). */
+bool
+EventJournal::flush(const qint64 from, const qint64 to) {
+    if (to <= from) return true;
+
+#ifdef Q_OS_WIN
+    if (!FlushViewOfFile(map + from, (SIZE_T) (to - from))) return false;
+
+    return FlushFileBuffers((HANDLE) _get_osfhandle(file.handle())) != 0;
+#else
+    /* the start of the page of the range. */
+    const qint64 page = sysconf(_SC_PAGESIZE);
+    const qint64 start = from - from % page;
+
+    return msync(map + start, (size_t) (to - start), MS_SYNC) == 0;
+#endif
+}
+
+/* scan the records from a position to the end of the journal (the
+   first record empty, torn or out of order), collecting the events
+   after a seq. */
+bool
+EventJournal::scan(const journalPosition &from, const quint64 afterSeq,
+                   QList<journalEvent> *events, journalPosition &end) {
+    end = from;
+
+    forever {
+        QFile segment(segmentName(end.segment));
+
+        /* the journal ends with the last segment. */
+        if (!segment.exists()) return true;
+        if (!segment.open(QIODevice::ReadOnly)) return false;
+
+        const qint64 size = segment.size() - segment.size() % JOURNAL_RECORD;
+        const uchar *data = size ? segment.map(0, size) : 0;
+
+        if (size && !data) return false;
+
+        journalEvent event;
+
+        while (end.offset + JOURNAL_RECORD <= size) {
+            if (!decodeEvent(data + end.offset, event) || event.seq <= end.seq) {
+                segment.unmap((uchar *) data);
+                return true;
+            }
+
+            if (events && event.seq > afterSeq) *events << event;
+
+            end.offset += JOURNAL_RECORD;
+            end.seq = event.seq;
+        }
+
+        if (data) segment.unmap((uchar *) data);
+
+        /* the segment is full, the journal may go on in the next one. */
+        if (!QFile::exists(segmentName(end.segment + 1))) return true;
+
+        end.segment++;
+        end.offset = 0;
+    }
+}
+
+/* find the first event after the end of the journal (past a bad record
+   of its segment or in a later segment), i.e. the history a bad record
+   in the middle would cut off. */
+bool
+EventJournal::findEventsAfter(const journalPosition &end, journalPosition &found) const {
+    for (int number = end.segment; QFile::exists(segmentName(number)); number++) {
+        QFile segment(segmentName(number));
+        if (!segment.open(QIODevice::ReadOnly)) return true; /* unreadable, keep it. */
+
+        const qint64 size = segment.size() - segment.size() % JOURNAL_RECORD;
+        const uchar *data = size ? segment.map(0, size) : 0;
+
+        if (size && !data) return true;
+
+        journalEvent event;
+        qint64 offset = number == end.segment ? end.offset + JOURNAL_RECORD : 0;
+
+        for (; offset + JOURNAL_RECORD <= size; offset += JOURNAL_RECORD) {
+            if (decodeEvent(data + offset, event) && event.seq > end.seq) {
+                segment.unmap((uchar *) data);
+
+                found.segment = number;
+                found.offset = offset;
+                found.seq = event.seq;
+
+                return true;
+            }
+        }
+
+        if (data) segment.unmap((uchar *) data);
+    }
+
+    return false;
+}
+
+/* read the checkpoint (the temporary one if it was not renamed yet). */
+bool
+EventJournal::readCheckpoint(journalPosition &position) const {
+    QFile checkpoint(QDir(directory).filePath(checkpointFileStr));
+
+    if (!checkpoint.exists())
+        checkpoint.setFileName(QDir(directory).filePath(checkpointTempFileStr));
+
+    if (!checkpoint.open(QIODevice::ReadOnly | QIODevice::Text)) return false;
+
+    const QStringList fields = QString::fromAscii(checkpoint.readLine()).simplified().split(' ');
+    if (fields.size() != 3) return false;
+
+    bool okSegment, okOffset, okSeq;
+
+    position.segment = fields.at(0).toInt(&okSegment);
+    position.offset = fields.at(1).toLongLong(&okOffset);
+    position.seq = fields.at(2).toULongLong(&okSeq);
+
+    return okSegment && okOffset && okSeq && position.segment >= 0 &&
+           position.offset >= 0 && position.offset % JOURNAL_RECORD == 0;
+}
@@ -0,0 +1,104 @@
+/* header defining the interface of the source. */
+#ifndef EVENTJOURNAL_H
+#define EVENTJOURNAL_H
+
+/* include some QT libraries. */
+#include <QString>
+#include <QFile>
+#include <QList>
+
+/* the suffix of the journal directory of a DB file. */
+static const QString journalSuffixStr = ".events";
+
+/* the bytes of a segment of the journal (a file mapped in memory). */
+static const qint64 DEF_JOURNAL_SEGMENT = 8 * 1024 * 1024;
+
+/* the events between the checkpoints of the journal (where recovery starts). */
+static const int DEF_JOURNAL_CHECKPOINT = 4096;
+
+/* journal event types enumeration data type. */
+typedef enum journalEventType {
+    Event_Entry = 1,      /* a vehicle entered. */
+    Event_Exit,           /* a vehicle exited and paid (the charge, kept on replay). */
+    Event_Payment,        /* a card paid (the amount). */
+    Event_Close,          /* a ticket was paid and closed (the charge). */
+    Event_Void,           /* a ticket was cancelled by mistake. */
+    Event_Settle,         /* all the open tickets were settled (older journals,
+                             a settlement is journaled as its exits now). */
+    Event_Balance,        /* the money of a card was set (the amount). */
+    Event_Purge           /* a deleted customer was purged. */
+} journalEventType;
+
+/* journal event structure data type. */
+typedef struct journalEvent {
+    quint64 seq;          /* given by the journal, from 1. */
+    int type;
+    qint64 when;          /* msecs since the epoch. */
+    int vehiId;
+    int custId;
+    int tranId;
+    double amount;
+} journalEvent;
+
+/* journal position structure data type (of a record). */
+typedef struct journalPosition {
+    int segment;
+    qint64 offset;
+    quint64 seq;          /* the last one before the position. */
+} journalPosition;
+
+/* class which implements the append-only journal of the events. it is
+   a sequence of segment files of fixed size records (with a checksum),
+   the last one mapped in memory: an append is a copy to the mapping and
+   a sync is a flush of the pages written since the last one. the end of
+   the journal is the first record which is empty or torn, and a torn
+   record with events after it is reported as damage (never cleared).
+
+   a checkpoint records where the events which are not projected to the
+   DB yet may start, so recovery reads only the tail of the journal. the
+   segments are never removed (they are the audit trail of the writer's
+   commands, not of the customers and vehicles edited directly). */
+class EventJournal
+{
+    public:
+        EventJournal(const QString &directory, const qint64 segmentSize = DEF_JOURNAL_SEGMENT);
+        ~EventJournal();
+
+        bool open(QString &error);
+        void close();
+        bool isOpen() const;
+
+        quint64 lastSeq() const;
+        void skipTo(const quint64 seq);
+
+        void mark();
+        bool append(journalEvent &event);
+        bool sync();
+        void rollback();
+
+        bool checkpoint();
+        bool readAfter(const quint64 seq, QList<journalEvent> &events, QString &error);
+
+    private:
+        QString segmentName(const int segment) const;
+        bool mapSegment(const int segment, const bool create);
+        void unmapSegment();
+        bool flush(const qint64 from, const qint64 to);
+        bool scan(const journalPosition &from, const quint64 afterSeq,
+                  QList<journalEvent> *events, journalPosition &end);
+        bool findEventsAfter(const journalPosition &end, journalPosition &found) const;
+        bool readCheckpoint(journalPosition &position) const;
+
+        QString directory;
+        qint64 segmentSize;
+
+        QFile file;                 /* the mapped segment ... */
+        uchar *map;
+        journalPosition current;    /* ... and the end of the journal. */
+        qint64 synced;              /* the mapping is synced up to it. */
+        journalPosition marked;     /* the end before the batch (for a rollback). */
+
+        Q_DISABLE_COPY(EventJournal)
+};
+
+#endif // EVENTJOURNAL_H
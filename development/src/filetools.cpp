@@ -0,0 +1,69 @@
+/*
+ *  This file implements some useful file tools.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+
+/* include the system headers syncing and renaming the files. */
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#endif
+
+/* include header defining the interface of the source. */
+#include "filetools.h"
+
+/* flush a file open for writing and wait until it is on the disk. */
+bool
+syncFile(QFile &file) {
+    if (!file.flush()) return false;
+
+#ifdef Q_OS_WIN
+    return FlushFileBuffers((HANDLE) _get_osfhandle(file.handle())) != 0;
+#else
+    return fsync(file.handle()) == 0;
+#endif
+}
+
+/* replace a file with another one in one step (a crash leaves either of
+   them, never none) and sync the directory of the name. */
+bool
+replaceFile(const QString &from, const QString &to) {
+#ifdef Q_OS_WIN
+    return MoveFileExW((LPCWSTR) QDir::toNativeSeparators(from).utf16(),
+                       (LPCWSTR) QDir::toNativeSeparators(to).utf16(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) != 0)
+        return false;
+
+    /* the new name is durable with its directory. */
+    const int directory = ::open(QFile::encodeName(QFileInfo(to).absolutePath()).constData(), O_RDONLY);
+    if (directory < 0) return false;
+
+    const bool synced = fsync(directory) == 0;
+    ::close(directory);
+
+    return synced;
+#endif
+}
@@ -0,0 +1,16 @@
+/* header defining the interface of the source. */
+#ifndef FILETOOLS_H
+#define FILETOOLS_H
+
+/* include some QT libraries. */
+#include <QFile>
+#include <QString>
+
+/* flush a file open for writing and wait until it is on the disk. */
+bool syncFile(QFile &file);
+
+/* replace a file with another one in one step (a crash leaves either of
+   them, never none) and sync the directory of the name. */
+bool replaceFile(const QString &from, const QString &to);
+
+#endif // FILETOOLS_H
@@ -0,0 +1,188 @@
+/*
+ *  This file implements the binary protocol of the gate devices.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <cstring>
+using namespace std;
+
+/* include header defining the interface of the source. */
+#include "gateprotocol.h"
+
+/* bytes of the frame header after the length (kind, id). */
+static const int FRAME_HEADER_SIZE = 1 + 4;
+
+/* bytes of the fixed request/response body. */
+static const int REQUEST_BODY_SIZE = 8 + 8 + 1;
+static const int RESPONSE_BODY_SIZE = 1 + 8;
+
+/* bytes of the optional site of a request (after the plate). */
+static const int REQUEST_SITE_SIZE = 2;
+
+/* the kind of a response frame (the requests use their type). */
+static const quint8 RESPONSE_KIND = 0;
+
+/* append a number in network byte order. */
+template <typename T> static void
+appendNumber(QByteArray &data, const T value) {
+    uchar bytes[sizeof(T)];
+    qToBigEndian<T>(value, bytes);
+    data.append((const char *) bytes, sizeof(T));
+}
+
+/* read a number in network byte order (the caller checks the size). */
+template <typename T> static T
+readNumber(const QByteArray &data, int &offset) {
+    const T value = qFromBigEndian<T>((const uchar *) data.constData() + offset);
+    offset += sizeof(T);
+    return value;
+}
+
+/* the bits of a double as a number (to send it in network byte order). */
+static quint64
+doubleBits(const double value) {
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/* the double of its bits. */
+static double
+bitsDouble(const quint64 bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/* put the length field in front of a frame. */
+static QByteArray
+finishFrame(const QByteArray &frame) {
+    QByteArray data;
+    data.reserve(2 + frame.size());
+
+    appendNumber<quint16>(data, (quint16) frame.size());
+    data.append(frame);
+
+    return data;
+}
+
+/* encode a request in a frame. */
+QByteArray
+encodeRequest(const gateRequest &request) {
+    /* the plate is truncated to its largest length, but not inside a
+       character (the continuation bytes of utf-8 are 10xxxxxx). */
+    QByteArray plate = request.plate.toUtf8();
+
+    if (plate.size() > GATE_MAX_PLATE) {
+        int size = GATE_MAX_PLATE;
+
+        while (size > 0 && ((uchar) plate.at(size) & 0xC0) == 0x80) size--;
+
+        plate.truncate(size);
+    }
+
+    QByteArray frame;
+    frame.reserve(FRAME_HEADER_SIZE + REQUEST_BODY_SIZE + plate.size() + REQUEST_SITE_SIZE);
+
+    appendNumber<quint8>(frame, request.type);
+    appendNumber<quint32>(frame, request.id);
+    appendNumber<qint64>(frame, request.when);
+    appendNumber<quint64>(frame, doubleBits(request.amount));
+    appendNumber<quint8>(frame, (quint8) plate.size());
+    frame.append(plate);
+
+    /* the frames of the default site stay as they were. */
+    if (request.site) appendNumber<quint16>(frame, request.site);
+
+    return finishFrame(frame);
+}
+
+/* encode a response in a frame. */
+QByteArray
+encodeResponse(const gateResponse &response) {
+    QByteArray frame;
+    frame.reserve(FRAME_HEADER_SIZE + RESPONSE_BODY_SIZE);
+
+    appendNumber<quint8>(frame, RESPONSE_KIND);
+    appendNumber<quint32>(frame, response.id);
+    appendNumber<quint8>(frame, response.result);
+    appendNumber<quint64>(frame, doubleBits(response.charge));
+
+    return finishFrame(frame);
+}
+
+/* decode a frame in a request. */
+bool
+decodeRequest(const QByteArray &frame, gateRequest &request) {
+    if (frame.size() < FRAME_HEADER_SIZE + REQUEST_BODY_SIZE) return false;
+
+    int offset = 0;
+
+    request.type = readNumber<quint8>(frame, offset);
+    request.id = readNumber<quint32>(frame, offset);
+    request.when = readNumber<qint64>(frame, offset);
+    request.amount = bitsDouble(readNumber<quint64>(frame, offset));
+
+    const int plateSize = readNumber<quint8>(frame, offset);
+
+    /* the plate fills the rest of the frame, but the site. */
+    const int rest = frame.size() - offset - plateSize;
+    if (rest != 0 && rest != REQUEST_SITE_SIZE) return false;
+
+    request.plate = QString::fromUtf8(frame.constData() + offset, plateSize);
+    offset += plateSize;
+
+    request.site = rest ? readNumber<quint16>(frame, offset) : 0;
+
+    return request.type >= Request_Entry && request.type <= Request_Pay;
+}
+
+/* decode a frame in a response. */
+bool
+decodeResponse(const QByteArray &frame, gateResponse &response) {
+    if (frame.size() != FRAME_HEADER_SIZE + RESPONSE_BODY_SIZE) return false;
+
+    int offset = 0;
+
+    if (readNumber<quint8>(frame, offset) != RESPONSE_KIND) return false;
+
+    response.id = readNumber<quint32>(frame, offset);
+    response.result = readNumber<quint8>(frame, offset);
+    response.charge = bitsDouble(readNumber<quint64>(frame, offset));
+
+    return true;
+}
+
+/* take the next complete frame of a receive buffer from the offset. */
+bool
+takeFrame(const QByteArray &buffer, int &offset, QByteArray &frame) {
+    /* the length field has not arrived yet. */
+    if (buffer.size() - offset < 2) return false;
+
+    int position = offset;
+    const int length = readNumber<quint16>(buffer, position);
+
+    /* the frame has not arrived whole yet. */
+    if (buffer.size() - position < length) return false;
+
+    frame = buffer.mid(position, length);
+    offset = position + length;
+
+    return true;
+}
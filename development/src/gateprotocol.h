@@ -0,0 +1,70 @@
+/* header defining the interface of the source. */
+#ifndef GATEPROTOCOL_H
+#define GATEPROTOCOL_H
+
+/* include some QT libraries. */
+#include <QByteArray>
+#include <QString>
+
+/* the default TCP port and local socket name of the gate daemon. */
+static const quint16 DEF_GATE_PORT = 7411;
+static const QString defGateSocketStr = "parkmand";
+
+/* the largest frame (the length field is 16 bits). */
+static const int GATE_MAX_FRAME = 0xFFFF;
+
+/* the longest plate of a request (its length field is 8 bits). */
+static const int GATE_MAX_PLATE = 0xFF;
+
+/* result of a request the daemon could not decode (after the gate results). */
+static const quint8 GATE_BAD_REQUEST = 0xFF;
+
+/* gate request types enumeration data type. */
+typedef enum gateRequestType {
+    Request_Entry = 1,
+    Request_Exit,
+    Request_Quote,
+    Request_Pay
+} gateRequestType;
+
+/* gate request structure data type. */
+typedef struct gateRequest {
+    quint8 type;
+    quint32 id;           /* chosen by the device, echoed in the response. */
+    qint64 when;          /* msecs since the epoch (0 for the daemon's now). */
+    double amount;        /* pay. */
+    QString plate;
+    quint16 site;         /* the car park of the gate (0 for the daemon's default). */
+} gateRequest;
+
+/* gate response structure data type. */
+typedef struct gateResponse {
+    quint32 id;
+    quint8 result;        /* a gate result of the engine or bad request. */
+    double charge;        /* exit, quote, pay. */
+} gateResponse;
+
+/* the frames of the protocol (all numbers in network byte order):
+
+     frame    : length (u16, bytes after it), kind (u8), id (u32), body.
+     request  : body is when (i64), amount (f64), plate length (u8), plate (utf-8)
+                and site (u16), left out for the default site.
+     response : kind is 0, body is result (u8), charge (f64).
+
+   the requests of a connection may be pipelined, the responses carry
+   the id of their request and may arrive in any order. */
+
+/* encode a request/response in a frame. */
+QByteArray encodeRequest(const gateRequest &request);
+QByteArray encodeResponse(const gateResponse &response);
+
+/* decode a frame (without its length field) in a request/response. */
+bool decodeRequest(const QByteArray &frame, gateRequest &request);
+bool decodeResponse(const QByteArray &frame, gateResponse &response);
+
+/* take the next complete frame (without its length field) of a receive
+   buffer from the offset and move the offset after it. false if it has
+   not arrived whole yet (the caller drops the consumed bytes once). */
+bool takeFrame(const QByteArray &buffer, int &offset, QByteArray &frame);
+
+#endif // GATEPROTOCOL_H
@@ -25,8 +25,8 @@ static const QString sqlInjectionRegExpStr = "[" + QRegExp::escape("\'\"$*+?[]^{
 /* regular expression for numbers (integer/real). */
 static const QString numberRegExpStr = "^[0-9]+(,[0-9]+){0,1}$";
 
-/* mask for a credit card number. */
-static const QString creditCardNumberMaskStr = "0000-0000-0000-0000;_";
+/* mask for a credit card number (12 to 19 digits). */
+static const QString creditCardNumberMaskStr = "0000-0000-0000-9999-999;_";
 
 /* format of a datetime value. */
 static const QString dateTimeFormatStr = "dd-MM-yyyy, hh:mm:ss";
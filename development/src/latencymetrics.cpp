@@ -0,0 +1,226 @@
+/*
+ *  This file implements the latency metrics of the hot paths.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <climits>
+#include <cstring>
+using namespace std;
+
+/* include header defining the interface of the source. */
+#include "latencymetrics.h"
+
+/* the names of the operations (as exported). */
+static const char *latencyNames[LATENCY_METRICS] = {
+    "entry", "exit", "payment", "report", "report_filter"
+};
+
+/* the name of the exported metric. */
+static const QString latencyMetricStr = "parkman_operation_latency_seconds";
+
+/* histograms of a thread structure data type. */
+typedef struct threadLatencies {
+    LatencyHistogram histograms[LATENCY_METRICS];
+} threadLatencies;
+
+/* the histograms of a thread (for its thread storage, which deletes it
+   when the thread finishes but not the histograms it points to). */
+typedef struct threadLatenciesRef {
+    threadLatencies *latencies;
+} threadLatenciesRef;
+
+/* the histograms of every thread which recorded any latency. they stay
+   when their thread finishes, so the summaries never go backwards. */
+static QMutex registryMutex;
+static QList<threadLatencies *> registry;
+static QThreadStorage<threadLatenciesRef *> currentLatencies;
+
+/* the histograms of the calling thread (registered the first time). */
+static threadLatencies *
+localLatencies() {
+    if (!currentLatencies.hasLocalData()) {
+        threadLatenciesRef *ref = new threadLatenciesRef;
+        ref->latencies = new threadLatencies;
+
+        QMutexLocker locker(&registryMutex);
+        registry << ref->latencies;
+        locker.unlock();
+
+        currentLatencies.setLocalData(ref);
+    }
+
+    return currentLatencies.localData()->latencies;
+}
+
+/* create an empty histogram. */
+LatencyHistogram::LatencyHistogram() : maximum(0) {
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+        buckets[i] = 0;
+}
+
+/* record a latency (only by the thread of the histogram, without locks). */
+void
+LatencyHistogram::record(const qint64 usecs) {
+    buckets[bucketOf(usecs)].fetchAndAddRelaxed(1);
+
+    const int value = (int) qBound((qint64) 0, usecs, (qint64) INT_MAX);
+
+    /* no other thread writes it. */
+    if (value > (int) maximum) maximum = value;
+}
+
+/* add the counts of the buckets and the maximum to others (any thread). */
+void
+LatencyHistogram::addTo(qint64 *counts, qint64 &maxUsecs) const {
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+        counts[i] += (int) buckets[i];
+
+    maxUsecs = qMax(maxUsecs, (qint64) (int) maximum);
+}
+
+/* the bucket of a latency. */
+int
+LatencyHistogram::bucketOf(const qint64 usecs) {
+    if (usecs < LATENCY_SUB_BUCKETS) return (int) qMax((qint64) 0, usecs);
+
+    const quint32 value = (quint32) qMin(usecs, (qint64) INT_MAX);
+
+    /* the power of two of the value (at least that of the sub-buckets). */
+    int power = 0;
+    while ((value >> (power + 1)) != 0) power++;
+
+    const int shift = power - 4; /* log2(LATENCY_SUB_BUCKETS). */
+
+    return LATENCY_SUB_BUCKETS * (shift + 1) + (int) (value >> shift) - LATENCY_SUB_BUCKETS;
+}
+
+/* the value a bucket stands for (its middle). */
+qint64
+LatencyHistogram::bucketValue(const int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) return bucket;
+
+    const int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    const qint64 lower = (qint64) (LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) << shift;
+
+    return lower + (((qint64) 1 << shift) >> 1);
+}
+
+/* start timing an operation. */
+LatencyTimer::LatencyTimer(const latencyMetric metric) {
+    this->metric = metric;
+    timer.start();
+}
+
+/* record the latency of the operation. */
+LatencyTimer::~LatencyTimer() {
+    recordLatency(metric, timer.nsecsElapsed() / 1000);
+}
+
+/* record the latency of an operation in the histograms of the calling thread. */
+void
+recordLatency(const latencyMetric metric, const qint64 usecs) {
+    localLatencies()->histograms[metric].record(usecs);
+}
+
+/* summarize the latencies of an operation (of all the threads). */
+latencySummary
+latencySnapshot(const latencyMetric metric) {
+    qint64 counts[LATENCY_BUCKETS];
+    memset(counts, 0, sizeof(counts));
+
+    latencySummary summary;
+    memset(&summary, 0, sizeof(summary));
+
+    {
+        QMutexLocker locker(&registryMutex);
+
+        foreach (const threadLatencies *latencies, registry)
+            latencies->histograms[metric].addTo(counts, summary.maxUsecs);
+    }
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        summary.count += counts[i];
+        summary.sumUsecs += counts[i] * LatencyHistogram::bucketValue(i);
+    }
+
+    if (!summary.count) return summary;
+
+    /* the ranks of the percentiles (rounded up). */
+    const qint64 p50 = (summary.count * 50 + 99) / 100;
+    const qint64 p95 = (summary.count * 95 + 99) / 100;
+    const qint64 p99 = (summary.count * 99 + 99) / 100;
+
+    qint64 seen = 0;
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        if (!counts[i]) continue;
+
+        const qint64 before = seen;
+        seen += counts[i];
+
+        const qint64 value = qMin(LatencyHistogram::bucketValue(i), summary.maxUsecs);
+
+        if (before < p50 && seen >= p50) summary.p50Usecs = value;
+        if (before < p95 && seen >= p95) summary.p95Usecs = value;
+        if (before < p99 && seen >= p99) summary.p99Usecs = value;
+    }
+
+    return summary;
+}
+
+/* the name of an operation (as exported). */
+QString
+latencyMetricName(const latencyMetric metric) {
+    return latencyNames[metric];
+}
+
+/* the latencies of all the operations in the Prometheus text format
+   (a summary with its quantiles and the maximum as a gauge). */
+QString
+latencyPrometheusText() {
+    QString text;
+    QTextStream out(&text);
+
+    out << "# HELP " << latencyMetricStr << " Latency of the operations of the lanes and the report.\n";
+    out << "# TYPE " << latencyMetricStr << " summary\n";
+
+    QString maxima;
+    QTextStream maxOut(&maxima);
+
+    maxOut << "# HELP " << latencyMetricStr << "_max Longest latency of the operations.\n";
+    maxOut << "# TYPE " << latencyMetricStr << "_max gauge\n";
+
+    for (int i = 0; i < LATENCY_METRICS; i++) {
+        const latencySummary summary = latencySnapshot((latencyMetric) i);
+        const QString label = QString("operation=\"%1\"").arg(latencyNames[i]);
+
+        out << latencyMetricStr << "{" << label << ",quantile=\"0.5\"} " << summary.p50Usecs / 1e6 << "\n";
+        out << latencyMetricStr << "{" << label << ",quantile=\"0.95\"} " << summary.p95Usecs / 1e6 << "\n";
+        out << latencyMetricStr << "{" << label << ",quantile=\"0.99\"} " << summary.p99Usecs / 1e6 << "\n";
+        out << latencyMetricStr << "_sum{" << label << "} " << summary.sumUsecs / 1e6 << "\n";
+        out << latencyMetricStr << "_count{" << label << "} " << summary.count << "\n";
+
+        maxOut << latencyMetricStr << "_max{" << label << "} " << summary.maxUsecs / 1e6 << "\n";
+    }
+
+    out.flush();
+    maxOut.flush();
+
+    return text + maxima;
+}
@@ -0,0 +1,91 @@
+/* header defining the interface of the source. */
+#ifndef LATENCYMETRICS_H
+#define LATENCYMETRICS_H
+
+/* include some QT libraries. */
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QString>
+
+/* timed operations enumeration data type. */
+typedef enum latencyMetric {
+    Latency_Entry = 0,    /* a vehicle enters (VehicleForm::transactionVehicle). */
+    Latency_Exit,         /* a transaction is priced (TransactionForm::completeTransaction, but the payment). */
+    Latency_Payment,      /* a transaction is charged to a card and stored in the report (TransactionForm::storeInReport). */
+    Latency_Report,       /* a transaction paid already is stored in the report (TransactionForm::storeInReport). */
+    Latency_ReportFilter  /* the report is filtered (ReportForm). */
+} latencyMetric;
+
+/* the timed operations. */
+static const int LATENCY_METRICS = 5;
+
+/* the values below it are counted exactly, the larger ones in buckets
+   of 1/16 of their power of two (at most 6.25% wider than a value). */
+static const int LATENCY_SUB_BUCKETS = 16;
+
+/* the powers of two after the exact values (up to 2^31 usecs). */
+static const int LATENCY_MAGNITUDES = 27;
+
+/* buckets of a latency histogram. */
+static const int LATENCY_BUCKETS = LATENCY_SUB_BUCKETS * (LATENCY_MAGNITUDES + 1);
+
+/* latency summary structure data type (usecs, of all the threads). */
+typedef struct latencySummary {
+    qint64 count;
+    qint64 sumUsecs;      /* as estimated by the buckets. */
+    qint64 maxUsecs;
+    qint64 p50Usecs;
+    qint64 p95Usecs;
+    qint64 p99Usecs;
+} latencySummary;
+
+/* class which implements a histogram of latencies (in usecs) with
+   log-linear buckets (HDR-style: a fixed relative error over a wide
+   range, a fixed size and a constant time record). only its own thread
+   records in it, any thread may read it meanwhile. */
+class LatencyHistogram
+{
+    public:
+        LatencyHistogram();
+
+        void record(const qint64 usecs);
+        void addTo(qint64 *counts, qint64 &maxUsecs) const;
+
+        static int bucketOf(const qint64 usecs);
+        static qint64 bucketValue(const int bucket);
+
+    private:
+        QAtomicInt buckets[LATENCY_BUCKETS];
+        QAtomicInt maximum;
+
+        Q_DISABLE_COPY(LatencyHistogram)
+};
+
+/* class which implements the timing of an operation from its creation
+   to the end of its scope (recorded by the calling thread). */
+class LatencyTimer
+{
+    public:
+        LatencyTimer(const latencyMetric metric);
+        ~LatencyTimer();
+
+    private:
+        latencyMetric metric;
+        QElapsedTimer timer;
+
+        Q_DISABLE_COPY(LatencyTimer)
+};
+
+/* record the latency of an operation in the histograms of the calling thread. */
+void recordLatency(const latencyMetric metric, const qint64 usecs);
+
+/* summarize the latencies of an operation (of all the threads). */
+latencySummary latencySnapshot(const latencyMetric metric);
+
+/* the name of an operation (as exported). */
+QString latencyMetricName(const latencyMetric metric);
+
+/* the latencies of all the operations in the Prometheus text format. */
+QString latencyPrometheusText();
+
+#endif // LATENCYMETRICS_H
@@ -27,16 +27,20 @@ using namespace std;
 /* include headers defining the interface of the sources. */
 #include "mainform.h"
 #include "globaldeclarations.h"
-
-/* declare DB driver and filename. */
-static const QString dbDriverStr = "QSQLITE";
-static const QString dbFileNameStr = "database.db";
+#include "databasetools.h"
+#include "bankingtools.h"
+#include "receiptspooler.h"
+#include "connectionpool.h"
+#include "metricsexporter.h"
+#include "standbyreplica.h"
+#include "customerpurge.h"
 
 /* GUI string messages. */
 static const QString dbConnectErrorStr       = QObject::tr("Database Connection Error");
 static const QString dbDriverNotExistStr     = QObject::tr("Database driver is not available.");
 static const QString dbCannotOpenStr         = QObject::tr("The database cannot open.");
 static const QString dbCreationStr           = QObject::tr("Creating a database instance...");
+static const QString dbCannotUpgradeStr      = QObject::tr("The database cannot be upgraded.");
 
 static const QString splashDBDriversStr      = QObject::tr("Searching Available Database Drivers...");
 static const QString splashDBConnectionStr   = QObject::tr("Establishing Database Connection...");
@@ -54,8 +58,8 @@ static const Qt::Alignment topCenter = Qt::AlignHCenter | Qt::AlignTop;
 /* splashscreen text wait time. */
 static const int SPLASH_TEXT_DELAY = 1500;
 
-/* progress bar number of steps. */
-static const int PBAR_MAX_STEPS = 8;
+/* progress bar steps besides the schema statements (the start and the data). */
+static const int PBAR_FIXED_STEPS = 2;
 
 /* creates a connection to the DB. */
 static bool
@@ -97,6 +101,9 @@ createDBConnection() {
         return false;
     }
 
+    /* apply the pragmas of the connection (write-ahead log). */
+    applyConnectionPragmas(db);
+
     /* DB connection successed. */
     return true;
 }
@@ -107,6 +114,9 @@ createDBInstance() {
     /* initial step of the progress bar. */
     int step = 0;
 
+    /* the statements creating the schema (one progress step each). */
+    const QStringList statements = dbSchemaStatements();
+
     /* create and setup a progress bar. */
     QProgressDialog progress;
     progress.setWindowModality(Qt::WindowModal);
@@ -114,7 +124,7 @@ createDBInstance() {
     progress.setCancelButtonText(QString()); /* hide cancel button. */
     progress.setLabelText(dbCreationStr);
     progress.setMinimum(step);
-    progress.setMaximum(PBAR_MAX_STEPS);
+    progress.setMaximum(statements.size() + PBAR_FIXED_STEPS);
 
     /* start progress. */
     progress.setValue(++step);
@@ -128,88 +138,24 @@ createDBInstance() {
     /* declare a sql query object. */
     QSqlQuery query;
 
-    /* create DB Schema. */
-    query.exec("CREATE TABLE cardtype ("
-               "  id INTEGER PRIMARY KEY AUTOINCREMENT, "
-               "  title TEXT NOT NULL)");
-
-    /* continue progress. */
-    progress.setValue(++step);
-    qApp->processEvents();
-
-    query.exec("CREATE TABLE customer ("
-               "  id INTEGER PRIMARY KEY AUTOINCREMENT, "
-               "  name TEXT NOT NULL, "
-               "  address TEXT, "
-               "  city TEXT, "
-               "  state TEXT, "
-               "  phone TEXT,"
-               "  email TEXT, "
-               "  card_date TEXT,"
-               "  card_money REAL,"
-               "  card_id INTEGER NOT NULL, "
-               "  FOREIGN KEY (card_id) REFERENCES cardtype)");
-
-    /* continue progress. */
-    progress.setValue(++step);
-    qApp->processEvents();
-
-    query.exec("CREATE TABLE vehicle ("
-               "  id INTEGER PRIMARY KEY AUTOINCREMENT, "
-               "  reg_num TEXT NOT NULL, "
-               "  desc TEXT, "
-               "  cust_id INTEGER NOT NULL, "
-               "  FOREIGN KEY (cust_id) REFERENCES customer)");
-
-    /* continue progress. */
-    progress.setValue(++step);
-    qApp->processEvents();
-
-    query.exec("CREATE TABLE transacts ("
-               "  id INTEGER PRIMARY KEY AUTOINCREMENT, "
-               "  vehi_id INTEGER NOT NULL, "
-               "  cust_id INTEGER NOT NULL, "
-               "  start_date TEXT NOT NULL,"
-               "  start_time TEXT NOT NULL,"
-               "  FOREIGN KEY (vehi_id) REFERENCES vehicle, "
-               "  FOREIGN KEY (cust_id) REFERENCES customer)");
-
-    /* continue progress. */
-    progress.setValue(++step);
-    qApp->processEvents();
+    /* create DB Schema (one progress step per statement). */
+    foreach (const QString statement, statements) {
+        query.exec(statement);
 
-    query.exec("CREATE TABLE report ("
-               "  id INTEGER PRIMARY KEY AUTOINCREMENT, "
-               "  vehicle TEXT NOT NULL, "
-               "  start_date TEXT NOT NULL,"
-               "  end_date TEXT NOT NULL,"
-               "  start_time TEXT NOT NULL,"
-               "  end_time TEXT NOT NULL,"
-               "  charge REAL NOT NULL,"
-               "  customer TEXT NOT NULL)");
-
-    /* continue progress. */
-    progress.setValue(++step);
-    qApp->processEvents();
+        /* continue progress. */
+        progress.setValue(++step);
+        qApp->processEvents();
+    }
 
     /* splashscreen message. */
     splash->showMessage(splashFillDBStr, topCenter);
     qApp->processEvents();
     QTest::qWait(SPLASH_TEXT_DELAY);
 
-    /* fill the card types. */
-    query.exec("INSERT INTO cardtype (title) VALUES ('No Card Customer')");
-    query.exec("INSERT INTO cardtype (title) VALUES ('Simple Member Card')");
-    query.exec("INSERT INTO cardtype (title) VALUES ('Month Member Card')");
-    query.exec("INSERT INTO cardtype (title) VALUES ('Year Member Card')");
-    query.exec("INSERT INTO cardtype (title) VALUES ('Credit Card Member')");
-
-    /* continue progress. */
-    progress.setValue(++step);
-    qApp->processEvents();
-
-    /* insert the guest customer. */
-    query.exec("INSERT INTO customer (name, card_id) VALUES ('Simple Guest', 1)");
+    /* fill the card types and insert the guest customer. */
+    foreach (const QString statement, dbDefaultDataStatements()) {
+        query.exec(statement);
+    }
 
     /* finish the progress. */
     progress.setValue(progress.maximum());
@@ -243,6 +189,30 @@ main(int argc, char *argv[]) {
         createDBInstance();
     }
 
+    /* bring the schema of the DB to the current version. */
+    if (!upgradeDBSchema(QSqlDatabase::database())) {
+        QMessageBox::critical(0, dbConnectErrorStr, dbCannotUpgradeStr);
+        return EXIT_FAILURE;
+    }
+
+    /* the connections of the background work (created by this thread). */
+    connectionPool();
+
+    /* forward the card payments stored offline (also by a previous run). */
+    paymentOutbox();
+
+    /* print the receipts left in the spool by a previous run. */
+    receiptSpooler();
+
+    /* keep the standby copy of the DB (backups and shipped journal). */
+    standbyReplica();
+
+    /* finish deleting the customers tombstoned by a previous run. */
+    customerPurge();
+
+    /* export the metrics of the hot paths (file and local socket). */
+    metricsExporter();
+
     /* splashscreen message. */
     splash->showMessage(splashAppStartStr, topCenter);
     qApp->processEvents();
@@ -28,14 +28,49 @@
 #include "transactionform.h"
 #include "reportform.h"
 #include "settingsform.h"
+#include "paystationform.h"
+#include "diagnosticsform.h"
 #include "mainform.h"
 #include "appsettings.h"
-#include "arithmetictools.h"
+#include "databasetools.h"
+#include "dbwriter.h"
+#include "cardexpiryscanner.h"
+#include "tariffengine.h"
+#include "settingsservice.h"
+#include "querytracer.h"
+#include "customerpurge.h"
+#include "bankingtools.h"
+#include "paymentoutbox.h"
 
 /* creates the application's main gui form. */
 MainForm::MainForm() {
-    /* try to establish app's settings. */
-    establishSettings();
+    /* the DB writer starts with the current settings. */
+    writer = 0;
+
+    /* no customers are deleted yet. */
+    purgeProgress = 0;
+
+    /* the settings of the application (the defaults for the invalid ones). */
+    SettingsService *service = settingsService();
+
+    if (!service->reload()) {
+        /* show a message. */
+        QMessageBox::warning(this, infoMsgTitleStr, cantWriteSetsStr);
+    }
+
+    applySettings(QStringList());
+
+    /* create the DB writer of the transactions (it stops with the form). */
+    writer = new DBWriter(service->settings(), dbFileNameStr, defWriterPrefixStr, this);
+    writer->setCommitWindow(service->commitWindow());
+    writer->start();
+
+    /* the customers deleted are purged by the writer. */
+    customerPurge()->setWriter(writer);
+
+    /* apply the changes of the settings without a restart. */
+    connect(service, SIGNAL(changed(const QStringList &)), this, SLOT(applySettings(const QStringList &)));
+    connect(service, SIGNAL(writeFailed()), this, SLOT(warnSettings()));
 
     /* create the panels for the customers and vehicles. */
     createCustomerPanel();
@@ -52,9 +87,12 @@ MainForm::MainForm() {
     editButtonCustomer = new QPushButton(customersButtonStr);
     editButtonTransaction = new QPushButton(transactsButtonStr);
     buttonReportTransaction = new QPushButton(reportButtonStr);
+    buttonPayStation = new QPushButton(payStationStr);
     buttonGuestVehicles = new QPushButton(guestVehiclesStr);
     quitButton = new QPushButton(quitButtonStr);
     settingsButton = new QPushButton(settingsButtonStr);
+    diagnosticsButton = new QPushButton(diagnosticsStr);
+    purgeButton = new QPushButton(purgeButtonStr);
 
     /* create the about toolbutton. */
     aboutButton = new QToolButton;
@@ -64,8 +102,10 @@ MainForm::MainForm() {
     buttonBox = new QDialogButtonBox;
     buttonBox->addButton(buttonGuestVehicles, QDialogButtonBox::ActionRole);
     buttonBox->addButton(buttonReportTransaction, QDialogButtonBox::ActionRole);
+    buttonBox->addButton(buttonPayStation, QDialogButtonBox::ActionRole);
     buttonBox->addButton(editButtonVehicle, QDialogButtonBox::ActionRole);
     buttonBox->addButton(editButtonCustomer, QDialogButtonBox::ActionRole);
+    buttonBox->addButton(purgeButton, QDialogButtonBox::ActionRole);
     buttonBox->addButton(editButtonTransaction, QDialogButtonBox::ActionRole);
 
     /* set the following button as checkable (as toogle button). */
@@ -75,11 +115,27 @@ MainForm::MainForm() {
     connect(customerView, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(editCustomers()));
     connect(vehicleView, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(editVehicles()));
     connect(buttonReportTransaction, SIGNAL(clicked()), this, SLOT(reportTransactions()));
+    connect(buttonPayStation, SIGNAL(clicked()), this, SLOT(showPayStation()));
     connect(editButtonTransaction, SIGNAL(clicked()), this, SLOT(editTransactions()));
     connect(editButtonCustomer, SIGNAL(clicked()), this, SLOT(editCustomers()));
     connect(editButtonVehicle, SIGNAL(clicked()), this, SLOT(editVehicles()));
     connect(buttonGuestVehicles, SIGNAL(toggled(const bool)), this, SLOT(handleGuestVehicles(const bool)));
     connect(settingsButton, SIGNAL(clicked()), this, SLOT(editSettings()));
+    connect(diagnosticsButton, SIGNAL(clicked()), this, SLOT(showDiagnostics()));
+    connect(purgeButton, SIGNAL(clicked()), this, SLOT(purgeCustomers()));
+
+    /* the customers deleted leave the view at once, the purge goes on behind. */
+    CustomerPurge *purge = customerPurge();
+
+    connect(purge, SIGNAL(tombstoned(const QList<int> &)), this, SLOT(hideCustomers()));
+    connect(purge, SIGNAL(progress(const int, const int)), this, SLOT(showPurgeProgress(const int, const int)), Qt::QueuedConnection);
+    connect(purge, SIGNAL(failed(const QString &)), this, SLOT(showPurgeFailure(const QString &)), Qt::QueuedConnection);
+    connect(purge, SIGNAL(purged(const int)), this, SLOT(finishPurge()), Qt::QueuedConnection);
+
+    /* the payments the outbox forwarded after the vehicle left may be declined. */
+    connect(paymentOutbox(), SIGNAL(declined(const QString &, const QString &, const double, const QDateTime &)),
+            this, SLOT(warnDeclinedPayment(const QString &, const QString &, const double, const QDateTime &)), Qt::QueuedConnection);
+
     connect(quitButton, SIGNAL(clicked()), this, SLOT(close()));
     connect(aboutButton, SIGNAL(clicked()), this, SLOT(handleAbout()));
 
@@ -93,6 +149,7 @@ MainForm::MainForm() {
     /* set the settings button and the button box to the horizontal layout. */
     mainHLayout->addWidget(aboutButton);
     mainHLayout->addWidget(settingsButton);
+    mainHLayout->addWidget(diagnosticsButton);
     mainHLayout->addStretch();
     mainHLayout->addWidget(buttonBox, 0, Qt::AlignHCenter);
     mainHLayout->addStretch();
@@ -114,6 +171,12 @@ MainForm::MainForm() {
     resize(QApplication::desktop()->size());
     showMaximized();
 
+    /* flag the expired and expiring cards in the background (it stops with the form). */
+    cardScanner = new CardExpiryScanner(dbFileNameStr, this);
+    connect(cardScanner, SIGNAL(scanned(const int, const QStringList &)),
+            this, SLOT(flagExpiringCards(const int, const QStringList &)), Qt::QueuedConnection);
+    cardScanner->start(QThread::LowPriority);
+
     /* show/hide the header of the vehicles view according of the records count. */
     vehicleView->horizontalHeader()->setVisible(vehicleModel->rowCount() > 0);
 
@@ -125,6 +188,11 @@ MainForm::MainForm() {
       customerView->setCurrentIndex(customerModel->index(0, 0));
 }
 
+/* the purge finishes its batch before the writer stops with the form. */
+MainForm::~MainForm() {
+    customerPurge()->setWriter(0);
+}
+
 /* updates the view with the vehicles data. */
 void
 MainForm::updateVehicleView() {
@@ -180,14 +248,11 @@ MainForm::updateCustomerView() {
 /* opens a form to manager application's settings. */
 void
 MainForm::editSettings() {
-    /* declare the form which manages settings. */
-    SettingsForm form(sets, this);
+    /* declare the form which manages settings (it applies what it saves). */
+    SettingsForm form(settingsService()->settings(), this);
 
     /* execute the form. */
     form.exec();
-
-    /* try to establish again any changes. */
-    establishSettings();
 }
 
 /* opens a form to manage vehicles. */
@@ -209,7 +274,7 @@ MainForm::editVehicles() {
     }
 
     /* declare the form which manages vehicles. */
-    VehicleForm form(sets.parkingCapacity, vehicleId, this);
+    VehicleForm form(writer, vehicleId, this);
 
     /* execute the form. */
     form.exec();
@@ -237,7 +302,7 @@ MainForm::editCustomers() {
     }
 
     /* declare the form which manages customers. */
-    CustomerForm form(customerId, this);
+    CustomerForm form(writer, customerId, this);
 
     /* execute the form. */
     form.exec();
@@ -246,11 +311,83 @@ MainForm::editCustomers() {
     updateCustomerView();
 }
 
+/* deletes the customers selected in the view (their vehicles and
+   transactions go to the guest customer). */
+void
+MainForm::purgeCustomers() {
+    QList<int> ids;
+
+    foreach (const QModelIndex &index, customerView->selectionModel()->selectedRows())
+        ids << customerModel->record(index.row()).value(CustomerForm::Customer_Id).toInt();
+
+    if (ids.isEmpty()) return;
+
+    /* ask him/her if he/she wants to delete the customers. */
+    int r = QMessageBox::question(this, infoMsgTitleStr, purgeCustomersStr.arg(ids.size()), QMessageBox::Yes | QMessageBox::No);
+
+    /* if he/she don't want it just return and do nothing. */
+    if (r == QMessageBox::No) return;
+
+    /* the customers are tombstoned now (and hidden), deleted behind. */
+    if (!customerPurge()->purge(ids)) {
+        QMessageBox::warning(this, infoMsgTitleStr, purgeFailedStr);
+        return;
+    }
+}
+
+/* hide the customers being deleted (the model filters the tombstones). */
+void
+MainForm::hideCustomers() {
+    updateCustomerView();
+
+    /* the selection is gone with the select, so are the vehicles shown. */
+    updateVehicleView();
+}
+
+/* show the progress of the purge (it goes on while the form is used). */
+void
+MainForm::showPurgeProgress(const int purged, const int total) {
+    if (!purgeProgress) {
+        purgeProgress = new QProgressDialog(this);
+        purgeProgress->setWindowTitle(appName);
+        purgeProgress->setCancelButtonText(QString()); /* hide cancel button. */
+        purgeProgress->setMinimumDuration(0);
+    }
+
+    purgeProgress->setLabelText(purgeProgressStr);
+    purgeProgress->setMaximum(total);
+    purgeProgress->setValue(purged);
+}
+
+/* show why the purge waits to try again. */
+void
+MainForm::showPurgeFailure(const QString &error) {
+    if (purgeProgress && purgeProgress->isVisible())
+        purgeProgress->setLabelText(purgeRetryStr.arg(error));
+}
+
+/* every customer is purged. */
+void
+MainForm::finishPurge() {
+    if (purgeProgress) purgeProgress->reset();
+}
+
+/* a payment of the outbox is declined (the diagnostics count them all). */
+void
+MainForm::warnDeclinedPayment(const QString &key, const QString &card, const double amount, const QDateTime &accepted) {
+    Q_UNUSED(key);
+
+    /* show a message. */
+    QMessageBox::warning(this, infoMsgTitleStr,
+                         paymentDeclinedStr.arg(amount, 0, 'f', 2).arg(card)
+                                           .arg(accepted.toString(Qt::SystemLocaleShortDate)));
+}
+
 /* opens a form to manage transactions. */
 void
 MainForm::editTransactions() {
     /* declare the form which manages transactions. */
-    TransactionForm form(sets, this);
+    TransactionForm form(settingsService()->settings(), writer, this);
 
     /* execute the form. */
     form.exec();
@@ -266,6 +403,40 @@ MainForm::reportTransactions() {
     form.exec();
 }
 
+/* opens the pay station (the live quote of a vehicle). */
+void
+MainForm::showPayStation() {
+    /* declare the pay station form. */
+    PayStationForm form(settingsService()->settings(), this);
+
+    /* execute the form. */
+    form.exec();
+}
+
+/* opens the diagnostics (latencies of the hot paths). */
+void
+MainForm::showDiagnostics() {
+    /* declare the diagnostics form. */
+    DiagnosticsForm form(this);
+
+    /* execute the form. */
+    form.exec();
+}
+
+/* show the expired and expiring cards next to the customers. */
+void
+MainForm::flagExpiringCards(const int expired, const QStringList &expiring) {
+    QStringList flags;
+
+    if (expired) flags << cardsExpiredStr.arg(expired);
+    if (!expiring.isEmpty()) flags << cardsExpiringStr.arg(expiring.size());
+
+    customerLabel->setText(flags.isEmpty() ? customersStr : customersStr + " (" + flags.join(", ") + ")");
+
+    /* the names of the customers to call. */
+    customerLabel->setToolTip(expiring.join("\n"));
+}
+
 /* opens an about dialog. */
 void
 MainForm::handleAbout() {
@@ -300,59 +471,34 @@ MainForm::handleGuestVehicles(const bool buttonPressed) {
     }
 }
 
-/* establish the settings of the program.
-   also check, create them if not exist. */
-void MainForm::establishSettings() {
-    QSettings s(setsAppOrg, setsAppName);
-
-    s.beginGroup("parking");
-    if (s.value("capacity").isNull()
-        || s.value("capacity").toInt() < MIN_PARKING_CAPACITY
-        || s.value("capacity").toInt() > MAX_PARKING_CAPACITY) {
-        s.setValue("capacity", DEF_PARKING_CAPACITY);
-    } else {
-        sets.parkingCapacity = s.value("capacity").toInt();
-    }
-    s.endGroup();
-
-    s.beginGroup("payment");
-    if (s.value("timeslice").isNull()
-        || s.value("timeslice").toInt() < MIN_TIMESLICE
-        || s.value("timeslice").toInt() > MAX_TIMESLICE) {
-        s.setValue("timeslice", DEF_TIMESLICE);
-    } else {
-        sets.timeslice = s.value("timeslice").toInt();
-    }
-
-    if (s.value("charge_per_timeslice").isNull()
-        || isLessThan(s.value("charge_per_timeslice").toDouble(), MIN_CHARGE_PER_TIMESLICE)
-        || isGreaterThan(s.value("charge_per_timeslice").toDouble(), MAX_CHARGE_PER_TIMESLICE)) {
-        s.setValue("charge_per_timeslice", DEF_CHARGE_PER_TIMESLICE);
-    } else {
-        sets.chargePerTimeslice = s.value("charge_per_timeslice").toDouble();
+/* apply the settings which changed (all of them for none). */
+void
+MainForm::applySettings(const QStringList &keys) {
+    const settingsSnapshot snapshot = settingsService()->snapshot();
+
+    /* check a new tariff (a broken one falls back to the linear charge). */
+    if (keys.isEmpty() || keys.contains(tariffFileKeyStr)) {
+        QString tariffError;
+        loadTariff(snapshot.sets, &tariffError);
+
+        if (!tariffError.isEmpty()) {
+            /* show a message. */
+            QMessageBox::warning(this, infoMsgTitleStr, tariffErrorStr + tariffError);
+        }
     }
 
-    if (s.value("charge_precision").isNull()
-        || s.value("charge_precision").toInt() < MIN_CHARGE_PRECISION
-        || s.value("charge_precision").toInt() > MAX_CHARGE_PRECISION) {
-        s.setValue("charge_precision", DEF_CHARGE_PRECISION);
-    } else {
-        sets.chargePrecision = s.value("charge_precision").toInt();
+    /* the DB writer works with the new settings. */
+    if (writer) {
+        writer->setSettings(snapshot.sets);
+        writer->setCommitWindow(snapshot.commitWindow);
     }
+}
 
-    s.endGroup();
-
-    /* try to write down the settings. */
-    s.sync();
-
-    /* if the app cannot write the settings. */
-    if (s.status() != QSettings::NoError) {
-        /* show a message. */
-        QMessageBox::critical(this, infoMsgTitleStr, cantWriteSetsStr);
-
-        /* terminate the program. */
-        exit(EXIT_FAILURE);
-    }
+/* the settings cannot be written (the defaults are used meanwhile). */
+void
+MainForm::warnSettings() {
+    /* show a message. */
+    QMessageBox::warning(this, infoMsgTitleStr, cantWriteSetsStr);
 }
 
 /* creates the panel for the customers. */
@@ -362,13 +508,13 @@ MainForm::createCustomerPanel() {
     customerPanel = new QWidget;
 
     /* create the model for the customers. */
-    customerModel = new QSqlRelationalTableModel(this);
+    customerModel = new TracedRelationalTableModel(this);
 
     /* set the table to select. */
     customerModel->setTable("customer");
 
-    /* get only the real customers. */
-    customerModel->setFilter("customer.id != 1");
+    /* get only the real customers (not the ones being deleted). */
+    customerModel->setFilter("customer.id != 1 AND customer.tombstone IS NULL");
 
     /* set a relation for the card type of the customer. */
     customerModel->setRelation(CustomerForm::Customer_CardId, QSqlRelation("cardtype", "id", "title"));
@@ -392,7 +538,7 @@ MainForm::createCustomerPanel() {
 
     /* set some operative options in the table view. */
     customerView->setItemDelegate(new QSqlRelationalDelegate(this));
-    customerView->setSelectionMode(QAbstractItemView::SingleSelection);
+    customerView->setSelectionMode(QAbstractItemView::ExtendedSelection);
     customerView->setSelectionBehavior(QAbstractItemView::SelectRows);
     customerView->setEditTriggers(QAbstractItemView::NoEditTriggers);
 
@@ -404,6 +550,8 @@ MainForm::createCustomerPanel() {
     customerView->setColumnHidden(CustomerForm::Customer_Email, true);
     customerView->setColumnHidden(CustomerForm::Customer_CardDate, true);
     customerView->setColumnHidden(CustomerForm::Customer_CardMoney, true);
+    customerView->setColumnHidden(CustomerForm::Customer_CardExpiry, true);
+    customerView->setColumnHidden(CustomerForm::Customer_Tombstone, true);
 
     /* perform some operations with columns' width. */
     customerView->resizeColumnsToContents();
@@ -436,7 +584,7 @@ MainForm::createVehiclePanel() {
     vehiclePanel = new QWidget;
 
     /* create the model for the vehicles. */
-    vehicleModel = new QSqlRelationalTableModel(this);
+    vehicleModel = new TracedRelationalTableModel(this);
 
     /* set the table to select. */
     vehicleModel->setTable("vehicle");
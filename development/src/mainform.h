@@ -4,6 +4,7 @@
 
 /* include some QT libraries. */
 #include <QWidget>
+#include <QList>
 
 /* include header defining the interface of the source. */
 #include "appsettings.h"
@@ -11,31 +12,52 @@
 /* use these classes. */
 class QSqlRelationalTableModel;
 class QDialogButtonBox;
+class QProgressDialog;
 class QModelIndex;
+class QDateTime;
 class QPushButton;
 class QToolButton;
 class QTableView;
 class QSplitter;
 class QLabel;
+class DBWriter;
+class CardExpiryScanner;
 
 /* GUI string messages. */
 static const QString vehiclesButtonStr  = QObject::tr("Manage &Vehicles");
 static const QString customersButtonStr = QObject::tr("Manage &Customers");
 static const QString transactsButtonStr = QObject::tr("Manage &Transactions");
 static const QString reportButtonStr    = QObject::tr("Transactions &Report");
+static const QString payStationStr      = QObject::tr("&Pay Station");
 static const QString guestVehiclesStr   = QObject::tr("&Show Guest Vehicles");
 static const QString quitButtonStr      = QObject::tr("&Quit");
 static const QString settingsButtonStr  = QObject::tr("&Settings");
+static const QString diagnosticsStr     = QObject::tr("&Diagnostics");
+static const QString purgeButtonStr     = QObject::tr("&Delete Customers");
 
 static const QString vehiclesOfStr      = QObject::tr("Ve&hicles of %1");
 static const QString vehiclesStr        = QObject::tr("Ve&hicles");
 static const QString customersStr       = QObject::tr("&Customers");
+static const QString cardsExpiredStr    = QObject::tr("%1 expired card(s)");
+static const QString cardsExpiringStr   = QObject::tr("%1 card(s) expiring soon");
 
 static const QString nameStr            = QObject::tr("Name");
 static const QString cardStr            = QObject::tr("Card Type");
 static const QString phoneStr           = QObject::tr("Phone");
 static const QString descStr            = QObject::tr("Description");
 
+static const QString tariffErrorStr     = QObject::tr("The linear charge is used because of the tariff: ");
+
+static const QString purgeCustomersStr  = QObject::tr("Do you want to delete the %1 selected customer(s)?\n"
+                                                      "Their vehicles and transactions go to the guest customer.");
+static const QString purgeFailedStr     = QObject::tr("The customers could not be deleted. Try again.");
+static const QString purgeProgressStr   = QObject::tr("Deleting the customers...");
+static const QString purgeRetryStr      = QObject::tr("Deleting the customers (retrying: %1)...");
+
+static const QString paymentDeclinedStr = QObject::tr("A card payment stored offline was declined by the bank:\n"
+                                                      "%1 from the card ending in %2, accepted at %3.\n"
+                                                      "The vehicle has already left, the money must be collected otherwise.");
+
 /* class which implements the main gui form. */
 class MainForm : public QWidget
 {
@@ -43,6 +65,7 @@ class MainForm : public QWidget
 
     public:
         MainForm();
+        ~MainForm();
 
     private slots:
         void updateVehicleView();
@@ -52,15 +75,26 @@ class MainForm : public QWidget
         void editTransactions();
         void editSettings();
         void reportTransactions();
+        void showPayStation();
+        void showDiagnostics();
         void handleAbout();
         void handleGuestVehicles(const bool buttonPressed);
+        void flagExpiringCards(const int expired, const QStringList &expiring);
+        void applySettings(const QStringList &keys);
+        void warnSettings();
+        void purgeCustomers();
+        void hideCustomers();
+        void showPurgeProgress(const int purged, const int total);
+        void showPurgeFailure(const QString &error);
+        void finishPurge();
+        void warnDeclinedPayment(const QString &key, const QString &card, const double amount, const QDateTime &accepted);
 
     private:
         void createCustomerPanel();
         void createVehiclePanel();
-        void establishSettings();
 
-        appSettings sets;
+        DBWriter *writer;
+        CardExpiryScanner *cardScanner;
 
         QSqlRelationalTableModel *customerModel;
         QSqlRelationalTableModel *vehicleModel;
@@ -80,12 +114,17 @@ class MainForm : public QWidget
         QPushButton *editButtonCustomer;
         QPushButton *editButtonTransaction;
         QPushButton *buttonReportTransaction;
+        QPushButton *buttonPayStation;
         QPushButton *buttonGuestVehicles;
         QPushButton *settingsButton;
+        QPushButton *diagnosticsButton;
+        QPushButton *purgeButton;
         QPushButton *quitButton;
         QToolButton *aboutButton;
 
         QDialogButtonBox *buttonBox;
+
+        QProgressDialog *purgeProgress;
 };
 
 #endif // MAINFORM_H
@@ -0,0 +1,176 @@
+/*
+ *  This file implements the export of the metrics of the application.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+#include <QtNetwork>
+
+/* include headers defining the interface of the sources. */
+#include "metricsexporter.h"
+#include "latencymetrics.h"
+#include "connectionpool.h"
+#include "standbyreplica.h"
+#include "appsettings.h"
+#include "filetools.h"
+
+/* the metrics of the application in the Prometheus text format. */
+QString
+metricsText() {
+    const connectionPoolStatistics pool = connectionPool()->statistics();
+    const standbyStatistics standby = standbyReplica()->statistics();
+
+    QString text;
+    QTextStream out(&text);
+
+    out << "# HELP parkman_pool_connections Open connections of the worker threads.\n";
+    out << "# TYPE parkman_pool_connections gauge\n";
+    out << "parkman_pool_connections " << pool.connections << "\n";
+    out << "# HELP parkman_pool_checked_out Connections checked out right now.\n";
+    out << "# TYPE parkman_pool_checked_out gauge\n";
+    out << "parkman_pool_checked_out " << pool.checkedOut << "\n";
+    out << "# HELP parkman_pool_checkouts_total Checkouts of the connections.\n";
+    out << "# TYPE parkman_pool_checkouts_total counter\n";
+    out << "parkman_pool_checkouts_total " << pool.checkouts << "\n";
+    out << "# HELP parkman_pool_waits_total Checkouts which found the pool full.\n";
+    out << "# TYPE parkman_pool_waits_total counter\n";
+    out << "parkman_pool_waits_total " << pool.waits << "\n";
+    out << "# HELP parkman_pool_timeouts_total Checkouts which gave up waiting.\n";
+    out << "# TYPE parkman_pool_timeouts_total counter\n";
+    out << "parkman_pool_timeouts_total " << pool.timeouts << "\n";
+    out << "# HELP parkman_standby_backups_total Complete backups to the standby copy.\n";
+    out << "# TYPE parkman_standby_backups_total counter\n";
+    out << "parkman_standby_backups_total " << standby.backups << "\n";
+    out << "# HELP parkman_standby_backup_failures_total Backups to the standby copy which failed.\n";
+    out << "# TYPE parkman_standby_backup_failures_total counter\n";
+    out << "parkman_standby_backup_failures_total " << standby.failedBackups << "\n";
+    out << "# HELP parkman_standby_backup_age_seconds Since the last complete backup.\n";
+    out << "# TYPE parkman_standby_backup_age_seconds gauge\n";
+    out << "parkman_standby_backup_age_seconds "
+        << (standby.lastBackup.isValid() ? standby.lastBackup.secsTo(QDateTime::currentDateTime()) : -1) << "\n";
+    out << "# HELP parkman_standby_lag_events Events committed, not shipped to the standby copy.\n";
+    out << "# TYPE parkman_standby_lag_events gauge\n";
+    out << "parkman_standby_lag_events " << standby.lagEvents << "\n";
+    out << "# HELP parkman_standby_lag_seconds Since the standby copy was last up to date.\n";
+    out << "# TYPE parkman_standby_lag_seconds gauge\n";
+    out << "parkman_standby_lag_seconds " << standby.lagMsecs / 1000.0 << "\n";
+
+    out.flush();
+
+    return latencyPrometheusText() + text;
+}
+
+/* check if another application serves on a local socket (it answers a
+   connection in time). */
+static bool
+isServing(const QString &socketName) {
+    QLocalSocket socket;
+    socket.connectToServer(socketName);
+
+    const bool serving = socket.waitForConnected(METRICS_PROBE_WAIT);
+    socket.abort();
+
+    return serving;
+}
+
+/* create the exporter and start dumping/serving (an empty file or socket
+   name for none). */
+MetricsExporter::MetricsExporter(const QString &fileName, const QString &socketName,
+                                 const int interval, QObject *parent) : QObject(parent) {
+    this->fileName = fileName;
+
+    if (!fileName.isEmpty()) {
+        connect(&dumpTimer, SIGNAL(timeout()), this, SLOT(dump()));
+        dumpTimer.start(qMax(interval, MIN_METRICS_INTERVAL));
+    }
+
+    if (!socketName.isEmpty()) {
+        connect(&server, SIGNAL(newConnection()), this, SLOT(serve()));
+
+        /* a running application keeps its socket, only a socket left by
+           one that crashed (nobody answers on it) is removed. */
+        if (!isServing(socketName)) {
+            QLocalServer::removeServer(socketName);
+            server.listen(socketName);
+        }
+    }
+}
+
+/* dump the metrics in the file (through a temporary one). */
+bool
+MetricsExporter::dump() {
+    const QString temporaryName = fileName + ".tmp";
+    QFile file(temporaryName);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) return false;
+
+    const QByteArray data = metricsText().toUtf8();
+
+    if (file.write(data) != data.size()) {
+        file.remove();
+        return false;
+    }
+
+    file.close();
+
+    /* the readers find either the last dump or this one, never none. */
+    if (!replaceFile(temporaryName, fileName)) {
+        QFile::remove(temporaryName);
+        return false;
+    }
+
+    return true;
+}
+
+/* send the metrics to the new clients of the socket. */
+void
+MetricsExporter::serve() {
+    while (server.hasPendingConnections()) {
+        QLocalSocket *socket = server.nextPendingConnection();
+
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+
+        socket->write(metricsText().toUtf8());
+
+        /* closed when everything is sent. */
+        socket->disconnectFromServer();
+    }
+}
+
+/* the metrics exporter of the application (created from the settings once). */
+MetricsExporter *
+metricsExporter() {
+    static MetricsExporter *exporter = 0;
+
+    if (!exporter) {
+        QSettings s(setsAppOrg, setsAppName);
+
+        /* "none" turns off the file or the socket. */
+        QString fileName = s.value("metrics/file", defMetricsFileStr).toString();
+        QString socketName = s.value("metrics/socket", defMetricsSocketStr).toString();
+        const int interval = s.value("metrics/interval", DEF_METRICS_INTERVAL).toInt();
+
+        if (fileName == "none") fileName.clear();
+        if (socketName == "none") socketName.clear();
+
+        /* it lives as long as the application. */
+        exporter = new MetricsExporter(fileName, socketName, interval, QCoreApplication::instance());
+    }
+
+    return exporter;
+}
@@ -0,0 +1,54 @@
+/* header defining the interface of the source. */
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+/* include some QT libraries. */
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QLocalServer>
+
+/* the default file and local socket of the metrics (none for none). */
+static const QString defMetricsFileStr = "metrics.prom";
+static const QString defMetricsSocketStr = "parkman-metrics";
+
+/* the default, minimum msecs between the dumps of the metrics file. */
+static const int DEF_METRICS_INTERVAL = 15000;
+static const int MIN_METRICS_INTERVAL = 1000;
+
+/* msecs a running application has to answer on the socket at start. */
+static const int METRICS_PROBE_WAIT = 500;
+
+/* the metrics of the application in the Prometheus text format (the
+   latencies of the hot paths, the connection pool and the standby copy). */
+QString metricsText();
+
+/* class which implements the export of the metrics. it dumps them in a
+   file every interval (replaced at once, a scraper never reads half of
+   it) and sends them to every client of a local socket, which is closed
+   after them (as a scrape). */
+class MetricsExporter : public QObject
+{
+    Q_OBJECT
+
+    public:
+        MetricsExporter(const QString &fileName, const QString &socketName,
+                        const int interval = DEF_METRICS_INTERVAL, QObject *parent = 0);
+
+    public slots:
+        bool dump();
+
+    private slots:
+        void serve();
+
+    private:
+        QString fileName;
+
+        QTimer dumpTimer;
+        QLocalServer server;
+};
+
+/* the metrics exporter of the application (created from the settings once). */
+MetricsExporter *metricsExporter();
+
+#endif // METRICSEXPORTER_H
@@ -0,0 +1,96 @@
+/* header defining the interface of the source. */
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+/* include some QT libraries. */
+#include <QAtomicPointer>
+#include <QThread>
+
+/* class which implements a lock-free multiple producers, single consumer
+   queue (linked nodes with a stub, producers swap the head atomically).
+   push() is safe from any thread, pop() only from the consumer thread. */
+template <typename T>
+class MpscQueue
+{
+    public:
+        MpscQueue();
+        ~MpscQueue();
+
+        void push(const T &value);
+        bool pop(T &value);
+
+    private:
+        /* node of the queue data type. */
+        struct Node {
+            QAtomicPointer<Node> next;
+            T value;
+        };
+
+        QAtomicPointer<Node> head; /* the last pushed node (producers). */
+        Node *tail;                /* the stub before the next node to pop (consumer). */
+
+        Q_DISABLE_COPY(MpscQueue)
+};
+
+/* create an empty queue (only the stub node). */
+template <typename T>
+MpscQueue<T>::MpscQueue() {
+    Node *stub = new Node;
+    stub->next = 0;
+
+    head = stub;
+    tail = stub;
+}
+
+/* delete the queue and any values left in it. */
+template <typename T>
+MpscQueue<T>::~MpscQueue() {
+    while (tail) {
+        Node *next = tail->next;
+        delete tail;
+        tail = next;
+    }
+}
+
+/* push a value (any thread, never blocks). */
+template <typename T>
+void
+MpscQueue<T>::push(const T &value) {
+    Node *node = new Node;
+    node->next = 0;
+    node->value = value;
+
+    /* become the new head, then link the previous head to us. between
+       the two steps the consumer waits for the link (see pop()). */
+    Node *previous = head.fetchAndStoreOrdered(node);
+    previous->next.fetchAndStoreRelease(node);
+}
+
+/* pop the oldest value (consumer thread only, false if empty). a value
+   pushed is never missed: if a producer has swapped the head but not
+   linked its node yet, the consumer yields until it does (the producer
+   is one step from it). */
+template <typename T>
+bool
+MpscQueue<T>::pop(T &value) {
+    Node *next = tail->next.fetchAndAddAcquire(0);
+
+    if (!next) {
+        /* nothing pushed after the stub. */
+        if (head.fetchAndAddAcquire(0) == tail) return false;
+
+        while (!(next = tail->next.fetchAndAddAcquire(0)))
+            QThread::yieldCurrentThread();
+    }
+
+    /* the popped node becomes the new stub. */
+    value = next->value;
+    next->value = T();
+
+    delete tail;
+    tail = next;
+
+    return true;
+}
+
+#endif // MPSCQUEUE_H
@@ -0,0 +1,952 @@
+/*
+ *  This file implements the headless gate operations (vehicle entry/exit).
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtSql>
+
+/* include headers defining the interface of the sources. */
+#include "parkingengine.h"
+#include "globaldeclarations.h"
+#include "arithmetictools.h"
+#include "chargingtools.h"
+#include "balanceledger.h"
+#include "zonemap.h"
+#include "customerpurge.h"
+
+/* the reasons of the ledger entries. */
+static const QString exitReasonStr    = "exit";
+static const QString paymentReasonStr = "payment";
+static const QString cardReasonStr    = "card";
+
+/* create the engine which works on the given connection. */
+ParkingEngine::ParkingEngine(const appSettings &sets, QSqlDatabase db) {
+    /* store the application's settings and the connection. */
+    this->sets = sets;
+    this->db = db;
+
+    /* compile the tariff of the settings once. */
+    tariff = loadTariff(sets);
+
+    /* every operation is a transaction of its own. */
+    batched = false;
+
+    /* the credit cards are charged on the DB. */
+    ledger = 0;
+
+    /* the capacity of the settings (no zones). */
+    zones = 0;
+}
+
+/* create the engine with a tariff compiled already (no file is read, for
+   the short-lived engines of a work item). */
+ParkingEngine::ParkingEngine(const appSettings &sets, const TariffEngine &tariff, QSqlDatabase db) {
+    this->sets = sets;
+    this->tariff = tariff;
+    this->db = db;
+
+    batched = false;
+    ledger = 0;
+    zones = 0;
+}
+
+/* run the operations inside the caller's transaction (as savepoints). */
+void
+ParkingEngine::setBatchMode(const bool batched) {
+    this->batched = batched;
+}
+
+/* change the settings of the next operations. */
+void
+ParkingEngine::setSettings(const appSettings &sets) {
+    this->sets = sets;
+    tariff = loadTariff(sets);
+}
+
+/* debit the credit cards from the in-memory balances (0 for the DB only). */
+void
+ParkingEngine::setLedger(BalanceLedger *ledger) {
+    this->ledger = ledger;
+}
+
+/* allocate the zones of the vehicles entering (0 for the capacity of the settings). */
+void
+ParkingEngine::setZones(ZoneMap *zones) {
+    this->zones = zones;
+}
+
+/* get the id of a vehicle from its registration number (-1 if not found). */
+int
+ParkingEngine::vehicleId(const QString &plate) {
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    /* prepare a sql query with place holders. */
+    query.prepare("SELECT id FROM vehicle WHERE reg_num = :plate LIMIT 1");
+
+    /* bind values to the query placeholders. */
+    query.bindValue(":plate", plate);
+
+    /* execute the query and try to get the first record. */
+    if (query.exec() && query.next())
+        return query.value(0).toInt();
+
+    return -1;
+}
+
+/* starts a vehicle transaction (the vehicle enters the parking). */
+ParkingEngine::gateResult
+ParkingEngine::enterVehicle(const int vehiId, const QDateTime &when) {
+    /* capacity check and insert must not interleave with other gates. */
+    if (!begin()) return Gate_DBError;
+
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    /* check if the vehicle is already in the parking. */
+    query.prepare("SELECT 1 FROM transacts WHERE vehi_id = :vehi_id");
+    query.bindValue(":vehi_id", vehiId);
+
+    if (!query.exec()) return finish(Gate_DBError);
+    if (query.next()) return finish(Gate_VehicleInParking);
+
+    /* find the id of the vehicle's customer with its card. */
+    query.prepare("SELECT vehi.cust_id, cust.card_id FROM vehicle AS vehi "
+                  "INNER JOIN customer AS cust ON cust.id = vehi.cust_id "
+                  "WHERE vehi.id = :vehi_id");
+    query.bindValue(":vehi_id", vehiId);
+
+    if (!query.exec()) return finish(Gate_DBError);
+    if (!query.next()) return finish(Gate_UnknownVehicle);
+
+    const int custId = query.value(0).toInt();
+    const int card_type = query.value(1).toInt() - 1; /* for fixing with indexes. */
+
+    /* a space in the zones of the card (freed if the operation is undone). */
+    QVariant zoneId(QVariant::Int);
+
+    if (zones && !zones->isEmpty()) {
+        const int zone = zones->allocate(card_type);
+        if (zone < 0) return finish(Gate_NoCapacity);
+
+        operationTaken << zone;
+        zoneId = zone;
+    }
+    else {
+        /* check if there is some vehicles capacity left. */
+        if (!query.exec("SELECT COUNT(*) FROM transacts") || !query.next())
+            return finish(Gate_DBError);
+
+        if (query.value(0).toInt() >= sets.parkingCapacity)
+            return finish(Gate_NoCapacity);
+    }
+
+    /* start a transaction. */
+    query.prepare("INSERT INTO transacts (vehi_id, cust_id, start_date, start_time, zone_id) VALUES (:vehi_id, :cust_id, :start_date, :start_time, :zone_id)");
+    query.bindValue(":vehi_id", vehiId);
+    query.bindValue(":cust_id", custId);
+    query.bindValue(":start_date", when.date());
+    query.bindValue(":start_time", when.time());
+    query.bindValue(":zone_id", zoneId);
+
+    if (!query.exec()) return finish(Gate_DBError);
+
+    return finish(Gate_Ok);
+}
+
+/* completes a vehicle transaction (the vehicle leaves the parking). members
+   with credit card pay from their card, the rest pay at the pay station.
+   a charge recorded already (the replay of an exit) is used instead of
+   the tariff, a negative one is priced. */
+ParkingEngine::gateResult
+ParkingEngine::exitVehicle(const int vehiId, const QDateTime &when, double *charge, const double recordedCharge) {
+    /* the payment, report and ticket removal happen all together or not at all. */
+    if (!begin()) return Gate_DBError;
+
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    /* find the ticket of the vehicle with its customer. */
+    query.prepare("SELECT tran.id, tran.start_date, tran.start_time, "
+                  "       cust.id, cust.name, cust.card_id, cust.card_expiry, cust.card_money, vehi.reg_num, "
+                  "       tran.zone_id, zone.name "
+                  "FROM transacts AS tran "
+                  "INNER JOIN customer AS cust ON cust.id = tran.cust_id "
+                  "INNER JOIN vehicle AS vehi ON vehi.id = tran.vehi_id "
+                  "LEFT JOIN zone ON zone.id = tran.zone_id "
+                  "WHERE tran.vehi_id = :vehi_id");
+    query.bindValue(":vehi_id", vehiId);
+
+    if (!query.exec()) return finish(Gate_DBError);
+    if (!query.next()) return finish(Gate_NoTicket);
+
+    /* get the ticket related data. */
+    const int tran_id = query.value(0).toInt();
+    const QDate start_date = query.value(1).toDate();
+    const QTime start_time = query.value(2).toTime();
+    const int cust_id = query.value(3).toInt();
+    const QString cust_name = query.value(4).toString();
+    const int card_type = query.value(5).toInt() - 1; /* for fixing with indexes. */
+    const qint64 card_expiry = query.value(6).toLongLong();
+    const bool hasCardMoney = !query.value(7).toString().isEmpty();
+    const double card_money = query.value(7).toDouble();
+    const QString vehi_name = query.value(8).toString();
+    const QVariant zone_id = query.value(9);
+    const QString zone_name = query.value(10).toString();
+
+    /* release the statement before writing. */
+    query.finish();
+
+    /* if card is expired stop the transaction. */
+    if (isCardExpired(card_expiry, when.date().toJulianDay()))
+        return finish(Gate_CardExpired);
+
+    /* calculate the charge of the transaction (unless it is recorded). */
+    const double value = recordedCharge >= 0 ? recordedCharge
+                                             : tariff.charge(QDateTime(start_date, start_time), when, card_type);
+
+    /* members with credit card pay from the money of their card. */
+    if (card_type == CreditCardType) {
+        if (ledger) {
+            const gateResult paid = debitCard(cust_id, value, when, exitReasonStr);
+            if (paid != Gate_Ok) return finish(paid);
+        }
+        else {
+            if (!hasCardMoney || isLessThan(card_money, value))
+                return finish(Gate_NotEnoughMoney);
+
+            query.prepare("UPDATE customer SET card_money = card_money - :charge WHERE customer.id = :cust_id");
+            query.bindValue(":charge", value);
+            query.bindValue(":cust_id", cust_id);
+
+            if (!query.exec()) return finish(Gate_DBError);
+        }
+    }
+
+    /* store the transaction in the report and remove it. */
+    if (!archiveTicket(tran_id, cust_id, cust_name, vehi_name, QDateTime(start_date, start_time), when, value, zone_name))
+        return finish(Gate_DBError);
+
+    /* the space of the vehicle is free when it commits. */
+    if (!zone_id.isNull()) operationFreed << zone_id.toInt();
+
+    /* return the charge of the transaction. */
+    if (charge) *charge = value;
+
+    return finish(Gate_Ok);
+}
+
+/* charge the card of a member (only if there is enough money). */
+ParkingEngine::gateResult
+ParkingEngine::chargeCard(const int custId, const double charge) {
+    if (!begin()) return Gate_DBError;
+
+    return finish(payFromCard(custId, charge, QDateTime::currentDateTime(), paymentReasonStr));
+}
+
+/* completes a ticket with the given charge, it is stored in the report
+   and removed. a ticket paid already (at the pay station) has no paying
+   customer (0, or -1 in the closes journaled before there was one), else
+   the charge is debited from the card of the customer in the same
+   transaction. */
+ParkingEngine::gateResult
+ParkingEngine::closeTicket(const int tranId, const QDateTime &when, const double charge, const int payingCustId) {
+    if (!begin()) return Gate_DBError;
+
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    /* find the ticket with the names of its customer and vehicle. */
+    query.prepare("SELECT tran.start_date, tran.start_time, cust.id, cust.name, vehi.reg_num, tran.zone_id, zone.name "
+                  "FROM transacts AS tran "
+                  "INNER JOIN customer AS cust ON cust.id = tran.cust_id "
+                  "INNER JOIN vehicle AS vehi ON vehi.id = tran.vehi_id "
+                  "LEFT JOIN zone ON zone.id = tran.zone_id "
+                  "WHERE tran.id = :tran_id");
+    query.bindValue(":tran_id", tranId);
+
+    if (!query.exec()) return finish(Gate_DBError);
+    if (!query.next()) return finish(Gate_NoTicket);
+
+    const QDateTime start(query.value(0).toDate(), query.value(1).toTime());
+    const int cust_id = query.value(2).toInt();
+    const QString cust_name = query.value(3).toString();
+    const QString vehi_name = query.value(4).toString();
+    const QVariant zone_id = query.value(5);
+    const QString zone_name = query.value(6).toString();
+
+    /* release the statement before writing. */
+    query.finish();
+
+    /* the payment, report and ticket removal happen all together or not at all. */
+    if (payingCustId > 0) {
+        const gateResult paid = payFromCard(payingCustId, charge, when, exitReasonStr);
+        if (paid != Gate_Ok) return finish(paid);
+    }
+
+    if (!archiveTicket(tranId, cust_id, cust_name, vehi_name, start, when, charge, zone_name))
+        return finish(Gate_DBError);
+
+    /* the space of the vehicle is free when it commits. */
+    if (!zone_id.isNull()) operationFreed << zone_id.toInt();
+
+    return finish(Gate_Ok);
+}
+
+/* remove a ticket without storing it in the report (a ticket by mistake). */
+ParkingEngine::gateResult
+ParkingEngine::cancelTicket(const int tranId) {
+    if (!begin()) return Gate_DBError;
+
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    /* find the zone of the ticket. */
+    query.prepare("SELECT zone_id FROM transacts WHERE id = :tran_id");
+    query.bindValue(":tran_id", tranId);
+
+    if (!query.exec()) return finish(Gate_DBError);
+    if (!query.next()) return finish(Gate_NoTicket);
+
+    const QVariant zone_id = query.value(0);
+
+    /* release the statement before writing. */
+    query.finish();
+
+    query.prepare("DELETE FROM transacts WHERE id = :tran_id");
+    query.bindValue(":tran_id", tranId);
+
+    if (!query.exec()) return finish(Gate_DBError);
+
+    /* the space of the vehicle is free when it commits. */
+    if (!zone_id.isNull()) operationFreed << zone_id.toInt();
+
+    return finish(Gate_Ok);
+}
+
+/* settle all the open tickets at once (e.g. the end of an event) as if
+   every vehicle left at the given time. the tickets are loaded in arrays
+   of tariff times and card types and charged in one pass, then stored in
+   the report and removed with prepared batches in one DB transaction.
+   the tickets of expired cards or of credit cards without enough money
+   are left open, as the gates would leave them. the tickets settled are
+   given with their charges if asked (to journal them as exits). */
+ParkingEngine::gateResult
+ParkingEngine::settleTickets(const QDateTime &when, settlementSummary *summary, QList<settledTicket> *settled) {
+    settlementSummary result;
+    result.tickets = result.settled = result.expired = result.notEnoughMoney = 0;
+    result.charged = 0;
+
+    if (!begin()) return Gate_DBError;
+
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    /* all the tickets with their customer and vehicle. */
+    if (!query.exec("SELECT tran.id, tran.start_date, tran.start_time, "
+                    "       cust.id, cust.name, cust.card_id, cust.card_expiry, cust.card_money, vehi.reg_num, "
+                    "       tran.zone_id, zone.name, tran.vehi_id "
+                    "FROM transacts AS tran "
+                    "INNER JOIN customer AS cust ON cust.id = tran.cust_id "
+                    "INNER JOIN vehicle AS vehi ON vehi.id = tran.vehi_id "
+                    "LEFT JOIN zone ON zone.id = tran.zone_id"))
+        return finish(Gate_DBError);
+
+    /* the tickets as arrays (one entry per ticket in every one). */
+    QVector<int> tranIds, vehiIds, custIds, cardTypes;
+    QVector<qint64> starts;
+    QVector<QVariant> startDates, startTimes, custNames, vehiNames, zoneIds, zoneNames;
+
+    /* the money of the credit cards (as it is spent by their tickets). */
+    QHash<int, double> cardMoney;
+
+    const qint64 today = when.date().toJulianDay();
+    const qint64 end = TariffEngine::tariffTime(when);
+
+    while (query.next()) {
+        result.tickets++;
+
+        const int card_type = query.value(5).toInt() - 1; /* for fixing with indexes. */
+
+        /* the expiry day of the card (if any) is stored with the customer. */
+        if (isCardExpired(query.value(6).toLongLong(), today)) {
+            result.expired++;
+            continue;
+        }
+
+        qint64 start;
+        const QVariant start_date = query.value(1);
+        const QVariant start_time = query.value(2);
+
+        if (!TariffEngine::parseTariffTime(start_date.toString(), start_time.toString(), start))
+            start = TariffEngine::tariffTime(QDateTime(start_date.toDate(), start_time.toTime()));
+
+        const int cust_id = query.value(3).toInt();
+
+        if (card_type == CreditCardType && !ledger && !cardMoney.contains(cust_id))
+            cardMoney.insert(cust_id, query.value(7).toString().isEmpty() ? -1 : query.value(7).toDouble());
+
+        tranIds << query.value(0).toInt();
+        vehiIds << query.value(11).toInt();
+        custIds << cust_id;
+        cardTypes << card_type;
+        starts << start;
+        startDates << start_date;
+        startTimes << start_time;
+        custNames << query.value(4);
+        vehiNames << query.value(8);
+        zoneIds << query.value(9);
+        zoneNames << query.value(10);
+    }
+
+    if (query.lastError().isValid()) return finish(Gate_DBError);
+
+    /* release the statement before writing. */
+    query.finish();
+
+    /* charge all the tickets in one pass. */
+    const int count = tranIds.size();
+    const QVector<qint64> ends(count, end);
+    QVector<double> charges(count);
+
+    tariff.charges(starts.constData(), ends.constData(), cardTypes.constData(), charges.data(), count);
+
+    /* the rows of the report and of the tickets to remove. */
+    QVariantList reportVehicles, reportStartDates, reportStartTimes, reportEndDates, reportEndTimes;
+    QVariantList reportCharges, reportCustomers, reportCustIds, reportZones, settledIds;
+    const QVariant end_date(when.date()), end_time(when.time());
+    QVariantList creditIds, creditCharges;
+    QList<settledTicket> tickets;
+
+    for (int i = 0; i < count; i++) {
+        const double charge = charges.at(i);
+
+        /* members with credit card pay from the money of their card. */
+        if (cardTypes.at(i) == CreditCardType && ledger) {
+            const gateResult paid = debitCard(custIds.at(i), charge, when, exitReasonStr);
+
+            if (paid == Gate_NotEnoughMoney) {
+                result.notEnoughMoney++;
+                continue;
+            }
+
+            if (paid != Gate_Ok) return finish(paid);
+        }
+        else if (cardTypes.at(i) == CreditCardType) {
+            QHash<int, double>::iterator money = cardMoney.find(custIds.at(i));
+
+            if (money.value() < 0 || isLessThan(money.value(), charge)) {
+                result.notEnoughMoney++;
+                continue;
+            }
+
+            money.value() -= charge;
+
+            creditIds << custIds.at(i);
+            creditCharges << charge;
+        }
+
+        reportVehicles << vehiNames.at(i);
+        reportStartDates << startDates.at(i);
+        reportStartTimes << startTimes.at(i);
+        reportEndDates << end_date;
+        reportEndTimes << end_time;
+        reportCharges << charge;
+        reportCustomers << custNames.at(i);
+        reportCustIds << custIds.at(i);
+        reportZones << zoneNames.at(i);
+        settledIds << tranIds.at(i);
+
+        /* the space of the vehicle is free when it commits. */
+        if (!zoneIds.at(i).isNull()) operationFreed << zoneIds.at(i).toInt();
+
+        settledTicket ticket;
+        ticket.tranId = tranIds.at(i);
+        ticket.vehiId = vehiIds.at(i);
+        ticket.custId = custIds.at(i);
+        ticket.charge = charge;
+        tickets << ticket;
+
+        result.settled++;
+        result.charged += charge;
+    }
+
+    if (result.settled) {
+        /* the payments from the credit cards. */
+        if (!creditIds.isEmpty()) {
+            query.prepare("UPDATE customer SET card_money = card_money - ? WHERE customer.id = ?");
+            query.addBindValue(creditCharges);
+            query.addBindValue(creditIds);
+
+            if (!query.execBatch()) return finish(Gate_DBError);
+        }
+
+        /* store the tickets in the report. */
+        query.prepare("INSERT INTO report (vehicle, start_date, end_date, start_time, end_time, charge, customer, zone, cust_id) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)");
+        query.addBindValue(reportVehicles);
+        query.addBindValue(reportStartDates);
+        query.addBindValue(reportEndDates);
+        query.addBindValue(reportStartTimes);
+        query.addBindValue(reportEndTimes);
+        query.addBindValue(reportCharges);
+        query.addBindValue(reportCustomers);
+        query.addBindValue(reportZones);
+        query.addBindValue(reportCustIds);
+
+        if (!query.execBatch()) return finish(Gate_DBError);
+
+        /* remove the tickets. */
+        query.prepare("DELETE FROM transacts WHERE id = ?");
+        query.addBindValue(settledIds);
+
+        if (!query.execBatch()) return finish(Gate_DBError);
+    }
+
+    if (summary) *summary = result;
+    if (settled) *settled = tickets;
+
+    return finish(Gate_Ok);
+}
+
+/* set the money of a member's credit card (a new card or a top up). the
+   ledger entries so far are applied to the old money, so they are marked
+   as applied and the new balance starts a new series of entries. */
+ParkingEngine::gateResult
+ParkingEngine::setCardBalance(const int custId, const double balance, const QDateTime &when) {
+    /* the balances are kept in thousandths in an integer. */
+    if (!BalanceLedger::fits(balance)) return Gate_InvalidAmount;
+
+    if (!begin()) return Gate_DBError;
+
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    query.prepare("UPDATE ledger SET applied = 1 WHERE cust_id = :cust_id AND applied = 0");
+    query.bindValue(":cust_id", custId);
+
+    if (!query.exec()) return finish(Gate_DBError);
+
+    query.prepare("UPDATE customer SET card_money = :balance WHERE customer.id = :cust_id");
+    query.bindValue(":balance", balance);
+    query.bindValue(":cust_id", custId);
+
+    /* the customer must exist. */
+    if (!query.exec() || query.numRowsAffected() != 1) return finish(Gate_DBError);
+
+    if (!appendLedger(custId, balance, balance, when, cardReasonStr, true))
+        return finish(Gate_DBError);
+
+    /* the lanes debit the new balance from now on (on the DB only if the
+       table of the balances is full, see debitCard()). */
+    if (ledger) {
+        operationAccounts << custId;
+
+        /* the table may be full, the member is debited on the DB then. */
+        const bool opened = ledger->open(custId, balance);
+
+        /* but an account it has must not keep the old balance. */
+        double old;
+        if (!opened && ledger->balance(custId, old)) return finish(Gate_DBError);
+    }
+
+    return finish(Gate_Ok);
+}
+
+/* store the balances in the card money of the customers (the ledger
+   entries not applied yet are added to it and marked as applied). */
+ParkingEngine::gateResult
+ParkingEngine::snapshotBalances() {
+    if (!begin()) return Gate_DBError;
+
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    if (!query.exec("UPDATE customer SET card_money = IFNULL(card_money, 0) + "
+                    "  (SELECT SUM(amount) FROM ledger WHERE ledger.cust_id = customer.id AND ledger.applied = 0) "
+                    "WHERE customer.id IN (SELECT cust_id FROM ledger WHERE applied = 0)"))
+        return finish(Gate_DBError);
+
+    if (!query.exec("UPDATE ledger SET applied = 1 WHERE applied = 0"))
+        return finish(Gate_DBError);
+
+    return finish(Gate_Ok);
+}
+
+/* purge a tombstoned customer (see CustomerPurge): its vehicles, open
+   tickets and report rows go to the customer of its tombstone (or the
+   one that is deleted into, the guest if none is left), the report rows
+   with its name too, and its ledger is deleted with it. a customer which
+   is not tombstoned (or purged already) is left as it is. */
+ParkingEngine::gateResult
+ParkingEngine::purgeCustomer(const int custId) {
+    if (!begin()) return Gate_DBError;
+
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    query.prepare("SELECT tombstone FROM customer WHERE id = :cust_id");
+    query.bindValue(":cust_id", custId);
+
+    if (!query.exec()) return finish(Gate_DBError);
+    if (!query.next() || query.value(0).isNull()) return finish(Gate_Ok);
+
+    /* the live customer of the target (the target may be tombstoned too). */
+    int target = query.value(0).toInt();
+    int hops = 0;
+
+    forever {
+        query.bindValue(":cust_id", target);
+
+        if (!query.exec()) return finish(Gate_DBError);
+
+        /* purged already (or a cycle of tombstones). */
+        if (!query.next() || ++hops > MAX_PURGE_HOPS) {
+            target = GUEST_CUSTOMER_ID;
+            break;
+        }
+
+        if (query.value(0).isNull()) break;
+
+        target = query.value(0).toInt();
+    }
+
+    /* release the statement before writing. */
+    query.finish();
+
+    /* the statements find the rows by the indexes of the customers. */
+    query.prepare("UPDATE vehicle SET cust_id = :target WHERE cust_id = :cust_id");
+    query.bindValue(":target", target);
+    query.bindValue(":cust_id", custId);
+
+    if (!query.exec()) return finish(Gate_DBError);
+
+    query.prepare("UPDATE transacts SET cust_id = :target WHERE cust_id = :cust_id");
+    query.bindValue(":target", target);
+    query.bindValue(":cust_id", custId);
+
+    if (!query.exec()) return finish(Gate_DBError);
+
+    query.prepare("UPDATE report SET customer = IFNULL((SELECT name FROM customer WHERE id = :target_name), ''), "
+                  "cust_id = :target WHERE cust_id = :cust_id");
+    query.bindValue(":target_name", target);
+    query.bindValue(":target", target);
+    query.bindValue(":cust_id", custId);
+
+    if (!query.exec()) return finish(Gate_DBError);
+
+    /* the money of the target's card does not change. */
+    query.prepare("DELETE FROM ledger WHERE cust_id = :cust_id");
+    query.bindValue(":cust_id", custId);
+
+    if (!query.exec()) return finish(Gate_DBError);
+
+    query.prepare("DELETE FROM customer WHERE id = :cust_id");
+    query.bindValue(":cust_id", custId);
+
+    if (!query.exec()) return finish(Gate_DBError);
+
+    return finish(Gate_Ok);
+}
+
+/* the caller's transaction of a batch is over. if it did not commit the
+   balances changed by its operations are read again from the DB and the
+   zones taken are freed, else the zones of the vehicles left are freed. */
+void
+ParkingEngine::finishBatch(const bool committed) {
+    if (!committed) reloadAccounts(batchAccounts);
+
+    batchAccounts.clear();
+
+    settleZones(committed, batchTaken, batchFreed);
+}
+
+/* quote the charge of a vehicle's ticket if it left the parking now
+   (it only reads, the ticket is completed with closeTicket). */
+ParkingEngine::gateResult
+ParkingEngine::quoteVehicle(const int vehiId, const QDateTime &when, double *charge, int *tranId) {
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    /* find the ticket of the vehicle with the card of its customer. */
+    query.prepare("SELECT tran.id, tran.start_date, tran.start_time, cust.card_id, cust.card_expiry "
+                  "FROM transacts AS tran "
+                  "INNER JOIN customer AS cust ON cust.id = tran.cust_id "
+                  "WHERE tran.vehi_id = :vehi_id");
+    query.bindValue(":vehi_id", vehiId);
+
+    if (!query.exec()) return Gate_DBError;
+    if (!query.next()) return Gate_NoTicket;
+
+    const int tran_id = query.value(0).toInt();
+    const QDate start_date = query.value(1).toDate();
+    const QTime start_time = query.value(2).toTime();
+    const int card_type = query.value(3).toInt() - 1; /* for fixing with indexes. */
+    const qint64 card_expiry = query.value(4).toLongLong();
+
+    /* an expired card must be renewed first. */
+    if (isCardExpired(card_expiry, when.date().toJulianDay())) return Gate_CardExpired;
+
+    /* calculate the charge of the transaction. */
+    if (charge) *charge = tariff.charge(QDateTime(start_date, start_time), when, card_type);
+    if (tranId) *tranId = tran_id;
+
+    return Gate_Ok;
+}
+
+/* the printable name of a gate operation result. */
+QString
+ParkingEngine::resultName(const gateResult result) {
+    switch (result) {
+        case Gate_Ok:               return "ok";
+        case Gate_NoCapacity:       return "no-capacity";
+        case Gate_VehicleInParking: return "vehicle-in-parking";
+        case Gate_UnknownVehicle:   return "unknown-vehicle";
+        case Gate_NoTicket:         return "no-ticket";
+        case Gate_CardExpired:      return "card-expired";
+        case Gate_NotEnoughMoney:   return "not-enough-money";
+        case Gate_InvalidAmount:    return "invalid-amount";
+        case Gate_DBError:          return "db-error";
+        default:                    return "unknown";
+    }
+}
+
+/* start a write DB transaction (take the write lock immediately,
+   so two gates never both read the capacity and then insert). */
+bool
+ParkingEngine::begin() {
+    operationAccounts.clear();
+    operationTaken.clear();
+    operationFreed.clear();
+
+    if (batched) return QSqlQuery(db).exec("SAVEPOINT gate_operation");
+
+    return QSqlQuery(db).exec("BEGIN IMMEDIATE");
+}
+
+/* commit the DB transaction on success, undo it on any failure. */
+ParkingEngine::gateResult
+ParkingEngine::finish(const gateResult result) {
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    /* in batch mode only the savepoint is kept or undone. */
+    if (batched) {
+        if (result != Gate_Ok) {
+            query.exec("ROLLBACK TO gate_operation");
+            reloadAccounts(operationAccounts);
+            settleZones(false, operationTaken, operationFreed);
+        }
+        else {
+            batchAccounts += operationAccounts;
+            batchTaken += operationTaken;
+            batchFreed += operationFreed;
+        }
+
+        return query.exec("RELEASE gate_operation") ? result : Gate_DBError;
+    }
+
+    if (result == Gate_Ok) {
+        /* try to commit, if it fails nothing happened. */
+        if (query.exec("COMMIT")) {
+            settleZones(true, operationTaken, operationFreed);
+            return Gate_Ok;
+        }
+
+        query.exec("ROLLBACK");
+        reloadAccounts(operationAccounts);
+        settleZones(false, operationTaken, operationFreed);
+        return Gate_DBError;
+    }
+
+    query.exec("ROLLBACK");
+    reloadAccounts(operationAccounts);
+    settleZones(false, operationTaken, operationFreed);
+    return result;
+}
+
+/* store a ticket in the report for future reference and remove it
+   (inside the transaction of the operation). */
+bool
+ParkingEngine::archiveTicket(const int tranId,
+                             const int custId, const QString &custName, const QString &vehiName,
+                             const QDateTime &start, const QDateTime &end,
+                             const double charge, const QString &zone) {
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    /* prepare a sql query with place holders. */
+    query.prepare("INSERT INTO report (vehicle, start_date, end_date, start_time, end_time, charge, customer, zone, cust_id) VALUES (:vehi_name, :start_date, :end_date, :start_time, :end_time, :charge, :cust_name, :zone, :cust_id)");
+
+    /* bind values to the query placeholders. */
+    query.bindValue(":vehi_name", vehiName);
+    query.bindValue(":start_date", start.date());
+    query.bindValue(":end_date", end.date());
+    query.bindValue(":start_time", start.time());
+    query.bindValue(":end_time", end.time());
+    query.bindValue(":charge", charge);
+    query.bindValue(":cust_name", custName);
+    query.bindValue(":zone", zone.isEmpty() ? QVariant(QVariant::String) : QVariant(zone));
+    query.bindValue(":cust_id", custId);
+
+    if (!query.exec()) return false;
+
+    /* remove the transaction. */
+    query.prepare("DELETE FROM transacts WHERE id = :tran_id");
+    query.bindValue(":tran_id", tranId);
+
+    return query.exec();
+}
+
+/* charge the card of a member only if there is enough money (inside the
+   transaction of the operation). */
+ParkingEngine::gateResult
+ParkingEngine::payFromCard(const int custId, const double charge, const QDateTime &when, const QString &reason) {
+    /* the check and the debit of the balance in one atomic step. */
+    if (ledger) return debitCard(custId, charge, when, reason);
+
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    /* the check and the charge in one statement (a placeholder is bound
+       once only by the driver, so the charge is bound under two names). */
+    query.prepare("UPDATE customer SET card_money = card_money - :charge WHERE customer.id = :cust_id AND card_money >= :min_money");
+    query.bindValue(":charge", charge);
+    query.bindValue(":cust_id", custId);
+    query.bindValue(":min_money", charge);
+
+    if (!query.exec()) return Gate_DBError;
+    if (query.numRowsAffected() != 1) return Gate_NotEnoughMoney;
+
+    return Gate_Ok;
+}
+
+/* check and debit the balance of a member's credit card in memory and
+   append the debit to the ledger (inside the transaction of the operation). */
+ParkingEngine::gateResult
+ParkingEngine::debitCard(const int custId, const double charge, const QDateTime &when, const QString &reason) {
+    double balance;
+    BalanceLedger::debitResult debited = ledger->debit(custId, charge, &balance);
+
+    /* the balance of a new member is read from the DB once. */
+    if (debited == BalanceLedger::Debit_NoAccount) {
+        double stored;
+
+        const gateResult read = storedBalance(custId, stored);
+        if (read != Gate_Ok) return read;
+
+        /* the table of the balances is full: the member is debited on
+           the DB only, by its ledger entry (until the next load). */
+        if (!ledger->open(custId, stored)) {
+            if (isLessThan(stored, charge)) return Gate_NotEnoughMoney;
+
+            return appendLedger(custId, -charge, stored - charge, when, reason, false) ? Gate_Ok : Gate_DBError;
+        }
+
+        debited = ledger->debit(custId, charge, &balance);
+    }
+
+    if (debited != BalanceLedger::Debit_Ok) return Gate_NotEnoughMoney;
+
+    /* undone if the operation or its batch does not commit. */
+    operationAccounts << custId;
+
+    if (!appendLedger(custId, -charge, balance, when, reason, false)) return Gate_DBError;
+
+    return Gate_Ok;
+}
+
+/* open the account of a member's credit card with its balance in the DB. */
+ParkingEngine::gateResult
+ParkingEngine::openAccount(const int custId) {
+    double balance;
+
+    const gateResult read = storedBalance(custId, balance);
+    if (read != Gate_Ok) return read;
+
+    return ledger->open(custId, balance) ? Gate_Ok : Gate_DBError;
+}
+
+/* the balance of a member's credit card in the DB (its card money and
+   the ledger entries not applied to it yet). */
+ParkingEngine::gateResult
+ParkingEngine::storedBalance(const int custId, double &balance) {
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    query.prepare("SELECT IFNULL(cust.card_money, 0) + "
+                  "       IFNULL((SELECT SUM(amount) FROM ledger WHERE ledger.cust_id = cust.id AND ledger.applied = 0), 0) "
+                  "FROM customer AS cust WHERE cust.id = :cust_id AND cust.card_id = :card_id");
+    query.bindValue(":cust_id", custId);
+    query.bindValue(":card_id", CreditCardType + 1); /* for fixing with indexes. */
+
+    if (!query.exec()) return Gate_DBError;
+
+    /* only the members with credit card have a balance. */
+    if (!query.next()) return Gate_NotEnoughMoney;
+
+    balance = query.value(0).toDouble();
+
+    return Gate_Ok;
+}
+
+/* read again the balances of some members from the DB (after an undo). */
+void
+ParkingEngine::reloadAccounts(const QSet<int> &custIds) {
+    if (!ledger) return;
+
+    foreach (const int custId, custIds)
+        openAccount(custId);
+}
+
+/* the zones of some operations are over: if they committed the spaces of
+   the vehicles left are freed, else the spaces taken by the vehicles
+   entering (the lists are cleared). */
+void
+ParkingEngine::settleZones(const bool committed, QList<int> &taken, QList<int> &freed) {
+    if (zones) {
+        foreach (const int zone, committed ? freed : taken)
+            zones->release(zone);
+    }
+
+    taken.clear();
+    freed.clear();
+}
+
+/* append an entry to the ledger of the balances. */
+bool
+ParkingEngine::appendLedger(const int custId, const double amount, const double balance,
+                            const QDateTime &when, const QString &reason, const bool applied) {
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    /* prepare a sql query with place holders. */
+    query.prepare("INSERT INTO ledger (cust_id, amount, balance, entry_date, entry_time, reason, applied) "
+                  "VALUES (:cust_id, :amount, :balance, :entry_date, :entry_time, :reason, :applied)");
+
+    /* bind values to the query placeholders. */
+    query.bindValue(":cust_id", custId);
+    query.bindValue(":amount", amount);
+    query.bindValue(":balance", balance);
+    query.bindValue(":entry_date", when.date());
+    query.bindValue(":entry_time", when.time());
+    query.bindValue(":reason", reason);
+    query.bindValue(":applied", applied ? 1 : 0);
+
+    return query.exec();
+}
@@ -0,0 +1,122 @@
+/* header defining the interface of the source. */
+#ifndef PARKINGENGINE_H
+#define PARKINGENGINE_H
+
+/* include some QT libraries. */
+#include <QDateTime>
+#include <QSqlDatabase>
+#include <QString>
+#include <QSet>
+#include <QList>
+
+/* include header defining the interface of the source. */
+#include "appsettings.h"
+#include "tariffengine.h"
+
+/* use these classes. */
+class BalanceLedger;
+class ZoneMap;
+
+/* settlement summary structure data type (the open tickets closed at once). */
+typedef struct settlementSummary {
+    int tickets;          /* open tickets found. */
+    int settled;          /* stored in the report and removed. */
+    int expired;          /* left open, the card must be renewed. */
+    int notEnoughMoney;   /* left open, the credit card cannot pay. */
+    double charged;       /* total charge of the settled tickets. */
+} settlementSummary;
+
+/* settled ticket structure data type (one ticket of a settlement). */
+typedef struct settledTicket {
+    int tranId;
+    int vehiId;
+    int custId;
+    double charge;
+} settledTicket;
+
+/* class which implements the headless gate operations (vehicle entry/exit)
+   with the same rules as the gui forms. it works on the given connection
+   so every thread (gate) must use its own engine and connection. in batch
+   mode every operation is a savepoint inside the caller's transaction.
+   with a balance ledger the credit cards are debited in memory and every
+   debit is appended to the ledger of the DB (see BalanceLedger). with a
+   zone map every vehicle entering is allocated a zone instead of checking
+   the capacity of the settings (see ZoneMap). */
+class ParkingEngine
+{
+    public:
+        /* gate operation results enumeration data type. */
+        typedef enum gateResult {
+            Gate_Ok = 0,
+            Gate_NoCapacity,
+            Gate_VehicleInParking,
+            Gate_UnknownVehicle,
+            Gate_NoTicket,
+            Gate_CardExpired,
+            Gate_NotEnoughMoney,
+            Gate_InvalidAmount,   /* out of the range of the balances. */
+            Gate_DBError
+        } gateResult;
+
+        ParkingEngine(const appSettings &sets, QSqlDatabase db);
+        ParkingEngine(const appSettings &sets, const TariffEngine &tariff, QSqlDatabase db);
+
+        void setBatchMode(const bool batched);
+        void setSettings(const appSettings &sets);
+        void setLedger(BalanceLedger *ledger);
+        void setZones(ZoneMap *zones);
+
+        int vehicleId(const QString &plate);
+
+        gateResult enterVehicle(const int vehiId, const QDateTime &when);
+        gateResult exitVehicle(const int vehiId, const QDateTime &when, double *charge = 0, const double recordedCharge = -1);
+        gateResult chargeCard(const int custId, const double charge);
+        gateResult closeTicket(const int tranId, const QDateTime &when, const double charge, const int payingCustId = 0);
+        gateResult cancelTicket(const int tranId);
+
+        gateResult settleTickets(const QDateTime &when, settlementSummary *summary = 0, QList<settledTicket> *settled = 0);
+
+        gateResult setCardBalance(const int custId, const double balance, const QDateTime &when);
+        gateResult snapshotBalances();
+        gateResult purgeCustomer(const int custId);
+        void finishBatch(const bool committed);
+
+        gateResult quoteVehicle(const int vehiId, const QDateTime &when, double *charge, int *tranId = 0);
+
+        static QString resultName(const gateResult result);
+
+    private:
+        bool begin();
+        gateResult finish(const gateResult result);
+
+        bool archiveTicket(const int tranId,
+                           const int custId, const QString &custName, const QString &vehiName,
+                           const QDateTime &start, const QDateTime &end,
+                           const double charge, const QString &zone);
+
+        gateResult payFromCard(const int custId, const double charge, const QDateTime &when, const QString &reason);
+        gateResult debitCard(const int custId, const double charge, const QDateTime &when, const QString &reason);
+        gateResult openAccount(const int custId);
+        gateResult storedBalance(const int custId, double &balance);
+        void reloadAccounts(const QSet<int> &custIds);
+        void settleZones(const bool committed, QList<int> &taken, QList<int> &freed);
+        bool appendLedger(const int custId, const double amount, const double balance,
+                          const QDateTime &when, const QString &reason, const bool applied);
+
+        appSettings sets;
+        TariffEngine tariff;
+        QSqlDatabase db;
+        bool batched;
+
+        BalanceLedger *ledger;
+        QSet<int> operationAccounts;  /* balances changed by the running operation ... */
+        QSet<int> batchAccounts;      /* ... and by the batch, not committed yet. */
+
+        ZoneMap *zones;
+        QList<int> operationTaken;    /* zones taken by the running operation ... */
+        QList<int> operationFreed;    /* ... and freed (when it commits) ... */
+        QList<int> batchTaken;        /* ... and the same for the batch, not committed yet. */
+        QList<int> batchFreed;
+};
+
+#endif // PARKINGENGINE_H
@@ -0,0 +1,71 @@
+/*
+ *  This file implements the common tools of the benchmarks.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+
+/* include header defining the interface of the source. */
+#include "benchmark.h"
+
+/* the sink of the measured values. */
+static volatile double sink = 0;
+
+/* parse the "--name value" options of a benchmark (false for a bad one). */
+bool
+parseBenchOptions(const QStringList &args, const QStringList &names, QMap<QString, QString> &options) {
+    for (int i = 0; i < args.size(); i += 2) {
+        const QString name = args.at(i);
+
+        if (!name.startsWith("--") || !names.contains(name.mid(2)) || i + 1 >= args.size())
+            return false;
+
+        options.insert(name.mid(2), args.at(i + 1));
+    }
+
+    return true;
+}
+
+/* the next number of a fast random stream (xorshift64*). */
+quint64
+benchRandom(quint64 &state) {
+    /* a zero state would stay zero. */
+    if (!state) state = Q_UINT64_C(0x9E3779B97F4A7C15);
+
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+
+    return state * Q_UINT64_C(2685821657736338717);
+}
+
+/* print the time of some operations (total, per operation and per second). */
+void
+printThroughput(QTextStream &out, const QString &what, const qint64 operations, const qint64 nsecs) {
+    const double secs = qMax(nsecs, (qint64) 1) / 1e9;
+
+    out << what.leftJustified(20) << ": " << operations << " in " << QString::number(secs, 'f', 3) << " secs, "
+        << QString::number((double) nsecs / qMax(operations, (qint64) 1), 'f', 1) << " nsecs each, "
+        << QString::number(operations / secs, 'f', 0) << " per sec\n";
+}
+
+/* keep a value alive so the compiler cannot drop the measured work. */
+void
+benchSink(const double value) {
+    sink = sink + value;
+}
@@ -0,0 +1,26 @@
+/* header defining the interface of the source. */
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+/* include some QT libraries. */
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QTextStream>
+
+/* a benchmark (its options after its name, the report stream). */
+typedef int (*benchmarkFunction)(const QStringList &args, QTextStream &out);
+
+/* parse the "--name value" options of a benchmark (false for a bad one). */
+bool parseBenchOptions(const QStringList &args, const QStringList &names, QMap<QString, QString> &options);
+
+/* the next number of a fast random stream (xorshift64*), the same for a seed. */
+quint64 benchRandom(quint64 &state);
+
+/* print the time of some operations (total, per operation and per second). */
+void printThroughput(QTextStream &out, const QString &what, const qint64 operations, const qint64 nsecs);
+
+/* keep a value alive so the compiler cannot drop the measured work. */
+void benchSink(const double value);
+
+#endif // BENCHMARK_H
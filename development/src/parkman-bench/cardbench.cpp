@@ -0,0 +1,132 @@
+/*
+ *  This file implements the benchmark of the card number validation.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <cstdlib>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "cardbench.h"
+#include "benchmark.h"
+#include "bankingtools.h"
+
+/* prefixes and lengths of the generated card numbers (some brands). */
+static const char *cardPrefixes[] = { "4", "51", "55", "2221", "34", "37", "6011", "3528", "62", "36" };
+static const int cardLengths[] = { 16, 16, 16, 16, 15, 15, 16, 16, 16, 14 };
+
+static const int CARD_PREFIXES_COUNT = sizeof(cardPrefixes) / sizeof(cardPrefixes[0]);
+
+/* a random card number of a known brand with a valid check digit. */
+static QString
+randomCardNumber(quint64 &seed) {
+    const quint64 r = benchRandom(seed);
+    const int brand = (int) (r % CARD_PREFIXES_COUNT);
+
+    char digits[MAX_CARD_DIGITS];
+    const char *prefix = cardPrefixes[brand];
+    const int count = cardLengths[brand];
+    int i = 0;
+
+    while (prefix[i]) {
+        digits[i] = prefix[i] - '0';
+        i++;
+    }
+
+    while (i < count) digits[i++] = (char) (benchRandom(seed) % 10);
+
+    /* the check digit which makes the Luhn sum a multiple of 10. */
+    digits[count - 1] = 0;
+    for (int d = 0; d < 10; d++) {
+        digits[count - 1] = (char) d;
+        if (isLuhnValid(digits, count)) break;
+    }
+
+    QString number;
+    for (i = 0; i < count; i++) {
+        if (i && i % 4 == 0) number += '-';
+        number += QChar('0' + digits[i]);
+    }
+
+    return number;
+}
+
+/* benchmark the local validation of the card numbers. */
+int
+cardBenchmark(const QStringList &args, QTextStream &out) {
+    QMap<QString, QString> options;
+
+    if (!parseBenchOptions(args, QStringList() << "cards" << "invalid" << "seed", options)) {
+        out << "usage: parkman-bench card [--cards N] [--invalid PERCENT] [--seed N]\n";
+        return EXIT_FAILURE;
+    }
+
+    const int cards = options.value("cards", "1000000").toInt();
+    const int invalid = qBound(0, options.value("invalid", "10").toInt(), 100);
+    quint64 seed = options.value("seed", "1").toULongLong();
+
+    /* the card numbers as typed (some of them with a wrong digit). */
+    QVector<QString> numbers(cards);
+
+    for (int i = 0; i < cards; i++) {
+        numbers[i] = randomCardNumber(seed);
+
+        if ((int) (benchRandom(seed) % 100) < invalid) {
+            const int last = numbers[i].size() - 1;
+            numbers[i][last] = QChar('0' + (numbers[i][last].digitValue() + 1) % 10);
+        }
+    }
+
+    /* warm up the caches, then measure the whole validation. */
+    int accepted = 0;
+    for (int i = 0; i < cards; i++) accepted += getCreditCardType(numbers.at(i)) != creditCardError;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int counts[creditCardMaestro + 2] = { 0 };
+    for (int i = 0; i < cards; i++) counts[getCreditCardType(numbers.at(i)) + 1]++;
+
+    printThroughput(out, "card types", cards, timer.nsecsElapsed());
+
+    /* the check digit alone. */
+    QVector<char> digits(cards * MAX_CARD_DIGITS);
+    QVector<int> lengths(cards);
+
+    for (int i = 0; i < cards; i++)
+        lengths[i] = cardNumberDigits(numbers.at(i), digits.data() + i * MAX_CARD_DIGITS);
+
+    timer.restart();
+
+    int valid = 0;
+    for (int i = 0; i < cards; i++) valid += isLuhnValid(digits.constData() + i * MAX_CARD_DIGITS, lengths.at(i));
+
+    printThroughput(out, "luhn checks", cards, timer.nsecsElapsed());
+    benchSink(valid + accepted);
+
+    /* the brands found. */
+    out << "rejected            : " << counts[0] << "\n";
+
+    for (int type = creditCardVisa; type <= creditCardMaestro; type++) {
+        if (counts[type + 1])
+            out << creditCardName((creditCardType) type).leftJustified(20) << ": " << counts[type + 1] << "\n";
+    }
+
+    return EXIT_SUCCESS;
+}
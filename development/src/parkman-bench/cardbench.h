@@ -0,0 +1,12 @@
+/* header defining the interface of the source. */
+#ifndef CARDBENCH_H
+#define CARDBENCH_H
+
+/* include some QT libraries. */
+#include <QStringList>
+#include <QTextStream>
+
+/* benchmark the local validation of the card numbers. */
+int cardBenchmark(const QStringList &args, QTextStream &out);
+
+#endif // CARDBENCH_H
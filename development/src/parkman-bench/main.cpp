@@ -0,0 +1,70 @@
+/*
+ *  This file implements the main startup of the benchmarks.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <cstdlib>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "benchmark.h"
+#include "tariffbench.h"
+#include "cardbench.h"
+#include "replaybench.h"
+
+/* benchmark structure data type. */
+typedef struct benchmarkEntry {
+    const char *name;
+    benchmarkFunction function;
+    const char *description;
+} benchmarkEntry;
+
+/* the benchmarks of the tool. */
+static const benchmarkEntry benchmarks[] = {
+    { "tariff", tariffBenchmark, "quotes of the compiled tariffs" },
+    { "card", cardBenchmark, "local validation of the card numbers" },
+    { "replay", replayBenchmark, "replay of the journal tail at the start of the writer" }
+};
+
+static const int BENCHMARKS_COUNT = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+/* main function. */
+int
+main(int argc, char *argv[]) {
+    /* create the console application. */
+    QCoreApplication app(argc, argv);
+
+    QTextStream out(stdout);
+    QStringList args = app.arguments();
+
+    /* the name of the benchmark and its options. */
+    const QString name = args.size() > 1 ? args.at(1) : QString();
+    args = args.mid(2);
+
+    for (int i = 0; i < BENCHMARKS_COUNT; i++) {
+        if (name == benchmarks[i].name) return benchmarks[i].function(args, out);
+    }
+
+    out << "usage: parkman-bench BENCHMARK [options]\n";
+
+    for (int i = 0; i < BENCHMARKS_COUNT; i++)
+        out << "  " << QString(benchmarks[i].name).leftJustified(12) << benchmarks[i].description << "\n";
+
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,28 @@
+# program's template as application.
+TEMPLATE = app
+
+# internal name of the tool.
+INTERNAL_NAME = parkman-bench
+
+# tool executable filename.
+TARGET = $${INTERNAL_NAME}
+
+# configuration options for the tool (console program).
+CONFIG += console
+CONFIG -= app_bundle
+
+# headers used in the tool.
+HEADERS = benchmark.h \
+        tariffbench.h \
+          cardbench.h \
+        replaybench.h
+
+# sources used in the tool.
+SOURCES = benchmark.cpp \
+        tariffbench.cpp \
+          cardbench.cpp \
+        replaybench.cpp \
+               main.cpp
+
+# headless core of the application.
+include(../core.pri)
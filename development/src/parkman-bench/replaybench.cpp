@@ -0,0 +1,208 @@
+/*
+ *  This file implements the benchmark of the replay of the journal.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <QtSql>
+#include <cstdlib>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "replaybench.h"
+#include "benchmark.h"
+#include "databasetools.h"
+#include "eventjournal.h"
+#include "dbwriter.h"
+#include "customerpurge.h"
+
+/* name of the connection preparing the DB of the benchmark. */
+static const QString replayConnectionStr = "parkman-bench-replay";
+
+/* the charge of every closed ticket. */
+static const double REPLAY_CHARGE = 2;
+
+/* remove the files of a DB of the benchmark (with its journal). */
+static void
+removeReplayFiles(const QString &fileName) {
+    QDir journal(fileName + journalSuffixStr);
+
+    foreach (const QString &segment, journal.entryList(QDir::Files))
+        journal.remove(segment);
+
+    QDir().rmdir(journal.path());
+
+    QFile::remove(fileName);
+    QFile::remove(fileName + "-wal");
+    QFile::remove(fileName + "-shm");
+}
+
+/* create the DB of the benchmark with some open tickets of the guest (the
+   ids of the tickets, empty on failure). */
+static QList<int>
+createOpenTickets(const QString &fileName, const int tickets, const QDateTime &start) {
+    QList<int> tranIds;
+
+    {
+        QSqlDatabase db = openDBConnection(replayConnectionStr, fileName);
+        QSqlQuery query(db);
+
+        bool ok = db.isOpen() && createDBSchema(db) && db.transaction();
+
+        QVariantList plates, vehicleCustomers;
+
+        for (int i = 0; i < tickets; i++) {
+            plates << QString("REPLAY-%1").arg(i + 1);
+            vehicleCustomers << GUEST_CUSTOMER_ID;
+        }
+
+        ok = ok && query.prepare("INSERT INTO vehicle (reg_num, cust_id) VALUES (?, ?)");
+        query.addBindValue(plates);
+        query.addBindValue(vehicleCustomers);
+        ok = ok && query.execBatch();
+
+        /* a ticket for every vehicle. */
+        ok = ok && query.exec(QString("INSERT INTO transacts (vehi_id, cust_id, start_date, start_time) "
+                                      "SELECT id, cust_id, '%1', '%2' FROM vehicle")
+                              .arg(start.date().toString(Qt::ISODate)).arg(start.time().toString(Qt::ISODate)));
+
+        ok = ok && query.exec("SELECT id FROM transacts ORDER BY id");
+
+        while (ok && query.next()) tranIds << query.value(0).toInt();
+
+        query.finish();
+
+        if (!ok || !db.commit() || tranIds.size() != tickets) tranIds.clear();
+    }
+
+    QSqlDatabase::removeDatabase(replayConnectionStr);
+
+    return tranIds;
+}
+
+/* count the rows of a table of the DB of the benchmark (-1 on failure). */
+static int
+countRows(const QString &fileName, const QString &table) {
+    int count = -1;
+
+    {
+        QSqlDatabase db = openDBConnection(replayConnectionStr, fileName);
+        QSqlQuery query(db);
+
+        if (query.exec(QString("SELECT COUNT(*) FROM %1").arg(table)) && query.next())
+            count = query.value(0).toInt();
+    }
+
+    QSqlDatabase::removeDatabase(replayConnectionStr);
+
+    return count;
+}
+
+/* benchmark the replay of the journal tail when the writer starts: the
+   closes of the tickets are journaled but not committed (as after a
+   crash), half of them without a paying customer as they are journaled
+   now (0) and half as the older journals have them (-1). every close
+   must be replayed, so it fails if one is refused. */
+int
+replayBenchmark(const QStringList &args, QTextStream &out) {
+    QMap<QString, QString> options;
+
+    if (!parseBenchOptions(args, QStringList() << "tickets" << "dir", options)) {
+        out << "usage: parkman-bench replay [--tickets N] [--dir DIRECTORY]\n";
+        return EXIT_FAILURE;
+    }
+
+    const int tickets = qMax(options.value("tickets", "10000").toInt(), 1);
+    const QString directory = options.value("dir", QDir::tempPath());
+    const QString fileName = QDir(directory).filePath(QString("parkman-replay-%1.db").arg(QCoreApplication::applicationPid()));
+
+    const QDateTime end = QDateTime::currentDateTime();
+    const QDateTime start = end.addSecs(-DEF_TIMESLICE);
+
+    removeReplayFiles(fileName);
+
+    const QList<int> tranIds = createOpenTickets(fileName, tickets, start);
+
+    if (tranIds.isEmpty()) {
+        out << "cannot create the database '" << fileName << "'\n";
+        removeReplayFiles(fileName);
+        return EXIT_FAILURE;
+    }
+
+    /* the closes journaled after the seq of the DB (none is projected). */
+    {
+        EventJournal journal(fileName + journalSuffixStr);
+        QString error;
+
+        bool ok = journal.open(error);
+
+        for (int i = 0; ok && i < tranIds.size(); i++) {
+            journalEvent event;
+            event.type = Event_Close;
+            event.when = end.toMSecsSinceEpoch();
+            event.vehiId = -1;
+            event.custId = i % 2 ? -1 : 0;
+            event.tranId = tranIds.at(i);
+            event.amount = REPLAY_CHARGE;
+
+            ok = journal.append(event);
+        }
+
+        if (!ok || !journal.sync()) {
+            out << "cannot journal the closes: " << error << "\n";
+            removeReplayFiles(fileName);
+            return EXIT_FAILURE;
+        }
+    }
+
+    appSettings sets;
+    sets.parkingCapacity = MAX_PARKING_CAPACITY;
+    sets.timeslice = DEF_TIMESLICE;
+    sets.chargePerTimeslice = DEF_CHARGE_PER_TIMESLICE;
+    sets.chargePrecision = DEF_CHARGE_PRECISION;
+
+    /* the writer replays the tail before any command. */
+    journalRecovery recovery;
+
+    {
+        DBWriter writer(sets, fileName, "parkman-bench");
+        writer.start();
+        writer.stop();
+        writer.wait();
+
+        recovery = writer.recovery();
+    }
+
+    const int reported = countRows(fileName, "report");
+    const int left = countRows(fileName, "transacts");
+
+    removeReplayFiles(fileName);
+
+    if (!recovery.journaling) {
+        out << "cannot replay the journal: " << recovery.error << "\n";
+        return EXIT_FAILURE;
+    }
+
+    printThroughput(out, "replayed closes", recovery.replayed, recovery.usecs * 1000);
+
+    out << "refused             : " << recovery.failed << "\n"
+        << "report rows         : " << reported << "\n"
+        << "open tickets left   : " << left << "\n";
+
+    return recovery.replayed == tickets && !recovery.failed && reported == tickets && !left ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,12 @@
+/* header defining the interface of the source. */
+#ifndef REPLAYBENCH_H
+#define REPLAYBENCH_H
+
+/* include some QT libraries. */
+#include <QStringList>
+#include <QTextStream>
+
+/* benchmark the replay of the journal tail when the writer starts. */
+int replayBenchmark(const QStringList &args, QTextStream &out);
+
+#endif // REPLAYBENCH_H
@@ -0,0 +1,164 @@
+/*
+ *  This file implements the benchmark of the tariff engine.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <cstdlib>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "tariffbench.h"
+#include "benchmark.h"
+#include "tariffengine.h"
+#include "appsettings.h"
+
+/* a tariff using every directive (when no tariff file is given). */
+static const QString sampleTariffStr = "rate 2.0\n"
+                                       "period mon-fri 22:00-07:00 1.0\n"
+                                       "period mon-fri 07:00-10:00 3.0\n"
+                                       "period mon-fri 16:00-19:00 3.0\n"
+                                       "period sat,sun 00:00-24:00 1.5\n"
+                                       "grace 10m\n"
+                                       "first 1h 1.0\n"
+                                       "cap 25\n"
+                                       "card simple 0.9\n";
+
+/* a stay of the benchmark (tariff times). */
+typedef struct benchStay {
+    qint64 start;
+    qint64 end;
+    int cardType;
+} benchStay;
+
+/* time the quotes of all the stays with a tariff. */
+static qint64
+timeQuotes(const TariffEngine &tariff, const QVector<benchStay> &stays) {
+    QElapsedTimer timer;
+    timer.start();
+
+    double total = 0;
+
+    for (int i = 0; i < stays.size(); i++) {
+        const benchStay &stay = stays.at(i);
+        total += tariff.charge(stay.start, stay.end, stay.cardType);
+    }
+
+    const qint64 nsecs = timer.nsecsElapsed();
+    benchSink(total);
+
+    return nsecs;
+}
+
+/* benchmark the quotes of the compiled tariffs. */
+int
+tariffBenchmark(const QStringList &args, QTextStream &out) {
+    QMap<QString, QString> options;
+
+    if (!parseBenchOptions(args, QStringList() << "quotes" << "tariff" << "seed", options)) {
+        out << "usage: parkman-bench tariff [--quotes N] [--tariff FILE] [--seed N]\n";
+        return EXIT_FAILURE;
+    }
+
+    const int quotes = options.value("quotes", "1000000").toInt();
+    quint64 seed = options.value("seed", "1").toULongLong();
+
+    /* the default settings of the application. */
+    appSettings sets;
+    sets.parkingCapacity = DEF_PARKING_CAPACITY;
+    sets.timeslice = DEF_TIMESLICE;
+    sets.chargePerTimeslice = DEF_CHARGE_PER_TIMESLICE;
+    sets.chargePrecision = DEF_CHARGE_PRECISION;
+
+    /* the tariff file or the sample tariff. */
+    QString text = sampleTariffStr;
+
+    if (options.contains("tariff")) {
+        QFile file(options.value("tariff"));
+
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            out << "cannot read the tariff '" << file.fileName() << "'.\n";
+            return EXIT_FAILURE;
+        }
+
+        text = QString::fromUtf8(file.readAll());
+    }
+
+    tariffDefinition definition = linearTariff(sets);
+    QString error;
+
+    if (!parseTariff(text, definition, error)) {
+        out << error << "\n";
+        return EXIT_FAILURE;
+    }
+
+    /* compile the tariffs. */
+    TariffEngine tariff, linear;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!tariff.compile(definition, sets.chargePrecision, error)) {
+        out << error << "\n";
+        return EXIT_FAILURE;
+    }
+
+    const qint64 compileNsecs = timer.nsecsElapsed();
+
+    linear.compile(linearTariff(sets), sets.chargePrecision, error);
+
+    /* random stays over a year: most of them some hours, some of them days. */
+    QVector<benchStay> stays(quotes);
+    const qint64 origin = TariffEngine::tariffTime(QDateTime(QDate(2010, 1, 4)));
+
+    for (int i = 0; i < quotes; i++) {
+        const quint64 r = benchRandom(seed);
+        const bool longStay = r % 100 < 10;
+
+        stays[i].start = origin + (qint64) ((r >> 8) % (365 * TARIFF_DAY_SECS));
+        stays[i].end = stays[i].start + 60 + (qint64) ((r >> 32) % (longStay ? 7 * TARIFF_DAY_SECS : 8 * 3600));
+        stays[i].cardType = (int) ((r >> 4) % TARIFF_CARD_TYPES);
+    }
+
+    /* warm up the caches, then measure. */
+    timeQuotes(tariff, stays);
+
+    out << "tariff steps        : " << tariff.steps() << " (k)\n";
+    printThroughput(out, "compile", 1, compileNsecs);
+    printThroughput(out, "quotes (tariff)", quotes, timeQuotes(tariff, stays));
+    printThroughput(out, "quotes (linear)", quotes, timeQuotes(linear, stays));
+
+    /* the quotes of the gui and the engine convert date times first. */
+    const int dated = qMin(quotes, 100000);
+    QVector<QDateTime> starts(dated), ends(dated);
+
+    for (int i = 0; i < dated; i++) {
+        starts[i] = QDateTime(QDate(1900, 1, 1)).addSecs(stays.at(i).start);
+        ends[i] = QDateTime(QDate(1900, 1, 1)).addSecs(stays.at(i).end);
+    }
+
+    timer.restart();
+
+    double total = 0;
+    for (int i = 0; i < dated; i++) total += tariff.charge(starts.at(i), ends.at(i), stays.at(i).cardType);
+
+    printThroughput(out, "quotes (date times)", dated, timer.nsecsElapsed());
+    benchSink(total);
+
+    return EXIT_SUCCESS;
+}
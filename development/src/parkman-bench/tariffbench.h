@@ -0,0 +1,12 @@
+/* header defining the interface of the source. */
+#ifndef TARIFFBENCH_H
+#define TARIFFBENCH_H
+
+/* include some QT libraries. */
+#include <QStringList>
+#include <QTextStream>
+
+/* benchmark the quotes of the compiled tariffs. */
+int tariffBenchmark(const QStringList &args, QTextStream &out);
+
+#endif // TARIFFBENCH_H
@@ -0,0 +1,470 @@
+/*
+ *  This file implements the synthetic data generator.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <QtSql>
+#include <cmath>
+
+/* include headers defining the interface of the sources. */
+#include "datagenerator.h"
+#include "chargingtools.h"
+#include "randomgenerator.h"
+
+/* salts which separate the random streams of the generator. */
+static const quint64 SALT_CARD  = Q_UINT64_C(0x43415244); /* "CARD" */
+static const quint64 SALT_OWNER = Q_UINT64_C(0x4F574E52); /* "OWNR" */
+static const quint64 SALT_NAME  = Q_UINT64_C(0x4E414D45); /* "NAME" */
+static const quint64 SALT_PLATE = Q_UINT64_C(0x504C4154); /* "PLAT" */
+static const quint64 SALT_CHUNK = Q_UINT64_C(0x43484E4B); /* "CHNK" */
+
+/* the pi constant (M_PI is not ANSI). */
+static const double PI = 3.14159265358979323846;
+
+/* the id of the simple guest customer. */
+static const int GUEST_CUSTOMER_ID = 1;
+
+/* shortest and longest generated parking stay (in secs). */
+static const int MIN_DWELL = 300;         /* 5 minutes. */
+static const int MAX_DWELL = 3 * 86400;   /* 3 days. */
+
+/* median (in hours) and spread of the parking stay per card type. members
+   with month/year cards are mostly commuters, guests stay for shopping. */
+static const double dwellMedianHours[CARD_TYPES_COUNT] = { 1.5, 2.0, 8.5, 8.5, 3.0 };
+static const double dwellSigma[CARD_TYPES_COUNT]       = { 0.9, 0.8, 0.3, 0.3, 0.8 };
+
+/* arrivals are a mixture of morning, lunch and evening peaks (in hours)
+   plus a flat background between 6:00 and 23:00. */
+static const int ARRIVAL_PEAKS = 3;
+static const double arrivalWeight[ARRIVAL_PEAKS] = { 0.40, 0.20, 0.20 };
+static const double arrivalMean[ARRIVAL_PEAKS]   = { 8.25, 12.5, 17.5 };
+static const double arrivalSigma[ARRIVAL_PEAKS]  = { 0.80, 1.5, 1.2 };
+
+/* weekend traffic compared to a weekday. */
+static const double WEEKEND_FACTOR = 0.55;
+
+/* names used to build the customers and the vehicles. */
+static const char *firstNames[] = { "Maria", "Eleni", "Katerina", "Sofia", "Anna", "Georgia", "Ioanna", "Dimitra",
+                                    "Giorgos", "Nikos", "Kostas", "Giannis", "Dimitris", "Christos", "Panagiotis", "Vasilis" };
+static const char *lastNames[]  = { "Papadopoulou", "Georgiou", "Nikolaou", "Ioannidis", "Konstantinou", "Vlachos",
+                                    "Karagiannis", "Oikonomou", "Makris", "Pappas", "Dimitriou", "Antoniou" };
+static const char *vehicleDescs[] = { "Silver Sedan", "Black Hatchback", "White Van", "Red Coupe",
+                                      "Blue Estate", "Grey SUV", "Green Compact", "Yellow Taxi" };
+static const char *cityNames[]  = { "Thessaloniki", "Athens", "Patra", "Larisa", "Volos", "Ioannina" };
+
+/* number of items of a static array. */
+#define ARRAY_SIZE(a) ((int) (sizeof(a) / sizeof((a)[0])))
+
+/* the card type of a customer (derived from its id only). */
+static int
+customerCardType(const generatorOptions &options, const int custId) {
+    if (custId == GUEST_CUSTOMER_ID) return NoCardType;
+
+    /* total weight of the card types mix. */
+    double total = 0;
+    for (int i = 0; i < CARD_TYPES_COUNT; i++) total += options.cardMix[i];
+
+    if (total <= 0) return NoCardType;
+
+    /* select a card type according to the weights. */
+    RandomGenerator rng(RandomGenerator::mix(options.seed ^ SALT_CARD, custId));
+    double r = rng.uniform() * total;
+
+    for (int i = 0; i < CARD_TYPES_COUNT; i++) {
+        if (r < options.cardMix[i]) return i;
+        r -= options.cardMix[i];
+    }
+
+    return NoCardType;
+}
+
+/* the customer owning a vehicle (derived from its id only). */
+static int
+vehicleOwner(const generatorOptions &options, const int custBase, const int vehiId) {
+    RandomGenerator rng(RandomGenerator::mix(options.seed ^ SALT_OWNER, vehiId));
+
+    /* some vehicles belong to the simple guest. */
+    if (options.customers <= 0 || rng.chance(options.guestShare))
+        return GUEST_CUSTOMER_ID;
+
+    return custBase + 1 + rng.uniformInt(options.customers);
+}
+
+/* the name of a customer (derived from its id only). */
+static QString
+customerName(const generatorOptions &options, const int custId) {
+    if (custId == GUEST_CUSTOMER_ID) return "Simple Guest";
+
+    RandomGenerator rng(RandomGenerator::mix(options.seed ^ SALT_NAME, custId));
+
+    return QString("%1 %2").arg(firstNames[rng.uniformInt(ARRAY_SIZE(firstNames))],
+                                lastNames[rng.uniformInt(ARRAY_SIZE(lastNames))]);
+}
+
+/* the registration number of a vehicle (derived from its id only). */
+static QString
+vehiclePlate(const generatorOptions &options, const int vehiId) {
+    RandomGenerator rng(RandomGenerator::mix(options.seed ^ SALT_PLATE, vehiId));
+
+    QString plate;
+    for (int i = 0; i < 3; i++) plate += QChar('A' + rng.uniformInt(26));
+
+    return plate + QString("-%1").arg(1000 + rng.uniformInt(9000));
+}
+
+/* sample an arrival time of the day (in secs after midnight). */
+static int
+sampleArrival(RandomGenerator &rng) {
+    double r = rng.uniform();
+    double hours = 6 + rng.uniform() * 17; /* background arrival. */
+
+    for (int i = 0; i < ARRIVAL_PEAKS; i++) {
+        if (r < arrivalWeight[i]) {
+            hours = rng.normal(arrivalMean[i], arrivalSigma[i]);
+            break;
+        }
+        r -= arrivalWeight[i];
+    }
+
+    return qBound(0, (int) (hours * 3600), 86399);
+}
+
+/* sample a parking stay (in secs) for the card type. */
+static int
+sampleDwell(RandomGenerator &rng, const int card_type) {
+    const double secs = rng.logNormal(dwellMedianHours[card_type] * 3600, dwellSigma[card_type]);
+
+    return qBound(MIN_DWELL, (int) secs, MAX_DWELL);
+}
+
+/* the vehicle of the n-th open ticket (spread over all vehicles, never twice). */
+static int
+openTicketVehicle(const generatorOptions &options, const int vehiBase, const int n) {
+    /* a stride co-prime with the vehicles count visits every vehicle once. */
+    qint64 stride = 2654435761LL % options.vehicles;
+    qint64 a = stride, b = options.vehicles;
+    while (b) { const qint64 t = a % b; a = b; b = t; }
+    if (stride == 0 || a != 1) stride = 1;
+
+    return vehiBase + 1 + (int) ((n * stride) % options.vehicles);
+}
+
+/* generate the customers of a work item. */
+static void
+generateCustomers(const generatorJob &job, RandomGenerator &rng, QVector<QVariant> &values) {
+    const generatorOptions &options = *job.options;
+    const QDate today = options.until.date();
+
+    for (int i = job.first; i < job.first + job.count; i++) {
+        const int id = job.custBase + 1 + i;
+        const int card_type = customerCardType(options, id);
+
+        /* the card date and money according to the card type. */
+        QVariant card_date(QVariant::Date);
+        QVariant card_money(QVariant::Double);
+        QVariant card_expiry(QVariant::LongLong);
+
+        if (card_type == MonthCardType)
+            card_date = today.addDays(-rng.uniformInt(36)); /* some expired. */
+        else if (card_type == YearCardType)
+            card_date = today.addDays(-rng.uniformInt(400)); /* some expired. */
+        else if (card_type == CreditCardType)
+            card_money = qRound((10 + rng.uniform() * 990) * 100) / 100.0;
+
+        if (card_date.isValid())
+            card_expiry = cardExpiryDay(card_type, card_date.toDate());
+
+        values << id
+               << customerName(options, id)
+               << QString("%1 Str. %2").arg(lastNames[rng.uniformInt(ARRAY_SIZE(lastNames))]).arg(1 + rng.uniformInt(200))
+               << cityNames[rng.uniformInt(ARRAY_SIZE(cityNames))]
+               << QString("Greece")
+               << QString("69%1").arg(10000000 + rng.uniformInt(90000000))
+               << QString("customer%1@example.com").arg(id)
+               << card_date
+               << card_money
+               << card_type + 1 /* for fixing with indexes. */
+               << card_expiry;
+    }
+}
+
+/* generate the vehicles of a work item. */
+static void
+generateVehicles(const generatorJob &job, RandomGenerator &rng, QVector<QVariant> &values) {
+    const generatorOptions &options = *job.options;
+
+    for (int i = job.first; i < job.first + job.count; i++) {
+        const int id = job.vehiBase + 1 + i;
+
+        values << id
+               << vehiclePlate(options, id)
+               << vehicleDescs[rng.uniformInt(ARRAY_SIZE(vehicleDescs))]
+               << vehicleOwner(options, job.custBase, id);
+    }
+}
+
+/* generate the open tickets (transactions) of a work item. */
+static void
+generateTransacts(const generatorJob &job, RandomGenerator &rng, QVector<QVariant> &values) {
+    const generatorOptions &options = *job.options;
+
+    for (int i = job.first; i < job.first + job.count; i++) {
+        const int vehiId = openTicketVehicle(options, job.vehiBase, i);
+        const int custId = vehicleOwner(options, job.custBase, vehiId);
+
+        /* the vehicle is somewhere in the middle of its stay. */
+        const int elapsed = (int) (rng.uniform() * sampleDwell(rng, customerCardType(options, custId)));
+        const QDateTime start = options.until.addSecs(-elapsed);
+
+        values << vehiId << custId << start.date() << start.time();
+    }
+}
+
+/* generate the report history of a work item (one day). */
+static void
+generateReport(const generatorJob &job, RandomGenerator &rng, QVector<QVariant> &values) {
+    const generatorOptions &options = *job.options;
+
+    /* the day of the work item. */
+    const QDate day = options.until.date().addDays(job.first - options.historyDays);
+
+    /* weekend and seasonal variation of the traffic. */
+    const double weekly = day.dayOfWeek() >= 6 ? WEEKEND_FACTOR : 1.0;
+    const double seasonal = 1.0 + 0.1 * sin(2.0 * PI * day.dayOfYear() / 365.0);
+    const int sessions = rng.poisson(options.dailySessions * weekly * seasonal);
+
+    for (int i = 0; i < sessions; i++) {
+        const int vehiId = job.vehiBase + 1 + rng.uniformInt(options.vehicles);
+        const int custId = vehicleOwner(options, job.custBase, vehiId);
+        const int card_type = customerCardType(options, custId);
+        const int dwell = sampleDwell(rng, card_type);
+
+        const QDateTime start(day, QTime(0, 0).addSecs(sampleArrival(rng)));
+        const QDateTime end = start.addSecs(dwell);
+
+        /* stays not finished yet are not in the history. */
+        if (end >= options.until) continue;
+
+        values << vehiclePlate(options, vehiId)
+               << start.date() << end.date()
+               << start.time() << end.time()
+               << options.tariff.charge(start, end, card_type)
+               << customerName(options, custId)
+               << custId;
+    }
+}
+
+/* generate the rows of a work item (runs in a worker thread). */
+generatedChunk
+DataGenerator::generateChunk(const generatorJob &job) {
+    /* every work item has its own random stream. */
+    RandomGenerator rng(RandomGenerator::mix(job.options->seed ^ SALT_CHUNK,
+                                             (quint64(job.table) << 32) | quint32(job.chunk)));
+
+    generatedChunk chunk;
+    chunk.table = job.table;
+
+    switch (job.table) {
+        case Table_Customer:
+            chunk.columns = 11;
+            generateCustomers(job, rng, chunk.values);
+            break;
+        case Table_Vehicle:
+            chunk.columns = 4;
+            generateVehicles(job, rng, chunk.values);
+            break;
+        case Table_Transact:
+            chunk.columns = 4;
+            generateTransacts(job, rng, chunk.values);
+            break;
+        case Table_Report:
+            chunk.columns = 8;
+            generateReport(job, rng, chunk.values);
+            break;
+        default: /* this should never happen. */
+            chunk.columns = 1;
+            break;
+    }
+
+    return chunk;
+}
+
+/* create the data generator. */
+DataGenerator::DataGenerator(const generatorOptions &options, QObject *parent) : QObject(parent) {
+    /* store the generator options. */
+    this->options = options;
+
+    /* nothing is written yet. */
+    pendingRows = 0;
+    for (int i = 0; i <= Table_Report; i++) writtenRows[i] = 0;
+
+    /* tickets are at most one per vehicle. */
+    this->options.openTickets = qMin(this->options.openTickets, this->options.vehicles);
+}
+
+/* generate all the data and write it in the DB. */
+bool
+DataGenerator::generate(QSqlDatabase db) {
+    this->db = db;
+
+    /* new rows continue after the existing ones. */
+    const int custBase = qMax(maxId("customer"), GUEST_CUSTOMER_ID);
+    const int vehiBase = maxId("vehicle");
+
+    /* prepare the insert statements once. */
+    const char *statements[] = {
+        "INSERT INTO customer (id, name, address, city, state, phone, email, card_date, card_money, card_id, card_expiry) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+        "INSERT INTO vehicle (id, reg_num, desc, cust_id) VALUES (?, ?, ?, ?)",
+        "INSERT INTO transacts (vehi_id, cust_id, start_date, start_time) VALUES (?, ?, ?, ?)",
+        "INSERT INTO report (vehicle, start_date, end_date, start_time, end_time, charge, customer, cust_id) VALUES (?, ?, ?, ?, ?, ?, ?, ?)"
+    };
+
+    inserts.clear();
+    for (int i = 0; i <= Table_Report; i++) {
+        QSqlQuery query(db);
+        if (!query.prepare(statements[i])) return false;
+        inserts << query;
+    }
+
+    /* bulk load, the durability of every batch is not needed. */
+    QSqlQuery(db).exec("PRAGMA synchronous = OFF");
+
+    /* the number of the worker threads. */
+    if (options.threads > 0)
+        QThreadPool::globalInstance()->setMaxThreadCount(options.threads);
+
+    /* all the work items in the order they will be written. */
+    QList<generatorJob> jobs = createJobs(custBase, vehiBase);
+
+    /* start the first wave of work items. */
+    QFuture<generatedChunk> future = QtConcurrent::mapped(takeWave(jobs), generateChunk);
+
+    /* the first batch transaction. */
+    if (!db.transaction()) return false;
+
+    forever {
+        /* wait the current wave and keep its rows. */
+        future.waitForFinished();
+        const QList<generatedChunk> chunks = future.results();
+
+        /* generate the next wave while the current one is written. */
+        const QList<generatorJob> wave = takeWave(jobs);
+        if (!wave.isEmpty())
+            future = QtConcurrent::mapped(wave, generateChunk);
+
+        /* write the rows of the current wave in order. */
+        foreach (const generatedChunk &chunk, chunks) {
+            if (!writeChunk(chunk)) {
+                /* stop the next wave and undo the last batch. */
+                future.waitForFinished();
+                db.rollback();
+                return false;
+            }
+        }
+
+        if (wave.isEmpty()) break;
+    }
+
+    /* commit the last batch. */
+    return db.commit();
+}
+
+/* create all the work items. */
+QList<generatorJob>
+DataGenerator::createJobs(const int custBase, const int vehiBase) const {
+    QList<generatorJob> jobs;
+
+    /* rows count of the chunked tables. */
+    const int rows[] = { options.customers, options.vehicles, options.openTickets };
+
+    for (int table = Table_Customer; table <= Table_Transact; table++) {
+        for (int first = 0, chunk = 0; first < rows[table]; first += GEN_CHUNK_ROWS, chunk++) {
+            generatorJob job = { table, chunk, first, qMin(GEN_CHUNK_ROWS, rows[table] - first),
+                                 custBase, vehiBase, &options };
+            jobs << job;
+        }
+    }
+
+    /* the report history is generated day by day. */
+    if (options.vehicles > 0) {
+        for (int day = 0; day < options.historyDays; day++) {
+            generatorJob job = { Table_Report, day, day, 1, custBase, vehiBase, &options };
+            jobs << job;
+        }
+    }
+
+    return jobs;
+}
+
+/* take the next wave of work items (a few per thread). */
+QList<generatorJob>
+DataGenerator::takeWave(QList<generatorJob> &jobs) const {
+    const int size = 4 * QThreadPool::globalInstance()->maxThreadCount();
+
+    const QList<generatorJob> wave = jobs.mid(0, size);
+    jobs = jobs.mid(wave.size());
+
+    return wave;
+}
+
+/* write the rows of a chunk in the current batch. */
+bool
+DataGenerator::writeChunk(const generatedChunk &chunk) {
+    QSqlQuery &query = inserts[chunk.table];
+
+    for (int row = 0; row < chunk.values.size(); row += chunk.columns) {
+        /* bind the values of the row. */
+        for (int column = 0; column < chunk.columns; column++)
+            query.bindValue(column, chunk.values.at(row + column));
+
+        if (!query.exec()) return false;
+
+        /* commit the batch if it is full. */
+        if (++pendingRows >= options.batchSize && !commitBatch())
+            return false;
+    }
+
+    /* report the progress of the table. */
+    writtenRows[chunk.table] += chunk.values.size() / chunk.columns;
+
+    const char *tables[] = { "customer", "vehicle", "transacts", "report" };
+    emit progress(tables[chunk.table], writtenRows[chunk.table]);
+
+    return true;
+}
+
+/* commit the current batch and start the next one. */
+bool
+DataGenerator::commitBatch() {
+    pendingRows = 0;
+
+    return db.commit() && db.transaction();
+}
+
+/* get the biggest id of a table. */
+int
+DataGenerator::maxId(const QString &table) {
+    QSqlQuery query(db);
+
+    /* execute the query and get the first record. */
+    if (query.exec(QString("SELECT MAX(id) FROM %1").arg(table)) && query.next())
+        return query.value(0).toInt();
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+/* header defining the interface of the source. */
+#ifndef DATAGENERATOR_H
+#define DATAGENERATOR_H
+
+/* include some QT libraries. */
+#include <QObject>
+#include <QDateTime>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QVariant>
+#include <QVector>
+
+/* include headers defining the interface of the sources. */
+#include "globaldeclarations.h"
+#include "appsettings.h"
+#include "tariffengine.h"
+
+/* number of card types (NoCardType ... CreditCardType). */
+static const int CARD_TYPES_COUNT = CreditCardType + 1;
+
+/* rows generated by one work item (customers, vehicles, tickets).
+   it never depends on the threads so the same seed gives the same data. */
+static const int GEN_CHUNK_ROWS = 4096;
+
+/* generator options structure data type. */
+typedef struct generatorOptions {
+    quint64 seed;
+    int customers;
+    int vehicles;
+    int openTickets;
+    int historyDays;
+    int dailySessions;
+    int threads;
+    int batchSize;
+    double guestShare;                  /* share of the vehicles owned by the guest. */
+    double cardMix[CARD_TYPES_COUNT];   /* weights of the card types of the customers. */
+    QDateTime until;                    /* the "now" of the generated data. */
+    appSettings sets;
+    TariffEngine tariff;                /* prices the history. */
+} generatorOptions;
+
+/* generator work item structure data type. */
+typedef struct generatorJob {
+    int table;
+    int chunk;
+    int first;
+    int count;
+    int custBase;
+    int vehiBase;
+    const generatorOptions *options;
+} generatorJob;
+
+/* rows generated by a work item (row-major, fixed columns per table). */
+typedef struct generatedChunk {
+    int table;
+    int columns;
+    QVector<QVariant> values;
+} generatedChunk;
+
+/* class which implements the synthetic data generator. rows are
+   generated in parallel (chunk by chunk) and written in order. */
+class DataGenerator : public QObject
+{
+    Q_OBJECT
+
+    public:
+        /* generated tables enumeration data type. */
+        typedef enum generatedTable {
+            Table_Customer = 0,
+            Table_Vehicle,
+            Table_Transact,
+            Table_Report
+        } generatedTable;
+
+        DataGenerator(const generatorOptions &options, QObject *parent = 0);
+        bool generate(QSqlDatabase db);
+
+        static generatedChunk generateChunk(const generatorJob &job);
+
+    signals:
+        void progress(const QString &table, const int rows);
+
+    private:
+        QList<generatorJob> createJobs(const int custBase, const int vehiBase) const;
+        QList<generatorJob> takeWave(QList<generatorJob> &jobs) const;
+        bool writeChunk(const generatedChunk &chunk);
+        bool commitBatch();
+        int maxId(const QString &table);
+
+        generatorOptions options;
+
+        QSqlDatabase db;
+        QList<QSqlQuery> inserts;
+
+        int pendingRows;
+        int writtenRows[Table_Report + 1];
+};
+
+#endif // DATAGENERATOR_H
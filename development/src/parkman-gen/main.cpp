@@ -0,0 +1,212 @@
+/*
+ *  This file implements the main startup of the synthetic data generator.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <QtSql>
+#include <cstdlib>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "datagenerator.h"
+#include "databasetools.h"
+#include "appsettings.h"
+
+/* console string messages. */
+static const QString usageStr = "usage: parkman-gen [options]\n"
+                                "  --db FILE           database file (default: database.db)\n"
+                                "  --seed N            random seed (default: 1)\n"
+                                "  --customers N       customers to generate (default: 1000)\n"
+                                "  --vehicles N        vehicles to generate (default: 1500)\n"
+                                "  --open N            open tickets to generate (default: 80)\n"
+                                "  --years N           years of report history (default: 1)\n"
+                                "  --days N            days of report history (instead of years)\n"
+                                "  --daily N           sessions per weekday in the history (default: 400)\n"
+                                "  --mix N,S,M,Y,C     weights of no/simple/month/year/credit cards (default: 50,25,10,5,10)\n"
+                                "  --guests P          share of the vehicles owned by the guest (default: 0.2)\n"
+                                "  --until DATETIME    the \"now\" of the data, yyyy-MM-ddThh:mm:ss (default: today 00:00)\n"
+                                "  --timeslice N       secs of the charge timeslice (default: settings default)\n"
+                                "  --charge N          charge per timeslice (default: settings default)\n"
+                                "  --tariff FILE       declarative tariff pricing the history (default: linear)\n"
+                                "  --threads N         worker threads (default: all cores)\n"
+                                "  --batch N           rows per DB transaction (default: 5000)\n";
+
+static const QString badOptionStr  = "parkman-gen: bad option or value '%1'.";
+static const QString dbOpenErrStr  = "parkman-gen: cannot open the database '%1'.";
+static const QString dbSchemaStr   = "parkman-gen: cannot create or upgrade the database schema.";
+static const QString genFailedStr  = "parkman-gen: generation failed: %1";
+static const QString tariffErrStr  = "parkman-gen: %1";
+static const QString progressStr   = "\r%1: %2 rows";
+static const QString finishedStr   = "\ngenerated in %1 secs.";
+
+/* class which prints the generator progress on the console. */
+class ProgressPrinter : public QObject
+{
+    Q_OBJECT
+
+    public:
+        ProgressPrinter() : out(stdout) {}
+
+    public slots:
+        void print(const QString &table, const int rows) {
+            /* a new line for every new table. */
+            if (table != lastTable && !lastTable.isEmpty()) out << "\n";
+            lastTable = table;
+
+            out << progressStr.arg(table).arg(rows);
+            out.flush();
+        }
+
+    private:
+        QTextStream out;
+        QString lastTable;
+};
+
+/* parse the command line options into the generator options. */
+static bool
+parseOptions(const QStringList &args, generatorOptions &options, QString &dbFileName) {
+    for (int i = 1; i < args.size(); i++) {
+        const QString option = args.at(i);
+
+        /* every option has a value. */
+        if (i + 1 >= args.size()) return false;
+        const QString value = args.at(++i);
+
+        bool ok = true;
+
+        if (option == "--db") dbFileName = value;
+        else if (option == "--seed") options.seed = value.toULongLong(&ok);
+        else if (option == "--customers") options.customers = value.toInt(&ok);
+        else if (option == "--vehicles") options.vehicles = value.toInt(&ok);
+        else if (option == "--open") options.openTickets = value.toInt(&ok);
+        else if (option == "--years") options.historyDays = 365 * value.toInt(&ok);
+        else if (option == "--days") options.historyDays = value.toInt(&ok);
+        else if (option == "--daily") options.dailySessions = value.toInt(&ok);
+        else if (option == "--guests") options.guestShare = value.toDouble(&ok);
+        else if (option == "--timeslice") options.sets.timeslice = value.toInt(&ok);
+        else if (option == "--charge") options.sets.chargePerTimeslice = value.toDouble(&ok);
+        else if (option == "--tariff") options.sets.tariffFile = value;
+        else if (option == "--threads") options.threads = value.toInt(&ok);
+        else if (option == "--batch") options.batchSize = value.toInt(&ok);
+        else if (option == "--until") {
+            options.until = QDateTime::fromString(value, Qt::ISODate);
+            ok = options.until.isValid();
+        }
+        else if (option == "--mix") {
+            const QStringList weights = value.split(',');
+            ok = weights.size() == CARD_TYPES_COUNT;
+
+            for (int w = 0; ok && w < CARD_TYPES_COUNT; w++)
+                options.cardMix[w] = weights.at(w).toDouble(&ok);
+        }
+        else return false;
+
+        if (!ok) return false;
+    }
+
+    /* check the ranges of the values. */
+    return options.customers >= 0 && options.vehicles >= 0 && options.openTickets >= 0
+        && options.historyDays >= 0 && options.dailySessions >= 0 && options.batchSize > 0
+        && options.guestShare >= 0 && options.guestShare <= 1
+        && options.sets.timeslice >= MIN_TIMESLICE && options.sets.timeslice <= MAX_TIMESLICE;
+}
+
+/* main function. */
+int
+main(int argc, char *argv[]) {
+    /* create the console application. */
+    QCoreApplication app(argc, argv);
+
+    QTextStream err(stderr);
+
+    /* the default generator options. */
+    generatorOptions options;
+    options.seed = 1;
+    options.customers = 1000;
+    options.vehicles = 1500;
+    options.openTickets = 80;
+    options.historyDays = 365;
+    options.dailySessions = 400;
+    options.threads = 0; /* all cores. */
+    options.batchSize = 5000;
+    options.guestShare = 0.2;
+    options.until = QDateTime(QDate::currentDate());
+
+    const double cardMix[CARD_TYPES_COUNT] = { 50, 25, 10, 5, 10 };
+    for (int i = 0; i < CARD_TYPES_COUNT; i++) options.cardMix[i] = cardMix[i];
+
+    options.sets.parkingCapacity = DEF_PARKING_CAPACITY;
+    options.sets.timeslice = DEF_TIMESLICE;
+    options.sets.chargePerTimeslice = DEF_CHARGE_PER_TIMESLICE;
+    options.sets.chargePrecision = DEF_CHARGE_PRECISION;
+
+    QString dbFileName = dbFileNameStr;
+
+    /* parse the command line. */
+    if (!parseOptions(app.arguments(), options, dbFileName)) {
+        err << usageStr;
+        return EXIT_FAILURE;
+    }
+
+    /* compile the tariff of the history. */
+    QString tariffError;
+    options.tariff = loadTariff(options.sets, &tariffError);
+
+    if (!tariffError.isEmpty()) {
+        err << tariffErrStr.arg(tariffError) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    /* connect to the DB with the following driver. */
+    QSqlDatabase db = QSqlDatabase::addDatabase(dbDriverStr);
+    db.setDatabaseName(dbFileName);
+
+    if (!db.open()) {
+        err << dbOpenErrStr.arg(dbFileName) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    /* if the DB is new create the schema as the application does (else upgrade it). */
+    if (hasDBSchema(db) ? !upgradeDBSchema(db) : !createDBSchema(db)) {
+        err << dbSchemaStr << "\n";
+        return EXIT_FAILURE;
+    }
+
+    /* create the generator and print its progress. */
+    DataGenerator generator(options);
+    ProgressPrinter printer;
+    QObject::connect(&generator, SIGNAL(progress(const QString &, const int)),
+                     &printer, SLOT(print(const QString &, const int)));
+
+    QTime timer;
+    timer.start();
+
+    /* generate the data. */
+    if (!generator.generate(db)) {
+        err << "\n" << genFailedStr.arg(db.lastError().text()) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    QTextStream(stdout) << finishedStr.arg(timer.elapsed() / 1000.0) << "\n";
+
+    return EXIT_SUCCESS;
+}
+
+/* the meta-object code of the progress printer. */
+#include "main.moc"
@@ -0,0 +1,24 @@
+# program's template as application.
+TEMPLATE = app
+
+# internal name of the tool.
+INTERNAL_NAME = parkman-gen
+
+# tool executable filename.
+TARGET = $${INTERNAL_NAME}
+
+# configuration options for the tool (console program).
+CONFIG += console
+CONFIG -= app_bundle
+
+# headers used in the tool.
+HEADERS = randomgenerator.h \
+            datagenerator.h
+
+# sources used in the tool.
+SOURCES = randomgenerator.cpp \
+            datagenerator.cpp \
+                     main.cpp
+
+# headless core of the application.
+include(../core.pri)
@@ -0,0 +1,120 @@
+/*
+ *  This file implements a reproducible random generator.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include ANSI C/C++ library headers. */
+#include <cmath>
+
+/* include header defining the interface of the source. */
+#include "randomgenerator.h"
+
+/* the pi constant (M_PI is not ANSI). */
+static const double PI = 3.14159265358979323846;
+
+/* create the generator from a seed (any seed, even zero, is valid). */
+RandomGenerator::RandomGenerator(const quint64 seed) {
+    state = mix(seed);
+
+    /* xorshift must never have an all zero state. */
+    if (!state) state = Q_UINT64_C(0x9E3779B97F4A7C15);
+}
+
+/* scramble a value (splitmix64 finalizer). */
+quint64
+RandomGenerator::mix(quint64 x) {
+    x += Q_UINT64_C(0x9E3779B97F4A7C15);
+    x = (x ^ (x >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+    return x ^ (x >> 31);
+}
+
+/* scramble two values into one (used to derive sub-seeds). */
+quint64
+RandomGenerator::mix(const quint64 a, const quint64 b) {
+    return mix(mix(a) ^ b);
+}
+
+/* return the next raw 64 bits value. */
+quint64
+RandomGenerator::next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * Q_UINT64_C(0x2545F4914F6CDD1D);
+}
+
+/* return a uniform value in [0, 1). */
+double
+RandomGenerator::uniform() {
+    /* use the upper 53 bits as the mantissa. */
+    return (next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* return a uniform integer in [0, n). */
+int
+RandomGenerator::uniformInt(const int n) {
+    if (n <= 0) return 0;
+
+    return (int) (uniform() * n);
+}
+
+/* return true with the probability p. */
+bool
+RandomGenerator::chance(const double p) {
+    return uniform() < p;
+}
+
+/* return a normal distributed value (box-muller). */
+double
+RandomGenerator::normal(const double mean, const double stddev) {
+    /* avoid the log of zero. */
+    const double u1 = 1.0 - uniform();
+    const double u2 = uniform();
+
+    return mean + stddev * sqrt(-2.0 * log(u1)) * cos(2.0 * PI * u2);
+}
+
+/* return a log-normal distributed value with the given median. */
+double
+RandomGenerator::logNormal(const double median, const double sigma) {
+    return median * exp(normal(0, sigma));
+}
+
+/* return a poisson distributed count. */
+int
+RandomGenerator::poisson(const double mean) {
+    if (mean <= 0) return 0;
+
+    /* for big means the normal approximation is good enough. */
+    if (mean > 30) {
+        const int k = qRound(normal(mean, sqrt(mean)));
+        return k < 0 ? 0 : k;
+    }
+
+    /* knuth's multiplication method. */
+    const double limit = exp(-mean);
+    double p = uniform();
+    int k = 0;
+
+    while (p > limit) {
+        p *= uniform();
+        k++;
+    }
+
+    return k;
+}
@@ -0,0 +1,30 @@
+/* header defining the interface of the source. */
+#ifndef RANDOMGENERATOR_H
+#define RANDOMGENERATOR_H
+
+/* include some QT libraries. */
+#include <QtGlobal>
+
+/* class which implements a small, seedable and reproducible random generator
+   (xorshift64* with splitmix64 seeding, the same sequence on every platform). */
+class RandomGenerator
+{
+    public:
+        RandomGenerator(const quint64 seed);
+
+        static quint64 mix(quint64 x);
+        static quint64 mix(const quint64 a, const quint64 b);
+
+        quint64 next();
+        double uniform();
+        int uniformInt(const int n);
+        bool chance(const double p);
+        double normal(const double mean, const double stddev);
+        double logNormal(const double median, const double sigma);
+        int poisson(const double mean);
+
+    private:
+        quint64 state;
+};
+
+#endif // RANDOMGENERATOR_H
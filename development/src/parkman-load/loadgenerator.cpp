@@ -0,0 +1,243 @@
+/*
+ *  This file implements the loopback load generator of the gate daemon.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+#include <QtNetwork>
+
+/* include header defining the interface of the source. */
+#include "loadgenerator.h"
+
+/* the steps every plate walks through (over and over). */
+static const int LOAD_STEPS_COUNT = 5;
+static const quint8 loadSteps[LOAD_STEPS_COUNT] = {
+    Request_Entry, Request_Quote, Request_Pay, Request_Entry, Request_Exit
+};
+
+/* create a lane device with its own plates (call start() to run it). */
+LoadConnection::LoadConnection(const loadOptions &options, const QStringList &plates, QObject *parent) : QObject(parent) {
+    this->options = options;
+    this->plates = plates;
+
+    /* every plate starts with an entry. */
+    steps.fill(0, plates.size());
+    for (int i = 0; i < plates.size(); i++) idle.enqueue(i);
+
+    device = 0;
+    lastId = 0;
+    sent = 0;
+    done = false;
+
+    stats.lostResponses = 0;
+    for (int i = 0; i <= Request_Pay; i++) stats.requests[i] = 0;
+}
+
+/* connect to the daemon. */
+void
+LoadConnection::start() {
+    if (!options.socketName.isEmpty()) {
+        QLocalSocket *socket = new QLocalSocket(this);
+
+        connect(socket, SIGNAL(connected()), this, SLOT(connected()));
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readResponses()));
+        connect(socket, SIGNAL(error(QLocalSocket::LocalSocketError)), this, SLOT(failed()));
+
+        device = socket;
+        socket->connectToServer(options.socketName);
+    }
+    else {
+        QTcpSocket *socket = new QTcpSocket(this);
+
+        connect(socket, SIGNAL(connected()), this, SLOT(connected()));
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readResponses()));
+        connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(failed()));
+
+        device = socket;
+        socket->connectToHost(options.host, options.port);
+    }
+}
+
+/* the statistics of the device (valid after it finishes). */
+const loadStatistics &
+LoadConnection::statistics() const {
+    return stats;
+}
+
+/* fill the pipeline as soon as the device is connected. */
+void
+LoadConnection::connected() {
+    /* the requests are small, send them at once. */
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(device);
+    if (socket) socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+    clock.start();
+
+    for (int i = 0; i < options.depth; i++) sendNext();
+
+    /* nothing to send at all. */
+    if (inFlight.isEmpty()) finish();
+}
+
+/* send the next step of an idle plate (if any and if more requests are due). */
+void
+LoadConnection::sendNext() {
+    if (sent >= options.requests || idle.isEmpty()) return;
+
+    const int plate = idle.dequeue();
+
+    gateRequest request;
+    request.type = loadSteps[steps.at(plate)];
+    request.id = ++lastId;
+    request.when = 0; /* the daemon's now. */
+    request.amount = request.type == Request_Pay ? options.payment : 0;
+    request.plate = plates.at(plate);
+    request.site = 0; /* the default site of the daemon. */
+
+    sentRequest item;
+    item.plate = plate;
+    item.sent = clock.nsecsElapsed();
+
+    inFlight.insert(request.id, item);
+
+    device->write(encodeRequest(request));
+
+    stats.requests[request.type]++;
+    sent++;
+}
+
+/* read the responses and keep the pipeline full. */
+void
+LoadConnection::readResponses() {
+    buffer.append(device->readAll());
+
+    int offset = 0;
+    QByteArray frame;
+
+    while (takeFrame(buffer, offset, frame)) {
+        gateResponse response;
+
+        if (!decodeResponse(frame, response) || !inFlight.contains(response.id)) {
+            stats.results[GATE_BAD_REQUEST]++;
+            continue;
+        }
+
+        const sentRequest item = inFlight.take(response.id);
+
+        stats.latencies << (clock.nsecsElapsed() - item.sent) / 1000;
+        stats.results[response.result]++;
+
+        /* the plate goes on with its next step. */
+        steps[item.plate] = (steps.at(item.plate) + 1) % LOAD_STEPS_COUNT;
+        idle.enqueue(item.plate);
+
+        sendNext();
+    }
+
+    buffer.remove(0, offset);
+
+    if (sent >= options.requests && inFlight.isEmpty()) finish();
+}
+
+/* the device failed (the requests in flight are lost). */
+void
+LoadConnection::failed() {
+    stats.lostResponses += inFlight.size();
+    inFlight.clear();
+
+    /* what was never sent is not lost, it was never due. */
+    finish();
+}
+
+/* the device has finished. */
+void
+LoadConnection::finish() {
+    if (done) return;
+    done = true;
+
+    device->close();
+    emit finished();
+}
+
+/* create the lane devices, the plates split between them. */
+LoadGenerator::LoadGenerator(const loadOptions &options, const QStringList &plates, QObject *parent) : QObject(parent) {
+    const int count = qMax(options.connections, 1);
+
+    for (int i = 0; i < count; i++) {
+        QStringList own;
+
+        for (int p = i; p < plates.size(); p += count) own << plates.at(p);
+
+        LoadConnection *connection = new LoadConnection(options, own, this);
+        connect(connection, SIGNAL(finished()), this, SLOT(connectionFinished()));
+
+        connections << connection;
+    }
+
+    elapsed = 0;
+    running = 0;
+}
+
+/* start all the devices together. */
+void
+LoadGenerator::start() {
+    running = connections.size();
+    wall.start();
+
+    foreach (LoadConnection *connection, connections) connection->start();
+}
+
+/* merge the statistics of the devices. */
+loadStatistics
+LoadGenerator::statistics() const {
+    loadStatistics total;
+    total.lostResponses = 0;
+    for (int i = 0; i <= Request_Pay; i++) total.requests[i] = 0;
+
+    foreach (LoadConnection *connection, connections) {
+        const loadStatistics &stats = connection->statistics();
+
+        total.latencies += stats.latencies;
+        total.lostResponses += stats.lostResponses;
+
+        for (int i = 0; i <= Request_Pay; i++) total.requests[i] += stats.requests[i];
+
+        QMapIterator<int, qint64> i(stats.results);
+        while (i.hasNext()) {
+            i.next();
+            total.results[i.key()] += i.value();
+        }
+    }
+
+    return total;
+}
+
+/* the wall time of the run. */
+qint64
+LoadGenerator::wallMsecs() const {
+    return elapsed;
+}
+
+/* a device has finished, the run finishes with the last one. */
+void
+LoadGenerator::connectionFinished() {
+    if (--running > 0) return;
+
+    elapsed = qMax(wall.elapsed(), (qint64) 1);
+    emit finished();
+}
@@ -0,0 +1,113 @@
+/* header defining the interface of the source. */
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+/* include some QT libraries. */
+#include <QObject>
+#include <QStringList>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QQueue>
+#include <QHash>
+#include <QMap>
+#include <QVector>
+
+/* include headers defining the interface of the sources. */
+#include "gateprotocol.h"
+
+/* use these classes. */
+class QIODevice;
+
+/* load options structure data type. */
+typedef struct loadOptions {
+    QString host;
+    quint16 port;
+    QString socketName;        /* a local socket instead of TCP (if not empty). */
+    int connections;           /* concurrent lane devices. */
+    int depth;                 /* pipelined requests per device. */
+    int requests;              /* requests per device. */
+    double payment;            /* the amount a pay station pays. */
+} loadOptions;
+
+/* load statistics structure data type. */
+typedef struct loadStatistics {
+    QVector<qint64> latencies;          /* round trip of every request (usecs). */
+    QMap<int, qint64> results;          /* responses per result. */
+    qint64 requests[Request_Pay + 1];   /* requests per type. */
+    qint64 lostResponses;               /* responses not arrived (device failed). */
+} loadStatistics;
+
+/* class which implements a simulated lane device. it walks its own plates
+   through entry, quote, pay, entry, exit with pipelined requests. */
+class LoadConnection : public QObject
+{
+    Q_OBJECT
+
+    public:
+        LoadConnection(const loadOptions &options, const QStringList &plates, QObject *parent = 0);
+
+        void start();
+        const loadStatistics &statistics() const;
+
+    signals:
+        void finished();
+
+    private slots:
+        void connected();
+        void readResponses();
+        void failed();
+
+    private:
+        /* request in flight structure data type. */
+        typedef struct sentRequest {
+            int plate;
+            qint64 sent;       /* nsecs of the connection's clock. */
+        } sentRequest;
+
+        void sendNext();
+        void finish();
+
+        loadOptions options;
+        QStringList plates;
+        QVector<int> steps;    /* the next step of every plate. */
+        QQueue<int> idle;      /* the plates without a request in flight. */
+
+        QIODevice *device;
+        QByteArray buffer;
+        QHash<quint32, sentRequest> inFlight;
+        QElapsedTimer clock;
+
+        quint32 lastId;
+        int sent;
+        bool done;
+
+        loadStatistics stats;
+};
+
+/* class which implements the load generator: many lane devices
+   on the loopback, all in one event-driven thread. */
+class LoadGenerator : public QObject
+{
+    Q_OBJECT
+
+    public:
+        LoadGenerator(const loadOptions &options, const QStringList &plates, QObject *parent = 0);
+
+        void start();
+        loadStatistics statistics() const;
+        qint64 wallMsecs() const;
+
+    signals:
+        void finished();
+
+    private slots:
+        void connectionFinished();
+
+    private:
+        QList<LoadConnection *> connections;
+        QElapsedTimer wall;
+        qint64 elapsed;
+        int running;
+};
+
+#endif // LOADGENERATOR_H
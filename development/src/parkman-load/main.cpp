@@ -0,0 +1,174 @@
+/*
+ *  This file implements the main startup of the gate daemon load generator.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <QtSql>
+#include <cstdlib>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "loadgenerator.h"
+#include "gateprotocol.h"
+#include "parkingengine.h"
+#include "databasetools.h"
+#include "arithmetictools.h"
+
+/* console string messages. */
+static const QString usageStr = "usage: parkman-load [options]\n"
+                                "  --db FILE          database file of the plates (default: database.db)\n"
+                                "  --plates N         plates to use, 0 for all (default: 0)\n"
+                                "  --host ADDRESS     TCP address of the daemon (default: 127.0.0.1)\n"
+                                "  --port N           TCP port of the daemon (default: 7411)\n"
+                                "  --socket NAME      local socket of the daemon (instead of TCP)\n"
+                                "  --connections N    concurrent lane devices (default: 100)\n"
+                                "  --depth N          pipelined requests per device (default: 4)\n"
+                                "  --requests N       requests per device (default: 1000)\n"
+                                "  --pay AMOUNT       amount paid at the pay station (default: 1000000)\n";
+
+static const QString loadFailedStr = "parkman-load: %1";
+
+/* the request type names. */
+static const char *requestNames[Request_Pay + 1] = { "", "entry", "exit", "quote", "pay" };
+
+/* read the plates of the registered vehicles. */
+static bool
+readPlates(const QString &dbFileName, const int count, QStringList &plates) {
+    const QString connectionName = "parkman-load";
+    bool ok = false;
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(dbDriverStr, connectionName);
+        db.setDatabaseName(dbFileName);
+
+        if (db.open()) {
+            QSqlQuery query(db);
+
+            ok = query.exec(QString("SELECT reg_num FROM vehicle ORDER BY id LIMIT %1").arg(count > 0 ? count : -1));
+
+            while (ok && query.next()) plates << query.value(0).toString();
+        }
+    }
+
+    QSqlDatabase::removeDatabase(connectionName);
+
+    return ok;
+}
+
+/* main function. */
+int
+main(int argc, char *argv[]) {
+    /* create the console application. */
+    QCoreApplication app(argc, argv);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    /* the default load options. */
+    loadOptions options;
+    options.host = "127.0.0.1";
+    options.port = DEF_GATE_PORT;
+    options.connections = 100;
+    options.depth = 4;
+    options.requests = 1000;
+    options.payment = 1000000;
+
+    QString dbFileName = dbFileNameStr;
+    int plateCount = 0;
+
+    /* parse the command line. */
+    const QStringList args = app.arguments();
+    bool ok = true;
+
+    for (int i = 1; ok && i < args.size(); i++) {
+        const QString option = args.at(i);
+
+        /* every option has a value. */
+        if (i + 1 >= args.size()) { ok = false; break; }
+        const QString value = args.at(++i);
+
+        if (option == "--db") dbFileName = value;
+        else if (option == "--plates") plateCount = value.toInt(&ok);
+        else if (option == "--host") options.host = value;
+        else if (option == "--port") options.port = value.toUShort(&ok);
+        else if (option == "--socket") options.socketName = value;
+        else if (option == "--connections") options.connections = value.toInt(&ok);
+        else if (option == "--depth") options.depth = value.toInt(&ok);
+        else if (option == "--requests") options.requests = value.toInt(&ok);
+        else if (option == "--pay") options.payment = value.toDouble(&ok);
+        else ok = false;
+    }
+
+    ok = ok && plateCount >= 0 && options.connections > 0 && options.depth > 0 && options.requests >= 0;
+
+    if (!ok) {
+        err << usageStr;
+        return EXIT_FAILURE;
+    }
+
+    /* the lane devices use the plates of the registered vehicles. */
+    QStringList plates;
+
+    if (!readPlates(dbFileName, plateCount, plates) || plates.isEmpty()) {
+        err << loadFailedStr.arg(QString("no vehicles in the database '%1'.").arg(dbFileName)) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    /* run the devices until they all finish. */
+    LoadGenerator generator(options, plates);
+    QObject::connect(&generator, SIGNAL(finished()), &app, SLOT(quit()));
+
+    generator.start();
+    app.exec();
+
+    /* print the report. */
+    loadStatistics stats = generator.statistics();
+    qSort(stats.latencies);
+
+    const qint64 wallMsecs = generator.wallMsecs();
+
+    out << "devices       : " << options.connections << " x " << options.depth << " pipelined ("
+        << (options.socketName.isEmpty() ? QString("%1:%2").arg(options.host).arg(options.port) : options.socketName) << ")\n";
+    out << "requests      :";
+
+    for (int i = Request_Entry; i <= Request_Pay; i++)
+        out << " " << stats.requests[i] << " " << requestNames[i];
+
+    out << "\n";
+    out << "responses     : " << stats.latencies.size() << " (" << stats.lostResponses << " lost)\n";
+    out << "wall time     : " << wallMsecs / 1000.0 << " secs\n";
+    out << "throughput    : " << QString::number(stats.latencies.size() * 1000.0 / wallMsecs, 'f', 1) << " requests/sec\n";
+    out << "latency p50   : " << percentile(stats.latencies, 0.50) << " usecs\n";
+    out << "latency p99   : " << percentile(stats.latencies, 0.99) << " usecs\n";
+    out << "latency max   : " << (stats.latencies.isEmpty() ? 0 : stats.latencies.last()) << " usecs\n";
+    out << "results       :\n";
+
+    QMapIterator<int, qint64> i(stats.results);
+
+    while (i.hasNext()) {
+        i.next();
+
+        const QString name = i.key() == GATE_BAD_REQUEST ? QString("bad-request")
+                                                         : ParkingEngine::resultName((ParkingEngine::gateResult) i.key());
+
+        out << "  " << name.leftJustified(20) << i.value() << "\n";
+    }
+
+    return stats.lostResponses ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,25 @@
+# program's template as application.
+TEMPLATE = app
+
+# internal name of the tool.
+INTERNAL_NAME = parkman-load
+
+# tool executable filename.
+TARGET = $${INTERNAL_NAME}
+
+# configuration options for the tool (console program).
+CONFIG += console
+CONFIG -= app_bundle
+
+# qt network support for the lane devices.
+QT += network
+
+# headers used in the tool.
+HEADERS = loadgenerator.h
+
+# sources used in the tool.
+SOURCES = loadgenerator.cpp \
+                 main.cpp
+
+# headless core of the application.
+include(../core.pri)
@@ -0,0 +1,155 @@
+/*
+ *  This file implements the gate event log of the simulator.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+#include <QtSql>
+
+/* include header defining the interface of the source. */
+#include "eventlog.h"
+
+/* names of the event types in the log. */
+static const QString entryEventStr = "entry";
+static const QString exitEventStr  = "exit";
+
+/* order the events by time. */
+static bool
+eventLessThan(const gateEvent &a, const gateEvent &b) {
+    return a.when < b.when;
+}
+
+/* load an event log (sorted by time). */
+bool
+loadEventLog(const QString &fileName, QList<gateEvent> &events, QString &error) {
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        error = file.errorString();
+        return false;
+    }
+
+    QTextStream in(&file);
+
+    for (int line = 1; !in.atEnd(); line++) {
+        const QString text = in.readLine().trimmed();
+
+        /* skip empty lines and comments. */
+        if (text.isEmpty() || text.startsWith('#')) continue;
+
+        const QStringList fields = text.split(',');
+
+        gateEvent event;
+        bool ok = fields.size() == 4;
+
+        if (ok) {
+            event.when = QDateTime::fromString(fields.at(0).trimmed(), eventTimeFormatStr);
+
+            /* also accept timestamps without milliseconds. */
+            if (!event.when.isValid())
+                event.when = QDateTime::fromString(fields.at(0).trimmed(), Qt::ISODate);
+
+            event.gate = fields.at(1).trimmed().toInt(&ok);
+            event.plate = fields.at(3).trimmed();
+
+            const QString type = fields.at(2).trimmed().toLower();
+
+            if (type == entryEventStr) event.type = Event_Entry;
+            else if (type == exitEventStr) event.type = Event_Exit;
+            else ok = false;
+
+            ok = ok && event.when.isValid() && !event.plate.isEmpty();
+        }
+
+        if (!ok) {
+            error = QString("%1:%2: bad event '%3'").arg(fileName).arg(line).arg(text);
+            return false;
+        }
+
+        events << event;
+    }
+
+    /* replay in time order (events of the same time keep their order). */
+    qStableSort(events.begin(), events.end(), eventLessThan);
+
+    return true;
+}
+
+/* save an event log. */
+bool
+saveEventLog(const QString &fileName, const QList<gateEvent> &events) {
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        return false;
+
+    QTextStream out(&file);
+
+    out << "# timestamp,gate,entry|exit,plate\n";
+
+    foreach (const gateEvent &event, events) {
+        out << event.when.toString(eventTimeFormatStr) << ","
+            << event.gate << ","
+            << (event.type == Event_Entry ? entryEventStr : exitEventStr) << ","
+            << event.plate << "\n";
+    }
+
+    out.flush();
+
+    return file.error() == QFile::NoError;
+}
+
+/* build an event log from the sessions of the report between two dates. */
+QList<gateEvent>
+eventsFromReport(QSqlDatabase db, const QDate from, const QDate to, const int gates) {
+    QList<gateEvent> events;
+
+    /* declare a forward only sql query object (the history can be big). */
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    /* prepare a sql query with place holders. */
+    query.prepare("SELECT vehicle, start_date, start_time, end_date, end_time FROM report WHERE start_date BETWEEN :from AND :to");
+    query.bindValue(":from", from);
+    query.bindValue(":to", to);
+    query.exec();
+
+    while (query.next()) {
+        const QString plate = query.value(0).toString();
+
+        /* a vehicle uses the same entry gate, and the next gate to exit. */
+        const int gate = (int) (qHash(plate) % (uint) qMax(gates, 1));
+
+        gateEvent entry;
+        entry.when = QDateTime(query.value(1).toDate(), query.value(2).toTime());
+        entry.gate = gate;
+        entry.type = Event_Entry;
+        entry.plate = plate;
+
+        gateEvent leave = entry;
+        leave.when = QDateTime(query.value(3).toDate(), query.value(4).toTime());
+        leave.gate = (gate + 1) % qMax(gates, 1);
+        leave.type = Event_Exit;
+
+        events << entry << leave;
+    }
+
+    qStableSort(events.begin(), events.end(), eventLessThan);
+
+    return events;
+}
@@ -0,0 +1,38 @@
+/* header defining the interface of the source. */
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+/* include some QT libraries. */
+#include <QDateTime>
+#include <QSqlDatabase>
+#include <QString>
+#include <QList>
+
+/* gate event types enumeration data type. */
+typedef enum gateEventType {
+    Event_Entry = 0,
+    Event_Exit
+} gateEventType;
+
+/* gate event structure data type (one line of the event log). */
+typedef struct gateEvent {
+    QDateTime when;
+    int gate;
+    int type;
+    QString plate;
+} gateEvent;
+
+/* format of the event log timestamps. */
+static const QString eventTimeFormatStr = "yyyy-MM-ddThh:mm:ss.zzz";
+
+/* load an event log (sorted by time). the format is one event per line:
+   "timestamp,gate,entry|exit,plate", lines starting with '#' are ignored. */
+bool loadEventLog(const QString &fileName, QList<gateEvent> &events, QString &error);
+
+/* save an event log. */
+bool saveEventLog(const QString &fileName, const QList<gateEvent> &events);
+
+/* build an event log from the sessions of the report between two dates. */
+QList<gateEvent> eventsFromReport(QSqlDatabase db, const QDate from, const QDate to, const int gates);
+
+#endif // EVENTLOG_H
@@ -0,0 +1,294 @@
+/*
+ *  This file implements the gate traffic replay simulator.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <QtSql>
+#include <cstring>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "gatesimulator.h"
+#include "databasetools.h"
+#include "arithmetictools.h"
+
+/* name of the simulator's own connection. */
+static const QString simConnectionStr = "parkman-sim";
+
+/* clear the counters of the statistics. */
+static void
+clearStatistics(gateStatistics &stats) {
+    stats.latencies.clear();
+    stats.maxLag = 0;
+
+    for (int i = 0; i <= ParkingEngine::Gate_DBError; i++) stats.results[i] = 0;
+    for (int i = 0; i <= Event_Exit; i++) stats.events[i] = 0;
+}
+
+/* create a clock which starts at the origin of the event log. */
+SimulatedClock::SimulatedClock(const QDateTime &origin, const double speed) {
+    this->origin = origin;
+    this->speed = speed;
+}
+
+/* start the clock (the origin is now). */
+void
+SimulatedClock::start() {
+    wall.start();
+}
+
+/* the current simulated time. */
+QDateTime
+SimulatedClock::now() const {
+    /* as fast as possible has no simulated time. */
+    if (speed <= 0) return origin;
+
+    return origin.addMSecs((qint64) (wall.elapsed() * speed));
+}
+
+/* wall msecs until the simulated time (negative when already late). */
+qint64
+SimulatedClock::msecsUntil(const QDateTime &when) const {
+    /* as fast as possible never waits. */
+    if (speed <= 0) return 0;
+
+    return (qint64) (origin.msecsTo(when) / speed) - wall.elapsed();
+}
+
+/* create a gate with its events. */
+GateWorker::GateWorker(const int gate, const QList<gateEvent> &events,
+                       const QHash<QString, int> &vehicles,
+                       const simulatorOptions &options,
+                       const SimulatedClock *clock,
+                       DBWriter *writer,
+                       QObject *parent) : QThread(parent) {
+    this->gate = gate;
+    this->events = events;
+    this->vehicles = vehicles;
+    this->options = options;
+    this->clock = clock;
+    this->writer = writer;
+
+    clearStatistics(stats);
+}
+
+/* the statistics of the gate (valid after the thread finishes). */
+const gateStatistics &
+GateWorker::statistics() const {
+    return stats;
+}
+
+/* replay the events of the gate. */
+void
+GateWorker::run() {
+    /* a connection may only be used by the thread which created it. */
+    const QString connectionName = QString("%1-gate-%2").arg(simConnectionStr).arg(gate);
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(dbDriverStr, connectionName);
+        db.setDatabaseName(options.dbFileName);
+
+        /* wait for the other gates instead of failing with a locked DB. */
+        db.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(options.busyTimeout));
+
+        const bool opened = db.open();
+
+        /* the gates read while the others write. */
+        if (opened) applyConnectionPragmas(db);
+
+        ParkingEngine engine(options.sets, db);
+        QElapsedTimer timer;
+
+        foreach (const gateEvent &event, events) {
+            /* wait for the time of the event (or remember how late it is). */
+            const qint64 wait = clock->msecsUntil(event.when);
+
+            if (wait > 0) msleep((unsigned long) wait);
+            else stats.maxLag = qMax(stats.maxLag, -wait);
+
+            /* find the vehicle of the plate. */
+            const int vehiId = vehicles.value(event.plate, -1);
+
+            timer.start();
+
+            ParkingEngine::gateResult result = ParkingEngine::Gate_DBError;
+
+            if (vehiId < 0) {
+                result = ParkingEngine::Gate_UnknownVehicle;
+            }
+            else if (writer) {
+                /* the writer commits the command with the other gates' ones. */
+                writeCommand command = createWriteCommand(event.type == Event_Entry ? Write_Entry : Write_Exit);
+                command.vehiId = vehiId;
+                command.when = event.when;
+
+                result = writer->execute(command);
+            }
+            else if (opened) {
+                if (event.type == Event_Entry)
+                    result = engine.enterVehicle(vehiId, event.when);
+                else
+                    result = engine.exitVehicle(vehiId, event.when);
+            }
+
+            /* keep the statistics of the event. */
+            stats.latencies << timer.nsecsElapsed() / 1000;
+            stats.results[result]++;
+            stats.events[event.type]++;
+        }
+    }
+
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+/* load the vehicles (plate to id) and register the unknown ones. */
+static bool
+loadVehicles(QSqlDatabase db, const QList<gateEvent> &events, const bool registerUnknown,
+             QHash<QString, int> &vehicles) {
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    if (!query.exec("SELECT id, reg_num FROM vehicle")) return false;
+
+    while (query.next())
+        vehicles.insert(query.value(1).toString(), query.value(0).toInt());
+
+    if (!registerUnknown) return true;
+
+    /* unknown plates become vehicles of the simple guest. */
+    if (!db.transaction()) return false;
+
+    query.prepare("INSERT INTO vehicle (reg_num, desc, cust_id) VALUES (:plate, 'Simulated Guest', 1)");
+
+    foreach (const gateEvent &event, events) {
+        if (vehicles.contains(event.plate)) continue;
+
+        query.bindValue(":plate", event.plate);
+
+        if (!query.exec()) {
+            db.rollback();
+            return false;
+        }
+
+        vehicles.insert(event.plate, query.lastInsertId().toInt());
+    }
+
+    return db.commit();
+}
+
+/* replay the events with concurrent gates and return the report. */
+bool
+runSimulation(const simulatorOptions &options, const QList<gateEvent> &events,
+              simulationReport &report, QString &error) {
+    clearStatistics(report.total);
+    report.wallMsecs = 0;
+    report.throughput = 0;
+    report.p50 = report.p99 = report.maxLatency = 0;
+    memset(&report.commits, 0, sizeof(report.commits));
+
+    if (events.isEmpty()) return true;
+
+    QHash<QString, int> vehicles;
+
+    {
+        /* the simulator's connection for the preparation. */
+        QSqlDatabase db = QSqlDatabase::addDatabase(dbDriverStr, simConnectionStr);
+        db.setDatabaseName(options.dbFileName);
+
+        if (!db.open())
+            error = db.lastError().text();
+        else if (!hasDBSchema(db))
+            error = "the database has no schema";
+        else if (!upgradeDBSchema(db))
+            error = "the database cannot be upgraded";
+        else if (!loadVehicles(db, events, options.registerUnknown, vehicles))
+            error = "cannot load the vehicles: " + db.lastError().text();
+    }
+
+    QSqlDatabase::removeDatabase(simConnectionStr);
+
+    if (!error.isEmpty()) return false;
+
+    /* split the events to the gates. */
+    const int gates = qMax(options.gates, 1);
+    QVector<QList<gateEvent> > gateEvents(gates);
+
+    foreach (const gateEvent &event, events)
+        gateEvents[qAbs(event.gate) % gates] << event;
+
+    /* the clock starts at the first event. */
+    SimulatedClock clock(events.first().when, options.speed);
+
+    /* the single DB writer of the gates (if any). */
+    DBWriter *writer = 0;
+
+    if (options.useWriter) {
+        writer = new DBWriter(options.sets, options.dbFileName);
+        writer->setCommitWindow(options.commitWindow);
+        writer->start();
+    }
+
+    /* create the gates. */
+    QList<GateWorker *> workers;
+
+    for (int gate = 0; gate < gates; gate++)
+        workers << new GateWorker(gate, gateEvents.at(gate), vehicles, options, &clock, writer);
+
+    /* start the clock and all the gates together. */
+    QElapsedTimer wall;
+    clock.start();
+    wall.start();
+
+    foreach (GateWorker *worker, workers) worker->start();
+    foreach (GateWorker *worker, workers) worker->wait();
+
+    report.wallMsecs = qMax(wall.elapsed(), (qint64) 1);
+
+    /* stop the writer (every command is already committed). */
+    if (writer) {
+        writer->stop();
+        writer->wait();
+
+        report.commits = writer->statistics();
+        delete writer;
+    }
+
+    /* merge the statistics of the gates. */
+    foreach (GateWorker *worker, workers) {
+        const gateStatistics &stats = worker->statistics();
+
+        report.total.latencies += stats.latencies;
+        report.total.maxLag = qMax(report.total.maxLag, stats.maxLag);
+
+        for (int i = 0; i <= ParkingEngine::Gate_DBError; i++) report.total.results[i] += stats.results[i];
+        for (int i = 0; i <= Event_Exit; i++) report.total.events[i] += stats.events[i];
+
+        delete worker;
+    }
+
+    /* the throughput and the latency percentiles. */
+    qSort(report.total.latencies);
+
+    report.throughput = events.size() * 1000.0 / report.wallMsecs;
+    report.p50 = percentile(report.total.latencies, 0.50);
+    report.p99 = percentile(report.total.latencies, 0.99);
+    report.maxLatency = report.total.latencies.last();
+
+    return true;
+}
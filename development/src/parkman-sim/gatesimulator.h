@@ -0,0 +1,99 @@
+/* header defining the interface of the source. */
+#ifndef GATESIMULATOR_H
+#define GATESIMULATOR_H
+
+/* include some QT libraries. */
+#include <QThread>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
+
+/* include headers defining the interface of the sources. */
+#include "eventlog.h"
+#include "parkingengine.h"
+#include "dbwriter.h"
+#include "appsettings.h"
+
+/* simulator options structure data type. */
+typedef struct simulatorOptions {
+    QString dbFileName;
+    int gates;                 /* concurrent gate threads. */
+    double speed;              /* replay speed (0 = as fast as possible). */
+    bool registerUnknown;      /* register unknown plates as guest vehicles. */
+    bool useWriter;            /* the gates submit to the single DB writer. */
+    int commitWindow;          /* msecs of the writer's group commit window. */
+    int busyTimeout;           /* msecs a gate waits for a locked DB. */
+    appSettings sets;
+} simulatorOptions;
+
+/* gate statistics structure data type. */
+typedef struct gateStatistics {
+    QVector<qint64> latencies;                  /* service time of every event (usecs). */
+    qint64 maxLag;                              /* worst delay behind the schedule (msecs). */
+    int results[ParkingEngine::Gate_DBError + 1];
+    int events[Event_Exit + 1];
+} gateStatistics;
+
+/* simulation report structure data type. */
+typedef struct simulationReport {
+    gateStatistics total;
+    qint64 wallMsecs;
+    double throughput;         /* events per wall second. */
+    qint64 p50;                /* latency percentiles (usecs). */
+    qint64 p99;
+    qint64 maxLatency;
+    groupCommitStatistics commits;  /* of the single DB writer (if any). */
+} simulationReport;
+
+/* class which implements a simulated clock: the time of the event log
+   is mapped to the wall time, faster or slower by the replay speed. */
+class SimulatedClock
+{
+    public:
+        SimulatedClock(const QDateTime &origin, const double speed);
+        void start();
+        QDateTime now() const;
+        qint64 msecsUntil(const QDateTime &when) const;
+
+    private:
+        QDateTime origin;
+        double speed;
+        QElapsedTimer wall;
+};
+
+/* class which implements a gate (thread) replaying its events against
+   the database with its own connection and engine, or through the
+   single DB writer when there is one. */
+class GateWorker : public QThread
+{
+    Q_OBJECT
+
+    public:
+        GateWorker(const int gate, const QList<gateEvent> &events,
+                   const QHash<QString, int> &vehicles,
+                   const simulatorOptions &options,
+                   const SimulatedClock *clock,
+                   DBWriter *writer,
+                   QObject *parent = 0);
+
+        const gateStatistics &statistics() const;
+
+    protected:
+        void run();
+
+    private:
+        int gate;
+        QList<gateEvent> events;
+        QHash<QString, int> vehicles;
+        simulatorOptions options;
+        const SimulatedClock *clock;
+        DBWriter *writer;
+        gateStatistics stats;
+};
+
+/* replay the events with concurrent gates and return the report. */
+bool runSimulation(const simulatorOptions &options, const QList<gateEvent> &events,
+                   simulationReport &report, QString &error);
+
+#endif // GATESIMULATOR_H
@@ -0,0 +1,212 @@
+/*
+ *  This file implements the main startup of the gate traffic simulator.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <QtSql>
+#include <cstdlib>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "gatesimulator.h"
+#include "eventlog.h"
+#include "databasetools.h"
+#include "appsettings.h"
+
+/* console string messages. */
+static const QString usageStr = "usage: parkman-sim --log FILE [options]\n"
+                                "       parkman-sim --export-log FILE --from DATE --to DATE [--db FILE] [--gates N]\n"
+                                "  --db FILE            database file (default: database.db)\n"
+                                "  --log FILE           event log to replay (timestamp,gate,entry|exit,plate)\n"
+                                "  --gates N            concurrent gate threads (default: 4)\n"
+                                "  --speed X            replay speed, 0 is as fast as possible (default: 0)\n"
+                                "  --capacity N         parking capacity (default: settings default)\n"
+                                "  --timeslice N        secs of the charge timeslice (default: settings default)\n"
+                                "  --charge N           charge per timeslice (default: settings default)\n"
+                                "  --tariff FILE        declarative tariff (default: linear)\n"
+                                "  --busy-timeout MSECS wait of a gate for a locked database (default: 5000)\n"
+                                "  --register-unknown   register unknown plates as guest vehicles\n"
+                                "  --writer             gates submit to a single DB writer thread\n"
+                                "  --window MSECS       group commit window of the writer (default: 5)\n"
+                                "  --export-log FILE    build an event log from the report sessions and exit\n"
+                                "  --from, --to DATE    sessions (start date, yyyy-MM-dd) of the exported log\n";
+
+static const QString simFailedStr = "parkman-sim: %1";
+
+/* main function. */
+int
+main(int argc, char *argv[]) {
+    /* create the console application. */
+    QCoreApplication app(argc, argv);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    /* the default simulator options. */
+    simulatorOptions options;
+    options.dbFileName = dbFileNameStr;
+    options.gates = 4;
+    options.speed = 0;
+    options.registerUnknown = false;
+    options.useWriter = false;
+    options.commitWindow = DEF_COMMIT_WINDOW;
+    options.busyTimeout = 5000;
+    options.sets.parkingCapacity = DEF_PARKING_CAPACITY;
+    options.sets.timeslice = DEF_TIMESLICE;
+    options.sets.chargePerTimeslice = DEF_CHARGE_PER_TIMESLICE;
+    options.sets.chargePrecision = DEF_CHARGE_PRECISION;
+
+    QString logFileName, exportFileName;
+    QDate from, to;
+
+    /* parse the command line. */
+    const QStringList args = app.arguments();
+    bool ok = true;
+
+    for (int i = 1; ok && i < args.size(); i++) {
+        const QString option = args.at(i);
+
+        /* the options without a value. */
+        if (option == "--register-unknown") {
+            options.registerUnknown = true;
+            continue;
+        }
+
+        if (option == "--writer") {
+            options.useWriter = true;
+            continue;
+        }
+
+        if (i + 1 >= args.size()) { ok = false; break; }
+        const QString value = args.at(++i);
+
+        if (option == "--db") options.dbFileName = value;
+        else if (option == "--log") logFileName = value;
+        else if (option == "--export-log") exportFileName = value;
+        else if (option == "--from") from = QDate::fromString(value, Qt::ISODate);
+        else if (option == "--to") to = QDate::fromString(value, Qt::ISODate);
+        else if (option == "--gates") options.gates = value.toInt(&ok);
+        else if (option == "--speed") options.speed = value.toDouble(&ok);
+        else if (option == "--capacity") options.sets.parkingCapacity = value.toInt(&ok);
+        else if (option == "--timeslice") options.sets.timeslice = value.toInt(&ok);
+        else if (option == "--charge") options.sets.chargePerTimeslice = value.toDouble(&ok);
+        else if (option == "--tariff") options.sets.tariffFile = value;
+        else if (option == "--busy-timeout") options.busyTimeout = value.toInt(&ok);
+        else if (option == "--window") options.commitWindow = value.toInt(&ok);
+        else ok = false;
+    }
+
+    /* export mode or replay mode. */
+    ok = ok && options.gates > 0 && options.sets.timeslice >= MIN_TIMESLICE
+            && options.commitWindow >= MIN_COMMIT_WINDOW && options.commitWindow <= MAX_COMMIT_WINDOW
+            && (exportFileName.isEmpty() ? !logFileName.isEmpty() : (from.isValid() && to.isValid()));
+
+    if (!ok) {
+        err << usageStr;
+        return EXIT_FAILURE;
+    }
+
+    /* build an event log from the report and exit. */
+    if (!exportFileName.isEmpty()) {
+        bool saved = false;
+
+        {
+            QSqlDatabase db = QSqlDatabase::addDatabase(dbDriverStr);
+            db.setDatabaseName(options.dbFileName);
+
+            saved = db.open() && saveEventLog(exportFileName, eventsFromReport(db, from, to, options.gates));
+        }
+
+        if (!saved) {
+            err << simFailedStr.arg("cannot export the event log.") << "\n";
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    /* load the event log. */
+    QList<gateEvent> events;
+    QString error;
+
+    if (!loadEventLog(logFileName, events, error)) {
+        err << simFailedStr.arg(error) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    /* replay the events. */
+    simulationReport report;
+
+    if (!runSimulation(options, events, report, error)) {
+        err << simFailedStr.arg(error) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    /* print the report. */
+    out << "events        : " << events.size()
+        << " (" << report.total.events[Event_Entry] << " entries, "
+        << report.total.events[Event_Exit] << " exits)\n";
+    out << "gates         : " << options.gates << (options.useWriter ? " (single writer)" : "") << "\n";
+    out << "wall time     : " << report.wallMsecs / 1000.0 << " secs\n";
+    out << "throughput    : " << QString::number(report.throughput, 'f', 1) << " events/sec\n";
+    out << "latency p50   : " << report.p50 << " usecs\n";
+    out << "latency p99   : " << report.p99 << " usecs\n";
+    out << "latency max   : " << report.maxLatency << " usecs\n";
+
+    if (options.speed > 0)
+        out << "max lag       : " << report.total.maxLag << " msecs behind schedule\n";
+
+    out << "results       :\n";
+
+    for (int i = 0; i <= ParkingEngine::Gate_DBError; i++) {
+        if (!report.total.results[i]) continue;
+
+        out << "  " << ParkingEngine::resultName((ParkingEngine::gateResult) i).leftJustified(20)
+            << report.total.results[i] << "\n";
+    }
+
+    out << "capacity rejections : " << report.total.results[ParkingEngine::Gate_NoCapacity] << "\n";
+
+    /* the group commits of the writer. */
+    const groupCommitStatistics &commits = report.commits;
+
+    if (options.useWriter && commits.commits > 0) {
+        out << "group commits : " << commits.commits << " (window " << options.commitWindow << " msecs, "
+            << commits.failedCommits << " failed)\n";
+        out << "batch size    : avg " << QString::number((double) commits.commands / commits.commits, 'f', 1)
+            << ", max " << commits.largestBatch << "\n";
+        out << "commit time   : avg " << commits.commitUsecs / commits.commits
+            << " usecs, max " << commits.maxCommitUsecs << " usecs\n";
+        out << "window wait   : avg " << commits.windowUsecs / commits.commits << " usecs\n";
+
+        out << "batch sizes   :\n";
+
+        for (int i = 0; i < COMMIT_SIZE_BUCKETS; i++) {
+            if (!commits.sizeBuckets[i]) continue;
+
+            /* the bucket i holds the sizes 2^i ... 2^(i+1)-1 (the last one all the rest). */
+            const QString range = i == COMMIT_SIZE_BUCKETS - 1 ? QString("%1+").arg(1 << i)
+                                                                : QString("%1-%2").arg(1 << i).arg((2 << i) - 1);
+
+            out << "  " << range.leftJustified(20) << commits.sizeBuckets[i] << "\n";
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
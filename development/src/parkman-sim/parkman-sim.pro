@@ -0,0 +1,24 @@
+# program's template as application.
+TEMPLATE = app
+
+# internal name of the tool.
+INTERNAL_NAME = parkman-sim
+
+# tool executable filename.
+TARGET = $${INTERNAL_NAME}
+
+# configuration options for the tool (console program).
+CONFIG += console
+CONFIG -= app_bundle
+
+# headers used in the tool.
+HEADERS = eventlog.h \
+     gatesimulator.h
+
+# sources used in the tool.
+SOURCES = eventlog.cpp \
+     gatesimulator.cpp \
+              main.cpp
+
+# headless core of the application.
+include(../core.pri)
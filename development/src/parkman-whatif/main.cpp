@@ -0,0 +1,143 @@
+/*
+ *  This file implements the main startup of the tariff what-if tool.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <QtSql>
+#include <cstdlib>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "whatifanalysis.h"
+#include "tariffengine.h"
+#include "databasetools.h"
+#include "appsettings.h"
+
+/* console string messages. */
+static const QString usageStr = "usage: parkman-whatif [options]\n"
+                                "  --db FILE              database file (default: database.db)\n"
+                                "  --timeslice N          secs of the candidate timeslice (default: settings default)\n"
+                                "  --charge N             candidate charge per timeslice (default: settings default)\n"
+                                "  --tariff FILE          candidate declarative tariff (default: linear)\n"
+                                "  --base-timeslice N     secs of the current timeslice (default: settings default)\n"
+                                "  --base-charge N        current charge per timeslice (default: settings default)\n"
+                                "  --base-tariff FILE     current declarative tariff (default: linear)\n"
+                                "  --precision N          charge precision digits (default: settings default)\n"
+                                "  --threads N            worker threads (default: all cores)\n"
+                                "  --chunk N              report rows per work item (default: 32768)\n";
+
+static const QString dbOpenErrStr  = "parkman-whatif: cannot open the database '%1'.";
+static const QString tariffErrStr  = "parkman-whatif: %1";
+static const QString failedStr     = "parkman-whatif: analysis failed: %1";
+
+/* main function. */
+int
+main(int argc, char *argv[]) {
+    /* create the console application. */
+    QCoreApplication app(argc, argv);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    /* the default settings of both tariffs. */
+    appSettings baseSets;
+    baseSets.parkingCapacity = DEF_PARKING_CAPACITY;
+    baseSets.timeslice = DEF_TIMESLICE;
+    baseSets.chargePerTimeslice = DEF_CHARGE_PER_TIMESLICE;
+    baseSets.chargePrecision = DEF_CHARGE_PRECISION;
+
+    appSettings candidateSets = baseSets;
+
+    QString dbFileName = dbFileNameStr;
+    int threads = 0; /* all cores. */
+    int chunkRows = DEF_WHATIF_CHUNK_ROWS;
+
+    /* parse the command line. */
+    const QStringList args = app.arguments();
+    bool ok = true;
+
+    for (int i = 1; ok && i < args.size(); i++) {
+        const QString option = args.at(i);
+
+        /* every option has a value. */
+        if (i + 1 >= args.size()) { ok = false; break; }
+        const QString value = args.at(++i);
+
+        if (option == "--db") dbFileName = value;
+        else if (option == "--timeslice") candidateSets.timeslice = value.toInt(&ok);
+        else if (option == "--charge") candidateSets.chargePerTimeslice = value.toDouble(&ok);
+        else if (option == "--tariff") candidateSets.tariffFile = value;
+        else if (option == "--base-timeslice") baseSets.timeslice = value.toInt(&ok);
+        else if (option == "--base-charge") baseSets.chargePerTimeslice = value.toDouble(&ok);
+        else if (option == "--base-tariff") baseSets.tariffFile = value;
+        else if (option == "--precision") baseSets.chargePrecision = value.toInt(&ok);
+        else if (option == "--threads") threads = value.toInt(&ok);
+        else if (option == "--chunk") chunkRows = value.toInt(&ok);
+        else ok = false;
+    }
+
+    candidateSets.chargePrecision = baseSets.chargePrecision;
+
+    ok = ok && threads >= 0 && chunkRows > 0
+            && baseSets.timeslice >= MIN_TIMESLICE && baseSets.timeslice <= MAX_TIMESLICE
+            && candidateSets.timeslice >= MIN_TIMESLICE && candidateSets.timeslice <= MAX_TIMESLICE
+            && baseSets.chargePrecision >= MIN_CHARGE_PRECISION && baseSets.chargePrecision <= MAX_CHARGE_PRECISION;
+
+    if (!ok) {
+        err << usageStr;
+        return EXIT_FAILURE;
+    }
+
+    /* compile both tariffs. */
+    QString tariffError;
+    const TariffEngine baseline = loadTariff(baseSets, &tariffError);
+    const TariffEngine candidate = tariffError.isEmpty() ? loadTariff(candidateSets, &tariffError) : TariffEngine();
+
+    if (!tariffError.isEmpty()) {
+        err << tariffErrStr.arg(tariffError) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    /* connect to the DB with the following driver. */
+    QSqlDatabase db = QSqlDatabase::addDatabase(dbDriverStr);
+    db.setDatabaseName(dbFileName);
+
+    if (!db.open()) {
+        err << dbOpenErrStr.arg(dbFileName) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    /* re-price the report history. */
+    WhatIfAnalysis analysis(baseline, candidate);
+    analysis.setThreads(threads);
+    analysis.setChunkRows(chunkRows);
+
+    whatIfSummary summary;
+    QString error;
+
+    if (!analysis.run(db, summary, error)) {
+        err << failedStr.arg(error) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    out << WhatIfAnalysis::summaryText(summary, baseSets.chargePrecision);
+    out.flush();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,18 @@
+# program's template as application.
+TEMPLATE = app
+
+# internal name of the tool.
+INTERNAL_NAME = parkman-whatif
+
+# tool executable filename.
+TARGET = $${INTERNAL_NAME}
+
+# configuration options for the tool (console program).
+CONFIG += console
+CONFIG -= app_bundle
+
+# sources used in the tool.
+SOURCES = main.cpp
+
+# headless core of the application.
+include(../core.pri)
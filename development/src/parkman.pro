@@ -16,6 +16,9 @@ CONFIG += qtestlib
 # qt sql support for the application.
 QT += sql
 
+# qt network support for the metrics socket.
+QT += network
+
 # headers used in the application.
 HEADERS = vehicleform.h \
          customerform.h \
@@ -23,13 +26,12 @@ HEADERS = vehicleform.h \
            reportform.h \
          settingsform.h \
             paywizard.h \
+       paystationform.h \
+      diagnosticsform.h \
+      metricsexporter.h \
              mainform.h \
-   globaldeclarations.h \
-          appsettings.h \
         emptydateedit.h \
-        emptytimeedit.h \
-      arithmetictools.h \
-         bankingtools.h
+        emptytimeedit.h
 
 # sources used in the application.
 SOURCES = vehicleform.cpp \
@@ -38,9 +40,13 @@ SOURCES = vehicleform.cpp \
            reportform.cpp \
          settingsform.cpp \
             paywizard.cpp \
+       paystationform.cpp \
+      diagnosticsform.cpp \
+      metricsexporter.cpp \
              mainform.cpp \
         emptydateedit.cpp \
         emptytimeedit.cpp \
-      arithmetictools.cpp \
-         bankingtools.cpp \
                  main.cpp
+
+# headless core shared with the tools.
+include(core.pri)
@@ -0,0 +1,455 @@
+/*
+ *  This file implements the gate server of the lane devices.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <QtSql>
+#include <QtNetwork>
+#include <climits>
+#include <cstring>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "gateserver.h"
+#include "databasetools.h"
+#include "arithmetictools.h"
+#include "settingsservice.h"
+
+/* class which implements the lookups of a gate request on a reader of its
+   shard: the vehicle of its plate (unless known) and the quote of its
+   ticket. the results are sent back to the server's thread (a work item). */
+class GateLookupTask : public QRunnable
+{
+    public:
+        GateLookupTask(GateServer *server, ConnectionPool *connections,
+                       const appSettings &sets, const TariffEngine &tariff,
+                       const int tag, const QString &plate, const int vehiId,
+                       const bool quote, const QDateTime &when) {
+            this->server = server;
+            this->connections = connections;
+            this->sets = sets;
+            this->tariff = tariff;
+            this->tag = tag;
+            this->plate = plate;
+            this->vehiId = vehiId;
+            this->quote = quote;
+            this->when = when;
+        }
+
+        void run() {
+            ParkingEngine::gateResult result = ParkingEngine::Gate_Ok;
+            double charge = 0;
+            int tranId = -1;
+
+            {
+                PooledConnection connection(connections);
+
+                if (!connection.isValid()) {
+                    result = ParkingEngine::Gate_DBError;
+                }
+                else {
+                    ParkingEngine engine(sets, tariff, connection.db());
+
+                    if (vehiId < 0) vehiId = engine.vehicleId(plate);
+
+                    if (vehiId < 0)
+                        result = ParkingEngine::Gate_UnknownVehicle;
+                    else if (quote)
+                        result = engine.quoteVehicle(vehiId, when, &charge, &tranId);
+                }
+            }
+
+            QMetaObject::invokeMethod(server, "finishLookup", Qt::QueuedConnection,
+                                      Q_ARG(int, tag), Q_ARG(int, vehiId), Q_ARG(int, result),
+                                      Q_ARG(double, charge), Q_ARG(int, tranId));
+        }
+
+    private:
+        GateServer *server;
+        ConnectionPool *connections;
+        appSettings sets;
+        TariffEngine tariff;
+        int tag;
+        QString plate;
+        int vehiId;
+        bool quote;
+        QDateTime when;
+};
+
+/* create the server of some sites (call start() to serve). */
+GateServer::GateServer(const appSettings &sets, const QList<siteConfig> &sites, QObject *parent) : QObject(parent) {
+    this->sets = sets;
+    this->sites = sites;
+
+    /* the quotes are priced as the writers do. */
+    tariff = loadTariff(sets);
+
+    defaultSite = sites.isEmpty() ? DEF_SITE_ID : sites.first().id;
+    siteShards = 0;
+    lastTag = 0;
+
+    memset(&stats, 0, sizeof(stats));
+
+    connect(&tcpServer, SIGNAL(newConnection()), this, SLOT(acceptTcp()));
+    connect(&localServer, SIGNAL(newConnection()), this, SLOT(acceptLocal()));
+}
+
+/* stop the server (the writers commit what they have already). */
+GateServer::~GateServer() {
+    tcpServer.close();
+    localServer.close();
+
+    /* the lookups running finish first (their results are dropped). */
+    delete siteShards;
+}
+
+/* apply the settings which changed (the daemon prices as the application
+   does). a changed commit window replaces the one of the command line. */
+void
+GateServer::applySettings(const QStringList &keys) {
+    const settingsSnapshot snapshot = settingsService()->snapshot();
+
+    sets = snapshot.sets;
+    tariff = loadTariff(sets);
+
+    if (siteShards) {
+        siteShards->setSettings(sets);
+        if (keys.contains(commitWindowKeyStr)) siteShards->setCommitWindow(snapshot.commitWindow);
+    }
+}
+
+/* open the shards, start the writers and listen on TCP (port not zero)
+   and on a local socket (name not empty). */
+bool
+GateServer::start(const QHostAddress &address, const quint16 port,
+                  const QString &socketName, const int commitWindow,
+                  QString &error) {
+    if (sites.isEmpty()) {
+        error = "no sites to serve.";
+        return false;
+    }
+
+    siteShards = new SiteShards(sets);
+
+    foreach (const siteConfig &site, sites) {
+        if (!siteShards->addSite(site, error)) return false;
+
+        /* the completions come from the writer threads. */
+        connect(siteShards->writer(site.id), SIGNAL(completed(int, int, double)),
+                this, SLOT(completeRequest(int, int, double)), Qt::QueuedConnection);
+    }
+
+    siteShards->setCommitWindow(commitWindow);
+    siteShards->start();
+
+    if (port && !tcpServer.listen(address, port)) {
+        error = QString("cannot listen on %1:%2 (%3).").arg(address.toString()).arg(port).arg(tcpServer.errorString());
+        return false;
+    }
+
+    if (!socketName.isEmpty()) {
+        /* a socket left by a server that crashed. */
+        QLocalServer::removeServer(socketName);
+
+        if (!localServer.listen(socketName)) {
+            error = QString("cannot listen on the local socket '%1' (%2).").arg(socketName).arg(localServer.errorString());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* get the statistics of the server. */
+gateServerStatistics
+GateServer::statistics() const {
+    return stats;
+}
+
+/* get the shards of the sites (none before start()). */
+SiteShards *
+GateServer::shards() const {
+    return siteShards;
+}
+
+/* accept the new TCP devices. */
+void
+GateServer::acceptTcp() {
+    while (tcpServer.hasPendingConnections()) {
+        QTcpSocket *socket = tcpServer.nextPendingConnection();
+
+        /* the responses are small, send them at once. */
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+        addDevice(socket);
+    }
+}
+
+/* accept the new local devices. */
+void
+GateServer::acceptLocal() {
+    while (localServer.hasPendingConnections())
+        addDevice(localServer.nextPendingConnection());
+}
+
+/* serve a new device. */
+void
+GateServer::addDevice(QIODevice *device) {
+    buffers.insert(device, QByteArray());
+    stats.connections++;
+
+    connect(device, SIGNAL(readyRead()), this, SLOT(readDevice()));
+    connect(device, SIGNAL(disconnected()), this, SLOT(dropDevice()));
+}
+
+/* read and handle the complete requests of a device. */
+void
+GateServer::readDevice() {
+    QIODevice *device = qobject_cast<QIODevice *>(sender());
+    if (!device || !buffers.contains(device)) return;
+
+    QByteArray &buffer = buffers[device];
+    buffer.append(device->readAll());
+
+    /* handle all the pipelined requests which arrived whole. */
+    int offset = 0;
+    QByteArray frame;
+
+    while (takeFrame(buffer, offset, frame)) {
+        gateRequest request;
+        request.id = 0;
+        request.site = 0;
+
+        stats.requests++;
+
+        if (!decodeRequest(frame, request)) {
+            stats.badRequests++;
+            respond(device, request.id, GATE_BAD_REQUEST, 0);
+            continue;
+        }
+
+        handleRequest(device, request);
+    }
+
+    /* drop the handled requests (the rest is an incomplete one). */
+    buffer.remove(0, offset);
+}
+
+/* forget a device which disconnected. */
+void
+GateServer::dropDevice() {
+    QIODevice *device = qobject_cast<QIODevice *>(sender());
+    if (!device) return;
+
+    buffers.remove(device);
+
+    /* its requests waiting for lookups are dropped, the results of those
+       running too (their tags are kept until then). */
+    waiting.remove(device);
+
+    QMutableHashIterator<int, QIODevice *> l(lookups);
+
+    while (l.hasNext()) {
+        l.next();
+        if (l.value() == device) l.setValue(0);
+    }
+
+    /* its requests in the writer are still committed, but not answered. */
+    QMutableHashIterator<int, pendingRequest> i(pending);
+
+    while (i.hasNext()) {
+        i.next();
+        if (i.value().device == device) i.value().device = 0;
+    }
+
+    device->deleteLater();
+}
+
+/* handle a request of a device (on the shard of its site), after the
+   requests of the device before it. */
+void
+GateServer::handleRequest(QIODevice *device, const gateRequest &request) {
+    const int siteId = request.site ? request.site : defaultSite;
+
+    /* a site the server does not host. */
+    if (!siteShards->hasSite(siteId)) {
+        stats.badRequests++;
+        respond(device, request.id, GATE_BAD_REQUEST, 0);
+        return;
+    }
+
+    pendingLookup lookup;
+    lookup.siteId = siteId;
+    lookup.request = request;
+    lookup.tag = 0;
+
+    /* the daemon's time unless the device has its own. */
+    lookup.when = request.when ? QDateTime::fromMSecsSinceEpoch(request.when)
+                               : QDateTime::currentDateTime();
+
+    QList<pendingLookup> &requests = waiting[device];
+    requests << lookup;
+
+    /* the others wait for the one being looked up. */
+    if (requests.size() == 1) serveWaiting(device);
+}
+
+/* handle the requests of a device in order until one needs a lookup on a
+   reader (an entry or exit of a known vehicle needs none). */
+void
+GateServer::serveWaiting(QIODevice *device) {
+    QHash<QIODevice *, QList<pendingLookup> >::iterator i = waiting.find(device);
+    if (i == waiting.end()) return;
+
+    while (!i.value().isEmpty()) {
+        pendingLookup &lookup = i.value().first();
+
+        const int vehiId = vehicles.value(lookup.siteId).value(lookup.request.plate, -1);
+        const bool quote = lookup.request.type == Request_Quote || lookup.request.type == Request_Pay;
+
+        if (vehiId < 0 || quote) {
+            lookup.tag = nextTag();
+            lookups.insert(lookup.tag, device);
+
+            siteShards->read(lookup.siteId, new GateLookupTask(this, siteShards->connections(lookup.siteId), sets, tariff,
+                                                               lookup.tag, lookup.request.plate, vehiId, quote, lookup.when));
+            return;
+        }
+
+        const pendingLookup known = i.value().takeFirst();
+        handleLookup(device, known, vehiId, ParkingEngine::Gate_Ok, 0, -1);
+    }
+
+    waiting.erase(i);
+}
+
+/* the lookups of the first request of a device are done (on a reader). */
+void
+GateServer::finishLookup(const int tag, const int vehiId, const int result, const double charge, const int tranId) {
+    /* the device disconnected meanwhile. */
+    QIODevice *device = lookups.take(tag);
+    if (!device || waiting.value(device).isEmpty()) return;
+
+    const pendingLookup lookup = waiting[device].takeFirst();
+
+    /* the unknown ones are asked again (they may be registered). */
+    if (vehiId >= 0) vehicles[lookup.siteId].insert(lookup.request.plate, vehiId);
+
+    handleLookup(device, lookup, vehiId, (ParkingEngine::gateResult) result, charge, tranId);
+
+    serveWaiting(device);
+}
+
+/* answer a request or send it to the writer of its site, with the vehicle
+   of its plate (-1 if unknown) and the quote of its ticket (if asked). */
+void
+GateServer::handleLookup(QIODevice *device, const pendingLookup &lookup, const int vehiId,
+                         const ParkingEngine::gateResult result, const double charge, const int tranId) {
+    const gateRequest &request = lookup.request;
+
+    /* an unknown vehicle (or the DB failed to find it). */
+    if (vehiId < 0) {
+        respond(device, request.id, result, 0);
+        return;
+    }
+
+    switch (request.type) {
+        case Request_Entry:
+        case Request_Exit:
+            {
+                writeCommand command = createWriteCommand(request.type == Request_Entry ? Write_Entry : Write_Exit);
+                command.vehiId = vehiId;
+                command.when = lookup.when;
+
+                submit(lookup.siteId, device, request.id, command);
+                break;
+            }
+        case Request_Quote:
+            respond(device, request.id, result, charge);
+            break;
+        case Request_Pay:
+            {
+                /* the pay station pays the quote of the ticket and completes it. */
+                if (result != ParkingEngine::Gate_Ok) {
+                    respond(device, request.id, result, charge);
+                    break;
+                }
+
+                if (isLessThan(request.amount, charge)) {
+                    respond(device, request.id, ParkingEngine::Gate_NotEnoughMoney, charge);
+                    break;
+                }
+
+                writeCommand command = createWriteCommand(Write_Close);
+                command.tranId = tranId;
+                command.custId = 0; /* paid here, no card is debited. */
+                command.amount = charge;
+                command.when = lookup.when;
+
+                submit(lookup.siteId, device, request.id, command);
+                break;
+            }
+        default: /* this should never happen (checked by the decoder). */
+            respond(device, request.id, GATE_BAD_REQUEST, 0);
+            break;
+    }
+}
+
+/* submit the command of a request to the writer of its site (answered when committed). */
+void
+GateServer::submit(const int siteId, QIODevice *device, const quint32 id, writeCommand command) {
+    pendingRequest request;
+    request.device = device;
+    request.id = id;
+
+    command.tag = nextTag();
+    pending.insert(command.tag, request);
+
+    siteShards->writer(siteId)->submit(command);
+}
+
+/* answer a request when the writer committed its command. */
+void
+GateServer::completeRequest(const int tag, const int result, const double charge) {
+    const pendingRequest request = pending.take(tag);
+
+    if (request.device) respond(request.device, request.id, (quint8) result, charge);
+}
+
+/* send the response of a request. */
+void
+GateServer::respond(QIODevice *device, const quint32 id, const quint8 result, const double charge) {
+    gateResponse response;
+    response.id = id;
+    response.result = result;
+    response.charge = charge;
+
+    device->write(encodeResponse(response));
+    stats.responses++;
+}
+
+/* a tag which is not waiting already, for the writer or a lookup (never zero). */
+int
+GateServer::nextTag() {
+    do {
+        lastTag = lastTag == INT_MAX ? 1 : lastTag + 1;
+    } while (pending.contains(lastTag) || lookups.contains(lastTag));
+
+    return lastTag;
+}
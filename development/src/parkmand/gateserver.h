@@ -0,0 +1,114 @@
+/* header defining the interface of the source. */
+#ifndef GATESERVER_H
+#define GATESERVER_H
+
+/* include some QT libraries. */
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QByteArray>
+#include <QDateTime>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QLocalServer>
+
+/* include headers defining the interface of the sources. */
+#include "gateprotocol.h"
+#include "parkingengine.h"
+#include "tariffengine.h"
+#include "dbwriter.h"
+#include "siteshards.h"
+#include "appsettings.h"
+
+/* gate server statistics structure data type. */
+typedef struct gateServerStatistics {
+    qint64 connections;
+    qint64 requests;
+    qint64 badRequests;
+    qint64 responses;
+} gateServerStatistics;
+
+/* class which implements the gate server. the lane devices connect with
+   TCP or a local socket and send requests of the gate protocol. it is
+   event-driven in one thread which runs no SQL: the vehicles of the plates
+   (cached once known) and the quotes are looked up on the readers of the
+   shards, and entries/exits/payments go to the DB writer, whose completion
+   signal sends their responses. nothing in the loop waits for the DB. the
+   requests of a device are handled in the order they arrived, a request
+   waits for the lookup of the one before it.
+
+   it may host the car parks of many sites, every one in its own shard
+   (see SiteShards). the requests are routed by their site, the first
+   one is the default for the devices which do not send any. */
+class GateServer : public QObject
+{
+    Q_OBJECT
+
+    public:
+        GateServer(const appSettings &sets, const QList<siteConfig> &sites, QObject *parent = 0);
+        ~GateServer();
+
+        bool start(const QHostAddress &address, const quint16 port,
+                   const QString &socketName, const int commitWindow,
+                   QString &error);
+
+        gateServerStatistics statistics() const;
+        SiteShards *shards() const;
+
+    public slots:
+        void applySettings(const QStringList &keys);
+
+    private slots:
+        void acceptTcp();
+        void acceptLocal();
+        void readDevice();
+        void dropDevice();
+        void completeRequest(const int tag, const int result, const double charge);
+        void finishLookup(const int tag, const int vehiId, const int result, const double charge, const int tranId);
+
+    private:
+        /* request waiting for the DB writer structure data type. */
+        typedef struct pendingRequest {
+            QIODevice *device;  /* none if it disconnected meanwhile. */
+            quint32 id;
+        } pendingRequest;
+
+        /* request waiting for its lookups structure data type. */
+        typedef struct pendingLookup {
+            int siteId;
+            gateRequest request;
+            QDateTime when;
+            int tag;            /* of its lookup on a reader (0 before it started). */
+        } pendingLookup;
+
+        void addDevice(QIODevice *device);
+        void handleRequest(QIODevice *device, const gateRequest &request);
+        void serveWaiting(QIODevice *device);
+        void handleLookup(QIODevice *device, const pendingLookup &lookup, const int vehiId,
+                          const ParkingEngine::gateResult result, const double charge, const int tranId);
+        void submit(const int siteId, QIODevice *device, const quint32 id, writeCommand command);
+        void respond(QIODevice *device, const quint32 id, const quint8 result, const double charge);
+        int nextTag();
+
+        appSettings sets;
+        QList<siteConfig> sites;
+        int defaultSite;
+
+        QTcpServer tcpServer;
+        QLocalServer localServer;
+
+        SiteShards *siteShards;
+        TariffEngine tariff;                          /* of the quotes (compiled once). */
+
+        QHash<QIODevice *, QByteArray> buffers;
+        QHash<int, pendingRequest> pending;           /* of all the sites (the tags are unique). */
+        QHash<QIODevice *, QList<pendingLookup> > waiting;  /* in order, the first one is looked up. */
+        QHash<int, QIODevice *> lookups;              /* the device of every lookup running. */
+        QHash<int, QHash<QString, int> > vehicles;    /* per site. */
+        int lastTag;
+
+        gateServerStatistics stats;
+};
+
+#endif // GATESERVER_H
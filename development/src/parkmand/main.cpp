@@ -0,0 +1,150 @@
+/*
+ *  This file implements the main startup of the gate daemon.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <QtNetwork>
+#include <cstdlib>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "gateserver.h"
+#include "gateprotocol.h"
+#include "databasetools.h"
+#include "dbwriter.h"
+#include "appsettings.h"
+#include "settingsservice.h"
+#include "siteshards.h"
+
+/* console string messages. */
+static const QString usageStr = "usage: parkmand [options]\n"
+                                "  --db FILE          database file of the default site (default: database.db)\n"
+                                "  --site ID:FILE     a site and its database file (repeat for more, the first is the default)\n"
+                                "  --listen ADDRESS   TCP address of the devices (default: 127.0.0.1)\n"
+                                "  --port N           TCP port of the devices, 0 for none (default: 7411)\n"
+                                "  --socket NAME      local socket of the devices, none for none (default: parkmand)\n"
+                                "  --window MSECS     group commit window, 0 for the lowest latency (default: settings)\n";
+
+static const QString startFailedStr = "parkmand: %1";
+static const QString listeningStr   = "parkmand: serving %1 on %2.";
+static const QString summaryStr     = "parkmand: %1 site(s), %2 open ticket(s), %3 closed ticket(s) charged %4.";
+
+/* the open and closed tickets of all the sites (merged by their kind). */
+static const QString summarySqlStr = "SELECT 'open', COUNT(*), 0.0 FROM transacts "
+                                     "UNION ALL "
+                                     "SELECT 'closed', COUNT(*), TOTAL(charge) FROM report";
+
+/* main function. */
+int
+main(int argc, char *argv[]) {
+    /* create the console application. */
+    QCoreApplication app(argc, argv);
+
+    QTextStream err(stderr);
+
+    /* the daemon prices as the application does. */
+    SettingsService *service = settingsService();
+    const appSettings sets = service->settings();
+    int commitWindow = service->commitWindow();
+
+    /* the default daemon options. */
+    QString dbFileName = dbFileNameStr;
+    QList<siteConfig> sites;
+    QHostAddress address(QHostAddress::LocalHost);
+    int port = DEF_GATE_PORT;
+    QString socketName = defGateSocketStr;
+
+    /* parse the command line. */
+    const QStringList args = app.arguments();
+    bool ok = true;
+
+    for (int i = 1; ok && i < args.size(); i++) {
+        const QString option = args.at(i);
+
+        /* every option has a value. */
+        if (i + 1 >= args.size()) { ok = false; break; }
+        const QString value = args.at(++i);
+
+        if (option == "--db") dbFileName = value;
+        else if (option == "--site") {
+            siteConfig site;
+            site.id = value.section(':', 0, 0).toInt(&ok);
+            site.fileName = value.section(':', 1);
+
+            ok = ok && site.id > 0 && site.id <= 0xFFFF && !site.fileName.isEmpty();
+            sites << site;
+        }
+        else if (option == "--listen") ok = address.setAddress(value);
+        else if (option == "--port") port = value.toInt(&ok);
+        else if (option == "--socket") socketName = value == "none" ? QString() : value;
+        else if (option == "--window") commitWindow = value.toInt(&ok);
+        else ok = false;
+    }
+
+    ok = ok && port >= 0 && port <= 0xFFFF && (port || !socketName.isEmpty())
+            && commitWindow >= MIN_COMMIT_WINDOW && commitWindow <= MAX_COMMIT_WINDOW;
+
+    if (!ok) {
+        err << usageStr;
+        return EXIT_FAILURE;
+    }
+
+    /* a single car park unless there are sites. */
+    if (sites.isEmpty()) {
+        siteConfig site;
+        site.id = DEF_SITE_ID;
+        site.fileName = dbFileName;
+
+        sites << site;
+    }
+
+    /* start serving the devices (with the changes of the settings). */
+    GateServer server(sets, sites);
+    QObject::connect(service, SIGNAL(changed(const QStringList &)), &server, SLOT(applySettings(const QStringList &)));
+    QString error;
+
+    if (!server.start(address, (quint16) port, socketName, commitWindow, error)) {
+        err << startFailedStr.arg(error) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    QStringList endpoints;
+    if (port) endpoints << QString("%1:%2").arg(address.toString()).arg(port);
+    if (!socketName.isEmpty()) endpoints << socketName;
+
+    QStringList shards;
+    foreach (const siteConfig &site, sites)
+        shards << QString("%1:'%2'").arg(site.id).arg(site.fileName);
+
+    err << listeningStr.arg(shards.join(", ")).arg(endpoints.join(", ")) << "\n";
+
+    /* the tickets of all the sites (read from every shard at once). */
+    QList<QVariantList> rows;
+
+    if (server.shards()->aggregate(summarySqlStr, 1, rows, error) && rows.size() == 2)
+        err << summaryStr.arg(sites.size()).arg(rows.at(0).at(1).toLongLong())
+                         .arg(rows.at(1).at(1).toLongLong()).arg(rows.at(1).at(2).toDouble(), 0, 'f', 2) << "\n";
+    else
+        err << startFailedStr.arg(error) << "\n";
+
+    err.flush();
+
+    /* run the daemon. */
+    return app.exec();
+}
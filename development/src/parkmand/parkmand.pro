@@ -0,0 +1,25 @@
+# program's template as application.
+TEMPLATE = app
+
+# internal name of the daemon.
+INTERNAL_NAME = parkmand
+
+# daemon executable filename.
+TARGET = $${INTERNAL_NAME}
+
+# configuration options for the daemon (console program).
+CONFIG += console
+CONFIG -= app_bundle
+
+# qt network support for the devices.
+QT += network
+
+# headers used in the daemon.
+HEADERS = gateserver.h
+
+# sources used in the daemon.
+SOURCES = gateserver.cpp \
+               main.cpp
+
+# headless core of the application.
+include(../core.pri)
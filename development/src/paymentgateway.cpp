@@ -0,0 +1,537 @@
+/*
+ *  This file implements the asynchronous payment gateway.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+#include <QtSql>
+
+/* include headers defining the interface of the sources. */
+#include "paymentgateway.h"
+#include "connectionpool.h"
+
+/* msecs of a day (the period of the capture). */
+static const int DAY_MSECS = 86400000;
+
+/* the digits of a card number kept with its authorization. */
+static const int CARD_KEPT_DIGITS = 4;
+
+/* msecs between the evictions of the payments over. */
+static const int PAYMENT_EVICT_INTERVAL = 60000;
+
+/* sleep the calling thread (on a semaphore nobody releases). */
+static void
+waitFor(const int msecs) {
+    QSemaphore never;
+    never.tryAcquire(1, msecs);
+}
+
+/* class which implements an authorization of the gateway (a work item). */
+class AuthorizeTask : public QRunnable
+{
+    public:
+        AuthorizeTask(PaymentGateway *gateway, const QString &key, const QString &cardNumber, const double amount) {
+            this->gateway = gateway;
+            this->key = key;
+            this->cardNumber = cardNumber;
+            this->amount = amount;
+        }
+
+        void run() {
+            gateway->process(key, cardNumber, amount);
+        }
+
+    private:
+        PaymentGateway *gateway;
+        QString key;
+        QString cardNumber;
+        double amount;
+};
+
+/* class which implements a capture of the gateway (a work item). */
+class CaptureTask : public QRunnable
+{
+    public:
+        CaptureTask(PaymentGateway *gateway) {
+            this->gateway = gateway;
+        }
+
+        void run() {
+            gateway->processCapture();
+        }
+
+    private:
+        PaymentGateway *gateway;
+};
+
+/* create the mock processor. */
+MockPaymentProvider::MockPaymentProvider(const int latency, const int declineRate, const int failureRate, const uint seed) {
+    this->latency = qMax(latency, 0);
+    this->declineRate = qBound(0, declineRate, 100);
+    this->failureRate = qBound(0, failureRate, 100);
+    this->seed = seed;
+
+    authCodes = 0;
+}
+
+/* the name of the processor. */
+QString
+MockPaymentProvider::name() const {
+    return "mock";
+}
+
+/* authorize a payment. the outcome is decided when the request arrives,
+   so a payment approved after the caller gave up is found by its retry. */
+paymentStatus
+MockPaymentProvider::authorize(const QString &key, const QString &cardNumber,
+                               const double amount, const int timeout, QString &authCode) {
+    Q_UNUSED(amount);
+
+    paymentStatus status;
+    int delay;
+
+    {
+        QMutexLocker locker(&mutex);
+
+        delay = latency + random(latency + 1);
+
+        /* the same key is the same payment. */
+        if (approvals.contains(key)) {
+            authCode = approvals.value(key);
+            status = Payment_Approved;
+        }
+        else {
+            const int r = random(100);
+
+            if (r < failureRate) {
+                status = Payment_Failed;
+            }
+            else if (r < failureRate + declineRate || cardNumber.isEmpty()) {
+                status = Payment_Declined;
+            }
+            else {
+                authCode = QString("%1").arg(++authCodes, 6, 10, QChar('0'));
+                approvals.insert(key, authCode);
+                status = Payment_Approved;
+            }
+        }
+    }
+
+    /* the caller gives up on a slow answer. */
+    if (delay > timeout) {
+        waitFor(timeout);
+        return Payment_TimedOut;
+    }
+
+    waitFor(delay);
+
+    return status;
+}
+
+/* capture a batch of approved payments. */
+bool
+MockPaymentProvider::capture(const QList<paymentAuthorization> &batch) {
+    Q_UNUSED(batch);
+
+    waitFor(latency);
+
+    QMutexLocker locker(&mutex);
+
+    return random(100) >= failureRate;
+}
+
+/* a pseudo random number in [0, range) (a linear congruential generator,
+   repeatable from the seed unlike qrand() of every thread). */
+int
+MockPaymentProvider::random(const int range) {
+    seed = seed * 1103515245U + 12345U;
+
+    return (int) ((seed >> 16) % (uint) qMax(range, 1));
+}
+
+/* create the gateway of a processor (it is deleted with the gateway). */
+PaymentGateway::PaymentGateway(PaymentProvider *provider, QObject *parent) : QObject(parent) {
+    this->provider = provider;
+
+    pool.setMaxThreadCount(DEF_PAYMENT_THREADS);
+
+    timeout = DEF_PAYMENT_TIMEOUT;
+    retries = DEF_PAYMENT_RETRIES;
+    capturing = false;
+    store = 0;
+
+    evicted.start();
+
+    captureTimer.setSingleShot(true);
+    connect(&captureTimer, SIGNAL(timeout()), this, SLOT(captureDaily()));
+}
+
+/* wait for the authorizations in flight and delete the processor. */
+PaymentGateway::~PaymentGateway() {
+    captureTimer.stop();
+    pool.waitForDone();
+
+    delete provider;
+}
+
+/* set the msecs an attempt waits for the processor. */
+void
+PaymentGateway::setTimeout(const int msecs) {
+    QMutexLocker locker(&mutex);
+
+    timeout = qBound(MIN_PAYMENT_TIMEOUT, msecs, MAX_PAYMENT_TIMEOUT);
+}
+
+/* set the retries of an authorization which timed out or failed. */
+void
+PaymentGateway::setRetries(const int retries) {
+    QMutexLocker locker(&mutex);
+
+    this->retries = qBound(MIN_PAYMENT_RETRIES, retries, MAX_PAYMENT_RETRIES);
+}
+
+/* capture the approved payments every day at the given time. */
+void
+PaymentGateway::scheduleCapture(const QTime &at) {
+    captureTime = at;
+
+    int msecs = QTime::currentTime().msecsTo(at);
+    if (msecs <= 0) msecs += DAY_MSECS;
+
+    captureTimer.start(msecs);
+}
+
+/* keep the approved payments in the DB of a pool until they are captured,
+   and load those left by the last run (the caller's thread, before any
+   authorization). */
+bool
+PaymentGateway::setStore(ConnectionPool *store) {
+    this->store = store;
+
+    PooledConnection connection(store);
+    if (!connection.isValid()) return false;
+
+    /* declare a sql query object for the DB. */
+    QSqlQuery query(connection.db());
+
+    if (!query.exec("SELECT pay_key, card, amount, auth_code, attempts FROM payment_capture")) return false;
+
+    QMutexLocker locker(&mutex);
+
+    while (query.next()) {
+        paymentAuthorization payment;
+        payment.key = query.value(0).toString();
+        payment.card = query.value(1).toString();
+        payment.amount = query.value(2).toDouble();
+        payment.authCode = query.value(3).toString();
+        payment.attempts = query.value(4).toInt();
+        payment.status = Payment_Approved;
+        payment.over = 0;
+
+        authorizations.insert(payment.key, payment);
+    }
+
+    return true;
+}
+
+/* start the authorization of a payment (it never blocks). the result is
+   reported with the authorized() signal, also for a key already known. */
+void
+PaymentGateway::authorize(const QString &key, const QString &cardNumber, const double amount) {
+    {
+        QMutexLocker locker(&mutex);
+
+        evictOver();
+
+        paymentAuthorization &payment = authorizations[key];
+
+        /* reported when it is over. */
+        if (payment.key == key && payment.status == Payment_Pending) return;
+
+        /* a new payment. */
+        if (payment.key != key) {
+            payment.key = key;
+            payment.card = cardNumber.right(CARD_KEPT_DIGITS);
+            payment.amount = amount;
+            payment.attempts = 0;
+            payment.over = 0;
+            payment.status = Payment_Pending;
+        }
+        /* a payment not known to be over is asked again (with the same key). */
+        else if (payment.status != Payment_Approved && payment.status != Payment_Declined) {
+            payment.status = Payment_Pending;
+            payment.over = 0;
+        }
+    }
+
+    pool.start(new AuthorizeTask(this, key, cardNumber, amount));
+}
+
+/* authorize a payment with one attempt, waiting for it (for the callers
+   on their own thread which retry on their own, see PaymentOutbox). */
+paymentStatus
+PaymentGateway::authorizeNow(const QString &key, const QString &cardNumber, const double amount, QString &authCode) {
+    int timeout;
+
+    {
+        QMutexLocker locker(&mutex);
+
+        evictOver();
+
+        paymentAuthorization &payment = authorizations[key];
+
+        /* a payment over is only reported again. */
+        if (payment.key == key && (payment.status == Payment_Approved || payment.status == Payment_Declined)) {
+            authCode = payment.authCode;
+            return (paymentStatus) payment.status;
+        }
+
+        if (payment.key != key) {
+            payment.key = key;
+            payment.card = cardNumber.right(CARD_KEPT_DIGITS);
+            payment.amount = amount;
+            payment.attempts = 0;
+        }
+
+        payment.status = Payment_Pending;
+        payment.over = 0;
+        timeout = this->timeout;
+    }
+
+    const paymentStatus status = provider->authorize(key, cardNumber, amount, timeout, authCode);
+
+    paymentAuthorization payment;
+
+    {
+        QMutexLocker locker(&mutex);
+
+        /* the approved ones are captured with the rest. */
+        paymentAuthorization &stored = authorizations[key];
+        stored.status = status;
+        stored.authCode = authCode;
+        stored.attempts++;
+        stored.over = status == Payment_Approved ? 0 : QDateTime::currentMSecsSinceEpoch();
+
+        payment = stored;
+    }
+
+    if (status == Payment_Approved) storeApproval(payment);
+
+    return status;
+}
+
+/* get a payment by its key (false if it is not known). */
+bool
+PaymentGateway::authorization(const QString &key, paymentAuthorization &result) {
+    QMutexLocker locker(&mutex);
+
+    if (!authorizations.contains(key)) return false;
+
+    result = authorizations.value(key);
+
+    return true;
+}
+
+/* create a new idempotency key. */
+QString
+PaymentGateway::createKey() {
+    return QUuid::createUuid().toString();
+}
+
+/* start the capture of the approved payments (it never blocks). */
+void
+PaymentGateway::capture() {
+    {
+        QMutexLocker locker(&mutex);
+
+        /* one capture at a time. */
+        if (capturing) return;
+        capturing = true;
+    }
+
+    pool.start(new CaptureTask(this));
+}
+
+/* the daily capture (and the next one). */
+void
+PaymentGateway::captureDaily() {
+    capture();
+    scheduleCapture(captureTime);
+}
+
+/* authorize a payment with the processor (a thread of the gateway). */
+void
+PaymentGateway::process(const QString &key, const QString &cardNumber, const double amount) {
+    paymentAuthorization payment;
+    int timeout, retries;
+
+    {
+        QMutexLocker locker(&mutex);
+
+        payment = authorizations.value(key);
+        timeout = this->timeout;
+        retries = this->retries;
+    }
+
+    /* a payment over is only reported again. */
+    if (payment.status == Payment_Approved || payment.status == Payment_Declined) {
+        emit authorized(key, payment.status, payment.authCode);
+        return;
+    }
+
+    paymentStatus status = Payment_Failed;
+    QString authCode;
+    int backoff = DEF_PAYMENT_BACKOFF;
+    int attempts = 0;
+
+    for (int attempt = 0; attempt <= retries; attempt++) {
+        /* give the processor some time before every retry. */
+        if (attempt) {
+            waitFor(backoff);
+            backoff *= 2;
+        }
+
+        attempts++;
+        status = provider->authorize(key, cardNumber, amount, timeout, authCode);
+
+        /* only an unknown outcome is retried. */
+        if (status == Payment_Approved || status == Payment_Declined) break;
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+
+        paymentAuthorization &stored = authorizations[key];
+        stored.status = status;
+        stored.authCode = authCode;
+        stored.attempts += attempts;
+        stored.over = status == Payment_Approved ? 0 : QDateTime::currentMSecsSinceEpoch();
+
+        payment = stored;
+    }
+
+    /* it waits for the capture in the DB (before it is reported). */
+    if (status == Payment_Approved) storeApproval(payment);
+
+    emit authorized(key, status, authCode);
+}
+
+/* capture the approved payments (a thread of the gateway). */
+void
+PaymentGateway::processCapture() {
+    QList<paymentAuthorization> batch;
+    double amount = 0;
+
+    {
+        QMutexLocker locker(&mutex);
+
+        foreach (const paymentAuthorization &payment, authorizations) {
+            if (payment.status == Payment_Approved) {
+                batch << payment;
+                amount += payment.amount;
+            }
+        }
+    }
+
+    /* the payments left (or approved meanwhile) are captured the next time. */
+    const bool ok = batch.isEmpty() || provider->capture(batch);
+
+    if (ok && !batch.isEmpty()) forgetCaptured(batch);
+
+    {
+        QMutexLocker locker(&mutex);
+
+        if (ok) {
+            foreach (const paymentAuthorization &payment, batch)
+                authorizations.remove(payment.key);
+        }
+
+        capturing = false;
+    }
+
+    emit captured(batch.size(), amount, ok);
+}
+
+/* store an approved payment until it is captured (without a store it
+   waits in the memory only). */
+void
+PaymentGateway::storeApproval(const paymentAuthorization &payment) {
+    if (!store) return;
+
+    PooledConnection connection(store);
+    if (!connection.isValid()) return;
+
+    /* declare a sql query object for the DB. */
+    QSqlQuery query(connection.db());
+
+    query.prepare("INSERT OR REPLACE INTO payment_capture (pay_key, card, amount, auth_code, attempts) "
+                  "VALUES (:pay_key, :card, :amount, :auth_code, :attempts)");
+    query.bindValue(":pay_key", payment.key);
+    query.bindValue(":card", payment.card);
+    query.bindValue(":amount", payment.amount);
+    query.bindValue(":auth_code", payment.authCode);
+    query.bindValue(":attempts", payment.attempts);
+
+    query.exec();
+}
+
+/* remove the payments captured from the store (in one transaction). */
+void
+PaymentGateway::forgetCaptured(const QList<paymentAuthorization> &batch) {
+    if (!store) return;
+
+    PooledConnection connection(store);
+    if (!connection.isValid()) return;
+
+    QSqlDatabase db = connection.db();
+
+    /* declare a sql query object for the DB. */
+    QSqlQuery query(db);
+
+    if (!db.transaction()) return;
+
+    bool ok = query.prepare("DELETE FROM payment_capture WHERE pay_key = :pay_key");
+
+    foreach (const paymentAuthorization &payment, batch) {
+        if (!ok) break;
+
+        query.bindValue(":pay_key", payment.key);
+        ok = query.exec();
+    }
+
+    if (!ok || !db.commit()) db.rollback();
+}
+
+/* forget the payments declined or failed a while ago (with the mutex,
+   at most once in a while). */
+void
+PaymentGateway::evictOver() {
+    if (!evicted.hasExpired(PAYMENT_EVICT_INTERVAL)) return;
+
+    evicted.restart();
+
+    const qint64 before = QDateTime::currentMSecsSinceEpoch() - DEF_PAYMENT_RETENTION;
+
+    QMutableHashIterator<QString, paymentAuthorization> i(authorizations);
+
+    while (i.hasNext()) {
+        i.next();
+
+        if (i.value().over && i.value().over < before) i.remove();
+    }
+}
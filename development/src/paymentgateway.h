@@ -0,0 +1,178 @@
+/* header defining the interface of the source. */
+#ifndef PAYMENTGATEWAY_H
+#define PAYMENTGATEWAY_H
+
+/* include some QT libraries. */
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QMutex>
+#include <QTime>
+#include <QTimer>
+#include <QThreadPool>
+#include <QElapsedTimer>
+
+/* use these classes. */
+class ConnectionPool;
+
+/* the default msecs an authorization attempt waits for the processor. */
+static const int DEF_PAYMENT_TIMEOUT = 5000;
+static const int MAX_PAYMENT_TIMEOUT = 60000;
+static const int MIN_PAYMENT_TIMEOUT = 100;
+
+/* the default retries of an authorization which timed out or failed. */
+static const int DEF_PAYMENT_RETRIES = 2;
+static const int MAX_PAYMENT_RETRIES = 10;
+static const int MIN_PAYMENT_RETRIES = 0;
+
+/* msecs before the first retry (doubled for every next one). */
+static const int DEF_PAYMENT_BACKOFF = 250;
+
+/* msecs a payment declined or failed is kept (a retry with its key finds
+   it) before it is forgotten. */
+static const int DEF_PAYMENT_RETENTION = 3600000;
+
+/* the most authorizations in flight at once. */
+static const int DEF_PAYMENT_THREADS = 4;
+
+/* the default latency (msecs) and the default rates (percent) of the mock processor. */
+static const int DEF_MOCK_LATENCY = 300;
+static const int DEF_MOCK_DECLINE_RATE = 0;
+static const int DEF_MOCK_FAILURE_RATE = 0;
+
+/* payment status enumeration data type. */
+typedef enum paymentStatus {
+    Payment_Approved = 0,
+    Payment_Declined,     /* final, the card cannot pay. */
+    Payment_TimedOut,     /* unknown, the processor did not answer in time. */
+    Payment_Failed,       /* the processor cannot be reached. */
+    Payment_Pending       /* in flight. */
+} paymentStatus;
+
+/* payment authorization structure data type. */
+typedef struct paymentAuthorization {
+    QString key;          /* idempotency key (one payment, however many attempts). */
+    QString card;         /* the last digits of the card only. */
+    double amount;
+    int status;           /* paymentStatus. */
+    QString authCode;     /* of an approved payment. */
+    int attempts;
+    qint64 over;          /* msecs since the epoch it was declined or failed (0 if not). */
+} paymentAuthorization;
+
+/* class which defines a payment processor. its calls may block (they run
+   on the threads of the gateway) and must be thread safe. an authorization
+   repeated with the same key must not charge the card twice. */
+class PaymentProvider
+{
+    public:
+        virtual ~PaymentProvider() {}
+
+        virtual QString name() const = 0;
+
+        virtual paymentStatus authorize(const QString &key, const QString &cardNumber,
+                                        const double amount, const int timeout, QString &authCode) = 0;
+
+        virtual bool capture(const QList<paymentAuthorization> &batch) = 0;
+};
+
+/* class which implements a local payment processor for testing. every
+   call takes the given latency (with up to as much jitter again) and
+   declines or fails at the given rates. the approvals are kept by key. */
+class MockPaymentProvider : public PaymentProvider
+{
+    public:
+        MockPaymentProvider(const int latency = DEF_MOCK_LATENCY,
+                            const int declineRate = DEF_MOCK_DECLINE_RATE,
+                            const int failureRate = DEF_MOCK_FAILURE_RATE,
+                            const uint seed = 1);
+
+        QString name() const;
+
+        paymentStatus authorize(const QString &key, const QString &cardNumber,
+                                const double amount, const int timeout, QString &authCode);
+
+        bool capture(const QList<paymentAuthorization> &batch);
+
+    private:
+        int random(const int range);
+
+        int latency;
+        int declineRate;
+        int failureRate;
+
+        QMutex mutex;
+        uint seed;
+        QHash<QString, QString> approvals;  /* auth code of every approved key. */
+        int authCodes;
+};
+
+/* class which implements the asynchronous payment gateway. authorizations
+   run on a pool of threads, so a slow processor never freezes the caller,
+   and every one is reported with a signal. an attempt which times out or
+   fails is retried with a growing pause under the same idempotency key, so
+   a retry never charges twice. approved payments are captured in batches
+   (at the end of the day) and then forgotten. with a store they wait for
+   the capture in the DB (the application may quit before it), and the
+   declined and failed payments are forgotten after a while. */
+class PaymentGateway : public QObject
+{
+    Q_OBJECT
+
+    public:
+        PaymentGateway(PaymentProvider *provider, QObject *parent = 0);
+        ~PaymentGateway();
+
+        void setTimeout(const int msecs);
+        void setRetries(const int retries);
+        void scheduleCapture(const QTime &at);
+        bool setStore(ConnectionPool *store);
+
+        void authorize(const QString &key, const QString &cardNumber, const double amount);
+        paymentStatus authorizeNow(const QString &key, const QString &cardNumber, const double amount, QString &authCode);
+        bool authorization(const QString &key, paymentAuthorization &result);
+
+        static QString createKey();
+
+    public slots:
+        void capture();
+
+    signals:
+        /* an authorization is over (emitted by a thread of the gateway). */
+        void authorized(const QString &key, const int status, const QString &authCode);
+
+        /* a capture is over (emitted by a thread of the gateway). */
+        void captured(const int payments, const double amount, const bool ok);
+
+    private slots:
+        void captureDaily();
+
+    private:
+        friend class AuthorizeTask;
+        friend class CaptureTask;
+
+        void process(const QString &key, const QString &cardNumber, const double amount);
+        void processCapture();
+        void storeApproval(const paymentAuthorization &payment);
+        void forgetCaptured(const QList<paymentAuthorization> &batch);
+        void evictOver();
+
+        PaymentProvider *provider;
+        QThreadPool pool;
+
+        int timeout;
+        int retries;
+
+        QTimer captureTimer;
+        QTime captureTime;
+
+        ConnectionPool *store;
+
+        QMutex mutex;
+        QHash<QString, paymentAuthorization> authorizations;
+        QElapsedTimer evicted;
+        bool capturing;
+};
+
+#endif // PAYMENTGATEWAY_H
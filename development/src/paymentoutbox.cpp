@@ -0,0 +1,299 @@
+/*
+ *  This file implements the store-and-forward outbox of the card payments.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+#include <QtSql>
+
+/* include headers defining the interface of the sources. */
+#include "paymentoutbox.h"
+#include "databasetools.h"
+#include "bankingtools.h"
+#include "arithmetictools.h"
+#include "connectionpool.h"
+
+/* name of the outbox's connection. */
+static const QString outboxConnectionStr = "parkman-outbox";
+
+/* the digits of a card number kept after its payment is over. */
+static const int CARD_KEPT_DIGITS = 4;
+
+/* class which implements an acceptance of the outbox (a work item). */
+class AcceptTask : public QRunnable
+{
+    public:
+        AcceptTask(PaymentOutbox *outbox, const QString &key, const QString &cardNumber, const double amount) {
+            this->outbox = outbox;
+            this->key = key;
+            this->cardNumber = cardNumber;
+            this->amount = amount;
+        }
+
+        void run() {
+            outbox->acceptPooled(key, cardNumber, amount);
+        }
+
+    private:
+        PaymentOutbox *outbox;
+        QString key;
+        QString cardNumber;
+        double amount;
+};
+
+/* create the outbox (call start() to run it). */
+PaymentOutbox::PaymentOutbox(PaymentGateway *gateway, const QString &fileName, QObject *parent)
+    : QThread(parent), vault(fileName + cardKeySuffixStr) {
+    this->gateway = gateway;
+    this->fileName = fileName;
+
+    riskLimit = DEF_OUTBOX_RISK_LIMIT;
+}
+
+/* stop the outbox (the payments left are forwarded the next time). */
+PaymentOutbox::~PaymentOutbox() {
+    stop();
+    wait();
+}
+
+/* set the most money of a card waiting in the outbox (before any accept()). */
+void
+PaymentOutbox::setRiskLimit(const double limit) {
+    riskLimit = qBound(MIN_OUTBOX_RISK_LIMIT, limit, MAX_OUTBOX_RISK_LIMIT);
+}
+
+/* store a payment the processor could not authorize, on the caller's
+   connection (true if it is accepted). a payment is accepted only if
+   its card is valid and all the money of the card waiting in the outbox
+   is within the risk limit. the same key is the same payment. without
+   the key of the card numbers nothing is accepted (none is stored in
+   clear). */
+bool
+PaymentOutbox::accept(QSqlDatabase db, const QString &key, const QString &cardNumber, const double amount) {
+    if (!isGreaterThan(amount, 0) || isGreaterThan(amount, riskLimit)) return false;
+    if (!vault.isOpen()) return false;
+
+    /* the digits of the card only (as it is forwarded and summed). */
+    char digits[MAX_CARD_DIGITS];
+    const int count = cardNumberDigits(cardNumber, digits);
+
+    if (count < 0 || getCreditCardType(cardNumber) == creditCardError) return false;
+
+    QString card;
+    for (int i = 0; i < count; i++) card += QChar('0' + digits[i]);
+
+    /* the number is stored sealed, found by its token. */
+    const QString token = vault.token(card);
+    const QString secret = vault.seal(card);
+
+    if (token.isEmpty() || secret.isEmpty()) return false;
+
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    /* the check and the insert must not interleave with other lanes. */
+    if (!query.exec("BEGIN IMMEDIATE")) return false;
+
+    bool ok = query.prepare("SELECT COUNT(*) FROM payment_outbox WHERE pay_key = :pay_key");
+    query.bindValue(":pay_key", key);
+
+    ok = ok && query.exec() && query.next();
+    const bool stored = ok && query.value(0).toInt() > 0;
+
+    if (ok && !stored) {
+        /* the payments of the card waiting already count for the limit. */
+        query.prepare("SELECT IFNULL(SUM(amount), 0) FROM payment_outbox WHERE card_token = :card_token AND status = :status");
+        query.bindValue(":card_token", token);
+        query.bindValue(":status", (int) Outbox_Queued);
+
+        ok = query.exec() && query.next() && !isGreaterThan(query.value(0).toDouble() + amount, riskLimit);
+
+        query.finish();
+
+        if (ok) {
+            const QDateTime now = QDateTime::currentDateTime();
+
+            query.prepare("INSERT INTO payment_outbox (pay_key, card, card_token, card_secret, amount, entry_date, entry_time, next_try) "
+                          "VALUES (:pay_key, :card, :card_token, :card_secret, :amount, :entry_date, :entry_time, :next_try)");
+            query.bindValue(":pay_key", key);
+            query.bindValue(":card", card.right(CARD_KEPT_DIGITS));
+            query.bindValue(":card_token", token);
+            query.bindValue(":card_secret", secret);
+            query.bindValue(":amount", amount);
+            query.bindValue(":entry_date", now.date());
+            query.bindValue(":entry_time", now.time());
+            query.bindValue(":next_try", (qint64) now.toTime_t());
+
+            ok = query.exec();
+        }
+    }
+
+    query.finish();
+
+    if (!ok || !query.exec("COMMIT")) {
+        query.exec("ROLLBACK");
+        return false;
+    }
+
+    /* forward it as soon as possible. */
+    wakeUp.release();
+
+    return true;
+}
+
+/* store a payment the processor could not authorize on a pooled thread
+   and connection, so the caller never waits for the lock of the DB (see
+   accept(), the answer is the accepted() signal). */
+void
+PaymentOutbox::acceptLater(const QString &key, const QString &cardNumber, const double amount) {
+    QThreadPool::globalInstance()->start(new AcceptTask(this, key, cardNumber, amount));
+}
+
+/* store a payment on a pooled connection (a pooled thread). */
+void
+PaymentOutbox::acceptPooled(const QString &key, const QString &cardNumber, const double amount) {
+    bool stored = false;
+
+    {
+        PooledConnection connection(connectionPool());
+
+        if (connection.isValid()) stored = accept(connection.db(), key, cardNumber, amount);
+    }
+
+    emit accepted(key, stored);
+}
+
+/* ask the outbox to stop (it wakes up at once). */
+void
+PaymentOutbox::stop() {
+    stopping.fetchAndStoreOrdered(1);
+    wakeUp.release();
+}
+
+/* stop the outbox and wait for it (the payment in flight is over). */
+void
+PaymentOutbox::shutdown() {
+    stop();
+    wait();
+}
+
+/* the outbox's loop. */
+void
+PaymentOutbox::run() {
+    {
+        /* the connection belongs to the outbox thread. */
+        QSqlDatabase db = openDBConnection(outboxConnectionStr, fileName);
+
+        while (!stopping.fetchAndAddOrdered(0)) {
+            const int msecs = forward(db);
+
+            /* sleep until the next payment is due (or a new one, or the stop). */
+            if (msecs) wakeUp.tryAcquire(1, msecs);
+        }
+    }
+
+    QSqlDatabase::removeDatabase(outboxConnectionStr);
+}
+
+/* forward the payments which are due, the msecs until the next pass. */
+int
+PaymentOutbox::forward(QSqlDatabase db) {
+    /* without the key of the card numbers the payments wait for it. */
+    if (!vault.isOpen()) return MAX_OUTBOX_BACKOFF;
+
+    const qint64 now = QDateTime::currentDateTime().toTime_t();
+
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    query.prepare("SELECT id, pay_key, card, card_secret, amount, attempts, entry_date, entry_time FROM payment_outbox "
+                  "WHERE status = :status AND next_try <= :now ORDER BY id LIMIT :batch");
+    query.bindValue(":status", (int) Outbox_Queued);
+    query.bindValue(":now", now);
+    query.bindValue(":batch", DEF_OUTBOX_BATCH);
+
+    if (!query.exec()) return MAX_OUTBOX_BACKOFF;
+
+    QList<int> ids, attempts;
+    QStringList keys, cards, secrets;
+    QList<double> amounts;
+    QList<QDateTime> accepted;
+
+    while (query.next()) {
+        ids << query.value(0).toInt();
+        keys << query.value(1).toString();
+        cards << query.value(2).toString();
+        secrets << query.value(3).toString();
+        amounts << query.value(4).toDouble();
+        attempts << query.value(5).toInt();
+        accepted << QDateTime(query.value(6).toDate(), query.value(7).toTime());
+    }
+
+    query.finish();
+
+    for (int i = 0; i < ids.size() && !stopping.fetchAndAddOrdered(0); i++) {
+        QString authCode, number;
+        paymentStatus status = Payment_Declined;
+
+        /* a number which cannot be unsealed (another key) cannot be paid. */
+        if (vault.unseal(secrets.at(i), number))
+            status = gateway->authorizeNow(keys.at(i), number, amounts.at(i), authCode);
+
+        if (status == Payment_Approved || status == Payment_Declined) {
+            const int result = status == Payment_Approved ? Outbox_Forwarded : Outbox_Declined;
+
+            /* the payment is over, the number of its card is not kept. */
+            query.prepare("UPDATE payment_outbox SET status = :status, card_secret = NULL, auth_code = :auth_code, "
+                          "attempts = attempts + 1 WHERE id = :id");
+            query.bindValue(":status", result);
+            query.bindValue(":auth_code", authCode);
+            query.bindValue(":id", ids.at(i));
+
+            /* it is forwarded again if it cannot be stored (the same key). */
+            query.exec();
+
+            emit forwarded(keys.at(i), result, authCode);
+
+            if (result == Outbox_Declined) emit declined(keys.at(i), cards.at(i), amounts.at(i), accepted.at(i));
+
+            continue;
+        }
+
+        /* the processor cannot be reached, the payment waits longer. */
+        const int backoff = qMin((qint64) DEF_OUTBOX_BACKOFF << qMin(attempts.at(i), 16), (qint64) MAX_OUTBOX_BACKOFF);
+
+        query.prepare("UPDATE payment_outbox SET attempts = attempts + 1, next_try = :next_try WHERE id = :id");
+        query.bindValue(":next_try", now + backoff / 1000);
+        query.bindValue(":id", ids.at(i));
+        query.exec();
+
+        /* the rest wait for it too. */
+        return backoff;
+    }
+
+    /* more payments may be due. */
+    if (ids.size() == DEF_OUTBOX_BATCH) return 0;
+
+    /* sleep until the next payment is due. */
+    if (!query.exec(QString("SELECT MIN(next_try) FROM payment_outbox WHERE status = %1").arg(Outbox_Queued)) || !query.next())
+        return MAX_OUTBOX_BACKOFF;
+
+    if (query.value(0).isNull()) return MAX_OUTBOX_BACKOFF;
+
+    return (int) qBound((qint64) 0, (query.value(0).toLongLong() - now) * 1000, (qint64) MAX_OUTBOX_BACKOFF);
+}
@@ -0,0 +1,92 @@
+/* header defining the interface of the source. */
+#ifndef PAYMENTOUTBOX_H
+#define PAYMENTOUTBOX_H
+
+/* include some QT libraries. */
+#include <QThread>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QSqlDatabase>
+#include <QDateTime>
+
+/* include headers defining the interface of the sources. */
+#include "paymentgateway.h"
+#include "cardvault.h"
+
+/* the default most money of a card waiting in the outbox (all its payments). */
+static const double DEF_OUTBOX_RISK_LIMIT = 20;
+static const double MAX_OUTBOX_RISK_LIMIT = 1000;
+static const double MIN_OUTBOX_RISK_LIMIT = 0; /* nothing accepted offline. */
+
+/* msecs before the first retry of a payment (doubled for every next one). */
+static const int DEF_OUTBOX_BACKOFF = 5000;
+static const int MAX_OUTBOX_BACKOFF = 600000;
+
+/* the payments forwarded in one pass. */
+static const int DEF_OUTBOX_BATCH = 32;
+
+/* outbox payment status enumeration data type. */
+typedef enum outboxStatus {
+    Outbox_Queued = 0,
+    Outbox_Forwarded,     /* approved by the processor. */
+    Outbox_Declined       /* the money is lost. */
+} outboxStatus;
+
+/* class which implements the store-and-forward outbox of the card
+   payments. when the processor cannot be reached, a small payment of a
+   valid card is stored in the DB and accepted at once, so the lane goes
+   on. the outbox thread forwards the stored payments (with the key of
+   their first try) as soon as the processor answers, and waits longer
+   and longer between the tries while it does not.
+
+   a card number waits sealed (see CardVault), with its last digits in
+   clear, and only the last digits are kept when its payment is over. a
+   payment declined when forwarded is money lost (the vehicle has left),
+   so it is reported to the operator. */
+class PaymentOutbox : public QThread
+{
+    Q_OBJECT
+
+    public:
+        PaymentOutbox(PaymentGateway *gateway, const QString &fileName, QObject *parent = 0);
+        ~PaymentOutbox();
+
+        void setRiskLimit(const double limit);
+
+        bool accept(QSqlDatabase db, const QString &key, const QString &cardNumber, const double amount);
+        void acceptLater(const QString &key, const QString &cardNumber, const double amount);
+
+    public slots:
+        void stop();
+        void shutdown();
+
+    signals:
+        /* a payment of acceptLater() is stored or not (emitted by a pooled thread). */
+        void accepted(const QString &key, const bool stored);
+
+        /* a stored payment is over (emitted by the outbox thread). */
+        void forwarded(const QString &key, const int status, const QString &authCode);
+
+        /* a stored payment is declined, the card ends with the given digits (emitted by the outbox thread). */
+        void declined(const QString &key, const QString &card, const double amount, const QDateTime &accepted);
+
+    protected:
+        void run();
+
+    private:
+        friend class AcceptTask;
+
+        void acceptPooled(const QString &key, const QString &cardNumber, const double amount);
+        int forward(QSqlDatabase db);
+
+        PaymentGateway *gateway;
+        QString fileName;
+        double riskLimit;
+
+        CardVault vault;          /* read only after the creation (any thread). */
+
+        QSemaphore wakeUp;
+        QAtomicInt stopping;
+};
+
+#endif // PAYMENTOUTBOX_H
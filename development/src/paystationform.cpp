@@ -0,0 +1,181 @@
+/*
+ *  This file implements the pay station gui form.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtGui>
+#include <QtSql>
+
+/* include headers defining the interface of the sources. */
+#include "paystationform.h"
+#include "globaldeclarations.h"
+
+/* creates the application's pay station gui form. */
+PayStationForm::PayStationForm(const appSettings sets, QWidget *parent) : QDialog(parent), service(sets) {
+    /* store the application's settings. */
+    this->sets = sets;
+
+    /* create the line edit of the vehicle and its buddy. */
+    plateEdit = new QLineEdit;
+    plateLabel = new QLabel(stationPlateLabelStr);
+    plateLabel->setBuddy(plateEdit);
+
+    /* create the labels of the quote. */
+    customerLabel = new QLabel(stationCustLabelStr);
+    cardLabel = new QLabel(stationCardLabelStr);
+    startLabel = new QLabel(stationStartLabelStr);
+    stayLabel = new QLabel(stationStayLabelStr);
+    chargeLabel = new QLabel(stationChargeLabelStr);
+
+    customerValue = new QLabel;
+    cardValue = new QLabel;
+    startValue = new QLabel;
+    stayValue = new QLabel;
+    chargeValue = new QLabel;
+    statusLabel = new QLabel;
+
+    /* the charge is what the customer looks for. */
+    QFont chargeFont = chargeValue->font();
+    chargeFont.setPointSize(chargeFont.pointSize() * 2);
+    chargeFont.setBold(true);
+    chargeValue->setFont(chargeFont);
+
+    /* create the management buttons. */
+    closeButton = new QPushButton(closeButtonStr);
+
+    /* add the buttons in a button box dialog. */
+    buttonBox = new QDialogButtonBox;
+    buttonBox->addButton(closeButton, QDialogButtonBox::AcceptRole);
+
+    /* create the timer which refreshes the quote. */
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(DEF_QUOTE_REFRESH);
+
+    /* set the signals/slots for the events. */
+    connect(plateEdit, SIGNAL(textChanged(const QString &)), this, SLOT(refreshQuote()));
+    connect(refreshTimer, SIGNAL(timeout()), this, SLOT(refreshQuote()));
+    connect(closeButton, SIGNAL(clicked()), this, SLOT(accept()));
+
+    /* create a table grid. */
+    QGridLayout *mainLayout = new QGridLayout;
+
+    /* add the following objects in the appropriate position in the grid. */
+    mainLayout->addWidget(plateLabel, 0, 0, 1, 1, Qt::AlignRight);
+    mainLayout->addWidget(plateEdit, 0, 1);
+    mainLayout->addWidget(customerLabel, 1, 0, 1, 1, Qt::AlignRight);
+    mainLayout->addWidget(customerValue, 1, 1);
+    mainLayout->addWidget(cardLabel, 2, 0, 1, 1, Qt::AlignRight);
+    mainLayout->addWidget(cardValue, 2, 1);
+    mainLayout->addWidget(startLabel, 3, 0, 1, 1, Qt::AlignRight);
+    mainLayout->addWidget(startValue, 3, 1);
+    mainLayout->addWidget(stayLabel, 4, 0, 1, 1, Qt::AlignRight);
+    mainLayout->addWidget(stayValue, 4, 1);
+    mainLayout->addWidget(chargeLabel, 5, 0, 1, 1, Qt::AlignRight);
+    mainLayout->addWidget(chargeValue, 5, 1);
+    mainLayout->addWidget(statusLabel, 6, 0, 1, 2);
+    mainLayout->addWidget(buttonBox, 7, 0, 1, 2);
+
+    /* set some GUI options for the table grid. */
+    mainLayout->setRowMinimumHeight(7, 35);
+    mainLayout->setRowStretch(7, 1);
+    mainLayout->setColumnMinimumWidth(1, 250);
+
+    /* do not allow to resize the form. */
+    mainLayout->setSizeConstraint (QLayout::SetFixedSize);
+
+    /* set the layout for the pay station form. */
+    setLayout(mainLayout);
+
+    /* set the text of the form's window. */
+    setWindowTitle(stationWinTitleStr);
+
+    /* cache the open transactions (the changes of this connection too). */
+    service.refresh(QSqlDatabase::database(), true);
+
+    /* focus the vehicle and start the live quote. */
+    plateEdit->setFocus();
+    clearQuote(QString());
+    refreshTimer->start();
+}
+
+/* stop the live quote and close the form. */
+void
+PayStationForm::done(const int result) {
+    refreshTimer->stop();
+
+    /* return from the form. */
+    QDialog::done(result);
+}
+
+/* quote the vehicle (or ticket) again with the current time. */
+void
+PayStationForm::refreshQuote() {
+    /* the cache reads the DB only if the gates changed it. */
+    if (!service.refresh(QSqlDatabase::database())) {
+        clearQuote(stationDBErrorStr);
+        return;
+    }
+
+    const QString plate = plateEdit->text().trimmed();
+
+    if (plate.isEmpty()) {
+        clearQuote(QString());
+        return;
+    }
+
+    /* a number may be the ticket instead of the registration number. */
+    const QDateTime now = QDateTime::currentDateTime();
+    ticketQuote quote;
+
+    bool isTicket;
+    const int tranId = plate.toInt(&isTicket);
+
+    ParkingEngine::gateResult result = service.quotePlate(plate, now, quote);
+    if (result == ParkingEngine::Gate_NoTicket && isTicket) result = service.quoteTicket(tranId, now, quote);
+
+    if (result == ParkingEngine::Gate_NoTicket) {
+        clearQuote(stationNoTicketStr);
+        return;
+    }
+
+    /* show the quote. */
+    customerValue->setText(quote.customer);
+    cardValue->setText(quote.card);
+    startValue->setText(quote.start.toString(dateTimeFormatStr));
+    stayValue->setText(stationStayStr.arg(quote.secs / 3600).arg((quote.secs % 3600) / 60));
+
+    if (result == ParkingEngine::Gate_CardExpired) {
+        chargeValue->clear();
+        statusLabel->setText(stationExpiredStr);
+        return;
+    }
+
+    chargeValue->setText(QString::number(quote.charge, 'f', sets.chargePrecision));
+    statusLabel->clear();
+}
+
+/* clear the quote and show a status. */
+void
+PayStationForm::clearQuote(const QString &status) {
+    customerValue->clear();
+    cardValue->clear();
+    startValue->clear();
+    stayValue->clear();
+    chargeValue->clear();
+    statusLabel->setText(status);
+}
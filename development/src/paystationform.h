@@ -0,0 +1,80 @@
+/* header defining the interface of the source. */
+#ifndef PAYSTATIONFORM_H
+#define PAYSTATIONFORM_H
+
+/* include some QT libraries. */
+#include <QDialog>
+
+/* include headers defining the interface of the sources. */
+#include "appsettings.h"
+#include "quoteservice.h"
+
+/* use these classes. */
+class QDialogButtonBox;
+class QPushButton;
+class QLineEdit;
+class QLabel;
+class QTimer;
+
+/* the msecs between the refreshes of the quote. */
+static const int DEF_QUOTE_REFRESH = 1000;
+
+/* GUI string messages. */
+static const QString stationWinTitleStr    = QObject::tr("Pay Station");
+
+static const QString stationPlateLabelStr  = QObject::tr("&Vehicle / Ticket :");
+static const QString stationCustLabelStr   = QObject::tr("Customer :");
+static const QString stationCardLabelStr   = QObject::tr("Card Type :");
+static const QString stationStartLabelStr  = QObject::tr("Start :");
+static const QString stationStayLabelStr   = QObject::tr("Stay :");
+static const QString stationChargeLabelStr = QObject::tr("Charge Now :");
+
+static const QString stationStayStr        = QObject::tr("%1 hour(s) %2 minute(s)");
+static const QString stationNoTicketStr    = QObject::tr("There is no transaction of the vehicle.");
+static const QString stationExpiredStr     = QObject::tr("Customer's card is expired. Renew the card.");
+static const QString stationDBErrorStr     = QObject::tr("The transactions cannot be read.");
+
+/* class which implements the pay station gui form. it shows what the
+   vehicle of a registration number (or a ticket number) owes right now
+   and refreshes it live, without completing the transaction. */
+class PayStationForm : public QDialog
+{
+    Q_OBJECT
+
+    public:
+        PayStationForm(const appSettings sets, QWidget *parent = 0);
+        void done(const int result);
+
+    private slots:
+        void refreshQuote();
+
+    private:
+        void clearQuote(const QString &status);
+
+        appSettings sets;
+        QuoteService service;
+
+        QTimer *refreshTimer;
+
+        QLabel *plateLabel;
+        QLabel *customerLabel;
+        QLabel *cardLabel;
+        QLabel *startLabel;
+        QLabel *stayLabel;
+        QLabel *chargeLabel;
+
+        QLineEdit *plateEdit;
+
+        QLabel *customerValue;
+        QLabel *cardValue;
+        QLabel *startValue;
+        QLabel *stayValue;
+        QLabel *chargeValue;
+        QLabel *statusLabel;
+
+        QPushButton *closeButton;
+
+        QDialogButtonBox *buttonBox;
+};
+
+#endif // PAYSTATIONFORM_H
@@ -19,12 +19,14 @@
 
 /* include some QT libraries. */
 #include <QtGui>
+#include <QtSql>
 
 /* include headers defining the interface of the sources. */
 #include "paywizard.h"
 #include "arithmetictools.h"
 #include "globaldeclarations.h"
 #include "bankingtools.h"
+#include "receiptspooler.h"
 
 /* create the transaction payment wizard (as non-linear state machine). */
 PayWizard::PayWizard(const QString custName, const double charge, QWidget *parent) : QWizard(parent) {
@@ -47,6 +49,17 @@ PayWizard::closeEvent(QCloseEvent *event) {
     event->ignore();
 }
 
+/* cancel the wizard (escape too), but not while a card is authorized:
+   the card may be charged and the transaction must be stored then. */
+void
+PayWizard::reject() {
+    const InsertCardPage *cardPage = qobject_cast<const InsertCardPage *>(page(Page_InsertCard));
+
+    if (cardPage && cardPage->isAuthorizing()) return;
+
+    QWizard::reject();
+}
+
 /* create the payment way selection wizard page. */
 SelectPayWayPage::SelectPayWayPage(const QString custName, const double charge, QWidget *parent) : QWizardPage(parent) {
     /* set the title of the page. */
@@ -174,6 +187,19 @@ InsertCardPage::InsertCardPage(QWidget *parent) : QWizardPage(parent) {
     /* register a mandatory field for the card number. */
     registerField("insertcard.number*", cardEdit);
 
+    /* one payment however many times it is tried (see PaymentGateway). */
+    paymentKey = PaymentGateway::createKey();
+    authorizing = false;
+    charged = false;
+
+    /* the card is authorized in the background. */
+    connect(paymentGateway(), SIGNAL(authorized(const QString &, const int, const QString &)),
+            this, SLOT(handleAuthorization(const QString &, const int, const QString &)));
+
+    /* and stored in the outbox in the background if the bank is down. */
+    connect(paymentOutbox(), SIGNAL(accepted(const QString &, const bool)),
+            this, SLOT(handleOffline(const QString &, const bool)));
+
     /* create the layout of the page. */
     QHBoxLayout *layoutH = new QHBoxLayout;
     layoutH->addWidget(cardLabel);
@@ -196,19 +222,108 @@ InsertCardPage::initializePage() {
 /* logic code for page validation. */
 bool
 InsertCardPage::validatePage() {
-    /* check if the credit card has been charged. */
-    if(chargeCreditCard(cardEdit->text(), field("payment.charge").toDouble())) {
-        /* move to the next page. */
-        return true;
+    /* move to the next page if the credit card has been charged. */
+    if (charged) return true;
+
+    /* wait for the authorization in flight. */
+    if (authorizing) return false;
+
+    /* only the known card types are sent to the bank. */
+    if (getCreditCardType(cardEdit->text()) == creditCardError) {
+        /* show a message. */
+        QMessageBox::warning(this, infoMsgTitleStr, cardNotChargedStr);
+
+        /* stay in the same page. */
+        return false;
     }
 
-    /* show a message. */
-    QMessageBox::warning(this, infoMsgTitleStr, cardNotChargedStr);
+    /* another card is another payment. */
+    if (paymentCard != cardEdit->text()) {
+        if (!paymentCard.isEmpty()) paymentKey = PaymentGateway::createKey();
+        paymentCard = cardEdit->text();
+    }
+
+    /* start the authorization, the page moves on when it is approved. */
+    setAuthorizing(true);
+    paymentGateway()->authorize(paymentKey, cardEdit->text(), field("payment.charge").toDouble());
 
-    /* stay in the same page. */
+    /* stay in the same page (for now). */
     return false;
 }
 
+/* handle the end of an authorization. */
+void
+InsertCardPage::handleAuthorization(const QString &key, const int status, const QString &authCode) {
+    Q_UNUSED(authCode);
+
+    /* the authorization of another payment. */
+    if (key != paymentKey || !authorizing) return;
+
+    if (status == Payment_Approved) {
+        setAuthorizing(false);
+
+        /* move to the next page. */
+        charged = true;
+        wizard()->next();
+        return;
+    }
+
+    if (status == Payment_Declined) {
+        setAuthorizing(false);
+
+        /* a new try is a new payment. */
+        paymentKey = PaymentGateway::createKey();
+        paymentCard.clear();
+
+        /* show a message. */
+        QMessageBox::warning(this, infoMsgTitleStr, cardNotChargedStr);
+        return;
+    }
+
+    /* a small payment is stored and forwarded when the bank answers (the
+       page stays locked until it is stored). */
+    paymentOutbox()->acceptLater(paymentKey, paymentCard, field("payment.charge").toDouble());
+}
+
+/* handle the end of the storing of a payment in the outbox. */
+void
+InsertCardPage::handleOffline(const QString &key, const bool stored) {
+    /* the payment of another page. */
+    if (key != paymentKey || !authorizing) return;
+
+    setAuthorizing(false);
+
+    if (stored) {
+        /* move to the next page. */
+        charged = true;
+        wizard()->next();
+        return;
+    }
+
+    /* the bank may have charged the card, a retry keeps the same key. */
+    QMessageBox::warning(this, infoMsgTitleStr, cardNoAnswerStr);
+}
+
+/* lock (or unlock) the page while the card is authorized. */
+void
+InsertCardPage::setAuthorizing(const bool authorizing) {
+    this->authorizing = authorizing;
+
+    /* the card and the payment cannot change meanwhile. */
+    cardEdit->setReadOnly(authorizing);
+    wizard()->button(QWizard::BackButton)->setDisabled(authorizing);
+    wizard()->button(QWizard::CancelButton)->setDisabled(authorizing);
+
+    topLabel->setText(authorizing ? cardAuthorizingStr
+                                  : payChargeLabelStr + field("payment.charge").toString());
+}
+
+/* check if a card is authorized (or its payment stored) right now. */
+bool
+InsertCardPage::isAuthorizing() const {
+    return authorizing;
+}
+
 /* set the next page for the next button. */
 int
 InsertCardPage::nextId() const {
@@ -287,29 +402,22 @@ CompletePage::setVisible(bool visible) {
     }
 }
 
-/* print a simple receipt for the payment transaction. */
+/* print a simple receipt for the payment transaction (it is formatted
+   and printed by the receipt spooler, the wizard never waits for it). */
 void
 CompletePage::printButtonClicked() {
-    /* create a printer object. */
-    QPrinter printer;
-
-    /* create a print dialog and assign it with the printer. */
-    QPrintDialog dialog(&printer, this);
-
-    /* open the dialog and handle printing properties. */
-    if (dialog.exec()) {
-        /* create a html text document. */
-        QTextDocument textDocument;
-
-        /* create html for the text document. */
-        QString html = payReceiptHtmlStr.arg(appName,
-                                             appVersion,
-                                             field("customer.name").toString(),
-                                             QDateTime::currentDateTime().toString(dateTimeFormatStr),
-                                             field("payment.charge").toString());
-
-        /* print the document .*/
-        textDocument.setHtml(html);
-        textDocument.print(&printer);
-    }
+    /* the fields of the receipt template. */
+    QHash<QString, QString> fields;
+    fields.insert("app", appName);
+    fields.insert("version", appVersion);
+    fields.insert("customer", field("customer.name").toString());
+    fields.insert("time", QDateTime::currentDateTime().toString(dateTimeFormatStr));
+    fields.insert("charge", field("payment.charge").toString());
+    fields.insert("way", QString(wizard()->hasVisitedPage(PayWizard::Page_InsertCash) ? payWayCashLabelStr
+                                                                                      : payWayCardLabelStr).remove('&'));
+
+    receiptSpooler()->submit(fields);
+
+    /* inform the user. */
+    topLabel->setText(topLabel->text() + "\n" + receiptQueuedStr);
 }
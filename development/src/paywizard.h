@@ -27,15 +27,12 @@ static const QString inputCardLabelStr   = QObject::tr("&Credit Card :");
 
 static const QString notManyMoneyStr     = QObject::tr("Please input enough money for the charge.");
 static const QString cardNotChargedStr   = QObject::tr("Unfortunately, credit card cannot be charged.");
+static const QString cardNoAnswerStr     = QObject::tr("The bank did not answer, please try again.");
+static const QString cardAuthorizingStr  = QObject::tr("Authorizing the credit card, please wait...");
 static const QString cardChargedLabelStr = QObject::tr("The credit card has been charged.");
 static const QString payWayTopLabelStr   = QObject::tr("Please select a payment way in order to continue.");
 
-static const QString payReceiptHtmlStr   = QObject::tr(
-        "<h2>%1 %2</h2>"
-        "<p>Receipt for transaction payment.</p>"
-        "<ul><li>Customer Name : <b>%3</b></li>"
-        "<li>Date & Time : <b>%4</b></li>"
-        "<li>Payment Charge : <b>%5</b></li></ul>");
+static const QString receiptQueuedStr    = QObject::tr("The receipt is being printed.");
 
 /* class which implements the transaction payment wizard (as non-linear state machine). */
 class PayWizard : public QWizard
@@ -53,6 +50,9 @@ class PayWizard : public QWizard
 
         PayWizard(const QString custName, const double charge, QWidget *parent = 0);
 
+    public slots:
+        void reject();
+
     protected:
         void closeEvent(QCloseEvent *event);
 };
@@ -99,8 +99,20 @@ class InsertCardPage : public QWizardPage
         void initializePage();
         bool validatePage();
         int nextId() const;
+        bool isAuthorizing() const;
+
+    private slots:
+        void handleAuthorization(const QString &key, const int status, const QString &authCode);
+        void handleOffline(const QString &key, const bool stored);
 
     private:
+        void setAuthorizing(const bool authorizing);
+
+        QString paymentKey;
+        QString paymentCard;      /* the card of the key. */
+        bool authorizing;
+        bool charged;
+
         QLabel *cardLabel;
         QLineEdit *cardEdit;
         QLabel *topLabel;
@@ -0,0 +1,383 @@
+/*
+ *  This file implements the tracing of the sql statements (slow-query log).
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+#include <QtSql>
+
+/* include headers defining the interface of the sources. */
+#include "querytracer.h"
+#include "appsettings.h"
+
+/* guards the creation of the tracer of the application. */
+static QMutex applicationTracerMutex;
+
+/* create a tracer (the log is opened for every slow statement). */
+QueryTracer::QueryTracer(const QString &logFileName, const int slowMsecs,
+                         const qint64 maxLogSize, const int logFiles) {
+    this->logFileName = logFileName;
+    this->maxLogSize = maxLogSize;
+    this->logFiles = logFiles;
+
+    setSlowMsecs(slowMsecs);
+}
+
+/* change the msecs after which a statement is slow (any thread). */
+void
+QueryTracer::setSlowMsecs(const int msecs) {
+    slowUsecs.fetchAndStoreOrdered(qMax(msecs, 0) * 1000);
+}
+
+/* the msecs after which a statement is slow. */
+int
+QueryTracer::slowMsecs() const {
+    return (int) slowUsecs / 1000;
+}
+
+/* trace an execution of a statement (by the thread of the connection,
+   the plan of a slow one is read on it). */
+void
+QueryTracer::trace(QSqlDatabase db, const queryTrace &trace,
+                   const QList<QPair<QString, QVariant> > &values) {
+    const bool slow = trace.usecs >= (int) slowUsecs;
+
+    {
+        QMutexLocker locker(&summaryMutex);
+
+        QHash<QString, statementSummary>::iterator i = summaries.find(trace.statement);
+
+        if (i == summaries.end() && summaries.size() < MAX_TRACED_STATEMENTS) {
+            statementSummary summary;
+            summary.statement = trace.statement;
+            summary.executions = summary.slow = summary.rows = 0;
+            summary.totalUsecs = summary.maxUsecs = 0;
+
+            i = summaries.insert(trace.statement, summary);
+        }
+
+        if (i != summaries.end()) {
+            i.value().executions++;
+            i.value().slow += slow ? 1 : 0;
+            i.value().rows += qMax(trace.rows, 0);
+            i.value().totalUsecs += trace.usecs;
+            i.value().maxUsecs = qMax(i.value().maxUsecs, trace.usecs);
+        }
+    }
+
+    if (!slow) return;
+
+    /* the trace, the statement in one line and its plan. */
+    QString entry = QString("%1 %2 ms, %3 row(s), %4 bind(s), connection '%5'%6\n")
+                        .arg(QDateTime::currentDateTime().toString(Qt::ISODate))
+                        .arg(trace.usecs / 1000.0, 0, 'f', 1)
+                        .arg(trace.rows)
+                        .arg(trace.binds)
+                        .arg(db.connectionName())
+                        .arg(trace.ok ? QString() : ", failed: " + trace.error);
+
+    entry += "  " + trace.statement.simplified() + "\n";
+
+    foreach (const QString &step, queryPlan(db, trace.statement, values))
+        entry += "  plan: " + step + "\n";
+
+    writeLog(entry);
+}
+
+/* the summaries of the statements traced (the slowest in total first). */
+QList<statementSummary>
+QueryTracer::statements() {
+    QMutexLocker locker(&summaryMutex);
+
+    QMultiMap<qint64, statementSummary> ordered;
+
+    foreach (const statementSummary &summary, summaries)
+        ordered.insert(-summary.totalUsecs, summary);
+
+    return ordered.values();
+}
+
+/* the plan of a statement with the same values (a step per row, empty if
+   it has none, e.g. not a query). the plan itself is not traced. */
+QStringList
+QueryTracer::queryPlan(QSqlDatabase db, const QString &statement,
+                       const QList<QPair<QString, QVariant> > &values) {
+    QStringList plan;
+
+    /* declare a sql query object for the DB. */
+    QSqlQuery query(db);
+
+    if (!query.prepare("EXPLAIN QUERY PLAN " + statement)) return plan;
+
+    for (int i = 0; i < values.size(); i++) {
+        if (values.at(i).first.isEmpty())
+            query.addBindValue(values.at(i).second);
+        else
+            query.bindValue(values.at(i).first, values.at(i).second);
+    }
+
+    if (!query.exec()) return plan;
+
+    /* the detail is the last column (in every version of sqlite). */
+    const int detail = query.record().count() - 1;
+
+    while (query.next())
+        plan << query.value(detail).toString();
+
+    return plan;
+}
+
+/* append an entry to the log (rotated when it grows too large). */
+void
+QueryTracer::writeLog(const QString &entry) {
+    QMutexLocker locker(&logMutex);
+
+    QFile file(logFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) return;
+
+    file.write(entry.toUtf8());
+
+    const qint64 size = file.size();
+    file.close();
+
+    if (size >= maxLogSize) rotateLog();
+}
+
+/* move the log to the first old one (and every old one to the next). */
+void
+QueryTracer::rotateLog() {
+    QFile::remove(QString("%1.%2").arg(logFileName).arg(logFiles));
+
+    for (int i = logFiles - 1; i >= 1; i--)
+        QFile::rename(QString("%1.%2").arg(logFileName).arg(i), QString("%1.%2").arg(logFileName).arg(i + 1));
+
+    if (logFiles > 0)
+        QFile::rename(logFileName, logFileName + ".1");
+    else
+        QFile::remove(logFileName);
+}
+
+/* create a traced query on a connection (the default one if none). */
+TracedQuery::TracedQuery(QSqlDatabase db) : QSqlQuery(db) {
+    database = db.isValid() ? db : QSqlDatabase::database();
+    executed = false;
+    tracing = false;
+}
+
+/* trace the last execution. */
+TracedQuery::~TracedQuery() {
+    stop();
+}
+
+/* prepare a statement (its values are bound next). */
+bool
+TracedQuery::prepare(const QString &query) {
+    stop();
+
+    prepared = query;
+    values.clear();
+    executed = false;
+
+    return QSqlQuery::prepare(query);
+}
+
+/* bind a value to a named placeholder. */
+void
+TracedQuery::bindValue(const QString &placeholder, const QVariant &value) {
+    for (int i = 0; i < values.size(); i++) {
+        if (values.at(i).first == placeholder) {
+            values[i].second = value;
+            QSqlQuery::bindValue(placeholder, value);
+            return;
+        }
+    }
+
+    values << qMakePair(placeholder, value);
+    QSqlQuery::bindValue(placeholder, value);
+}
+
+/* bind a value to the next positional placeholder. */
+void
+TracedQuery::addBindValue(const QVariant &value) {
+    /* the positional values start again after an execution. */
+    if (executed) {
+        for (int i = values.size() - 1; i >= 0; i--)
+            if (values.at(i).first.isEmpty()) values.removeAt(i);
+
+        executed = false;
+    }
+
+    values << qMakePair(QString(), value);
+    QSqlQuery::addBindValue(value);
+}
+
+/* execute a statement (without values). */
+bool
+TracedQuery::exec(const QString &query) {
+    stop();
+
+    prepared.clear();
+    values.clear();
+
+    start(query);
+
+    const bool ok = QSqlQuery::exec(query);
+
+    current.usecs += timer.nsecsElapsed() / 1000;
+    current.ok = ok;
+    current.error = ok ? QString() : lastError().text();
+
+    if (ok && !isSelect()) current.rows = numRowsAffected();
+
+    return ok;
+}
+
+/* execute the prepared statement with its values. */
+bool
+TracedQuery::exec() {
+    stop();
+    start(prepared);
+
+    const bool ok = QSqlQuery::exec();
+
+    current.usecs += timer.nsecsElapsed() / 1000;
+    current.ok = ok;
+    current.error = ok ? QString() : lastError().text();
+
+    if (ok && !isSelect()) current.rows = numRowsAffected();
+
+    executed = true;
+
+    return ok;
+}
+
+/* fetch the next row (the execution is traced after the last one). */
+bool
+TracedQuery::next() {
+    if (!tracing) return QSqlQuery::next();
+
+    timer.start();
+    const bool fetched = QSqlQuery::next();
+    current.usecs += timer.nsecsElapsed() / 1000;
+
+    if (fetched) current.rows++;
+    else stop();
+
+    return fetched;
+}
+
+/* trace the execution and release its rows. */
+void
+TracedQuery::finish() {
+    stop();
+    QSqlQuery::finish();
+}
+
+/* start tracing an execution of a statement. */
+void
+TracedQuery::start(const QString &statement) {
+    tracing = true;
+
+    current.statement = statement;
+    current.binds = values.size();
+    current.rows = 0;
+    current.usecs = 0;
+    current.ok = false;
+    current.error.clear();
+
+    tracedValues = values;
+
+    timer.start();
+}
+
+/* trace the execution (once). */
+void
+TracedQuery::stop() {
+    if (!tracing) return;
+
+    tracing = false;
+    queryTracer()->trace(database, current, tracedValues);
+}
+
+/* create a table model with traced selects. */
+TracedTableModel::TracedTableModel(QObject *parent, QSqlDatabase db) : QSqlTableModel(parent, db) {
+}
+
+/* select the rows and trace it (the rows of the first fetch). */
+bool
+TracedTableModel::select() {
+    QElapsedTimer timer;
+    timer.start();
+
+    const bool ok = QSqlTableModel::select();
+
+    queryTrace trace;
+    trace.statement = selectStatement();
+    trace.binds = 0;
+    trace.rows = rowCount();
+    trace.usecs = timer.nsecsElapsed() / 1000;
+    trace.ok = ok;
+    trace.error = ok ? QString() : lastError().text();
+
+    queryTracer()->trace(database(), trace);
+
+    return ok;
+}
+
+/* create a relational table model with traced selects. */
+TracedRelationalTableModel::TracedRelationalTableModel(QObject *parent, QSqlDatabase db) : QSqlRelationalTableModel(parent, db) {
+}
+
+/* select the rows and trace it (the rows of the first fetch). */
+bool
+TracedRelationalTableModel::select() {
+    QElapsedTimer timer;
+    timer.start();
+
+    const bool ok = QSqlRelationalTableModel::select();
+
+    queryTrace trace;
+    trace.statement = selectStatement();
+    trace.binds = 0;
+    trace.rows = rowCount();
+    trace.usecs = timer.nsecsElapsed() / 1000;
+    trace.ok = ok;
+    trace.error = ok ? QString() : lastError().text();
+
+    queryTracer()->trace(database(), trace);
+
+    return ok;
+}
+
+/* the query tracer of the application (any thread). */
+QueryTracer *
+queryTracer() {
+    QMutexLocker locker(&applicationTracerMutex);
+
+    static QueryTracer *tracer = 0;
+
+    /* it lives as long as the application. */
+    if (!tracer) {
+        QSettings s(setsAppOrg, setsAppName);
+
+        tracer = new QueryTracer(s.value("tracing/slow_log", defSlowQueryLogStr).toString(),
+                                 s.value("tracing/slow_msecs", DEF_SLOW_QUERY_MSECS).toInt());
+    }
+
+    return tracer;
+}
@@ -0,0 +1,147 @@
+/* header defining the interface of the source. */
+#ifndef QUERYTRACER_H
+#define QUERYTRACER_H
+
+/* include some QT libraries. */
+#include <QSqlQuery>
+#include <QSqlTableModel>
+#include <QSqlRelationalTableModel>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QVariant>
+#include <QString>
+#include <QStringList>
+#include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QPair>
+
+/* the default msecs after which a statement is slow (logged with its plan). */
+static const int DEF_SLOW_QUERY_MSECS = 100;
+
+/* the default slow-query log, its largest size and the old logs kept
+   (slow-queries.log.1 is the newest of them). */
+static const QString defSlowQueryLogStr = "slow-queries.log";
+static const qint64 DEF_SLOW_LOG_SIZE = 1024 * 1024;
+static const int DEF_SLOW_LOG_FILES = 4;
+
+/* the most statements summarized (the rest are only logged if slow). */
+static const int MAX_TRACED_STATEMENTS = 512;
+
+/* query trace structure data type (an execution of a statement). */
+typedef struct queryTrace {
+    QString statement;
+    int binds;            /* values bound to it. */
+    int rows;             /* fetched (select) or affected (the rest), -1 if unknown. */
+    qint64 usecs;         /* executing and fetching. */
+    bool ok;
+    QString error;
+} queryTrace;
+
+/* statement summary structure data type (all the traces of a statement). */
+typedef struct statementSummary {
+    QString statement;
+    qint64 executions;
+    qint64 slow;
+    qint64 rows;
+    qint64 totalUsecs;
+    qint64 maxUsecs;
+} statementSummary;
+
+/* class which implements the tracer of the sql statements. it summarizes
+   the traces per statement and, for the slow ones, writes the trace and
+   the plan of the statement (EXPLAIN QUERY PLAN on the same connection,
+   with the same values) to a log, which is rotated when it grows too
+   large. a table scan in a plan points at a missing index. */
+class QueryTracer
+{
+    public:
+        QueryTracer(const QString &logFileName = defSlowQueryLogStr,
+                    const int slowMsecs = DEF_SLOW_QUERY_MSECS,
+                    const qint64 maxLogSize = DEF_SLOW_LOG_SIZE,
+                    const int logFiles = DEF_SLOW_LOG_FILES);
+
+        void setSlowMsecs(const int msecs);
+        int slowMsecs() const;
+
+        void trace(QSqlDatabase db, const queryTrace &trace,
+                   const QList<QPair<QString, QVariant> > &values = QList<QPair<QString, QVariant> >());
+
+        QList<statementSummary> statements();
+
+        static QStringList queryPlan(QSqlDatabase db, const QString &statement,
+                                     const QList<QPair<QString, QVariant> > &values);
+
+    private:
+        void writeLog(const QString &entry);
+        void rotateLog();
+
+        QString logFileName;
+        qint64 maxLogSize;
+        int logFiles;
+        QAtomicInt slowUsecs;
+
+        QMutex summaryMutex;
+        QHash<QString, statementSummary> summaries;
+
+        QMutex logMutex;
+
+        Q_DISABLE_COPY(QueryTracer)
+};
+
+/* class which implements a traced sql query. it is used as a QSqlQuery,
+   every execution (with the fetching of its rows) is traced when the
+   next one starts or the query is destroyed. */
+class TracedQuery : public QSqlQuery
+{
+    public:
+        TracedQuery(QSqlDatabase db = QSqlDatabase());
+        ~TracedQuery();
+
+        bool prepare(const QString &query);
+        void bindValue(const QString &placeholder, const QVariant &value);
+        void addBindValue(const QVariant &value);
+
+        bool exec(const QString &query);
+        bool exec();
+
+        bool next();
+        void finish();
+
+    private:
+        void start(const QString &statement);
+        void stop();
+
+        QSqlDatabase database;
+        QString prepared;
+        QList<QPair<QString, QVariant> > values;    /* bound (a positional one without name). */
+        bool executed;                              /* the next positional values replace them. */
+
+        bool tracing;
+        queryTrace current;
+        QList<QPair<QString, QVariant> > tracedValues;
+        QElapsedTimer timer;
+};
+
+/* class which implements a table model whose selects are traced. */
+class TracedTableModel : public QSqlTableModel
+{
+    public:
+        TracedTableModel(QObject *parent = 0, QSqlDatabase db = QSqlDatabase());
+
+        bool select();
+};
+
+/* class which implements a relational table model whose selects are traced. */
+class TracedRelationalTableModel : public QSqlRelationalTableModel
+{
+    public:
+        TracedRelationalTableModel(QObject *parent = 0, QSqlDatabase db = QSqlDatabase());
+
+        bool select();
+};
+
+/* the query tracer of the application (created from the settings once). */
+QueryTracer *queryTracer();
+
+#endif // QUERYTRACER_H
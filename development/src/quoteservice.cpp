@@ -0,0 +1,156 @@
+/*
+ *  This file implements the quotes of the open tickets.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtSql>
+
+/* include headers defining the interface of the sources. */
+#include "quoteservice.h"
+#include "chargingtools.h"
+
+/* create the service with an empty cache (refresh it to quote). */
+QuoteService::QuoteService(const appSettings &sets) {
+    tariff = loadTariff(sets);
+    dataVersion = -1;
+}
+
+/* change the settings of the next quotes. */
+void
+QuoteService::setSettings(const appSettings &sets) {
+    const TariffEngine compiled = loadTariff(sets);
+
+    QWriteLocker locker(&lock);
+    tariff = compiled;
+}
+
+/* cache again the open tickets and the cards of their customers. it reads
+   the DB only if another connection changed it since the last time (the
+   data version of SQLite), unless forced (the changes of this connection). */
+bool
+QuoteService::refresh(QSqlDatabase db, const bool force) {
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+
+    if (!query.exec("PRAGMA data_version") || !query.next()) return false;
+
+    const int version = query.value(0).toInt();
+
+    {
+        QReadLocker locker(&lock);
+        if (!force && version == dataVersion) return true;
+    }
+
+    /* the open tickets with the card of their customer. */
+    query.setForwardOnly(true);
+
+    if (!query.exec("SELECT tran.id, tran.start_date, tran.start_time, vehi.reg_num, "
+                    "       cust.id, cust.name, cust.card_id, cust.card_expiry, card.title "
+                    "FROM transacts AS tran "
+                    "INNER JOIN vehicle AS vehi ON vehi.id = tran.vehi_id "
+                    "INNER JOIN customer AS cust ON cust.id = tran.cust_id "
+                    "INNER JOIN cardtype AS card ON card.id = cust.card_id"))
+        return false;
+
+    QHash<int, openTicket> newTickets;
+    QHash<QString, int> newPlates;
+    QHash<int, customerCard> newCards;
+
+    while (query.next()) {
+        openTicket ticket;
+        ticket.tranId = query.value(0).toInt();
+        ticket.start = QDateTime(query.value(1).toDate(), query.value(2).toTime());
+        ticket.plate = query.value(3).toString();
+        ticket.custId = query.value(4).toInt();
+
+        newTickets.insert(ticket.tranId, ticket);
+        newPlates.insert(ticket.plate, ticket.tranId);
+
+        if (!newCards.contains(ticket.custId)) {
+            customerCard card;
+            card.name = query.value(5).toString();
+            card.cardType = query.value(6).toInt() - 1; /* for fixing with indexes. */
+            card.cardExpiry = query.value(7).toLongLong();
+            card.title = query.value(8).toString();
+
+            newCards.insert(ticket.custId, card);
+        }
+    }
+
+    if (query.lastError().isValid()) return false;
+
+    /* swap the new cache in (the quotes wait only for the swap). */
+    QWriteLocker locker(&lock);
+
+    openTickets.swap(newTickets);
+    plates.swap(newPlates);
+    cards.swap(newCards);
+    dataVersion = version;
+
+    return true;
+}
+
+/* the open tickets cached. */
+int
+QuoteService::tickets() {
+    QReadLocker locker(&lock);
+    return openTickets.size();
+}
+
+/* quote a ticket by its id. */
+ParkingEngine::gateResult
+QuoteService::quoteTicket(const int tranId, const QDateTime &when, ticketQuote &quote) {
+    QReadLocker locker(&lock);
+
+    QHash<int, openTicket>::const_iterator ticket = openTickets.constFind(tranId);
+    if (ticket == openTickets.constEnd()) return ParkingEngine::Gate_NoTicket;
+
+    return this->quote(ticket.value(), when, quote);
+}
+
+/* quote the ticket of a vehicle by its registration number. */
+ParkingEngine::gateResult
+QuoteService::quotePlate(const QString &plate, const QDateTime &when, ticketQuote &quote) {
+    QReadLocker locker(&lock);
+
+    QHash<QString, int>::const_iterator tranId = plates.constFind(plate);
+    if (tranId == plates.constEnd()) return ParkingEngine::Gate_NoTicket;
+
+    return this->quote(openTickets.value(tranId.value()), when, quote);
+}
+
+/* quote a cached ticket with the same rules as its completion (locked). */
+ParkingEngine::gateResult
+QuoteService::quote(const openTicket &ticket, const QDateTime &when, ticketQuote &quote) {
+    const customerCard card = cards.value(ticket.custId);
+
+    quote.tranId = ticket.tranId;
+    quote.plate = ticket.plate;
+    quote.customer = card.name;
+    quote.card = card.title;
+    quote.start = ticket.start;
+    quote.secs = ticket.start.secsTo(when);
+    quote.charge = 0;
+
+    /* an expired card must be renewed first. */
+    if (isCardExpired(card.cardExpiry, when.date().toJulianDay())) return ParkingEngine::Gate_CardExpired;
+
+    quote.charge = tariff.charge(ticket.start, when, card.cardType);
+
+    return ParkingEngine::Gate_Ok;
+}
@@ -0,0 +1,74 @@
+/* header defining the interface of the source. */
+#ifndef QUOTESERVICE_H
+#define QUOTESERVICE_H
+
+/* include some QT libraries. */
+#include <QDateTime>
+#include <QSqlDatabase>
+#include <QReadWriteLock>
+#include <QString>
+#include <QHash>
+
+/* include headers defining the interface of the sources. */
+#include "parkingengine.h"
+#include "tariffengine.h"
+#include "appsettings.h"
+
+/* ticket quote structure data type (what a vehicle owes now). */
+typedef struct ticketQuote {
+    int tranId;
+    QString plate;
+    QString customer;
+    QString card;         /* title of the card type. */
+    QDateTime start;
+    qint64 secs;          /* stay until the quote time. */
+    double charge;
+} ticketQuote;
+
+/* class which implements the quotes of the open tickets. the tickets and
+   the cards of their customers are cached (one query per refresh, nothing
+   when the DB did not change), so a quote costs no SQL: a hash lookup,
+   the card check and the tariff. it can quote from many threads while
+   another one refreshes it. */
+class QuoteService
+{
+    public:
+        QuoteService(const appSettings &sets);
+
+        void setSettings(const appSettings &sets);
+
+        bool refresh(QSqlDatabase db, const bool force = false);
+        int tickets();
+
+        ParkingEngine::gateResult quoteTicket(const int tranId, const QDateTime &when, ticketQuote &quote);
+        ParkingEngine::gateResult quotePlate(const QString &plate, const QDateTime &when, ticketQuote &quote);
+
+    private:
+        /* cached open ticket structure data type. */
+        typedef struct openTicket {
+            int tranId;
+            int custId;
+            QString plate;
+            QDateTime start;
+        } openTicket;
+
+        /* cached customer card structure data type. */
+        typedef struct customerCard {
+            QString name;
+            QString title;
+            int cardType;
+            qint64 cardExpiry;    /* julian day (0 for never). */
+        } customerCard;
+
+        ParkingEngine::gateResult quote(const openTicket &ticket, const QDateTime &when, ticketQuote &quote);
+
+        TariffEngine tariff;
+
+        QReadWriteLock lock;
+        QHash<int, openTicket> openTickets;   /* by ticket. */
+        QHash<QString, int> plates;           /* ticket of every plate. */
+        QHash<int, customerCard> cards;       /* by customer. */
+        int dataVersion;                      /* of the DB when cached (-1 for none). */
+};
+
+#endif // QUOTESERVICE_H
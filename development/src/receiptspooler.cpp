@@ -0,0 +1,301 @@
+/*
+ *  This file implements the receipt spooler (formatting and printing).
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+
+/* include headers defining the interface of the sources. */
+#include "receiptspooler.h"
+#include "appsettings.h"
+
+/* printer control structure data type (the ESC/POS bytes of a control). */
+typedef struct receiptControl {
+    const char *name;
+    const char *bytes;
+    int length;
+} receiptControl;
+
+/* the printer controls of the templates. */
+static const receiptControl receiptControls[] = {
+    { "init",   "\x1B\x40",     2 },  /* ESC @ */
+    { "center", "\x1B\x61\x01", 3 },  /* ESC a 1 */
+    { "left",   "\x1B\x61\x00", 3 },  /* ESC a 0 */
+    { "bold",   "\x1B\x45\x01", 3 },  /* ESC E 1 */
+    { "/bold",  "\x1B\x45\x00", 3 },  /* ESC E 0 */
+    { "big",    "\x1D\x21\x11", 3 },  /* GS ! 0x11 (double width and height) */
+    { "/big",   "\x1D\x21\x00", 3 },  /* GS ! 0 */
+    { "cut",    "\x1D\x56\x01", 3 }   /* GS V 1 (partial cut) */
+};
+
+static const int RECEIPT_CONTROLS_COUNT = sizeof(receiptControls) / sizeof(receiptControls[0]);
+
+/* the extension of the receipt files. */
+static const QString receiptSuffixStr = ".prn";
+
+/* compile a receipt template to byte segments (the printer controls are
+   resolved once, only the fields are filled in for every receipt). */
+bool
+compileReceiptTemplate(const QString &text, const receiptFormat format,
+                       receiptTemplate &compiled, QString &error) {
+    compiled.segments.clear();
+    compiled.fields.clear();
+
+    receiptSegment segment;
+    segment.field = -1;
+
+    int i = 0;
+
+    while (i < text.size()) {
+        const int open = text.indexOf('{', i);
+
+        /* the text up to the next brace. */
+        segment.bytes += text.mid(i, open < 0 ? -1 : open - i).toLatin1();
+        if (open < 0) break;
+
+        const int close = text.indexOf('}', open);
+
+        if (close < 0) {
+            error = QString("receipt template: no '}' for the '{' at %1").arg(open);
+            return false;
+        }
+
+        const QString name = text.mid(open + 1, close - open - 1).trimmed();
+        i = close + 1;
+
+        if (name.isEmpty()) {
+            error = QString("receipt template: empty braces at %1").arg(open);
+            return false;
+        }
+
+        /* a printer control is some more bytes (none for plain text). */
+        int control = 0;
+        while (control < RECEIPT_CONTROLS_COUNT && name != receiptControls[control].name) control++;
+
+        if (control < RECEIPT_CONTROLS_COUNT) {
+            if (format == Receipt_EscPos)
+                segment.bytes += QByteArray(receiptControls[control].bytes, receiptControls[control].length);
+            continue;
+        }
+
+        /* a field ends the segment. */
+        if (!compiled.fields.contains(name)) compiled.fields << name;
+
+        segment.field = compiled.fields.indexOf(name);
+        compiled.segments << segment;
+
+        segment.bytes.clear();
+        segment.field = -1;
+    }
+
+    if (!segment.bytes.isEmpty()) compiled.segments << segment;
+
+    return true;
+}
+
+/* fill in the fields of a compiled receipt (a missing field is empty). */
+QByteArray
+formatReceipt(const receiptTemplate &compiled, const QHash<QString, QString> &fields) {
+    /* the values of the fields once. */
+    QList<QByteArray> values;
+
+    foreach (const QString &name, compiled.fields)
+        values << fields.value(name).toLatin1();
+
+    QByteArray receipt;
+
+    foreach (const receiptSegment &segment, compiled.segments) {
+        receipt += segment.bytes;
+        if (segment.field >= 0) receipt += values.at(segment.field);
+    }
+
+    return receipt;
+}
+
+/* create the spooler (call start() to run it). */
+ReceiptSpooler::ReceiptSpooler(const receiptTemplate &compiled, const QString &spool, const QString &printer, QObject *parent) : QThread(parent) {
+    this->compiled = compiled;
+    spoolPath = spool;
+    printerPath = printer;
+
+    spooled = 0;
+}
+
+/* stop the spooler (the receipts already submitted are spooled). */
+ReceiptSpooler::~ReceiptSpooler() {
+    stop();
+    wait();
+}
+
+/* submit a receipt (any thread, never blocks). */
+void
+ReceiptSpooler::submit(const QHash<QString, QString> &fields) {
+    queue.push(fields);
+
+    /* wake up the spooler. */
+    pending.release();
+}
+
+/* ask the spooler to stop when the queue is empty. */
+void
+ReceiptSpooler::stop() {
+    stopping.fetchAndStoreOrdered(1);
+
+    /* wake up the spooler. */
+    pending.release();
+}
+
+/* the spooler's loop. */
+void
+ReceiptSpooler::run() {
+    QDir().mkpath(spoolPath);
+
+    /* the receipts left by a previous run first. */
+    printSpool();
+
+    QHash<QString, QString> fields;
+
+    forever {
+        /* sleep until a receipt arrives (or it is time to try the spool again). */
+        pending.tryAcquire(1, DEF_RECEIPT_RETRY);
+
+        bool spooledAny = false;
+
+        while (queue.pop(fields)) {
+            if (!spool(formatReceipt(compiled, fields)))
+                emit printerFailed(QString("cannot spool a receipt to '%1'").arg(spoolPath));
+
+            spooledAny = true;
+        }
+
+        printSpool();
+
+        /* stop only when the queue is empty. */
+        if (!spooledAny && stopping.fetchAndAddOrdered(0)) break;
+    }
+}
+
+/* store a receipt in the spool (the name keeps the order of the receipts). */
+bool
+ReceiptSpooler::spool(const QByteArray &receipt) {
+    const QString name = QString("%1-%2%3").arg(QDateTime::currentDateTime().toString("yyyyMMddhhmmsszzz"))
+                                           .arg(++spooled, 6, 10, QChar('0'))
+                                           .arg(receiptSuffixStr);
+
+    /* written aside and renamed, the printer never takes half a receipt. */
+    QFile file(QDir(spoolPath).filePath(name + ".tmp"));
+
+    if (!file.open(QIODevice::WriteOnly) || file.write(receipt) != receipt.size()) return false;
+
+    file.close();
+
+    return file.rename(QDir(spoolPath).filePath(name));
+}
+
+/* send a spooled receipt to the printer (and remove it from the spool). */
+bool
+ReceiptSpooler::print(const QString &name, QString &error) {
+    QFile file(QDir(spoolPath).filePath(name));
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+
+    const QByteArray receipt = file.readAll();
+    file.close();
+
+    /* a virtual printer keeps the receipt as a file. */
+    if (QFileInfo(printerPath).isDir()) {
+        const QString printed = QDir(printerPath).filePath(name);
+
+        QFile::remove(printed);
+
+        if (!file.rename(printed)) {
+            error = file.errorString();
+            return false;
+        }
+
+        return true;
+    }
+
+    /* a printer device (or a file) takes the bytes. */
+    QFile printer(printerPath);
+
+    if (!printer.open(QIODevice::WriteOnly | QIODevice::Append) || printer.write(receipt) != receipt.size()) {
+        error = printer.errorString();
+        return false;
+    }
+
+    printer.close();
+
+    return file.remove();
+}
+
+/* send the spooled receipts to the printer in their order (until it fails). */
+void
+ReceiptSpooler::printSpool() {
+    const QStringList names = QDir(spoolPath).entryList(QStringList() << "*" + receiptSuffixStr, QDir::Files, QDir::Name);
+
+    foreach (const QString &name, names) {
+        QString error;
+
+        if (!print(name, error)) {
+            emit printerFailed(error);
+            return;
+        }
+
+        emit printed(name);
+    }
+}
+
+/* the receipt spooler of the application (created from the settings once). */
+ReceiptSpooler *
+receiptSpooler() {
+    static ReceiptSpooler *spooler = 0;
+
+    if (!spooler) {
+        QSettings s(setsAppOrg, setsAppName);
+
+        const receiptFormat format = s.value("receipt/format").toString() == "text" ? Receipt_Text : Receipt_EscPos;
+
+        /* the template file (the default one if it cannot be used). */
+        QString text = defReceiptTemplateStr;
+        QFile file(s.value("receipt/template").toString());
+
+        if (!file.fileName().isEmpty() && file.open(QIODevice::ReadOnly | QIODevice::Text))
+            text = QString::fromUtf8(file.readAll());
+
+        receiptTemplate compiled;
+        QString error;
+
+        if (!compileReceiptTemplate(text, format, compiled, error))
+            compileReceiptTemplate(defReceiptTemplateStr, format, compiled, error);
+
+        /* the virtual printer by default. */
+        const QString printer = s.value("receipt/printer", defReceiptPrinterStr).toString();
+        if (printer == defReceiptPrinterStr) QDir().mkpath(printer);
+
+        /* it lives as long as the application. */
+        spooler = new ReceiptSpooler(compiled, s.value("receipt/spool", defReceiptSpoolStr).toString(),
+                                     printer, QCoreApplication::instance());
+        spooler->start(QThread::LowPriority);
+    }
+
+    return spooler;
+}
@@ -0,0 +1,111 @@
+/* header defining the interface of the source. */
+#ifndef RECEIPTSPOOLER_H
+#define RECEIPTSPOOLER_H
+
+/* include some QT libraries. */
+#include <QThread>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+
+/* include header defining the interface of the source. */
+#include "mpscqueue.h"
+
+/* the default receipt (fields and printer controls in braces):
+
+     {app} {version} {customer} {time} {charge} {way} and any other
+     field of the receipt, {init} resets the printer, {center} {left}
+     align, {bold} {/bold} and {big} {/big} style the text, {cut} cuts
+     the paper. */
+static const QString defReceiptTemplateStr = "{init}{center}{big}{app}{/big}\n"
+                                             "{version}\n\n"
+                                             "Receipt for transaction payment.\n\n"
+                                             "{left}Customer Name : {bold}{customer}{/bold}\n"
+                                             "Date & Time    : {time}\n"
+                                             "Payment Way    : {way}\n"
+                                             "Payment Charge : {bold}{charge}{/bold}\n"
+                                             "\n\n\n{cut}";
+
+/* the default spool directory of the receipts not printed yet. */
+static const QString defReceiptSpoolStr = "receipts/spool";
+
+/* the default virtual printer (a directory, a file per receipt). */
+static const QString defReceiptPrinterStr = "receipts/printed";
+
+/* msecs before the spooled receipts are tried again (printer offline). */
+static const int DEF_RECEIPT_RETRY = 10000;
+
+/* receipt formats enumeration data type. */
+typedef enum receiptFormat {
+    Receipt_EscPos = 0,   /* the printer controls of the ESC/POS printers. */
+    Receipt_Text          /* plain text, the controls are dropped. */
+} receiptFormat;
+
+/* receipt template segment structure data type (some bytes, then a field). */
+typedef struct receiptSegment {
+    QByteArray bytes;
+    int field;            /* index of the field (-1 for none). */
+} receiptSegment;
+
+/* compiled receipt template structure data type. */
+typedef struct receiptTemplate {
+    QList<receiptSegment> segments;
+    QStringList fields;   /* the names of the fields. */
+} receiptTemplate;
+
+/* compile a receipt template to byte segments (the printer controls are
+   resolved once, only the fields are filled in for every receipt). */
+bool compileReceiptTemplate(const QString &text, const receiptFormat format,
+                            receiptTemplate &compiled, QString &error);
+
+/* fill in the fields of a compiled receipt (a missing field is empty). */
+QByteArray formatReceipt(const receiptTemplate &compiled, const QHash<QString, QString> &fields);
+
+/* class which implements the receipt spooler. the receipts are submitted
+   without waiting and formatted on the spooler thread, stored in the spool
+   directory and then sent to the printer (a device or a file, or for a
+   directory a virtual printer which keeps every receipt as a file). the
+   receipts the printer cannot take stay in the spool and are tried again. */
+class ReceiptSpooler : public QThread
+{
+    Q_OBJECT
+
+    public:
+        ReceiptSpooler(const receiptTemplate &compiled, const QString &spool, const QString &printer, QObject *parent = 0);
+        ~ReceiptSpooler();
+
+        void submit(const QHash<QString, QString> &fields);
+        void stop();
+
+    signals:
+        /* a receipt is sent to the printer (emitted by the spooler thread). */
+        void printed(const QString &name);
+
+        /* the printer cannot take the receipts (emitted by the spooler thread). */
+        void printerFailed(const QString &error);
+
+    protected:
+        void run();
+
+    private:
+        bool spool(const QByteArray &receipt);
+        bool print(const QString &name, QString &error);
+        void printSpool();
+
+        receiptTemplate compiled;
+        QString spoolPath;
+        QString printerPath;
+        int spooled;
+
+        MpscQueue<QHash<QString, QString> > queue;
+        QSemaphore pending;
+        QAtomicInt stopping;
+};
+
+/* the receipt spooler of the application (created from the settings once). */
+ReceiptSpooler *receiptSpooler();
+
+#endif // RECEIPTSPOOLER_H
@@ -24,6 +24,8 @@
 /* include headers defining the interface of the sources. */
 #include "reportform.h"
 #include "globaldeclarations.h"
+#include "querytracer.h"
+#include "latencymetrics.h"
 
 /* creates the application's report gui form and data model. */
 ReportForm::ReportForm(QWidget *parent) : QDialog(parent) {
@@ -79,7 +81,7 @@ ReportForm::createReportPanel() {
     reportPanel = new QWidget;
 
     /* create the model for the report. */
-    tableModel = new QSqlTableModel(this);
+    tableModel = new TracedTableModel(this);
 
     /* set the table to select. */
     tableModel->setTable("report");
@@ -95,6 +97,7 @@ ReportForm::createReportPanel() {
     tableModel->setHeaderData(Report_StartTime, Qt::Horizontal, startTimeStr);
     tableModel->setHeaderData(Report_EndTime, Qt::Horizontal, endTimeStr);
     tableModel->setHeaderData(Report_Charge, Qt::Horizontal, chargeStr);
+    tableModel->setHeaderData(Report_Zone, Qt::Horizontal, zoneStr);
 
     /* select the model in order to apply the changes. */
     tableModel->select();
@@ -113,6 +116,7 @@ ReportForm::createReportPanel() {
 
     /* hide the following columns. */
     reportView->setColumnHidden(Report_Id, true);
+    reportView->setColumnHidden(Report_CustomerId, true);
 
     /* perform some operations with columns' width. */
     reportView->resizeColumnsToContents();
@@ -201,6 +205,9 @@ ReportForm::dateShowReport() {
         return;
     }
 
+    /* time the filter (the query of the view). */
+    LatencyTimer timer(Latency_ReportFilter);
+
     /* set the filter again, which performs changes in the report view. */
     tableModel->setFilter(QString("start_date BETWEEN '%1' AND '%2'").arg(fromDateFilterEdit->text(),
                                                                           toDateFilterEdit->text()));
@@ -222,6 +229,9 @@ ReportForm::custShowReport() {
         return;
     }
 
+    /* time the filter (the query of the view). */
+    LatencyTimer timer(Latency_ReportFilter);
+
     /* set the filter again, which performs changes in the report view. */
     tableModel->setFilter(QString("customer LIKE '%%1%'").arg(custFilterEdit->text()));
 
@@ -242,6 +252,9 @@ ReportForm::vehiShowReport() {
         return;
     }
 
+    /* time the filter (the query of the view). */
+    LatencyTimer timer(Latency_ReportFilter);
+
     /* set the filter again, which performs changes in the report view. */
     tableModel->setFilter(QString("vehicle LIKE '%%1%'").arg(vehiFilterEdit->text()));
 
@@ -252,6 +265,9 @@ ReportForm::vehiShowReport() {
 /* show all the transactions. */
 void
 ReportForm::showAllReport() {
+    /* time the filter (the query of the view). */
+    LatencyTimer timer(Latency_ReportFilter);
+
     /* set a filter to get all the records. */
     tableModel->setFilter("");
 
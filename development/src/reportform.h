@@ -22,6 +22,7 @@ static const QString endDateStr       = QObject::tr("End Date");
 static const QString startTimeStr     = QObject::tr("Start Time");
 static const QString endTimeStr       = QObject::tr("End Time");
 static const QString chargeStr        = QObject::tr("Charge");
+static const QString zoneStr          = QObject::tr("Zone");
 
 static const QString fromDateLabelStr = QObject::tr("&From Date :");
 static const QString toDateLabelStr   = QObject::tr("&To Date: ");
@@ -48,7 +49,9 @@ class ReportForm : public QDialog
             Report_StartTime,
             Report_EndTime,
             Report_Charge,
-            Report_Customer
+            Report_Customer,
+            Report_Zone,
+            Report_CustomerId
         } reportField;
 
         ReportForm(QWidget *parent = 0);
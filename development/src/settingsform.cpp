@@ -21,6 +21,28 @@
 #include "settingsform.h"
 #include "globaldeclarations.h"
 #include "appsettings.h"
+#include "tariffengine.h"
+#include "whatifanalysis.h"
+#include "settingsservice.h"
+#include "connectionpool.h"
+
+/* re-price the report history on a pooled connection (any thread). */
+static whatIfOutcome
+analyzeHistory(WhatIfAnalysis analysis) {
+    whatIfOutcome outcome;
+    outcome.ok = false;
+
+    PooledConnection connection(connectionPool());
+
+    if (!connection.isValid()) {
+        outcome.error = whatIfBusyStr;
+        return outcome;
+    }
+
+    outcome.ok = analysis.run(connection.db(), outcome.summary, outcome.error);
+
+    return outcome;
+}
 
 /* creates the application's settings gui form. */
 SettingsForm::SettingsForm(const appSettings sets, QWidget *parent) : QDialog(parent) {
@@ -46,11 +68,13 @@ SettingsForm::SettingsForm(const appSettings sets, QWidget *parent) : QDialog(pa
 
     /* create the management buttons. */
     saveButton = new QPushButton(saveButtonStr);
+    whatIfButton = new QPushButton(whatIfButtonStr);
     closeButton = new QPushButton(closeButtonStr);
 
     /* add the buttons in a button box dialog. */
     buttonBox = new QDialogButtonBox;
     buttonBox->addButton(saveButton, QDialogButtonBox::ActionRole);
+    buttonBox->addButton(whatIfButton, QDialogButtonBox::ActionRole);
     buttonBox->addButton(closeButton, QDialogButtonBox::AcceptRole);
 
     /* set up some ranges for spinboxes. */
@@ -73,6 +97,8 @@ SettingsForm::SettingsForm(const appSettings sets, QWidget *parent) : QDialog(pa
 
     /* set the signals/slots for the buttons' events. */
     connect(saveButton, SIGNAL(clicked()), this, SLOT(writeSettings()));
+    connect(whatIfButton, SIGNAL(clicked()), this, SLOT(analyzeSettings()));
+    connect(&analysisWatcher, SIGNAL(finished()), this, SLOT(showAnalysis()));
     connect(closeButton, SIGNAL(clicked()), this, SLOT(accept()));
 
     /* create a table grid. */
@@ -128,12 +154,46 @@ void SettingsForm::writeSettings() {
     /* try to write down the settings. */
     s.sync();
 
-    /* if the app cannot write the settings. */
+    /* if the app cannot write the settings (the current ones stay). */
     if (s.status() != QSettings::NoError) {
         /* show a message. */
         QMessageBox::critical(this, infoMsgTitleStr, cantWriteSetsStr);
+        return;
+    }
+
+    /* apply them now (not when the file watcher notices). */
+    settingsService()->reload();
+}
 
-        /* terminate the program. */
-        exit(EXIT_FAILURE);
+/* show the revenue impact of the settings on the report history. */
+void
+SettingsForm::analyzeSettings() {
+    /* the candidate settings (as they would be saved). */
+    appSettings candidateSets = sets;
+    candidateSets.timeslice = chargeTimesliceSpin->value();
+    candidateSets.chargePerTimeslice = chargePerSliceSpin->value();
+    candidateSets.chargePrecision = chargePrecisionSpin->value();
+
+    WhatIfAnalysis analysis(loadTariff(sets), loadTariff(candidateSets));
+    analysisPrecision = candidateSets.chargePrecision;
+
+    /* re-price the history in the background (it takes a few secs for
+       millions of sessions), the lanes and the forms go on meanwhile. */
+    whatIfButton->setEnabled(false);
+    analysisWatcher.setFuture(QtConcurrent::run(analyzeHistory, analysis));
+}
+
+/* show the revenue impact when the analysis is over. */
+void
+SettingsForm::showAnalysis() {
+    whatIfButton->setEnabled(true);
+
+    const whatIfOutcome outcome = analysisWatcher.result();
+
+    if (!outcome.ok) {
+        QMessageBox::warning(this, infoMsgTitleStr, whatIfFailedStr + outcome.error);
+        return;
     }
+
+    QMessageBox::information(this, whatIfTitleStr, WhatIfAnalysis::summaryText(outcome.summary, analysisPrecision));
 }
@@ -4,9 +4,11 @@
 
 /* include some QT libraries. */
 #include <QDialog>
+#include <QFutureWatcher>
 
-/* include header defining the interface of the source. */
+/* include headers defining the interface of the sources. */
 #include "appsettings.h"
+#include "whatifanalysis.h"
 
 /* use these classes. */
 class QDialogButtonBox;
@@ -23,6 +25,17 @@ static const QString chargeTimesliceLabelStr = QObject::tr("&Payment Timeslice :
 static const QString chargePerSliceLabelStr  = QObject::tr("&Charge / Timeslice :");
 static const QString chargePrecisionLabelStr = QObject::tr("&Charge Precision :");
 static const QString saveButtonStr           = QObject::tr("&Save");
+static const QString whatIfButtonStr         = QObject::tr("What-&if...");
+static const QString whatIfTitleStr          = QObject::tr("Revenue Impact");
+static const QString whatIfFailedStr         = QObject::tr("The report history cannot be re-priced: ");
+static const QString whatIfBusyStr           = QObject::tr("The report history cannot be read now (the database is busy).");
+
+/* what-if outcome structure data type (of the analysis in the background). */
+typedef struct whatIfOutcome {
+    bool ok;
+    whatIfSummary summary;
+    QString error;
+} whatIfOutcome;
 
 /* class which implements the settings gui form. */
 class SettingsForm : public QDialog
@@ -35,6 +48,8 @@ class SettingsForm : public QDialog
 
     private slots:
         void writeSettings();
+        void analyzeSettings();
+        void showAnalysis();
 
     private:
         appSettings sets;
@@ -50,9 +65,14 @@ class SettingsForm : public QDialog
         QSpinBox *chargePrecisionSpin;
 
         QPushButton *saveButton;
+        QPushButton *whatIfButton;
         QPushButton *closeButton;
 
         QDialogButtonBox *buttonBox;
+
+        /* the what-if analysis running in the background. */
+        QFutureWatcher<whatIfOutcome> analysisWatcher;
+        int analysisPrecision;
 };
 
 #endif // SETTINGSFORM_H
@@ -0,0 +1,228 @@
+/*
+ *  This file implements the settings service of the application.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+
+/* include headers defining the interface of the sources. */
+#include "settingsservice.h"
+#include "arithmetictools.h"
+#include "dbwriter.h"
+
+/* read an integer setting (the default, also written, if it is invalid). */
+static int
+readInt(QSettings &s, const QString &key, const int def, const int min, const int max) {
+    const QVariant value = s.value(key);
+
+    if (value.isNull() || value.toInt() < min || value.toInt() > max) {
+        s.setValue(key, def);
+        return def;
+    }
+
+    return value.toInt();
+}
+
+/* read a real setting (the default, also written, if it is invalid). */
+static double
+readDouble(QSettings &s, const QString &key, const double def, const double min, const double max) {
+    const QVariant value = s.value(key);
+
+    if (value.isNull() || isLessThan(value.toDouble(), min) || isGreaterThan(value.toDouble(), max)) {
+        s.setValue(key, def);
+        return def;
+    }
+
+    return value.toDouble();
+}
+
+/* read the settings and check them (the defaults for the invalid ones). */
+static void
+readSnapshot(QSettings &s, settingsSnapshot &snapshot) {
+    snapshot.sets.parkingCapacity = readInt(s, parkingCapacityKeyStr, DEF_PARKING_CAPACITY,
+                                            MIN_PARKING_CAPACITY, MAX_PARKING_CAPACITY);
+
+    snapshot.sets.timeslice = readInt(s, timesliceKeyStr, DEF_TIMESLICE, MIN_TIMESLICE, MAX_TIMESLICE);
+
+    snapshot.sets.chargePerTimeslice = readDouble(s, chargePerTimesliceKeyStr, DEF_CHARGE_PER_TIMESLICE,
+                                                  MIN_CHARGE_PER_TIMESLICE, MAX_CHARGE_PER_TIMESLICE);
+
+    snapshot.sets.chargePrecision = readInt(s, chargePrecisionKeyStr, DEF_CHARGE_PRECISION,
+                                            MIN_CHARGE_PRECISION, MAX_CHARGE_PRECISION);
+
+    /* none for the linear charge. */
+    if (s.value(tariffFileKeyStr).isNull()) s.setValue(tariffFileKeyStr, QString());
+    snapshot.sets.tariffFile = s.value(tariffFileKeyStr).toString();
+
+    snapshot.commitWindow = readInt(s, commitWindowKeyStr, DEF_COMMIT_WINDOW, MIN_COMMIT_WINDOW, MAX_COMMIT_WINDOW);
+}
+
+/* get the keys which differ between two snapshots. */
+static QStringList
+changedKeys(const settingsSnapshot &a, const settingsSnapshot &b) {
+    QStringList keys;
+
+    if (a.sets.parkingCapacity != b.sets.parkingCapacity) keys << parkingCapacityKeyStr;
+    if (a.sets.timeslice != b.sets.timeslice) keys << timesliceKeyStr;
+    if (isLessThan(a.sets.chargePerTimeslice, b.sets.chargePerTimeslice)
+        || isGreaterThan(a.sets.chargePerTimeslice, b.sets.chargePerTimeslice)) keys << chargePerTimesliceKeyStr;
+    if (a.sets.chargePrecision != b.sets.chargePrecision) keys << chargePrecisionKeyStr;
+    if (a.sets.tariffFile != b.sets.tariffFile) keys << tariffFileKeyStr;
+    if (a.commitWindow != b.commitWindow) keys << commitWindowKeyStr;
+
+    return keys;
+}
+
+/* create the service with the current settings. */
+SettingsService::SettingsService(QObject *parent) : QObject(parent), current(0) {
+    reloadTimer.setSingleShot(true);
+    reloadTimer.setInterval(DEF_SETTINGS_RELOAD_DELAY);
+
+    connect(&watcher, SIGNAL(fileChanged(const QString &)), this, SLOT(fileChanged()));
+    connect(&reloadTimer, SIGNAL(timeout()), this, SLOT(reload()));
+
+    retireTimer.setSingleShot(true);
+    retireTimer.setInterval(DEF_SETTINGS_RETIRE_DELAY);
+
+    connect(&retireTimer, SIGNAL(timeout()), this, SLOT(freeRetired()));
+
+    reload();
+}
+
+/* delete the snapshots (nobody reads them any more). */
+SettingsService::~SettingsService() {
+    delete current.fetchAndStoreOrdered(0);
+
+    qDeleteAll(retired);
+}
+
+/* get a copy of the current snapshot (any thread, without a lock). the
+   reader is counted in before it reads the pointer, so the snapshot is
+   not freed under it (see freeRetired()). */
+settingsSnapshot
+SettingsService::snapshot() const {
+    readers.ref();
+    const settingsSnapshot copy = *current;
+    readers.deref();
+
+    return copy;
+}
+
+/* get the current settings of the charge (any thread, without a lock). */
+appSettings
+SettingsService::settings() const {
+    return snapshot().sets;
+}
+
+/* get the current group commit window (any thread, without a lock). */
+int
+SettingsService::commitWindow() const {
+    return snapshot().commitWindow;
+}
+
+/* read the settings again and publish them if they changed. the invalid
+   ones are replaced with the defaults, also in the file (false if it
+   cannot be written, the defaults are used anyway). */
+bool
+SettingsService::reload() {
+    QSettings s(setsAppOrg, setsAppName);
+
+    /* the changes of other processes. */
+    s.sync();
+
+    settingsSnapshot *next = new settingsSnapshot;
+    readSnapshot(s, *next);
+
+    /* try to write down the defaults. */
+    s.sync();
+
+    const bool ok = s.status() == QSettings::NoError;
+
+    fileName = s.fileName();
+    watch();
+
+    const settingsSnapshot *previous = current;
+    QStringList keys;
+
+    if (previous) {
+        keys = changedKeys(*previous, *next);
+
+        /* nothing to publish. */
+        if (keys.isEmpty()) {
+            delete next;
+            if (!ok) emit writeFailed();
+            return ok;
+        }
+
+        next->version = previous->version + 1;
+    }
+    else {
+        next->version = 0;
+    }
+
+    /* the readers see the whole new snapshot or the old one. */
+    settingsSnapshot *replaced = current.fetchAndStoreOrdered(next);
+
+    if (replaced) {
+        retired << replaced;
+        freeRetired();
+    }
+
+    if (previous) emit changed(keys);
+    if (!ok) emit writeFailed();
+
+    return ok;
+}
+
+/* the file of the settings changed (read it when it is written). */
+void
+SettingsService::fileChanged() {
+    reloadTimer.start();
+}
+
+/* free the snapshots replaced if no reader is in. a reader counted in
+   later reads the pointer after it was swapped, i.e. the current one. */
+void
+SettingsService::freeRetired() {
+    if (readers.fetchAndAddOrdered(0)) {
+        retireTimer.start();
+        return;
+    }
+
+    qDeleteAll(retired);
+    retired.clear();
+}
+
+/* watch the file of the settings (again, since it is replaced and not
+   written in place, the watcher loses it). */
+void
+SettingsService::watch() {
+    if (!watcher.files().contains(fileName) && QFile::exists(fileName))
+        watcher.addPath(fileName);
+}
+
+/* the settings of the application (read and watched once). */
+SettingsService *
+settingsService() {
+    static SettingsService *service = 0;
+
+    /* it lives as long as the application. */
+    if (!service) service = new SettingsService(QCoreApplication::instance());
+
+    return service;
+}
@@ -0,0 +1,91 @@
+/* header defining the interface of the source. */
+#ifndef SETTINGSSERVICE_H
+#define SETTINGSSERVICE_H
+
+/* include some QT libraries. */
+#include <QObject>
+#include <QAtomicPointer>
+#include <QAtomicInt>
+#include <QFileSystemWatcher>
+#include <QStringList>
+#include <QTimer>
+#include <QList>
+
+/* include header defining the interface of the source. */
+#include "appsettings.h"
+
+/* msecs the file of the settings has to stay unchanged before it is read
+   again (an editor or QSettings may write it in a few steps). */
+static const int DEF_SETTINGS_RELOAD_DELAY = 200;
+
+/* msecs between the tries to free the snapshots replaced while a thread
+   was reading one. */
+static const int DEF_SETTINGS_RETIRE_DELAY = 100;
+
+/* the keys of the settings (as they are reported changed). */
+static const QString parkingCapacityKeyStr    = "parking/capacity";
+static const QString timesliceKeyStr          = "payment/timeslice";
+static const QString chargePerTimesliceKeyStr = "payment/charge_per_timeslice";
+static const QString chargePrecisionKeyStr    = "payment/charge_precision";
+static const QString tariffFileKeyStr         = "payment/tariff_file";
+static const QString commitWindowKeyStr       = "database/commit_window";
+
+/* settings snapshot structure data type (never changed once published). */
+typedef struct settingsSnapshot {
+    appSettings sets;
+    int commitWindow;     /* msecs of the group commit of the DB writer. */
+    int version;          /* counts the snapshots published. */
+} settingsSnapshot;
+
+/* class which implements the settings of the application. the settings are
+   read and checked once into a snapshot which is published with an atomic
+   pointer swap, so any thread reads the current settings without a lock and
+   without QSettings. the file of the settings is watched, so the changes of
+   another process (or of the settings form) are read again, and every new
+   snapshot is reported with the keys which changed. a reader copies the
+   snapshot while it is counted in, and the snapshots replaced are freed
+   once no reader is in (tried again later while one is), so a reader
+   never copies a deleted one. */
+class SettingsService : public QObject
+{
+    Q_OBJECT
+
+    public:
+        SettingsService(QObject *parent = 0);
+        ~SettingsService();
+
+        settingsSnapshot snapshot() const;
+        appSettings settings() const;
+        int commitWindow() const;
+
+    public slots:
+        bool reload();
+
+    signals:
+        /* a new snapshot is published (the keys which changed). */
+        void changed(const QStringList &keys);
+
+        /* the settings cannot be written (the defaults are used in memory). */
+        void writeFailed();
+
+    private slots:
+        void fileChanged();
+        void freeRetired();
+
+    private:
+        void watch();
+
+        QAtomicPointer<settingsSnapshot> current;
+        QList<settingsSnapshot *> retired;
+        mutable QAtomicInt readers;
+
+        QFileSystemWatcher watcher;
+        QTimer reloadTimer;
+        QTimer retireTimer;
+        QString fileName;
+};
+
+/* the settings of the application (read and watched once). */
+SettingsService *settingsService();
+
+#endif // SETTINGSSERVICE_H
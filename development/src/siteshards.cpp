@@ -0,0 +1,308 @@
+/*
+ *  This file implements the sites of the car parks (a shard per site).
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+#include <QtSql>
+
+/* include headers defining the interface of the sources. */
+#include "siteshards.h"
+#include "databasetools.h"
+
+/* class which implements a query of an aggregate on a shard (a work item). */
+class ShardQueryTask : public QRunnable
+{
+    public:
+        ShardQueryTask(SiteShards *shards, const int siteId, const QString &sql,
+                       QList<QVariantList> *rows, QString *error, QSemaphore *done) {
+            this->shards = shards;
+            this->siteId = siteId;
+            this->sql = sql;
+            this->rows = rows;
+            this->error = error;
+            this->done = done;
+        }
+
+        void run() {
+            shards->query(siteId, sql, *rows, *error);
+
+            /* the caller merges when every shard is done. */
+            done->release();
+        }
+
+    private:
+        SiteShards *shards;
+        int siteId;
+        QString sql;
+        QList<QVariantList> *rows;
+        QString *error;
+        QSemaphore *done;
+};
+
+/* create the shards without sites. */
+SiteShards::SiteShards(const appSettings &sets) {
+    this->sets = sets;
+}
+
+/* stop the writers (they commit what they have) and the readers. */
+SiteShards::~SiteShards() {
+    foreach (const shard &s, shards) {
+        delete s.writer;
+
+        s.readers->waitForDone();
+        delete s.readers;
+
+        /* the readers are over, their connections can go. */
+        delete s.connections;
+    }
+}
+
+/* add a site with its shard (its schema is upgraded if older). the
+   connections of its writer and readers are named after the site, so
+   those of two shards never replace each other. not thread safe, add
+   the sites before the shards are shared. */
+bool
+SiteShards::addSite(const siteConfig &site, QString &error) {
+    if (site.id <= 0 || shards.contains(site.id)) {
+        error = QString("the site %1 is not valid or is added twice.").arg(site.id);
+        return false;
+    }
+
+    /* the shard is checked on a connection of its own. */
+    const QString connectionName = QString("site-%1-schema").arg(site.id);
+    bool ok;
+
+    {
+        QSqlDatabase db = openDBConnection(connectionName, site.fileName);
+
+        if (!db.isOpen()) {
+            error = QString("cannot open the database '%1' of the site %2.").arg(site.fileName).arg(site.id);
+            ok = false;
+        }
+        else {
+            ok = hasDBSchema(db) && upgradeDBSchema(db);
+
+            if (!ok) error = QString("the database '%1' of the site %2 has no schema or cannot be upgraded.").arg(site.fileName).arg(site.id);
+        }
+    }
+
+    QSqlDatabase::removeDatabase(connectionName);
+
+    if (!ok) return false;
+
+    shard s;
+    s.site = site;
+    s.writer = new DBWriter(sets, site.fileName, QString("site-%1").arg(site.id));
+
+    /* the readers keep their threads (and their connections). */
+    s.readers = new QThreadPool;
+    s.readers->setMaxThreadCount(DEF_SHARD_READERS);
+    s.readers->setExpiryTimeout(-1);
+
+    /* a connection for every reader. */
+    s.connections = new ConnectionPool(site.fileName, DEF_SHARD_READERS, QString("site-%1-pool").arg(site.id));
+
+    shards.insert(site.id, s);
+    order << site.id;
+
+    return true;
+}
+
+/* start the writers of the sites. */
+void
+SiteShards::start() {
+    foreach (const shard &s, shards)
+        s.writer->start();
+}
+
+/* the ids of the sites (as they were added). */
+QList<int>
+SiteShards::sites() const {
+    return order;
+}
+
+/* check if a site is hosted. */
+bool
+SiteShards::hasSite(const int siteId) const {
+    return shards.contains(siteId);
+}
+
+/* the shard of a site (empty if it is not hosted). */
+QString
+SiteShards::fileName(const int siteId) const {
+    return shards.value(siteId).site.fileName;
+}
+
+/* the DB writer of a site (0 if it is not hosted). */
+DBWriter *
+SiteShards::writer(const int siteId) const {
+    QHash<int, shard>::const_iterator i = shards.constFind(siteId);
+
+    return i == shards.constEnd() ? 0 : i.value().writer;
+}
+
+/* the connections of the readers of a site (0 if it is not hosted). */
+ConnectionPool *
+SiteShards::connections(const int siteId) const {
+    QHash<int, shard>::const_iterator i = shards.constFind(siteId);
+
+    return i == shards.constEnd() ? 0 : i.value().connections;
+}
+
+/* run a work item on a reader of a site (it is deleted when done). the
+   site must be hosted. */
+void
+SiteShards::read(const int siteId, QRunnable *task) {
+    shards.value(siteId).readers->start(task);
+}
+
+/* change the settings of the writers of all the sites. */
+void
+SiteShards::setSettings(const appSettings &sets) {
+    foreach (const shard &s, shards)
+        s.writer->setSettings(sets);
+}
+
+/* change the group commit window of the writers of all the sites. */
+void
+SiteShards::setCommitWindow(const int msecs) {
+    foreach (const shard &s, shards)
+        s.writer->setCommitWindow(msecs);
+}
+
+/* run a query on every site in parallel (on the readers of every shard)
+   and merge the rows by their first key columns, adding up the rest (so
+   the aggregates are COUNT and SUM, an average is a sum and a count). */
+bool
+SiteShards::aggregate(const QString &sql, const int keyColumns, QList<QVariantList> &rows, QString &error) {
+    const int count = order.size();
+
+    QVector<QList<QVariantList> > results(count);
+    QVector<QString> errors(count);
+    QSemaphore done;
+
+    for (int i = 0; i < count; i++) {
+        QHash<int, shard>::const_iterator s = shards.constFind(order.at(i));
+
+        /* a lookup never adds a site (it fails the query instead). */
+        if (s == shards.constEnd()) {
+            errors[i] = "the site is not hosted";
+            done.release();
+            continue;
+        }
+
+        s.value().readers->start(new ShardQueryTask(this, s.value().site.id, sql, &results[i], &errors[i], &done));
+    }
+
+    /* wait for every shard. */
+    done.acquire(count);
+
+    QList<QVariantList> all;
+
+    for (int i = 0; i < count; i++) {
+        if (!errors.at(i).isEmpty()) {
+            error = QString("site %1: %2").arg(order.at(i)).arg(errors.at(i));
+            return false;
+        }
+
+        all += results.at(i);
+    }
+
+    rows = mergeRows(all, keyColumns);
+
+    return true;
+}
+
+/* run a query on the shard of a site (on a pooled connection of the calling thread). */
+bool
+SiteShards::query(const int siteId, const QString &sql, QList<QVariantList> &rows, QString &error) {
+    if (!hasSite(siteId)) {
+        error = QString("no site %1.").arg(siteId);
+        return false;
+    }
+
+    PooledConnection connection(shards.value(siteId).connections);
+
+    if (!connection.isValid()) {
+        error = QString("no connection to the site %1.").arg(siteId);
+        return false;
+    }
+
+    /* declare a sql query object. */
+    QSqlQuery query(connection.db());
+    query.setForwardOnly(true);
+
+    if (!query.exec(sql)) {
+        error = query.lastError().text();
+        return false;
+    }
+
+    const int columns = query.record().count();
+
+    while (query.next()) {
+        QVariantList row;
+
+        for (int c = 0; c < columns; c++)
+            row << query.value(c);
+
+        rows << row;
+    }
+
+    if (query.lastError().isValid()) {
+        error = query.lastError().text();
+        return false;
+    }
+
+    return true;
+}
+
+/* merge some rows by their first key columns, adding up the rest (in the
+   order the keys are first found). */
+QList<QVariantList>
+SiteShards::mergeRows(const QList<QVariantList> &rows, const int keyColumns) {
+    QList<QVariantList> merged;
+    QHash<QString, int> indexes;    /* merged row of every key. */
+
+    foreach (const QVariantList &row, rows) {
+        QStringList key;
+
+        for (int c = 0; c < keyColumns && c < row.size(); c++)
+            key << row.at(c).toString();
+
+        const QString joined = key.join(QChar(0x1F)); /* a separator no key has. */
+
+        if (!indexes.contains(joined)) {
+            indexes.insert(joined, merged.size());
+            merged << row;
+            continue;
+        }
+
+        QVariantList &total = merged[indexes.value(joined)];
+
+        for (int c = keyColumns; c < row.size() && c < total.size(); c++) {
+            /* the counts stay integers. */
+            if (total.at(c).type() == QVariant::Double || row.at(c).type() == QVariant::Double)
+                total[c] = total.at(c).toDouble() + row.at(c).toDouble();
+            else
+                total[c] = total.at(c).toLongLong() + row.at(c).toLongLong();
+        }
+    }
+
+    return merged;
+}
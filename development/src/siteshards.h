@@ -0,0 +1,78 @@
+/* header defining the interface of the source. */
+#ifndef SITESHARDS_H
+#define SITESHARDS_H
+
+/* include some QT libraries. */
+#include <QSqlDatabase>
+#include <QThreadPool>
+#include <QVariant>
+#include <QString>
+#include <QList>
+#include <QHash>
+
+/* include headers defining the interface of the sources. */
+#include "dbwriter.h"
+#include "connectionpool.h"
+#include "appsettings.h"
+
+/* the id of the site of a single car park. */
+static const int DEF_SITE_ID = 1;
+
+/* the readers of every shard (threads with a connection each). */
+static const int DEF_SHARD_READERS = 2;
+
+/* site structure data type (a car park and its shard). */
+typedef struct siteConfig {
+    int id;               /* positive. */
+    QString fileName;     /* the SQLite shard of the site. */
+} siteConfig;
+
+/* class which implements the sites of the car parks hosted by one server,
+   every one in its own SQLite shard. a site has its own DB writer (the
+   writes are routed by the site id) and its own pool of readers, each one
+   with a pooled connection to the shard. the aggregate queries of all the
+   sites run on the readers of every shard in parallel and are merged, and
+   the lookups of the gate server run on the readers of their site. the
+   sites are added before the shards are shared with other threads. */
+class SiteShards
+{
+    public:
+        SiteShards(const appSettings &sets);
+        ~SiteShards();
+
+        bool addSite(const siteConfig &site, QString &error);
+        void start();
+
+        QList<int> sites() const;
+        bool hasSite(const int siteId) const;
+        QString fileName(const int siteId) const;
+        DBWriter *writer(const int siteId) const;
+        ConnectionPool *connections(const int siteId) const;
+        void read(const int siteId, QRunnable *task);
+
+        void setSettings(const appSettings &sets);
+        void setCommitWindow(const int msecs);
+
+        bool aggregate(const QString &sql, const int keyColumns, QList<QVariantList> &rows, QString &error);
+        bool query(const int siteId, const QString &sql, QList<QVariantList> &rows, QString &error);
+
+        static QList<QVariantList> mergeRows(const QList<QVariantList> &rows, const int keyColumns);
+
+    private:
+        /* shard of a site structure data type. */
+        typedef struct shard {
+            siteConfig site;
+            DBWriter *writer;
+            QThreadPool *readers;
+            ConnectionPool *connections;    /* of the readers. */
+        } shard;
+
+        appSettings sets;
+
+        QList<int> order;                /* the sites as they were added. */
+        QHash<int, shard> shards;
+
+        Q_DISABLE_COPY(SiteShards)
+};
+
+#endif // SITESHARDS_H
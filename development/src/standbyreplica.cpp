@@ -0,0 +1,381 @@
+/*
+ *  This file implements the standby copy of the DB (backup and shipping).
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+#include <QtSql>
+
+/* include headers defining the interface of the sources. */
+#include "standbyreplica.h"
+#include "eventjournal.h"
+#include "databasetools.h"
+#include "appsettings.h"
+#include "filetools.h"
+
+/* name of the connection the DB is copied from. */
+static const QString standbyConnectionStr = "parkman-standby";
+
+/* name of the connection which creates the schema of the copy. */
+static const QString standbyCopyConnectionStr = "parkman-standby-copy";
+
+/* run the statements creating the objects of some types (a list of
+   quoted names) of the schema of the DB on its copy, through a
+   connection of the same driver (the same sqlite). */
+static bool
+copySchema(QSqlDatabase db, const QString &copyFileName, const QString &types, QString &error) {
+    /* declare a sql query object for the DB. */
+    QSqlQuery query(db);
+
+    if (!query.exec(QString("SELECT sql FROM sqlite_master WHERE type IN (%1) AND sql IS NOT NULL "
+                            "AND name NOT LIKE 'sqlite_%' ORDER BY rowid").arg(types))) {
+        error = query.lastError().text();
+        return false;
+    }
+
+    QStringList statements;
+
+    while (query.next())
+        statements << query.value(0).toString();
+
+    query.finish();
+
+    bool ok;
+
+    {
+        QSqlDatabase copy = QSqlDatabase::addDatabase(dbDriverStr, standbyCopyConnectionStr);
+        copy.setDatabaseName(copyFileName);
+
+        ok = copy.open();
+        if (!ok) error = copy.lastError().text();
+
+        QSqlQuery statement(copy);
+
+        foreach (QString sql, statements) {
+            if (!ok) break;
+
+            ok = statement.exec(sql);
+            if (!ok) error = statement.lastError().text();
+        }
+    }
+
+    QSqlDatabase::removeDatabase(standbyCopyConnectionStr);
+
+    return ok;
+}
+
+/* create the standby copy of a DB in a directory (call start() to run it). */
+StandbyReplica::StandbyReplica(const QString &fileName, const QString &directory,
+                               const int backupInterval, const int shipInterval,
+                               QObject *parent) : QThread(parent) {
+    this->fileName = fileName;
+    this->directory = directory;
+    this->backupInterval = qMax(backupInterval, MIN_STANDBY_INTERVAL);
+    this->shipInterval = qMax(shipInterval, MIN_STANDBY_INTERVAL);
+
+    /* the copy has the name of the DB. */
+    standbyFileName = QDir(directory).filePath(QFileInfo(fileName).fileName());
+
+    stats.backups = stats.failedBackups = 0;
+    stats.backupMsecs = 0;
+    stats.backupSeq = stats.primarySeq = stats.shippedSeq = 0;
+    stats.lagEvents = stats.lagMsecs = 0;
+}
+
+/* stop the standby thread (the events committed are shipped first). */
+StandbyReplica::~StandbyReplica() {
+    stop();
+    wait();
+}
+
+/* ask for a backup now (any thread). */
+void
+StandbyReplica::requestBackup() {
+    backupRequested.fetchAndStoreOrdered(1);
+    wakeUp.release();
+}
+
+/* ask the standby thread to stop (a backup in progress is dropped). */
+void
+StandbyReplica::stop() {
+    stopping.fetchAndStoreOrdered(1);
+    wakeUp.release();
+}
+
+/* get a copy of the statistics of the standby (any thread). */
+standbyStatistics
+StandbyReplica::statistics() {
+    QMutexLocker locker(&statisticsMutex);
+
+    standbyStatistics copy = stats;
+
+    /* the lag keeps growing between the shippings. */
+    if (copy.lagEvents && upToDate.isValid())
+        copy.lagMsecs = upToDate.msecsTo(QDateTime::currentDateTime());
+
+    return copy;
+}
+
+/* the standby thread's loop: a backup if there is none or it is due,
+   the committed events shipped on every wake up. */
+void
+StandbyReplica::run() {
+    {
+        /* the connection belongs to the standby thread. */
+        QSqlDatabase db = openDBConnection(standbyConnectionStr, fileName);
+
+        QString error;
+
+        EventJournal journal(standbyFileName + journalSuffixStr);
+
+        if (!QDir().mkpath(directory) || !journal.open(error)) {
+            QMutexLocker locker(&statisticsMutex);
+            stats.error = error.isEmpty() ? QString("cannot create the directory '%1'").arg(directory) : error;
+        }
+
+        QElapsedTimer backupTimer;
+        backupTimer.start();
+
+        forever {
+            /* no backup is started while stopping, only the last shipping. */
+            const bool due = !stopping.fetchAndAddOrdered(0) &&
+                             (!QFile::exists(standbyFileName) ||
+                              backupTimer.hasExpired(backupInterval) ||
+                              backupRequested.fetchAndStoreOrdered(0));
+
+            error.clear();
+
+            bool ok = true;
+
+            if (due) {
+                ok = backup(db, journal, error);
+                backupTimer.restart();
+            }
+
+            ok = ok && ship(db, journal, error);
+
+            statisticsMutex.lock();
+            stats.error = ok ? QString() : error;
+            statisticsMutex.unlock();
+
+            if (stopping.fetchAndAddOrdered(0)) break;
+
+            /* sleep until the next shipping (or a backup asked for). */
+            wakeUp.tryAcquire(1, shipInterval);
+        }
+    }
+
+    QSqlDatabase::removeDatabase(standbyConnectionStr);
+}
+
+/* copy the DB to the standby directory: the tables, their rows, then
+   the indexes (replaced when complete, a failed one leaves the last).
+   the journal of the copy starts after the seq it is at. */
+bool
+StandbyReplica::backup(QSqlDatabase db, EventJournal &journal, QString &error) {
+    QElapsedTimer timer;
+    timer.start();
+
+    const QString temp = standbyFileName + ".tmp";
+    QFile::remove(temp);
+    QFile::remove(temp + "-journal");
+
+    quint64 seq = 0;
+
+    bool ok = copySchema(db, temp, "'table'", error) &&
+              copyRows(db, temp, seq, error) &&
+              copySchema(db, temp, "'index', 'trigger', 'view'", error);
+
+    /* the last copy is there until the new one takes its name. */
+    if (ok && !replaceFile(temp, standbyFileName)) {
+        error = QString("cannot replace '%1'").arg(standbyFileName);
+        ok = false;
+    }
+
+    if (!ok) {
+        if (stopping.fetchAndAddOrdered(0)) error = "the backup was stopped";
+
+        QFile::remove(temp);
+
+        QMutexLocker locker(&statisticsMutex);
+        stats.failedBackups++;
+
+        return false;
+    }
+
+    /* the events up to it are in the copy. */
+    if (journal.isOpen()) {
+        journal.skipTo(seq);
+        journal.checkpoint();
+    }
+
+    emit backedUp(standbyFileName);
+
+    QMutexLocker locker(&statisticsMutex);
+
+    stats.backups++;
+    stats.lastBackup = QDateTime::currentDateTime();
+    stats.backupMsecs = timer.elapsed();
+    stats.backupSeq = seq;
+
+    return true;
+}
+
+/* copy the rows of every table of the DB to its copy (attached to the
+   connection of the DB) in one transaction: a consistent copy which,
+   with the write-ahead log, never blocks the writer (it only holds its
+   checkpoints back). the seq of the journal the copy is at is read in
+   the same transaction. */
+bool
+StandbyReplica::copyRows(QSqlDatabase db, const QString &copyFileName, quint64 &seq, QString &error) {
+    /* declare a sql query object for the DB. */
+    QSqlQuery query(db);
+
+    /* the counters of the autoincrement keys last (the rows set them too). */
+    if (!query.exec("SELECT name FROM sqlite_master WHERE type = 'table' AND "
+                    "(name NOT LIKE 'sqlite_%' OR name = 'sqlite_sequence') ORDER BY name = 'sqlite_sequence', rowid")) {
+        error = query.lastError().text();
+        return false;
+    }
+
+    QStringList tables;
+
+    while (query.next())
+        tables << query.value(0).toString();
+
+    query.finish();
+
+    query.prepare("ATTACH DATABASE :file AS standby");
+    query.bindValue(":file", copyFileName);
+
+    if (!query.exec()) {
+        error = query.lastError().text();
+        return false;
+    }
+
+    bool ok = query.exec("BEGIN");
+
+    foreach (QString table, tables) {
+        if (!ok || stopping.fetchAndAddOrdered(0)) break;
+
+        if (table == "sqlite_sequence") ok = query.exec("DELETE FROM standby.sqlite_sequence");
+
+        const QString name = table.replace("\"", "\"\"");
+        ok = ok && query.exec(QString("INSERT INTO standby.\"%1\" SELECT * FROM main.\"%1\"").arg(name));
+    }
+
+    /* the version of the schema, and the seq of the journal. */
+    ok = ok && query.exec("PRAGMA main.user_version") && query.next();
+    ok = ok && query.exec(QString("PRAGMA standby.user_version = %1").arg(query.value(0).toInt()));
+
+    ok = ok && query.exec("SELECT seq FROM main.journal_state WHERE id = 1");
+    seq = ok && query.next() ? query.value(0).toULongLong() : 0;
+
+    ok = ok && !stopping.fetchAndAddOrdered(0) && query.exec("COMMIT");
+
+    if (!ok) {
+        error = query.lastError().text();
+        query.exec("ROLLBACK");
+    }
+
+    query.exec("DETACH DATABASE standby");
+
+    return ok;
+}
+
+/* append the events committed in the DB since the last shipping to the
+   journal of the copy (with their seqs) and sync it. */
+bool
+StandbyReplica::ship(QSqlDatabase db, EventJournal &journal, QString &error) {
+    if (!journal.isOpen()) {
+        error = "the standby journal is not open";
+        return false;
+    }
+
+    /* declare a sql query object for the DB. */
+    QSqlQuery query(db);
+
+    if (!query.exec("SELECT seq FROM journal_state WHERE id = 1") || !query.next()) {
+        error = query.lastError().text();
+        return false;
+    }
+
+    const quint64 primary = query.value(0).toULongLong();
+    query.finish();
+
+    if (journal.lastSeq() < primary) {
+        /* read only, the writer owns the journal of the DB. */
+        EventJournal source(fileName + journalSuffixStr);
+        QList<journalEvent> events;
+
+        if (!source.readAfter(journal.lastSeq(), events, error)) return false;
+
+        foreach (journalEvent event, events) {
+            /* an event synced but not committed yet. */
+            if (event.seq > primary) break;
+
+            journal.skipTo(event.seq - 1);
+
+            if (!journal.append(event)) {
+                error = "cannot append to the standby journal";
+                return false;
+            }
+        }
+
+        if (!journal.sync()) {
+            error = "cannot sync the standby journal";
+            return false;
+        }
+    }
+
+    QMutexLocker locker(&statisticsMutex);
+
+    stats.primarySeq = primary;
+    stats.shippedSeq = journal.lastSeq();
+    stats.lagEvents = primary > journal.lastSeq() ? (qint64) (primary - journal.lastSeq()) : 0;
+
+    if (!stats.lagEvents) upToDate = QDateTime::currentDateTime();
+
+    stats.lagMsecs = upToDate.isValid() ? upToDate.msecsTo(QDateTime::currentDateTime()) : 0;
+
+    return true;
+}
+
+/* the standby copy of the DB of the application (any thread after the
+   first call, which is made by the main thread at start). */
+StandbyReplica *
+standbyReplica() {
+    static StandbyReplica *replica = 0;
+
+    if (!replica) {
+        QSettings s(setsAppOrg, setsAppName);
+
+        /* "none" turns off the standby copy. */
+        const QString directory = s.value("standby/directory", defStandbyDirStr).toString();
+
+        /* it lives as long as the application. */
+        replica = new StandbyReplica(dbFileNameStr, directory,
+                                     s.value("standby/backup_interval", DEF_STANDBY_BACKUP_INTERVAL).toInt(),
+                                     s.value("standby/ship_interval", DEF_STANDBY_SHIP_INTERVAL).toInt(),
+                                     QCoreApplication::instance());
+
+        if (directory != "none") replica->start(QThread::LowPriority);
+    }
+
+    return replica;
+}
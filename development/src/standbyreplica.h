@@ -0,0 +1,100 @@
+/* header defining the interface of the source. */
+#ifndef STANDBYREPLICA_H
+#define STANDBYREPLICA_H
+
+/* include some QT libraries. */
+#include <QThread>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QSqlDatabase>
+#include <QDateTime>
+#include <QString>
+#include <QMutex>
+
+/* use these classes. */
+class EventJournal;
+
+/* the default directory of the standby copy of the DB (none for none). */
+static const QString defStandbyDirStr = "standby";
+
+/* the default msecs between the online backups, the shippings of the
+   journal to the standby copy (minimum for both). */
+static const int DEF_STANDBY_BACKUP_INTERVAL = 600000;
+static const int DEF_STANDBY_SHIP_INTERVAL = 2000;
+static const int MIN_STANDBY_INTERVAL = 500;
+
+/* standby statistics structure data type. */
+typedef struct standbyStatistics {
+    qint64 backups;
+    qint64 failedBackups;
+    QDateTime lastBackup;         /* the last complete one. */
+    qint64 backupMsecs;           /* it took. */
+    quint64 backupSeq;            /* the seq of the journal it is at. */
+    quint64 primarySeq;           /* the last event committed in the DB. */
+    quint64 shippedSeq;           /* the last event in the standby journal. */
+    qint64 lagEvents;             /* committed, not shipped. */
+    qint64 lagMsecs;              /* since the standby was last up to date. */
+    QString error;                /* of the last backup or shipping, if failed. */
+} standbyStatistics;
+
+/* class which implements the standby copy of the DB in a directory (a
+   stand-in for a remote replica). from time to time it copies the DB
+   through the sql driver (the schema, then the rows of every table in
+   one read transaction), and in between it ships the events of the
+   journal committed since (see EventJournal) to the journal of the
+   copy, all on its own thread and connection.
+
+   the standby directory is a DB with its journal: a writer started on
+   it replays the shipped events past the backup (see DBWriter), so the
+   tickets, the report and the card balances are as recent as the last
+   shipping. the rest (the customers, the vehicles, the payment outbox
+   and the purges) is not journaled and is as recent as the last backup,
+   i.e. at most the backup interval behind (requestBackup() for sooner). */
+class StandbyReplica : public QThread
+{
+    Q_OBJECT
+
+    public:
+        StandbyReplica(const QString &fileName, const QString &directory,
+                       const int backupInterval = DEF_STANDBY_BACKUP_INTERVAL,
+                       const int shipInterval = DEF_STANDBY_SHIP_INTERVAL,
+                       QObject *parent = 0);
+        ~StandbyReplica();
+
+        void requestBackup();
+        void stop();
+
+        standbyStatistics statistics();
+
+    signals:
+        /* a backup is complete (emitted by the standby thread). */
+        void backedUp(const QString &fileName);
+
+    protected:
+        void run();
+
+    private:
+        bool backup(QSqlDatabase db, EventJournal &journal, QString &error);
+        bool copyRows(QSqlDatabase db, const QString &copyFileName, quint64 &seq, QString &error);
+        bool ship(QSqlDatabase db, EventJournal &journal, QString &error);
+
+        QString fileName;
+        QString directory;
+        QString standbyFileName;
+        int backupInterval;
+        int shipInterval;
+
+        QMutex statisticsMutex;
+        standbyStatistics stats;
+        QDateTime upToDate;
+
+        QSemaphore wakeUp;
+        QAtomicInt backupRequested;
+        QAtomicInt stopping;
+};
+
+/* the standby copy of the DB of the application (created from the
+   settings once, not started without a directory). */
+StandbyReplica *standbyReplica();
+
+#endif // STANDBYREPLICA_H
@@ -0,0 +1,460 @@
+/*
+ *  This file implements the tariff engine (compiled tariffs).
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C/C++ library headers. */
+#include <QtCore>
+#include <cmath>
+#include <algorithm>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "tariffengine.h"
+#include "globaldeclarations.h"
+
+/* minutes of a day and of a week (the resolution of the periods). */
+static const int DAY_MINUTES = 1440;
+static const int WEEK_MINUTES = 7 * DAY_MINUTES;
+
+/* the origin of the tariff time, a monday (1900-01-01). */
+static const int TARIFF_ORIGIN_JULIAN_DAY = 2415021;
+
+/* the names of the week days and card types in a tariff. */
+static const char *dayNames[7] = { "mon", "tue", "wed", "thu", "fri", "sat", "sun" };
+static const char *cardNames[TARIFF_CARD_TYPES] = { "no", "simple", "month", "year", "credit" };
+
+/* the tariff of the application settings (a linear charge per timeslice). */
+tariffDefinition
+linearTariff(const appSettings &sets) {
+    tariffDefinition definition;
+
+    definition.rate = sets.chargePerTimeslice * 3600.0 / sets.timeslice;
+    definition.grace = 0;
+    definition.first = 0;
+    definition.firstCharge = 0;
+    definition.dailyCap = 0;
+
+    /* simple cards have a discount of 10%, month/year cards pay their fee. */
+    definition.cardFactors[NoCardType] = 1;
+    definition.cardFactors[SimpleCardType] = 0.9;
+    definition.cardFactors[MonthCardType] = 0;
+    definition.cardFactors[YearCardType] = 0;
+    definition.cardFactors[CreditCardType] = 1;
+
+    return definition;
+}
+
+/* parse a duration (secs or with a s, m, h, d unit). */
+static bool
+parseDuration(const QString &text, int &secs) {
+    QRegExp format("^(\\d+)([smhd]?)$");
+    if (!format.exactMatch(text)) return false;
+
+    const QString unit = format.cap(2);
+    const int factor = unit == "m" ? 60 : unit == "h" ? 3600 : unit == "d" ? TARIFF_DAY_SECS : 1;
+
+    secs = format.cap(1).toInt() * factor;
+
+    return true;
+}
+
+/* parse a time of the day (hh:mm, 24:00 is the end of the day) in minutes. */
+static bool
+parseMinutes(const QString &text, int &minutes) {
+    QRegExp format("^(\\d{1,2}):(\\d{2})$");
+    if (!format.exactMatch(text)) return false;
+
+    minutes = format.cap(1).toInt() * 60 + format.cap(2).toInt();
+
+    return format.cap(2).toInt() < 60 && minutes <= DAY_MINUTES;
+}
+
+/* parse the week days (all, mon, mon-fri, sat,sun) in a bit mask. */
+static bool
+parseDays(const QString &text, int &days) {
+    days = 0;
+
+    if (text == "all") {
+        days = 0x7F;
+        return true;
+    }
+
+    foreach (const QString part, text.split(',')) {
+        const QStringList range = part.split('-');
+        if (range.size() > 2) return false;
+
+        int first = -1, last = -1;
+
+        for (int d = 0; d < 7; d++) {
+            if (range.first() == dayNames[d]) first = d;
+            if (range.last() == dayNames[d]) last = d;
+        }
+
+        if (first < 0 || last < 0) return false;
+
+        /* a range may go past sunday (fri-mon). */
+        for (int d = first; ; d = (d + 1) % 7) {
+            days |= 1 << d;
+            if (d == last) break;
+        }
+    }
+
+    return true;
+}
+
+/* parse a declarative tariff (the directives change the linear tariff). */
+bool
+parseTariff(const QString &text, tariffDefinition &definition, QString &error) {
+    const QStringList lines = text.split('\n');
+
+    for (int n = 0; n < lines.size(); n++) {
+        /* drop the comments and the spaces. */
+        const QString line = lines.at(n).section('#', 0, 0).simplified();
+        if (line.isEmpty()) continue;
+
+        const QStringList words = line.split(' ');
+        const QString directive = words.first();
+
+        bool ok = false;
+
+        if (directive == "rate" && words.size() == 2) {
+            definition.rate = words.at(1).toDouble(&ok);
+        }
+        else if (directive == "period" && words.size() == 4) {
+            tariffPeriod period;
+            const QStringList hours = words.at(2).split('-');
+
+            ok = parseDays(words.at(1), period.days)
+                 && hours.size() == 2
+                 && parseMinutes(hours.first(), period.from)
+                 && parseMinutes(hours.last(), period.to);
+
+            if (ok) period.rate = words.at(3).toDouble(&ok);
+            if (ok) definition.periods << period;
+        }
+        else if (directive == "grace" && words.size() == 2) {
+            ok = parseDuration(words.at(1), definition.grace);
+        }
+        else if (directive == "first" && words.size() == 3) {
+            ok = parseDuration(words.at(1), definition.first);
+            if (ok) definition.firstCharge = words.at(2).toDouble(&ok);
+        }
+        else if (directive == "cap" && words.size() == 2) {
+            definition.dailyCap = words.at(1).toDouble(&ok);
+        }
+        else if (directive == "card" && words.size() == 3) {
+            for (int c = 0; c < TARIFF_CARD_TYPES; c++) {
+                if (words.at(1) == cardNames[c])
+                    definition.cardFactors[c] = words.at(2).toDouble(&ok);
+            }
+        }
+
+        if (!ok) {
+            error = QString("bad tariff directive at line %1: %2").arg(n + 1).arg(line);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* create a free tariff (compile one to use it). */
+TariffEngine::TariffEngine() {
+    starts << 0;
+    rates << 0;
+    prefix << 0;
+    weekTotal = 0;
+    flat = true;
+
+    for (int d = 0; d < 7; d++) cappedDays[d] = 0;
+    cappedWeek = 0;
+
+    grace = 0;
+    first = 0;
+    firstCharge = 0;
+    dailyCap = 0;
+
+    for (int c = 0; c < TARIFF_CARD_TYPES; c++) cardFactors[c] = 0;
+
+    scale = 1;
+}
+
+/* compile a tariff definition (charges rounded to the precision digits). */
+bool
+TariffEngine::compile(const tariffDefinition &definition, const int precision, QString &error) {
+    /* check the definition. */
+    if (definition.rate < 0 || definition.grace < 0 || definition.first < 0
+        || definition.firstCharge < 0 || definition.dailyCap < 0) {
+        error = "a tariff cannot have negative values.";
+        return false;
+    }
+
+    for (int c = 0; c < TARIFF_CARD_TYPES; c++) {
+        if (definition.cardFactors[c] < 0) {
+            error = "a tariff cannot have negative card factors.";
+            return false;
+        }
+    }
+
+    /* paint the rate (per hour) of every minute of the week. */
+    QVector<double> minutes(WEEK_MINUTES, definition.rate);
+
+    foreach (const tariffPeriod &period, definition.periods) {
+        if (period.rate < 0) {
+            error = "a tariff cannot have negative rates.";
+            return false;
+        }
+
+        for (int d = 0; d < 7; d++) {
+            if (!(period.days & (1 << d))) continue;
+
+            /* past midnight it goes on in the next day (sunday in monday). */
+            const int length = period.to > period.from ? period.to - period.from
+                                                       : DAY_MINUTES - period.from + period.to;
+
+            for (int m = 0; m < length; m++)
+                minutes[(d * DAY_MINUTES + period.from + m) % WEEK_MINUTES] = period.rate;
+        }
+    }
+
+    /* merge the equal minutes in steps with the charge before them. */
+    starts.clear();
+    rates.clear();
+    prefix.clear();
+
+    double total = 0;
+
+    for (int m = 0; m < WEEK_MINUTES; m++) {
+        const double rate = minutes.at(m) / 3600.0;
+
+        if (rates.isEmpty() || rates.last() != rate) {
+            starts << m * 60;
+            rates << rate;
+            prefix << total;
+        }
+
+        total += rate * 60;
+    }
+
+    weekTotal = total;
+    flat = starts.size() == 1;
+
+    /* the rest of the definition. */
+    grace = definition.grace;
+    first = definition.first;
+    firstCharge = definition.firstCharge;
+    dailyCap = definition.dailyCap;
+
+    for (int c = 0; c < TARIFF_CARD_TYPES; c++) cardFactors[c] = definition.cardFactors[c];
+
+    /* the charge of the whole days of the week. */
+    cappedWeek = 0;
+
+    for (int d = 0; d < 7; d++) {
+        cappedDays[d] = capped(weekCharge((d + 1) * TARIFF_DAY_SECS) - weekCharge(d * TARIFF_DAY_SECS));
+        cappedWeek += cappedDays[d];
+    }
+
+    scale = pow(10.0, qBound(0, precision, 15));
+
+    return true;
+}
+
+/* the charge of a stay (as the tariff time of its start and end). */
+double
+TariffEngine::charge(const QDateTime &start, const QDateTime &end, const int cardType) const {
+    return charge(tariffTime(start), tariffTime(end), cardType);
+}
+
+/* the charge of a stay between two tariff times for a card type. */
+double
+TariffEngine::charge(const qint64 start, const qint64 end, const int cardType) const {
+    /* the stays in the grace period are free. */
+    if (end - start <= grace || cardType < 0 || cardType >= TARIFF_CARD_TYPES) return 0;
+
+    const double factor = cardFactors[cardType];
+    if (factor == 0) return 0;
+
+    /* the first part of the stay has a flat charge, the rest follows the rates. */
+    double value = first > 0 ? firstCharge + timeCharge(start + first, end)
+                             : timeCharge(start, end);
+
+    /* round the charge of the card to the precision. */
+    return floor(value * factor * scale + 0.5) / scale;
+}
+
+/* the charges of many stays at once (arrays of count tariff times and card
+   types). the flat tariffs without a cap or a first part, the usual ones,
+   are a straight loop of arithmetic without any branch to a binary search
+   the compiler can vectorize, the rest are charged one by one. */
+void
+TariffEngine::charges(const qint64 *start, const qint64 *end, const int *cardType,
+                      double *charge, const int count) const {
+    if (!flat || dailyCap > 0 || first > 0) {
+        for (int i = 0; i < count; i++)
+            charge[i] = this->charge(start[i], end[i], cardType[i]);
+
+        return;
+    }
+
+    const double rate = rates.at(0);
+
+    /* the same arithmetic (and rounding) as charge(). */
+    for (int i = 0; i < count; i++) {
+        const qint64 secs = end[i] - start[i];
+        const int card = cardType[i];
+        const double factor = secs > grace && card >= 0 && card < TARIFF_CARD_TYPES ? cardFactors[card] : 0;
+
+        charge[i] = floor(secs * rate * factor * scale + 0.5) / scale;
+    }
+}
+
+/* the steps of the compiled tariff (the k of O(log k)). */
+int
+TariffEngine::steps() const {
+    return starts.size();
+}
+
+/* the tariff time of a date time: the local secs since monday 1900-01-01. */
+qint64
+TariffEngine::tariffTime(const QDateTime &when) {
+    const QTime time = when.time();
+
+    return tariffTime(when.date().toJulianDay(), time.hour() * 3600 + time.minute() * 60 + time.second());
+}
+
+/* the tariff time of a julian day and the secs of the day. */
+qint64
+TariffEngine::tariffTime(const qint64 julianDay, const int secs) {
+    return (julianDay - TARIFF_ORIGIN_JULIAN_DAY) * TARIFF_DAY_SECS + secs;
+}
+
+/* parse some digits of a text (false if any is not a digit). */
+static bool
+parseDigits(const QString &text, const int from, const int count, int &value) {
+    value = 0;
+
+    for (int i = from; i < from + count; i++) {
+        const QChar c = text.at(i);
+        if (!c.isDigit()) return false;
+
+        value = value * 10 + c.digitValue();
+    }
+
+    return true;
+}
+
+/* parse a stored date (yyyy-MM-dd) and time (hh:mm:ss[.zzz]) in a tariff time
+   without the date/time formatting machinery (for bulk work on many rows). */
+bool
+TariffEngine::parseTariffTime(const QString &date, const QString &time, qint64 &when) {
+    if (date.size() < 10 || time.size() < 8) return false;
+
+    int year, month, day, hour, minute, second;
+
+    if (!parseDigits(date, 0, 4, year) || !parseDigits(date, 5, 2, month) || !parseDigits(date, 8, 2, day)
+        || !parseDigits(time, 0, 2, hour) || !parseDigits(time, 3, 2, minute) || !parseDigits(time, 6, 2, second))
+        return false;
+
+    const QDate valid(year, month, day);
+    if (!valid.isValid() || hour > 23 || minute > 59 || second > 59) return false;
+
+    when = tariffTime(valid.toJulianDay(), hour * 3600 + minute * 60 + second);
+
+    return true;
+}
+
+/* the charge from the origin to a tariff time (the step function integrated). */
+double
+TariffEngine::weekCharge(const qint64 time) const {
+    /* the times before the origin are not charged. */
+    if (time <= 0) return 0;
+
+    const qint64 weeks = time / TARIFF_WEEK_SECS;
+    const int secs = (int) (time % TARIFF_WEEK_SECS);
+
+    /* the last step which starts before the time (the first starts at 0). */
+    const int step = (int) (upper_bound(starts.constBegin(), starts.constEnd(), secs) - starts.constBegin()) - 1;
+
+    return weeks * weekTotal + prefix.at(step) + (secs - starts.at(step)) * rates.at(step);
+}
+
+/* the charge by the rates between two tariff times (with the daily cap). */
+double
+TariffEngine::timeCharge(const qint64 start, const qint64 end) const {
+    if (end <= start) return 0;
+
+    if (dailyCap <= 0) return flat ? (end - start) * rates.at(0) : weekCharge(end) - weekCharge(start);
+
+    /* the days of the start and the end. */
+    const qint64 startDay = start / TARIFF_DAY_SECS;
+    const qint64 endDay = end / TARIFF_DAY_SECS;
+
+    if (startDay == endDay) return capped(weekCharge(end) - weekCharge(start));
+
+    /* the rest of the first day. */
+    double total = capped(weekCharge((startDay + 1) * TARIFF_DAY_SECS) - weekCharge(start));
+
+    /* the whole days between (the day 0 is a monday). */
+    const qint64 days = endDay - startDay - 1;
+    total += (days / 7) * cappedWeek;
+
+    for (int d = 0; d < days % 7; d++) total += cappedDays[(startDay + 1 + d) % 7];
+
+    /* the start of the last day. */
+    total += capped(weekCharge(end) - weekCharge(endDay * TARIFF_DAY_SECS));
+
+    return total;
+}
+
+/* the charge of a day with the daily cap. */
+double
+TariffEngine::capped(const double charge) const {
+    return dailyCap > 0 && charge > dailyCap ? dailyCap : charge;
+}
+
+/* compile the tariff of the settings (its file if any, else the linear one). */
+TariffEngine
+loadTariff(const appSettings &sets, QString *error) {
+    tariffDefinition definition = linearTariff(sets);
+    QString message;
+
+    /* the directives of the file change the linear tariff. */
+    if (!sets.tariffFile.isEmpty()) {
+        QFile file(sets.tariffFile);
+
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            message = QString("cannot read the tariff '%1'.").arg(sets.tariffFile);
+        }
+        else if (!parseTariff(QString::fromUtf8(file.readAll()), definition, message)) {
+            definition = linearTariff(sets);
+        }
+    }
+
+    TariffEngine tariff;
+
+    if (!tariff.compile(definition, sets.chargePrecision, message) || !message.isEmpty()) {
+        /* a broken tariff falls back to the linear one. */
+        QString ignored;
+        tariff.compile(linearTariff(sets), sets.chargePrecision, ignored);
+    }
+
+    if (error) *error = message;
+
+    return tariff;
+}
@@ -0,0 +1,104 @@
+/* header defining the interface of the source. */
+#ifndef TARIFFENGINE_H
+#define TARIFFENGINE_H
+
+/* include some QT libraries. */
+#include <QDateTime>
+#include <QString>
+#include <QList>
+#include <QVector>
+
+/* include header defining the interface of the source. */
+#include "appsettings.h"
+
+/* number of card types (NoCardType ... CreditCardType). */
+static const int TARIFF_CARD_TYPES = 5;
+
+/* secs of a day and of a week (the period of the tariffs). */
+static const int TARIFF_DAY_SECS = 86400;
+static const int TARIFF_WEEK_SECS = 7 * TARIFF_DAY_SECS;
+
+/* tariff period structure data type (a rate at some hours of some days). */
+typedef struct tariffPeriod {
+    int days;             /* bit mask of the week days (monday is bit 0). */
+    int from;             /* minutes of the day (to < from goes past midnight). */
+    int to;
+    double rate;          /* charge per hour. */
+} tariffPeriod;
+
+/* tariff definition structure data type. */
+typedef struct tariffDefinition {
+    double rate;                          /* charge per hour out of any period. */
+    QList<tariffPeriod> periods;          /* the later ones win (night, weekend). */
+    int grace;                            /* secs of a free stay. */
+    int first;                            /* secs of the first part of the stay ... */
+    double firstCharge;                   /* ... charged with a flat charge. */
+    double dailyCap;                      /* most charged per calendar day (0 for none). */
+    double cardFactors[TARIFF_CARD_TYPES];  /* charge factor of every card type. */
+} tariffDefinition;
+
+/* the tariff of the application settings (a linear charge per timeslice). */
+tariffDefinition linearTariff(const appSettings &sets);
+
+/* parse a declarative tariff (one directive per line, # for comments):
+
+     rate 2.0                        charge per hour (default from the settings)
+     period mon-fri 22:00-06:00 1.0  charge per hour at some hours of some days
+     period sat,sun 00:00-24:00 3.0
+     grace 10m                       free stays (s, m, h, d or secs)
+     first 1h 1.5                    flat charge of the first part of a stay
+     cap 20                          most charged per calendar day
+     card simple 0.9                 charge factor of a card type (no, simple,
+                                     month, year, credit) */
+bool parseTariff(const QString &text, tariffDefinition &definition, QString &error);
+
+/* class which implements the tariff engine. a tariff definition is compiled
+   to a step function of the rate over the week with prefix sums of the
+   charge, so the charge of any stay is two binary searches (O(log k) for
+   k steps) and some arithmetic, without any allocation. it is read-only
+   after compile() and can be shared by many threads. */
+class TariffEngine
+{
+    public:
+        TariffEngine();
+
+        bool compile(const tariffDefinition &definition, const int precision, QString &error);
+
+        double charge(const QDateTime &start, const QDateTime &end, const int cardType) const;
+        double charge(const qint64 start, const qint64 end, const int cardType) const;
+
+        void charges(const qint64 *start, const qint64 *end, const int *cardType,
+                     double *charge, const int count) const;
+
+        int steps() const;
+
+        static qint64 tariffTime(const QDateTime &when);
+        static qint64 tariffTime(const qint64 julianDay, const int secs);
+        static bool parseTariffTime(const QString &date, const QString &time, qint64 &when);
+
+    private:
+        double weekCharge(const qint64 time) const;
+        double timeCharge(const qint64 start, const qint64 end) const;
+        double capped(const double charge) const;
+
+        QVector<int> starts;      /* secs of the week where every step starts. */
+        QVector<double> rates;    /* charge per sec of every step. */
+        QVector<double> prefix;   /* charge from the week start to every step. */
+        double weekTotal;
+        bool flat;                /* one rate all the week (a straight product). */
+
+        double cappedDays[7];     /* charge of every whole week day (capped). */
+        double cappedWeek;
+
+        int grace;
+        int first;
+        double firstCharge;
+        double dailyCap;
+        double cardFactors[TARIFF_CARD_TYPES];
+        double scale;             /* 10^precision of the charge. */
+};
+
+/* compile the tariff of the settings (its file if any, else the linear one). */
+TariffEngine loadTariff(const appSettings &sets, QString *error = 0);
+
+#endif // TARIFFENGINE_H
@@ -25,14 +25,25 @@
 #include "transactionform.h"
 #include "paywizard.h"
 #include "globaldeclarations.h"
+#include "querytracer.h"
 #include "appsettings.h"
 #include "arithmetictools.h"
+#include "chargingtools.h"
+#include "cardcache.h"
+#include "dbwriter.h"
+#include "latencymetrics.h"
 
 /* creates the application's transactions gui form and data model. */
-TransactionForm::TransactionForm(const appSettings sets, QWidget *parent) : QDialog(parent) {
+TransactionForm::TransactionForm(const appSettings sets, DBWriter *writer, QWidget *parent) : QDialog(parent) {
     /* store the application's settings. */
     this->sets = sets;
 
+    /* compile the tariff of the settings. */
+    tariff = loadTariff(sets);
+
+    /* store the DB writer of the transactions. */
+    this->writer = writer;
+
     /* create line edits and buddies objects for transaction fields. */
     vehicleEdit = new QLineEdit;
     vehicleLabel = new QLabel(vehicleLabelStr);
@@ -58,17 +69,19 @@ TransactionForm::TransactionForm(const appSettings sets, QWidget *parent) : QDia
 
     /* create the management buttons. */
     completeButton = new QPushButton(completeButtonStr);
+    settleButton = new QPushButton(settleButtonStr);
     deleteButton = new QPushButton(deleteButtonStr);
     closeButton = new QPushButton(closeButtonStr);
 
     /* add the buttons in a button box dialog. */
     buttonBox = new QDialogButtonBox;
     buttonBox->addButton(completeButton, QDialogButtonBox::ActionRole);
+    buttonBox->addButton(settleButton, QDialogButtonBox::ActionRole);
     buttonBox->addButton(deleteButton, QDialogButtonBox::ActionRole);
     buttonBox->addButton(closeButton, QDialogButtonBox::AcceptRole);
 
     /* create the relational table model for the transactions. */
-    tableModel = new QSqlRelationalTableModel(this);
+    tableModel = new TracedRelationalTableModel(this);
 
     /* set the table to select. */
     tableModel->setTable("transacts");
@@ -102,6 +115,7 @@ TransactionForm::TransactionForm(const appSettings sets, QWidget *parent) : QDia
     connect(nextButton, SIGNAL(clicked()), mapper, SLOT(toNext()));
     connect(lastButton, SIGNAL(clicked()), mapper, SLOT(toLast()));
     connect(completeButton, SIGNAL(clicked()), this, SLOT(completeTransaction()));
+    connect(settleButton, SIGNAL(clicked()), this, SLOT(settleTransactions()));
     connect(deleteButton, SIGNAL(clicked()), this, SLOT(deleteTransaction()));
     connect(closeButton, SIGNAL(clicked()), this, SLOT(accept()));
 
@@ -188,11 +202,18 @@ TransactionForm::deleteTransaction() {
     /* get the index of the current transaction selected. */
     const int row = mapper->currentIndex();
 
-    /* remove the transaction. */
-    tableModel->removeRow(row);
+    /* remove the transaction (its zone space is freed by the writer). */
+    writeCommand command = createWriteCommand(Write_Cancel);
+    command.tranId = tableModel->record(row).value(Transaction_Id).toInt();
 
-    /* apply any changes. */
-    mapper->submit();
+    if (writer->execute(command) != ParkingEngine::Gate_Ok) {
+        /* show a message. */
+        QMessageBox::warning(this, infoMsgTitleStr, deleteFailedStr);
+        return;
+    }
+
+    /* the writer removed the transaction, select the rest again. */
+    tableModel->select();
 
     /* if it was the last transaction in the database. */
     if (!tableModel->rowCount()) {
@@ -217,6 +238,10 @@ TransactionForm::completeTransaction() {
     /* if he/she don't want it just return and do nothing. */
     if (r == QMessageBox::No) return;
 
+    /* time the lookups and the pricing (the payment is timed alone). */
+    QElapsedTimer exitTimer;
+    exitTimer.start();
+
     /* get the row of the current transaction selected. */
     const int row = mapper->currentIndex();
 
@@ -241,40 +266,33 @@ TransactionForm::completeTransaction() {
     /* get the start-end date related data. */
     const QDate start_date(record.value(Transaction_StartDate).toDate());
     const QTime start_time(record.value(Transaction_StartTime).toTime());
-    const QDate end_date(QDate::currentDate());
-    const QTime end_time(QTime::currentTime());
+    const QDateTime end(QDateTime::currentDateTime());
 
-    /* calculate time the vehicle exists in the parking. */
-    const int time = calculateTime (start_date, end_date, start_time, end_time);
+    /* calculate the charge of the time the vehicle exists in the parking. */
+    const double charge = tariff.charge (QDateTime(start_date, start_time), end, card_type);
 
-    /* calculate the charge of the transaction. */
-    const double charge = calculateCharge (card_type, time);
+    recordLatency(Latency_Exit, exitTimer.nsecsElapsed() / 1000);
 
-    /* get both customer and vehicle names. */
+    /* get the customer name. */
     const QString cust_name(record.value(Transaction_CustomerId).toString());
-    const QString vehi_name(record.value(Transaction_VehicleId).toString());
 
     /* try to perform the payment. */
     if (!completePayment(card_type, cust_id, cust_name, charge))
         return; /* in case of ignore transaction. */
 
-    /* transaction has been completed.
-       save in report the transaction. */
+    /* transaction has been paid (or the credit card pays it now). store
+       it in the report for future reference and remove it (one commit). */
+    if (!storeInReport (tran_id, end, charge, card_type == CreditCardType ? cust_id : 0)) {
+        /* show a message. */
+        QMessageBox::warning(this, infoMsgTitleStr, transactFailedStr);
+        return;
+    }
 
     /* show a message. */
     QMessageBox::information(this, infoMsgTitleStr, transactSuccessStr);
 
-    /* store the transaction in the report for future reference. */
-    storeInReport (cust_name, vehi_name,
-                   start_date, end_date,
-                   start_time, end_time,
-                   charge);
-
-    /* remove the transaction. */
-    tableModel->removeRow(row);
-
-    /* apply any changes. */
-    mapper->submit();
+    /* the writer removed the transaction, select the rest again. */
+    tableModel->select();
 
     /* if it was the last transaction in the database. */
     if (!tableModel->rowCount()) {
@@ -287,11 +305,60 @@ TransactionForm::completeTransaction() {
     mapper->setCurrentIndex(qMin(row, tableModel->rowCount() - 1));
 }
 
+/* complete all the transactions at once (e.g. the end of an event). */
+void
+TransactionForm::settleTransactions() {
+    /* check if the are any rows in the model. */
+    if (!tableModel->rowCount()) return;
+
+    /* ask him/her if he/she wants to complete all the transactions. */
+    int r = QMessageBox::question(this, infoMsgTitleStr, settleTransactStr, QMessageBox::Yes | QMessageBox::No);
+
+    /* if he/she don't want it just return and do nothing. */
+    if (r == QMessageBox::No) return;
+
+    /* the settlement of all the transactions (one commit). */
+    writeCommand command = createWriteCommand(Write_Settle);
+    command.when = QDateTime::currentDateTime();
+
+    double charge = 0;
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const bool settled = writer->execute(command, &charge) == ParkingEngine::Gate_Ok;
+    QApplication::restoreOverrideCursor();
+
+    if (!settled) {
+        /* show a message. */
+        QMessageBox::warning(this, infoMsgTitleStr, settleFailedStr);
+        return;
+    }
+
+    /* the writer removed the transactions, select the rest again. */
+    tableModel->select();
+
+    /* count the transactions left (the model fetches them lazily). */
+    TracedQuery query;
+    const int left = query.exec("SELECT COUNT(*) FROM transacts") && query.next() ? query.value(0).toInt() : 0;
+
+    /* show a message. */
+    QMessageBox::information(this, infoMsgTitleStr, settleSuccessStr.arg(charge, 0, 'f', sets.chargePrecision).arg(left));
+
+    /* if there are no transactions left. */
+    if (!tableModel->rowCount()) {
+        clearGUI(); /* clear the data from the gui objects .*/
+        lockGUI();  /* lock all gui objects (readonly, disabled). */
+        return;
+    }
+
+    /* select the first transaction left. */
+    mapper->toFirst();
+}
+
 /* get the id of the customer. */
 int
 TransactionForm::getCustomerId (const int tran_id) {
     /* declare a sql query object. */
-    QSqlQuery query;
+    TracedQuery query;
 
     /* prepare a sql query with place holders. */
     query.prepare("SELECT cust.id FROM customer AS cust INNER JOIN transacts AS tran ON cust.id = tran.cust_id WHERE tran.id = :tran_id");
@@ -318,11 +385,20 @@ TransactionForm::getCustomerId (const int tran_id) {
 /* get the money from the card of the customer. */
 double
 TransactionForm::getCardMoney (const int cust_id) {
+    /* the customer's card money (the writer debits it in memory). */
+    double card_money;
+
+    if (writer->balances().balance(cust_id, card_money))
+        return card_money;
+
     /* declare a sql query object. */
-    QSqlQuery query;
+    TracedQuery query;
 
-    /* prepare a sql query with place holders. */
-    query.prepare("SELECT cust.card_money FROM customer AS cust WHERE cust.id = :cust_id");
+    /* prepare a sql query with place holders (the money of the card and
+       the ledger entries not applied to it yet). */
+    query.prepare("SELECT cust.card_money + "
+                  "       IFNULL((SELECT SUM(amount) FROM ledger WHERE ledger.cust_id = cust.id AND ledger.applied = 0), 0) "
+                  "FROM customer AS cust WHERE cust.id = :cust_id");
 
     /* bind values to the query placeholders. */
     query.bindValue(":cust_id", cust_id);
@@ -330,8 +406,8 @@ TransactionForm::getCardMoney (const int cust_id) {
     /* execute the query. */
     query.exec();
 
-    /* the customer's card money (assume not found). */
-    double card_money = -1;
+    /* assume not found. */
+    card_money = -1;
 
     /* try to get the first record. */
     if (query.next())
@@ -344,131 +420,43 @@ TransactionForm::getCardMoney (const int cust_id) {
     return card_money;
 }
 
-/* charge the card of the customer. */
-bool
-TransactionForm::chargeCustomerCard(const int cust_id, const double charge) {
-    /* declare a sql query object. */
-    QSqlQuery query;
-
-    /* prepare a sql query with place holders. */
-    query.prepare("UPDATE customer SET card_money = card_money - :charge WHERE customer.id = :cust_id");
-
-    /* bind values to the query placeholders. */
-    query.bindValue(":cust_id", cust_id);
-    query.bindValue(":charge", charge);
-
-    /* execute the query (return true/false for success/failure). */
-    return query.exec();
-}
-
 /* check and return the card type of the customer. */
 int
 TransactionForm::checkCardType (const int cust_id) {
-    /* declare a sql query object. */
-    QSqlQuery query;
+    /* the card of the customer (read from the DB once). */
+    memberCard card;
 
-    /* prepare a sql query with place holders. */
-    query.prepare("SELECT cust.card_id, cust.card_date FROM customer AS cust WHERE cust.id = :cust_id");
+    if (!cardCache()->find(cust_id, card)) {
+        /* declare a sql query object. */
+        TracedQuery query;
 
-    /* bind values to the query placeholders. */
-    query.bindValue(":cust_id", cust_id);
+        /* prepare a sql query with place holders. */
+        query.prepare("SELECT cust.card_id, cust.card_expiry FROM customer AS cust WHERE cust.id = :cust_id");
 
-    /* execute the query. */
-    query.exec();
-
-    /* the customer's card type (assume not found). */
-    int card_type = ErrorCardType;
-
-    /* try to get the first record. */
-    if (query.next()) {
-        /* get the card type of the customer. */
-        card_type = query.value(0).toInt() - 1; /* for fixing with indexes. */
+        /* bind values to the query placeholders. */
+        query.bindValue(":cust_id", cust_id);
 
-        /* get the possible card date. */
-        const QDate date = query.value(1).toDate();
+        /* execute the query and try to get the first record. */
+        if (!query.exec() || !query.next()) return ErrorCardType;
 
-        /* if the card has date check if it is expired. */
-        if (card_type == MonthCardType) {
-            if ((date.daysTo(QDate::currentDate()) + 1) > 30) { /* plus the card creation day. */
-                /* show a message. */
-                QMessageBox::warning(this, infoMsgTitleStr, cardExpiredStr);
+        /* get the card type and the possible card expiry day of the customer. */
+        card.cardType = query.value(0).toInt() - 1; /* for fixing with indexes. */
+        card.expiry = query.value(1).toLongLong();
 
-                /* card is expired, stop transaction. */
-                card_type = ErrorCardType;
-            }
-        }
-        else if(card_type == YearCardType) {
-            if (date.daysTo(QDate::currentDate()) > date.daysInYear()) {
-                /* show a message. */
-                QMessageBox::warning(this, infoMsgTitleStr, cardExpiredStr);
-
-                /* card is expired, stop transaction. */
-                card_type = ErrorCardType;
-            }
-        }
+        cardCache()->insert(cust_id, card);
     }
 
-    /* return the card type of the customer. */
-    return card_type;
-}
+    /* if the card has an expiry day check if it is expired. */
+    if (isCardExpired(card, QDate::currentDate().toJulianDay())) {
+        /* show a message. */
+        QMessageBox::warning(this, infoMsgTitleStr, cardExpiredStr);
 
-/* calculate time elapsed between start-end dates and times. */
-int
-TransactionForm::calculateTime (const QDate start_date, const QDate end_date,
-                                const QTime start_time, const QTime end_time) {
-    /* create datetime objects. */
-    QDateTime startDateTime, endDateTime;
-
-    /* set to datetime objects the appropriate values. */
-    startDateTime.setDate(start_date);
-    startDateTime.setTime(start_time);
-    endDateTime.setDate(end_date);
-    endDateTime.setTime(end_time);
-
-    /* return the number of timeslices elapsed. */
-    return startDateTime.secsTo(endDateTime);
-}
-
-/* return the charge for the transaction. */
-double
-TransactionForm::calculateCharge (const int card_type, const int time) {
-    /* calculate the base charge. */
-    const double base = (time * sets.chargePerTimeslice) / sets.timeslice;
-
-    /* assume no charge first. */
-    double charge = 0;
-
-    /* according to the card type of the customer. */
-    switch (card_type) {
-        case NoCardType:
-            {
-                /* charge him/her the base charge. */
-                charge = base;
-                break;
-            }
-        case SimpleCardType:
-            {
-                /* charge him/her the base charge with discount. */
-                charge = base - base*0.1;
-                break;
-            }
-        case MonthCardType:
-        case YearCardType:
-            /* no charge. */
-            break;
-        case CreditCardType:
-            {
-                /* charge him/her the base charge. */
-                charge = base;
-                break;
-            }
-        case ErrorCardType: /* in case of an error card type. */
-        default:            /* this should never happen. */
-            break;
+        /* card is expired, stop transaction. */
+        return ErrorCardType;
     }
 
-    /* format the charge of the transaction and return it. */
-    return QString::number(charge, 'f', sets.chargePrecision).toDouble();
+    /* return the card type of the customer. */
+    return card.cardType;
 }
 
 /* try to perform the payment of the transaction. */
@@ -510,9 +498,9 @@ TransactionForm::completePayment(const int card_type, const int cust_id, const Q
                     return false;
                 }
 
-                /* substracts the money from the customer's card
-                   and accept or ignore the transaction payment. */
-                return chargeCustomerCard(cust_id, charge);
+                /* accept the payment, the money is substracted from the
+                   customer's card when the transaction is stored. */
+                return true;
                 break; /* save for future bug. */
             }
         case ErrorCardType: /* in case of an error card type. */
@@ -524,29 +512,23 @@ TransactionForm::completePayment(const int card_type, const int cust_id, const Q
     return false;
 }
 
-/* store in report the transaction. */
-void
-TransactionForm::storeInReport(const QString cust_name, const QString vehi_name,
-                               const QDate start_date, const QDate end_date,
-                               const QTime start_time, const QTime end_time,
-                               const double charge) {
-    /* declare a sql query object. */
-    QSqlQuery query;
-
-    /* prepare a sql query with place holders. */
-    query.prepare("INSERT INTO report (vehicle, start_date, end_date, start_time, end_time, charge, customer) VALUES (:vehi_name, :start_date, :end_date, :start_time, :end_time, :charge, :cust_name)");
-
-    /* bind values to the query placeholders. */
-    query.bindValue(":vehicle", vehi_name);
-    query.bindValue(":start_date", start_date);
-    query.bindValue(":end_date", end_date);
-    query.bindValue(":start_time", start_time);
-    query.bindValue(":end_time", end_time);
-    query.bindValue(":charge", charge);
-    query.bindValue(":customer", cust_name);
-
-    /* execute the query. */
-    query.exec();
+/* store in report the transaction and remove it. the card of the paying
+   customer (none for a transaction paid already) is charged in the same
+   commit, like the exit of a gate. */
+bool
+TransactionForm::storeInReport(const int tran_id, const QDateTime end, const double charge, const int paying_cust_id) {
+    /* time the completion until it is committed. */
+    LatencyTimer timer(paying_cust_id ? Latency_Payment : Latency_Report);
+
+    /* the completion of the transaction. */
+    writeCommand command = createWriteCommand(Write_Close);
+    command.tranId = tran_id;
+    command.custId = paying_cust_id;
+    command.amount = charge;
+    command.when = end;
+
+    /* wait until it is committed (true/false for success/failure). */
+    return writer->execute(command) == ParkingEngine::Gate_Ok;
 }
 
 /* lock (readonly, disable) the gui objects. */
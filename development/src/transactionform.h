@@ -10,6 +10,7 @@
 #include "emptytimeedit.h"
 #include "globaldeclarations.h"
 #include "appsettings.h"
+#include "tariffengine.h"
 
 /* use these classes. */
 class QSqlRelationalTableModel;
@@ -18,6 +19,7 @@ class QDialogButtonBox;
 class QPushButton;
 class QLineEdit;
 class QLabel;
+class DBWriter;
 
 /* GUI string messages. */
 static const QString tranWinTitleStr     = QObject::tr("Manage Transactions");
@@ -26,12 +28,19 @@ static const QString startDateLabelStr   = QObject::tr("&Start Date :");
 static const QString startTimeLabelStr   = QObject::tr("&Start Time :");
 
 static const QString completeButtonStr   = QObject::tr("&Complete Transaction");
+static const QString settleButtonStr     = QObject::tr("Settle &All");
 
 static const QString deleteTransactStr   = QObject::tr("Do you want to delete the transaction?");
 static const QString completeTransactStr = QObject::tr("Do you want to complete the transaction?");
 static const QString cardExpiredStr      = QObject::tr("Customer's card is expired. Renew the card.");
 static const QString notManyCardMoneyStr = QObject::tr("Not enough money in the card because charge is : ");
 static const QString transactSuccessStr  = QObject::tr("The transaction has been completed.");
+static const QString transactFailedStr   = QObject::tr("The transaction could not be stored. Try again.");
+static const QString deleteFailedStr     = QObject::tr("The transaction could not be deleted. Try again.");
+static const QString settleTransactStr   = QObject::tr("Do you want to complete all the transactions now?");
+static const QString settleSuccessStr    = QObject::tr("The transactions have been completed with total charge : %1\n"
+                                                       "Transactions left (expired cards, not enough card money) : %2");
+static const QString settleFailedStr     = QObject::tr("The transactions could not be stored. Try again.");
 
 /* class which implements the transaction gui form and data model. */
 class TransactionForm : public QDialog
@@ -48,32 +57,25 @@ class TransactionForm : public QDialog
             Transaction_StartTime
         } transactionField;
 
-        TransactionForm(const appSettings sets, QWidget *parent = 0);
+        TransactionForm(const appSettings sets, DBWriter *writer, QWidget *parent = 0);
         void done(const int result);
 
     private slots:
         void deleteTransaction();
         void completeTransaction();
+        void settleTransactions();
 
     private:
         int getCustomerId(const int tran_id);
         int checkCardType(const int cust_id);
 
-        int calculateTime(const QDate start_date, const QDate end_date,
-                          const QTime start_time, const QTime end_time);
-
         bool completePayment(const int card_type,
                              const int cust_id,
                              const QString cust_name,
                              const double charge);
 
-        void storeInReport(const QString cust_name, const QString vehi_name,
-                           const QDate start_date, const QDate end_date,
-                           const QTime start_time, const QTime end_time,
-                           const double charge);
+        bool storeInReport(const int tran_id, const QDateTime end, const double charge, const int paying_cust_id);
 
-        bool chargeCustomerCard(const int cust_id, const double charge);
-        double calculateCharge(const int card_type, const int time);
         double getCardMoney (const int cust_id);
 
         void lockGUI();
@@ -81,6 +83,9 @@ class TransactionForm : public QDialog
         void clearGUI();
 
         appSettings sets;
+        TariffEngine tariff;
+
+        DBWriter *writer;
 
         QSqlRelationalTableModel *tableModel;
         QDataWidgetMapper *mapper;
@@ -102,6 +107,7 @@ class TransactionForm : public QDialog
         QPushButton *lastButton;
         QPushButton *deleteButton;
         QPushButton *completeButton;
+        QPushButton *settleButton;
         QPushButton *closeButton;
 
         QDialogButtonBox *buttonBox;
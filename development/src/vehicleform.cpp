@@ -23,12 +23,15 @@
 
 /* include headers defining the interface of the sources. */
 #include "vehicleform.h"
+#include "dbwriter.h"
 #include "globaldeclarations.h"
+#include "querytracer.h"
+#include "latencymetrics.h"
 
 /* creates the application's vehicles gui form and data model. */
-VehicleForm::VehicleForm(const int capacity, int id, QWidget *parent) : QDialog(parent) {
-    /* store the parking capacity value. */
-    this->capacity = capacity;
+VehicleForm::VehicleForm(DBWriter *writer, int id, QWidget *parent) : QDialog(parent) {
+    /* store the DB writer of the transactions. */
+    this->writer = writer;
 
     /* create the appropriate vehicles line edits, labels and set buddies. */
     nameEdit = new QLineEdit;
@@ -63,7 +66,7 @@ VehicleForm::VehicleForm(const int capacity, int id, QWidget *parent) : QDialog(
     connect(closeButton, SIGNAL(clicked()), this, SLOT(accept()));
 
     /* create the relational table model for the vehicles. */
-    tableModel = new QSqlRelationalTableModel(this);
+    tableModel = new TracedRelationalTableModel(this);
 
     /* set the table to select. */
     tableModel->setTable("vehicle");
@@ -215,7 +218,7 @@ VehicleForm::deleteVehicle() {
     const int id = record.value(Vehicle_Id).toInt();
 
     /* declare a sql query object. */
-    QSqlQuery query;
+    TracedQuery query;
 
     /* check if the vehicle is already in the parking. */
     query.exec(QString("SELECT * FROM transacts WHERE vehi_id = %1").arg(id));
@@ -248,86 +251,42 @@ VehicleForm::transactionVehicle() {
     /* check if the are any rows in the model. */
     if (!tableModel->rowCount()) return;
 
-    /* get the row of the current vehicle selected. */
-    const int row = mapper->currentIndex();
+    ParkingEngine::gateResult result;
 
-    /* get the record of the specific vehicle. */
-    const QSqlRecord record = tableModel->record(row);
+    {
+        /* time the entry (not the messages to the user). */
+        LatencyTimer timer(Latency_Entry);
 
-    /* get the id of the vehicle. */
-    const int vehiId = record.value(Vehicle_Id).toInt();
+        /* get the row of the current vehicle selected. */
+        const int row = mapper->currentIndex();
 
-    /* declare a sql query object. */
-    QSqlQuery query;
+        /* get the record of the specific vehicle. */
+        const QSqlRecord record = tableModel->record(row);
 
-    /* check if the vehicle is already in the parking. */
-    query.exec(QString("SELECT * FROM transacts WHERE vehi_id = %1").arg(vehiId));
+        /* get the id of the vehicle. */
+        const int vehiId = record.value(Vehicle_Id).toInt();
 
-    /* try to get the first record. */
-    if (query.next()) {
-        /* show a message. */
-        QMessageBox::information(this, infoMsgTitleStr, vehicleReservedStr);
+        /* the entry of the vehicle (with the same checks as at the gates). */
+        writeCommand command = createWriteCommand(Write_Entry);
+        command.vehiId = vehiId;
+        command.when = QDateTime::currentDateTime();
 
-        /* do nothing more and return. */
-        return;
+        /* start the transaction and wait until it is committed. */
+        result = writer->execute(command);
     }
 
-    /* execute a query to find the number of transactions. */
-    query.exec("SELECT COUNT(*) FROM transacts");
-
-    /* assume zero transactions. */
-    int numTransacts = 0;
-
-    /* try to get the first record. */
-    if (query.next()) {
-        /* get the result from count function. */
-        numTransacts = query.value(0).toInt();
+    switch (result) {
+        case ParkingEngine::Gate_VehicleInParking:
+            /* show a message. */
+            QMessageBox::information(this, infoMsgTitleStr, vehicleReservedStr);
+            break;
+        case ParkingEngine::Gate_NoCapacity:
+            /* show a message. */
+            QMessageBox::information(this, infoMsgTitleStr, noCapacityInDBStr);
+            break;
+        default: /* started or ignored. */
+            break;
     }
-
-    /* check if there is some vehicles capacity left. */
-    if (numTransacts >= capacity) {
-        /* show a message. */
-        QMessageBox::information(this, infoMsgTitleStr, noCapacityInDBStr);
-
-        /* do nothing more and return. */
-        return;
-    }
-
-    /* find the id of the vehicle's customer. */
-
-    /* prepare a sql query with place holders. */
-    query.prepare("SELECT c.id FROM customer AS c INNER JOIN vehicle AS v ON c.id = v.cust_id WHERE v.id = :vehi_id");
-
-    /* bind values to the query placeholders. */
-    query.bindValue(":vehi_id", vehiId);
-
-    /* execute the query. */
-    query.exec();
-
-    /* the vehicle's customer id (assume not found). */
-    int custId = -1;
-
-    /* try to get the first record. */
-    if (query.next())
-        /* get the id of the vehicle's customer. */
-        custId = query.value(0).toInt();
-    else
-        /* ignore the process and do nothing. */
-        return;
-
-    /* start a transaction. */
-
-    /* prepare a sql query with place holders. */
-    query.prepare("INSERT INTO transacts (vehi_id, cust_id, start_date, start_time) VALUES (:vehi_id, :cust_id, :start_date, :start_time)");
-
-    /* bind values to the query placeholders. */
-    query.bindValue(":vehi_id", vehiId);
-    query.bindValue(":cust_id", custId);
-    query.bindValue(":start_date", QDate::currentDate());
-    query.bindValue(":start_time", QTime::currentTime());
-
-    /* execute the query. */
-    query.exec();
 }
 
 /* lock (readonly, disable) the gui objects. */
@@ -13,6 +13,7 @@ class QPushButton;
 class QComboBox;
 class QLineEdit;
 class QLabel;
+class DBWriter;
 
 /* GUI string messages. */
 static const QString vehiWinTitleStr    = QObject::tr("Manage Vehicles");
@@ -39,7 +40,7 @@ class VehicleForm : public QDialog
             Vehicle_CustomerId
         } vehicleField;
 
-        VehicleForm(const int capacity, const int id, QWidget *parent = 0);
+        VehicleForm(DBWriter *writer, const int id, QWidget *parent = 0);
         void done(const int result);
 
     private slots:
@@ -52,7 +53,7 @@ class VehicleForm : public QDialog
         void unlockGUI();
         void clearGUI();
 
-        int capacity;
+        DBWriter *writer;
 
         QSqlRelationalTableModel *tableModel;
         QDataWidgetMapper *mapper;
@@ -0,0 +1,263 @@
+/*
+ *  This file implements the what-if analysis of the tariffs.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT and ANSI C library headers. */
+#include <QtCore>
+#include <QtSql>
+#include <cstring>
+using namespace std;
+
+/* include headers defining the interface of the sources. */
+#include "whatifanalysis.h"
+#include "globaldeclarations.h"
+#include "arithmetictools.h"
+
+/* the names of the card types in the summary. */
+static const char *cardTitles[TARIFF_CARD_TYPES] = { "no card", "simple card", "month card", "year card", "credit card" };
+
+/* class which implements a work item of the analysis (a chunk of sessions). */
+class RepriceTask : public QRunnable
+{
+    public:
+        RepriceTask(const QVector<reportSession> &sessions,
+                    const TariffEngine *baseline, const TariffEngine *candidate,
+                    whatIfSummary *summary, QSemaphore *freeSlots) {
+            this->sessions = sessions;
+            this->baseline = baseline;
+            this->candidate = candidate;
+            this->summary = summary;
+            this->freeSlots = freeSlots;
+        }
+
+        void run() {
+            WhatIfAnalysis::reprice(sessions, *baseline, *candidate, *summary);
+
+            /* the reader may read the next chunk. */
+            freeSlots->release();
+        }
+
+    private:
+        QVector<reportSession> sessions;
+        const TariffEngine *baseline;
+        const TariffEngine *candidate;
+        whatIfSummary *summary;
+        QSemaphore *freeSlots;
+};
+
+/* create the analysis of a candidate tariff against the current one. */
+WhatIfAnalysis::WhatIfAnalysis(const TariffEngine &baseline, const TariffEngine &candidate) {
+    this->baseline = baseline;
+    this->candidate = candidate;
+
+    threads = 0; /* all cores. */
+    chunkRows = DEF_WHATIF_CHUNK_ROWS;
+}
+
+/* set the worker threads (0 for all cores). */
+void
+WhatIfAnalysis::setThreads(const int threads) {
+    this->threads = qMax(threads, 0);
+}
+
+/* set the report rows of a work item. */
+void
+WhatIfAnalysis::setChunkRows(const int rows) {
+    chunkRows = qMax(rows, 1);
+}
+
+/* analyze the report history of the DB (on the caller's connection). */
+bool
+WhatIfAnalysis::run(QSqlDatabase db, whatIfSummary &summary, QString &error) {
+    QElapsedTimer timer;
+    timer.start();
+
+    clearSummary(summary);
+
+    /* the sessions with the current card of their customer (by name, as the report keeps it). */
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    if (!query.exec("SELECT rep.start_date, rep.start_time, rep.end_date, rep.end_time, rep.charge, cust.card_id "
+                    "FROM report AS rep "
+                    "LEFT JOIN (SELECT name, MIN(card_id) AS card_id FROM customer GROUP BY name) AS cust "
+                    "ON cust.name = rep.customer")) {
+        error = query.lastError().text();
+        return false;
+    }
+
+    /* the workers and the chunks in flight (two per worker, the reader never runs far ahead). */
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads > 0 ? threads : QThread::idealThreadCount());
+
+    QSemaphore freeSlots(pool.maxThreadCount() * 2);
+    QList<whatIfSummary *> parts;
+
+    QVector<reportSession> chunk;
+    chunk.reserve(chunkRows);
+
+    bool more = true;
+
+    while (more) {
+        more = query.next();
+
+        if (more) {
+            reportSession session;
+            session.startDate = query.value(0).toString();
+            session.startTime = query.value(1).toString();
+            session.endDate = query.value(2).toString();
+            session.endTime = query.value(3).toString();
+            session.charge = query.value(4).toDouble();
+
+            /* the sessions of removed customers are of the guest (no card). */
+            session.cardType = query.value(5).isNull() ? (int) NoCardType : query.value(5).toInt() - 1;
+
+            chunk << session;
+        }
+
+        /* a full chunk (or the last one) goes to a worker with its own accumulator. */
+        if (chunk.size() == chunkRows || (!more && !chunk.isEmpty())) {
+            freeSlots.acquire();
+
+            whatIfSummary *part = new whatIfSummary;
+            clearSummary(*part);
+            parts << part;
+
+            pool.start(new RepriceTask(chunk, &baseline, &candidate, part, &freeSlots));
+
+            chunk = QVector<reportSession>();
+            chunk.reserve(chunkRows);
+        }
+    }
+
+    pool.waitForDone();
+
+    /* merge the accumulators. */
+    foreach (whatIfSummary *part, parts) {
+        mergeSummary(summary, *part);
+        delete part;
+    }
+
+    summary.msecs = timer.elapsed();
+
+    return true;
+}
+
+/* clear a summary. */
+void
+WhatIfAnalysis::clearSummary(whatIfSummary &summary) {
+    memset(&summary, 0, sizeof(summary));
+}
+
+/* add a summary of some sessions to a total. */
+void
+WhatIfAnalysis::mergeSummary(whatIfSummary &total, const whatIfSummary &part) {
+    total.sessions += part.sessions;
+    total.skipped += part.skipped;
+    total.stored += part.stored;
+    total.baseline += part.baseline;
+    total.candidate += part.candidate;
+    total.increased += part.increased;
+    total.decreased += part.decreased;
+    total.unchanged += part.unchanged;
+    total.largestIncrease = qMax(total.largestIncrease, part.largestIncrease);
+    total.largestDecrease = qMax(total.largestDecrease, part.largestDecrease);
+
+    for (int c = 0; c < TARIFF_CARD_TYPES; c++) {
+        total.cardSessions[c] += part.cardSessions[c];
+        total.cardBaseline[c] += part.cardBaseline[c];
+        total.cardCandidate[c] += part.cardCandidate[c];
+    }
+}
+
+/* re-price some sessions with both tariffs in a summary (a worker's accumulator). */
+void
+WhatIfAnalysis::reprice(const QVector<reportSession> &sessions,
+                        const TariffEngine &baseline, const TariffEngine &candidate,
+                        whatIfSummary &summary) {
+    for (int i = 0; i < sessions.size(); i++) {
+        const reportSession &session = sessions.at(i);
+        qint64 start, end;
+
+        if (session.cardType < 0 || session.cardType >= TARIFF_CARD_TYPES
+            || !TariffEngine::parseTariffTime(session.startDate, session.startTime, start)
+            || !TariffEngine::parseTariffTime(session.endDate, session.endTime, end)) {
+            summary.skipped++;
+            continue;
+        }
+
+        const double current = baseline.charge(start, end, session.cardType);
+        const double proposed = candidate.charge(start, end, session.cardType);
+
+        summary.sessions++;
+        summary.stored += session.charge;
+        summary.baseline += current;
+        summary.candidate += proposed;
+
+        if (isGreaterThan(proposed, current)) {
+            summary.increased++;
+            summary.largestIncrease = qMax(summary.largestIncrease, proposed - current);
+        }
+        else if (isLessThan(proposed, current)) {
+            summary.decreased++;
+            summary.largestDecrease = qMax(summary.largestDecrease, current - proposed);
+        }
+        else {
+            summary.unchanged++;
+        }
+
+        summary.cardSessions[session.cardType]++;
+        summary.cardBaseline[session.cardType] += current;
+        summary.cardCandidate[session.cardType] += proposed;
+    }
+}
+
+/* the printable summary (charges with the precision digits). */
+QString
+WhatIfAnalysis::summaryText(const whatIfSummary &summary, const int precision) {
+    QString text;
+    QTextStream out(&text);
+
+    const double change = summary.candidate - summary.baseline;
+    const double percent = summary.baseline > 0 ? 100.0 * change / summary.baseline : 0;
+
+    out << "sessions: " << summary.sessions << " (" << summary.skipped << " skipped) in "
+        << summary.msecs / 1000.0 << " secs\n";
+    out << "revenue as charged: " << QString::number(summary.stored, 'f', precision) << "\n";
+    out << "revenue with the current tariff: " << QString::number(summary.baseline, 'f', precision) << "\n";
+    out << "revenue with the candidate tariff: " << QString::number(summary.candidate, 'f', precision)
+        << " (" << (change >= 0 ? "+" : "") << QString::number(change, 'f', precision)
+        << ", " << (percent >= 0 ? "+" : "") << QString::number(percent, 'f', 2) << "%)\n";
+    out << "sessions charged more: " << summary.increased
+        << " (at most +" << QString::number(summary.largestIncrease, 'f', precision) << ")\n";
+    out << "sessions charged less: " << summary.decreased
+        << " (at most -" << QString::number(summary.largestDecrease, 'f', precision) << ")\n";
+    out << "sessions charged the same: " << summary.unchanged << "\n";
+
+    for (int c = 0; c < TARIFF_CARD_TYPES; c++) {
+        if (!summary.cardSessions[c]) continue;
+
+        out << cardTitles[c] << ": " << summary.cardSessions[c] << " sessions, "
+            << QString::number(summary.cardBaseline[c], 'f', precision) << " -> "
+            << QString::number(summary.cardCandidate[c], 'f', precision) << "\n";
+    }
+
+    out.flush();
+
+    return text;
+}
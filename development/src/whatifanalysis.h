@@ -0,0 +1,75 @@
+/* header defining the interface of the source. */
+#ifndef WHATIFANALYSIS_H
+#define WHATIFANALYSIS_H
+
+/* include some QT libraries. */
+#include <QString>
+#include <QVector>
+#include <QSqlDatabase>
+
+/* include headers defining the interface of the sources. */
+#include "tariffengine.h"
+
+/* the default report rows of a work item of the analysis. */
+static const int DEF_WHATIF_CHUNK_ROWS = 32768;
+
+/* what-if summary structure data type. */
+typedef struct whatIfSummary {
+    qint64 sessions;                                /* sessions re-priced. */
+    qint64 skipped;                                 /* rows with broken dates. */
+    double stored;                                  /* revenue as charged. */
+    double baseline;                                /* revenue re-priced with the current tariff. */
+    double candidate;                               /* revenue re-priced with the candidate tariff. */
+    qint64 increased;                               /* sessions the candidate charges more ... */
+    qint64 decreased;                               /* ... less ... */
+    qint64 unchanged;                               /* ... the same (than the current tariff). */
+    double largestIncrease;
+    double largestDecrease;
+    qint64 cardSessions[TARIFF_CARD_TYPES];
+    double cardBaseline[TARIFF_CARD_TYPES];
+    double cardCandidate[TARIFF_CARD_TYPES];
+    qint64 msecs;                                   /* wall time of the analysis. */
+} whatIfSummary;
+
+/* report session structure data type (as read, parsed by the workers). */
+typedef struct reportSession {
+    QString startDate;
+    QString startTime;
+    QString endDate;
+    QString endTime;
+    double charge;
+    int cardType;
+} reportSession;
+
+/* class which implements the what-if analysis of a tariff. it streams the
+   report history in chunks, re-prices every session with the current and
+   the candidate tariff in a pool of threads (every work item with its own
+   accumulator, merged at the end) and summarizes the revenue impact. the
+   card type of a session is the current card type of its customer. */
+class WhatIfAnalysis
+{
+    public:
+        WhatIfAnalysis(const TariffEngine &baseline, const TariffEngine &candidate);
+
+        void setThreads(const int threads);
+        void setChunkRows(const int rows);
+
+        bool run(QSqlDatabase db, whatIfSummary &summary, QString &error);
+
+        static void clearSummary(whatIfSummary &summary);
+        static void mergeSummary(whatIfSummary &total, const whatIfSummary &part);
+
+        static void reprice(const QVector<reportSession> &sessions,
+                            const TariffEngine &baseline, const TariffEngine &candidate,
+                            whatIfSummary &summary);
+
+        static QString summaryText(const whatIfSummary &summary, const int precision);
+
+    private:
+        TariffEngine baseline;
+        TariffEngine candidate;
+        int threads;
+        int chunkRows;
+};
+
+#endif // WHATIFANALYSIS_H
@@ -0,0 +1,252 @@
+/*
+ *  This file implements the zones of the parking with their occupancy.
+ *
+ *  Copyright (C) 2010  Efstathios Chatzikyriakidis (stathis.chatzikyriakidis@gmail.com)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* include some QT libraries. */
+#include <QtCore>
+#include <QtSql>
+
+/* include header defining the interface of the source. */
+#include "zonemap.h"
+
+/* allocation rank structure data type (the order of a zone for a card type). */
+typedef struct zoneRank {
+    int priority;
+    int reserved;         /* 1 for a zone reserved for the card type. */
+    int level;
+    int index;
+
+    /* the zone allocated first is the smallest. */
+    bool operator<(const zoneRank &other) const {
+        if (priority != other.priority) return priority > other.priority;
+        if (reserved != other.reserved) return reserved > other.reserved;
+        if (level != other.level) return level < other.level;
+        return index < other.index;
+    }
+} zoneRank;
+
+/* the zones of some ranks in their allocation order. */
+static QVector<int>
+allocationOrder(QList<zoneRank> ranks) {
+    qSort(ranks);
+
+    QVector<int> order;
+
+    foreach (const zoneRank &rank, ranks)
+        order << rank.index;
+
+    return order;
+}
+
+/* create an empty map (no zones, load it before sharing it). */
+ZoneMap::ZoneMap() {
+    zones = 0;
+    count = 0;
+}
+
+/* delete the zones. */
+ZoneMap::~ZoneMap() {
+    delete [] zones;
+}
+
+/* load the zones, their occupancy (the open tickets of every zone) and the
+   allocation order of every card type. not thread safe, call it before the
+   map is shared with the lanes. */
+bool
+ZoneMap::load(QSqlDatabase db) {
+    /* declare a sql query object. */
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    if (!query.exec("SELECT id, name, level, capacity, card_types, priority FROM zone ORDER BY id"))
+        return false;
+
+    QList<int> ids, levels, capacities, priorities;
+    QStringList names;
+    QList<QList<int> > cardTypes;     /* none for an open zone. */
+
+    while (query.next()) {
+        ids << query.value(0).toInt();
+        names << query.value(1).toString();
+        levels << query.value(2).toInt();
+        capacities << qBound(MIN_ZONE_CAPACITY, query.value(3).toInt(), MAX_ZONE_CAPACITY);
+        priorities << query.value(5).toInt();
+
+        /* the card types are stored with their ids ("2,3,4"). */
+        QList<int> types;
+
+        foreach (const QString &id, query.value(4).toString().split(',', QString::SkipEmptyParts))
+            types << id.trimmed().toInt() - 1; /* for fixing with indexes. */
+
+        cardTypes << types;
+    }
+
+    if (query.lastError().isValid()) return false;
+
+    /* the open tickets of every zone. */
+    QHash<int, int> occupied;
+
+    if (!query.exec("SELECT zone_id, COUNT(*) FROM transacts WHERE zone_id IS NOT NULL GROUP BY zone_id"))
+        return false;
+
+    while (query.next())
+        occupied.insert(query.value(0).toInt(), query.value(1).toInt());
+
+    /* the card types known. */
+    QList<int> knownTypes;
+
+    if (!query.exec("SELECT id FROM cardtype"))
+        return false;
+
+    while (query.next())
+        knownTypes << query.value(0).toInt() - 1; /* for fixing with indexes. */
+
+    if (query.lastError().isValid()) return false;
+
+    /* fill the table. */
+    delete [] zones;
+    count = ids.size();
+    zones = count ? new zone[count] : 0;
+
+    indexes.clear();
+    orders.clear();
+
+    for (int i = 0; i < count; i++) {
+        zones[i].id = ids.at(i);
+        zones[i].name = names.at(i);
+        zones[i].level = levels.at(i);
+        zones[i].capacity = capacities.at(i);
+        zones[i].occupied = occupied.value(ids.at(i));
+
+        indexes.insert(ids.at(i), i);
+    }
+
+    /* the order of the open zones (the card types not known). */
+    QList<zoneRank> ranks;
+
+    for (int i = 0; i < count; i++) {
+        if (!cardTypes.at(i).isEmpty()) continue;
+
+        zoneRank rank = { priorities.at(i), 0, levels.at(i), i };
+        ranks << rank;
+    }
+
+    openOrder = allocationOrder(ranks);
+
+    /* the order of every card type (its reserved zones and the open ones). */
+    foreach (const int type, knownTypes) {
+        ranks.clear();
+
+        for (int i = 0; i < count; i++) {
+            const bool reserved = cardTypes.at(i).contains(type);
+            if (!reserved && !cardTypes.at(i).isEmpty()) continue;
+
+            zoneRank rank = { priorities.at(i), reserved ? 1 : 0, levels.at(i), i };
+            ranks << rank;
+        }
+
+        orders.insert(type, allocationOrder(ranks));
+    }
+
+    return true;
+}
+
+/* check if the parking has no zones (the capacity of the settings is used). */
+bool
+ZoneMap::isEmpty() const {
+    return !count;
+}
+
+/* allocate a space for a vehicle of a card type in the first zone of its
+   order with a free space (any thread). the zone id or -1 if they are full. */
+int
+ZoneMap::allocate(const int cardType) {
+    const QHash<int, QVector<int> >::const_iterator found = orders.constFind(cardType);
+    const QVector<int> &order = found != orders.constEnd() ? found.value() : openOrder;
+
+    foreach (const int i, order) {
+        zone &z = zones[i];
+
+        forever {
+            const int current = z.occupied;
+            if (current >= z.capacity) break;
+
+            /* only if nobody took a space since we read it. */
+            if (z.occupied.testAndSetOrdered(current, current + 1)) return z.id;
+        }
+    }
+
+    return -1;
+}
+
+/* release the space of a vehicle in a zone (any thread). */
+void
+ZoneMap::release(const int zoneId) {
+    if (!indexes.contains(zoneId)) return;
+
+    zone &z = zones[indexes.value(zoneId)];
+
+    forever {
+        const int current = z.occupied;
+        if (current <= 0) return;
+
+        if (z.occupied.testAndSetOrdered(current, current - 1)) return;
+    }
+}
+
+/* the spaces of all the zones. */
+qint64
+ZoneMap::capacity() const {
+    qint64 spaces = 0;
+
+    for (int i = 0; i < count; i++)
+        spaces += zones[i].capacity;
+
+    return spaces;
+}
+
+/* the spaces taken in all the zones (any thread). */
+qint64
+ZoneMap::occupied() const {
+    qint64 taken = 0;
+
+    for (int i = 0; i < count; i++)
+        taken += (int) zones[i].occupied;
+
+    return taken;
+}
+
+/* the zones as they are now (any thread). */
+QList<zoneOccupancy>
+ZoneMap::occupancy() const {
+    QList<zoneOccupancy> result;
+
+    for (int i = 0; i < count; i++) {
+        zoneOccupancy z;
+
+        z.id = zones[i].id;
+        z.name = zones[i].name;
+        z.level = zones[i].level;
+        z.capacity = zones[i].capacity;
+        z.occupied = zones[i].occupied;
+
+        result << z;
+    }
+
+    return result;
+}
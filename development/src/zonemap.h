@@ -0,0 +1,75 @@
+/* header defining the interface of the source. */
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+
+/* include some QT libraries. */
+#include <QAtomicInt>
+#include <QSqlDatabase>
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QVector>
+
+/* the maximum, minimum capacity of a zone (a site has any number of zones). */
+static const int MAX_ZONE_CAPACITY = 100000;
+static const int MIN_ZONE_CAPACITY = 0;   /* closed. */
+
+/* zone occupancy structure data type (a zone as it is now). */
+typedef struct zoneOccupancy {
+    int id;
+    QString name;
+    int level;            /* floor of the garage (0 for the ground). */
+    int capacity;
+    int occupied;
+} zoneOccupancy;
+
+/* class which implements the zones of the parking (levels, EV bays,
+   reserved member zones) with their occupancy in memory. a zone has a
+   capacity and may be reserved for some card types, the rest are open
+   to every vehicle.
+
+   a vehicle entering is allocated the first zone of its card type with a
+   free space: the zones of higher priority first, then the zones reserved
+   for its card (so the open spaces are kept for the guests), then the
+   lower levels. the order of every card type is computed by load(), and
+   the occupancy of every zone is an atomic integer taken with
+   compare-and-swap, so any number of lanes allocate without locks and a
+   zone is never over its capacity. the table is filled by load() before
+   it is shared, like BalanceLedger. */
+class ZoneMap
+{
+    public:
+        ZoneMap();
+        ~ZoneMap();
+
+        bool load(QSqlDatabase db);
+        bool isEmpty() const;
+
+        int allocate(const int cardType);
+        void release(const int zoneId);
+
+        qint64 capacity() const;
+        qint64 occupied() const;
+        QList<zoneOccupancy> occupancy() const;
+
+    private:
+        /* zone of the table structure data type. */
+        struct zone {
+            int id;
+            QString name;
+            int level;
+            int capacity;
+            QAtomicInt occupied;
+        };
+
+        zone *zones;
+        int count;
+
+        QHash<int, int> indexes;                /* index of every zone id. */
+        QHash<int, QVector<int> > orders;       /* the zones of every card type, in allocation order. */
+        QVector<int> openOrder;                 /* the open zones (for any other card type). */
+
+        Q_DISABLE_COPY(ZoneMap)
+};
+
+#endif // ZONEMAP_H